@@ -0,0 +1,53 @@
+//
+// Created by Kilig on 2025/6/1.
+//
+#pragma once
+
+#ifndef JOKER_ARENA_H
+#define JOKER_ARENA_H
+#include <stdalign.h>
+
+#include "common.h"
+
+#define ARENA_BLOCK_SIZE    (64 * 1024)     // 默认块大小, 更大的请求单独成块
+#define ARENA_ALIGNMENT     16
+
+/*
+* 编译期 arena: 一次 compile() 中编译器 / 窥孔优化的临时数组都从这里顺序分配,
+* 编译结束后 arena_free 整体释放, 不逐个 free, 也不经过 reallocate(不计入 gc 统计, 不会触发 gc).
+*
+* 块按分配顺序串成链表; arena_save / arena_restore 回退到之前的位置,
+* 回退掉的块留作备用, 后面的分配直接复用.
+*/
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;                    // data 的字节数
+    alignas(ARENA_ALIGNMENT) char data[];
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock* head;
+    ArenaBlock* current;            // NULL 表示还没有分配过
+    char* cursor;
+    char* limit;
+    size_t block_count;
+} Arena;
+
+typedef struct ArenaMark {
+    ArenaBlock* block;
+    char* cursor;
+} ArenaMark;
+
+void arena_init(Arena* self);
+void arena_free(Arena* self);
+
+void* arena_alloc(Arena* self, size_t size);
+void* arena_grow(Arena* self, void* pointer, size_t old_size, size_t new_size);
+ArenaMark arena_save(Arena* self);
+void arena_restore(Arena* self, ArenaMark mark);
+
+#define macro_arena_allocate(arena, type, count) \
+    (type*)arena_alloc(arena, sizeof(type) * (count))
+
+#endif //JOKER_ARENA_H
@@ -0,0 +1,31 @@
+//
+// Created by Kilig on 2025/6/8.
+//
+#pragma once
+
+#ifndef JOKER_BOXED_I64_H
+#define JOKER_BOXED_I64_H
+
+#include "common.h"
+#include "object.h"
+
+#define macro_as_boxed_i64_from_obj(obj)		((BoxedI64*)obj)
+
+/* NaN-boxing 下放不进 48 bit payload 的 i64 装箱到堆上(见 value.h), 由 gc 管理.
+*
+* 装箱值只是 i64 的另一种表示: Value 的类型仍是 VAL_I64, 不是对象(macro_is_obj 为 false),
+* 只有 gc 通过 macro_is_gc_ref 看得到它. 新装箱的值和新字符串一样, 在再次分配之前必须放进 gc 根(栈 / 已可达对象).
+*/
+typedef struct BoxedI64 {
+    Object base;
+    int64_t value;
+} BoxedI64;
+
+
+BoxedI64 *new_boxed_i64(VirtualMachine *vm, int64_t value);
+void free_boxed_i64(BoxedI64 *self);
+bool boxed_i64_equal(BoxedI64 *left, BoxedI64 *right);
+void print_boxed_i64(BoxedI64 *self);
+int snprintf_boxed_i64(BoxedI64 *self, char *buf, size_t size);
+
+#endif //JOKER_BOXED_I64_H
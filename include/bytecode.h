@@ -0,0 +1,119 @@
+//
+// Created by Kilig on 2025/6/8.
+//
+#pragma once
+
+#ifndef JOKER_BYTECODE_H
+#define JOKER_BYTECODE_H
+#include "common.h"
+
+#define bytecode_magic          "JKC"           // 含结尾 '\0' 共 4 字节
+#define bytecode_version        2               // 格式变化(字段增减, 指令编码变化)时加一
+#define bytecode_extension      ".jkc"
+
+/*
+* 字节码缓存(.jkc): 编译得到的 Fn 树序列化到文件, 下次运行跳过扫描 / 解析 / 编译.
+*
+* 文件布局(小端, 定长整数):
+*   header   magic[4] version:u16 op_count:u16 flags:u32
+*            source_size:u64 source_mtime:i64 source_hash:u64
+*   fn       arity:i32 upvalue_count:i32 max_stack:i32(加载时不用) name:string(长度 -1 表示匿名)
+*            code_count:i32 code[code_count]
+*            pad[0..3] line_count:i32 (line:i32 count:i32)[line_count]
+*                                                                  补 0 对齐到 4 字节, RleLine 数组原样保存
+*            cache_count:i32                                       内联缓存是运行时状态, 只记个数
+*            constant_count:i32 (kind:u8 payload)[constant_count]  kind 见 BytecodeConstant, 嵌套的 Fn 递归写
+*
+* 失效: op_count 或 flags(寄存器模式会改变生成的指令)与当前虚拟机不同时不用;
+* 源码大小与修改时间(秒)都没变直接用, 否则读源码比较哈希, 内容没变也可以用.
+* 同一秒内改动且长度不变的源码只靠哈希发现不了, 与 mtime 一起判断时会被当作没变(同 CPython .pyc).
+*
+* 加载时整个文件只读 mmap(私有映射, 同一个 .jkc 的多个进程共享物理页), 指令和行号表就地使用,
+* 不拷贝: chunk.is_mapped 置位, 这些 chunk 不释放也不改写它们的 code / lines(虚拟机不再做指令 deopt 回写).
+* 映像挂在 vm->images 上, 虚拟机销毁时(所有 Fn 释放之后)才解除映射.
+* 映像内容不可信: 每个 Fn 读出来之后校验操作码、操作数下标和跳转目标, max_stack 重新分析,
+* 任何一项不对整个映像作废, 退回重新编译源码.
+* 字符串常量仍然拷贝进 String 并驻留: String 是带 gc 标记位的可变对象, 且按指针比较依赖驻留.
+* 没有 mmap 的平台退化为整个读进内存, 同样保留到虚拟机销毁.
+*/
+
+typedef enum BytecodeConstant {
+    bytecode_constant_i32,
+    bytecode_constant_i64,
+    bytecode_constant_f32,
+    bytecode_constant_f64,
+    bytecode_constant_string,
+    bytecode_constant_fn,
+} BytecodeConstant;
+
+typedef struct BytecodeImage {
+    struct BytecodeImage* next;
+    uint8_t* base;
+    size_t size;
+    bool is_mapped;             // false: malloc 的缓冲(没有 mmap 的平台)
+} BytecodeImage;
+
+typedef struct SourceStamp {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+} SourceStamp;
+
+/* 写缓冲: 整个文件先写进内存, 最后一次写出 */
+typedef struct BytecodeWriter {
+    uint8_t* data;
+    size_t count;
+    size_t capacity;
+} BytecodeWriter;
+
+/* 读游标: 越界或格式不对时 ok 置 false, 之后的读取都返回 0 */
+typedef struct BytecodeReader {
+    const uint8_t* base;        // 映像起点(页对齐), 对齐按相对它的偏移算
+    const uint8_t* cursor;
+    const uint8_t* end;
+    bool ok;
+} BytecodeReader;
+
+uint64_t hash_source(const char* source, size_t size);
+bool stamp_source(const char* path, const char* source, SourceStamp* stamp);
+char* image_path(const char* source_path, const char* extension);
+bool has_extension(const char* path, const char* extension);
+char* bytecode_path(const char* source_path);
+bool is_bytecode_path(const char* path);
+
+bool save_bytecode(VirtualMachine* vm, Fn* fn, const SourceStamp* stamp, const char* path);
+Fn* load_bytecode(VirtualMachine* vm, const char* path, const char* source_path);
+void free_bytecode_images(VirtualMachine* vm);
+
+/* 映像的编码与映射, 堆快照(snapshot.h)沿用同样的文件头、Fn 记录和加载方式 */
+void put_bytes(BytecodeWriter* self, const void* bytes, size_t size);
+void put_u8(BytecodeWriter* self, uint8_t value);
+void put_u16(BytecodeWriter* self, uint16_t value);
+void put_u32(BytecodeWriter* self, uint32_t value);
+void put_u64(BytecodeWriter* self, uint64_t value);
+void put_i32(BytecodeWriter* self, int32_t value);
+void put_align(BytecodeWriter* self, size_t align);
+void put_string(BytecodeWriter* self, String* string);
+bool put_fn(BytecodeWriter* self, Fn* fn);
+void put_header(BytecodeWriter* self, VirtualMachine* vm, const char* magic, uint16_t version,
+                const SourceStamp* stamp);
+bool write_image(BytecodeWriter* self, const char* path);
+
+const uint8_t* get_bytes(BytecodeReader* self, size_t size);
+void get_align(BytecodeReader* self, size_t align);
+uint8_t get_u8(BytecodeReader* self);
+uint16_t get_u16(BytecodeReader* self);
+uint32_t get_u32(BytecodeReader* self);
+uint64_t get_u64(BytecodeReader* self);
+int32_t get_i32(BytecodeReader* self);
+int get_count(BytecodeReader* self, size_t element_size);
+String* get_string(VirtualMachine* vm, BytecodeReader* self);
+Fn* get_fn(VirtualMachine* vm, BytecodeReader* self, int depth);
+bool get_header(BytecodeReader* self, VirtualMachine* vm, const char* magic, uint16_t version,
+                const char* source_path);
+
+bool map_image(const char* path, BytecodeImage* image);
+void unmap_image(BytecodeImage* image);
+void keep_image(VirtualMachine* vm, const BytecodeImage* image);
+
+#endif //JOKER_BYTECODE_H
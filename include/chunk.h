@@ -62,8 +62,8 @@ typedef enum OpCode {
     op_set_upvalue,         // 33    16 bit(set_upvalue + index)
 
     // 面向对象操作
-    op_get_property,        // 34    16 bit(get_property + index)
-    op_set_property,        // 35    16 bit(set_property + index)
+    op_get_property,        // 34    32 bit(get_property + index + cache[high 8 bit, low 8 bit])
+    op_set_property,        // 35    32 bit(set_property + index + cache[high 8 bit, low 8 bit])
     op_get_super,           // 36    16 bit(get_super + index)
     op_get_layer_property,  // 37    16 bit(get_layer_property + index)
     op_get_type,            // 38    16 bit(get_type + index)
@@ -90,7 +90,7 @@ typedef enum OpCode {
     op_class,               // 51    16 bit(class + index)
     op_method,              // 52    16 bit(method + index)
     op_inherit,             // 53     8 bit(inherit)
-    op_invoke,              // 54    24 bit(invoke + callee_index + arg_count)
+    op_invoke,              // 54    40 bit(invoke + callee_index + arg_count + cache[high 8 bit, low 8 bit])
     op_super_invoke,        // 55    24 bit(super_invoke + callee_index + arg_count)
     op_struct,              // 56    16 bit(struct + index)
     op_member,              // 57    16 bit(member + index)
@@ -108,9 +108,66 @@ typedef enum OpCode {
     op_vector_new,          // 65    16 bit(vector_init + element_count)
     op_vector_set,          // 66    24 bit(vector_set + index + set_value)
     op_vector_get,          // 67    16 bit(vector_get + index)
+
+    // 寄存器指令(register mode): A = 目标寄存器, B/C = RK 操作数
+    op_r_move,              // 68    24 bit(r_move + A + B)
+    op_r_add,               // 69    32 bit(r_add + A + B + C)
+    op_r_subtract,          // 70    32 bit(r_subtract + A + B + C)
+    op_r_multiply,          // 71    32 bit(r_multiply + A + B + C)
+    op_r_divide,            // 72    32 bit(r_divide + A + B + C)
+    op_r_mod,               // 73    32 bit(r_mod + A + B + C)
+    op_r_equal,             // 74    32 bit(r_equal + A + B + C)
+    op_r_not_equal,         // 75    32 bit(r_not_equal + A + B + C)
+    op_r_less,              // 76    32 bit(r_less + A + B + C)
+    op_r_less_equal,        // 77    32 bit(r_less_equal + A + B + C)
+    op_r_greater,           // 78    32 bit(r_greater + A + B + C)
+    op_r_greater_equal,     // 79    32 bit(r_greater_equal + A + B + C)
+
+    // 类型特化指令: 操作数静态类型已知(类型标注/字面量), 运行时类型不符时 deopt 回通用指令
+    op_add_i32,             // 80     8 bit(+, i32)
+    op_subtract_i32,        // 81     8 bit(-, i32)
+    op_multiply_i32,        // 82     8 bit(*, i32)
+    op_equal_i32,           // 83     8 bit(==, i32)
+    op_not_equal_i32,       // 84     8 bit(!=, i32)
+    op_less_i32,            // 85     8 bit(<, i32)
+    op_less_equal_i32,      // 86     8 bit(<=, i32)
+    op_greater_i32,         // 87     8 bit(>, i32)
+    op_greater_equal_i32,   // 88     8 bit(>=, i32)
+    op_add_f64,             // 89     8 bit(+, f64)
+    op_subtract_f64,        // 90     8 bit(-, f64)
+    op_multiply_f64,        // 91     8 bit(*, f64)
+    op_divide_f64,          // 92     8 bit(/, f64)
+    op_less_f64,            // 93     8 bit(<, f64)
+    op_less_equal_f64,      // 94     8 bit(<=, f64)
+    op_greater_f64,         // 95     8 bit(>, f64)
+    op_greater_equal_f64,   // 96     8 bit(>=, f64)
+
+    // 比较 + 条件跳转融合(compare_i32 + jump_if_false), 栈效果与两条指令相同
+    op_less_jump_i32,           // 97    24 bit(less_jump_i32 + offset)
+    op_less_equal_jump_i32,     // 98    24 bit(less_equal_jump_i32 + offset)
+    op_greater_jump_i32,        // 99    24 bit(greater_jump_i32 + offset)
+    op_greater_equal_jump_i32,  // 100   24 bit(greater_equal_jump_i32 + offset)
+
+    // 超级指令: 由 peephole_optimize() 在函数编译完成后合并常见指令序列得到
+    op_get_local_local,         // 101   24 bit(get_local_local + slot + slot)
+    op_add_local_local,         // 102   24 bit(add_local_local + slot + slot)
+    op_compare_local_constant_jump, // 103   48 bit(compare_local_constant_jump + slot + constant + operator + offset)
+    op_get_self_property,       // 104   32 bit(get_self_property + index + cache[high 8 bit, low 8 bit])
     OP_COUNT,               //       op count
 } OpCode;
 
+/*
+ * 寄存器指令操作数(RK 编码, 同 Lua):
+ *  - 寄存器即当前帧的 slot(frame->slots[r]), r < 128
+ *  - 最高位置 1 表示常量池下标(k < 128)
+ *  - A == reg_push 表示结果压栈, 供后续栈指令继续使用
+ */
+#define reg_max                 0x80
+#define reg_push                0xFF
+#define macro_rk_is_constant(rk)    ((rk) & 0x80)
+#define macro_rk_index(rk)          ((rk) & 0x7F)
+#define macro_rk_constant(index)    ((uint8_t)((index) | 0x80))
+
 /*
  * RLE行号压缩结构
  * 用于高效存储代码行号信息
@@ -131,6 +188,34 @@ void init_rle_lines(RleLines* lines);
 void free_rle_lines(VirtualMachine* vm, RleLines* rle_lines);
 line_t get_rle_line(RleLines* lines, index_t code_count);
 
+/*
+ * InlineCache: 调用点内联缓存
+ * op_get_property / op_set_property / op_invoke 每个调用点占用一个 cache,
+ * 以 (class, class version, shape) 为 key, 缓存字段 slot 或已解析的方法.
+ * op_method / op_inherit 修改 class 时更新 class->version, 旧 entry 自然失效.
+ */
+#define inline_cache_ways 4        // 多态缓存路数, 超出后轮换替换
+
+typedef struct InlineCacheEntry {
+    Class* klass;
+    uint32_t version;   // 填充时的 klass->version
+    Shape* shape;
+    int slot;           // 字段 slot, -1 表示 method
+    Value method;       // slot == -1 时已解析的方法(closure / native)
+} InlineCacheEntry;
+
+typedef struct InlineCache {
+    uint8_t count;      // 已填充 entry 数
+    uint8_t next;       // 满后下一个替换位置
+    InlineCacheEntry entries[inline_cache_ways];
+} InlineCache;
+
+typedef struct InlineCaches {
+    int count;
+    int capacity;
+    InlineCache* caches;
+} InlineCaches;
+
 /*
  * Chunk: 字节码块
  * 包含指令序列、行号信息和常量池
@@ -142,6 +227,8 @@ typedef struct Chunk {
     uint8_t* code;             // 指令数组（操作码 | 操作数）
     RleLines lines;            // RLE压缩的行号信息
     Values constants;          // 常量池
+    InlineCaches caches;       // 调用点内联缓存
+    bool is_mapped;            // code / lines 直接指向只读映射的字节码映像(bytecode.h), 不归 chunk 释放, 运行时也不改写
 } Chunk;
 
 // Chunk操作函数
@@ -150,5 +237,13 @@ void free_chunk(Chunk* chunk);
 void write_chunk(Chunk* chunk, uint8_t code, line_t line);
 index_t add_constant(Chunk* chunk, Value value);
 void write_constant(Chunk* chunk, Value value, line_t line);
+index_t add_inline_cache(Chunk* chunk);
+void truncate_chunk(Chunk* chunk, int count);
+
+// 指令解码(peephole / 栈深度分析 / 字节码映像校验共用)
+int instruction_fixed_length(uint8_t opcode);
+int instruction_length(Chunk* chunk, int offset);
+int jump_direction(uint8_t opcode);
+int jump_target(Chunk* chunk, int offset, int length);
 
 #endif //JOKER_CHUNK_H
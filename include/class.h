@@ -8,6 +8,7 @@
 #include "common.h"
 #include "hashmap.h"
 #include "object.h"
+#include "shape.h"
 
 #define macro_is_class(value)            is_obj_type(value, OBJ_CLASS)
 #define macro_as_class(value)        ((Class*)macro_as_obj(value))
@@ -19,6 +20,8 @@ typedef struct Class {
     Object base;
     String* name;
     HashMap methods;
+    uint32_t version;   // methods 变化时更新, 用于 inline cache 失效
+    Shape root_shape;   // instance 字段布局 transition 树的根
 } Class;
 
 Class* new_class(VirtualMachine *vm, String* name);
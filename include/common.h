@@ -19,7 +19,7 @@
 #define deprecated_print_keyword true
 
 
-/* TODO: OPTIMIZE */
+/* NaN-boxing Value(8 bytes): enable by cmake -DJOKER_NAN_BOXING=ON */
 // #define NAN_BOXING
 
 typedef int index_t;
@@ -46,7 +46,6 @@ typedef struct Scanner Scanner;
 typedef struct String String;
 typedef struct Token Token;
 typedef struct TokenNode TokenNode;
-typedef struct TokenList TokenList;
 typedef struct Upvalue Upvalue, *UpvaluePtr, **UpvaluePtrs;
 #ifdef NAN_BOXING
 typedef uint64_t Value;
@@ -70,6 +69,7 @@ typedef struct Class Class;
 typedef struct Instance Instance;
 typedef struct ClassCompiler ClassCompiler;
 typedef struct Struct Struct;
+typedef struct Shape Shape;
 typedef struct Member Member;
 typedef struct ObjectVTable ObjectVTable;
 
@@ -103,9 +103,12 @@ typedef struct JokerConsole JokerConsole;
 #define debug_print_allocations false       // print allocations
 #define debug_stress_gc         false       // stress gc
 #define debug_log_gc            false       // log gc
+#define debug_check_stack       false       // check stack bounds on every push / pop
 
 #define debug_enable_allocator  false
 #define debug_trace_allocator   false
+#define debug_pool_probe        false       // print pool alloc probe (hot path)
+#define debug_pool_leak_abort   false       // abort in pool_destroy when alloc / free counts differ
 
 
 /* optional struct Option {Some, None} */
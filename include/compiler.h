@@ -16,8 +16,35 @@ typedef struct LocalVariable {
 	Token name;
 	int depth;
 	bool is_captured;
+	uint8_t type;                   // 静态类型(ValueType, 来自类型标注或初始化表达式), type_unknown 未知
 } LocalVariable;
 
+#define type_unknown ((uint8_t)VALUE_COUNT)
+
+/*
+ * TypedSpan: chunk 末尾一段"恰好压入一个值"的直线代码及其静态类型.
+ * 相邻的两段即二元运算的左右操作数, 据此发出类型特化指令.
+ */
+typedef struct TypedSpan {
+    int start;
+    int end;
+    uint8_t type;
+} TypedSpan;
+
+#define typed_span_max 8
+
+/*
+ * ConstantSpan: chunk 末尾一条字面量指令(op_constant / op_true / op_false / op_none)及其值.
+ * 运算符的操作数都是字面量时在编译期求值(常量折叠), 条件是字面量时丢弃不可达的分支.
+ */
+typedef struct ConstantSpan {
+    int start;
+    int end;
+    Value value;
+} ConstantSpan;
+
+#define constant_span_max 8
+
 /*
  * Loop {       <- outer start
  *      Loop {  <- inner start
@@ -27,7 +54,8 @@ typedef struct LocalVariable {
  */
 typedef struct Loop {
     int start;                      // 循环开始的位置
-    int end;                        // break 指令的跳转位置
+    int breaks[uint8_count];        // 每条 break 的跳转偏移, 循环结束时逐个回填
+    int break_count;
     struct Loop* enclosing;         // 包围的循环信息
 } Loop;
 void begin_loop(Compiler* self, Loop *curr_loop, int start);
@@ -60,6 +88,19 @@ typedef struct Compiler {
 	upvalue_info_t upvalues[upvalue_index_count];   // function used local variable upvalue info list
 
     Loop* loop;                                     // loop info
+
+    /* register mode: 栈指令回收为 3-address 指令时需要的发射记录(chunk 偏移, -1 表示无) */
+    int reg_operands[2];                            // 最近两条 RK 操作数指令(op_get_local / op_constant)
+    int reg_last_op;                                // 最近一条结果压栈(reg_push)的寄存器指令
+    int reg_last_set;                               // 最近一条 op_set_local
+    int jump_target;                                // 最近回填的跳转目标, 不能回收跨过它的指令
+
+    TypedSpan typed[typed_span_max];                // 编译期类型栈(类型特化指令)
+    int typed_count;
+    int typed_last_op;                              // 最近一条特化比较指令(比较 + 跳转融合)
+
+    ConstantSpan constants[constant_span_max];      // 编译期常量栈(常量折叠)
+    int constant_count;
 } Compiler;
 
 Fn* compile(VirtualMachine* vm, const char* source);
@@ -73,4 +114,6 @@ void compile_end_scope(Compiler* self);
 
 void print_locals(Compiler* self);
 
+int compute_max_stack(Chunk* chunk, int arity);
+
 #endif //JOKER_COMPILER_H
@@ -39,6 +39,7 @@ typedef struct Fn {
 	Chunk chunk;
 	String* name;
 	int upvalue_count;
+	int max_stack;		// 相对 frame->slots 的最大栈深度(含 slot 0 与参数), 由 compute_max_stack 得出
 } Fn;
 
 Fn* new_fn(VirtualMachine* vm);
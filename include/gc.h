@@ -6,7 +6,93 @@
 #ifndef JOKER_GC_H
 #define JOKER_GC_H
 #include "common.h"
+#include "object.h"
+#include "slab.h"
+#include "pool.h"
 #define GC_HEAP_GROW_FACTOR 2
+#define GC_NURSERY_SIZE     (512 * 1024)    // 新生代分配预算: 超过后做一次 minor gc
+#define GC_STEP_SIZE        (64 * 1024)     // 增量模式: 每分配这么多字节推进一步
+#define GC_PARALLEL_MIN_HEAP (4 * 1024 * 1024)  // 并行标记: 堆小于此值时线程启动开销不划算
+#define GC_MAX_MARK_WORKERS 64
+#define GC_STRESS_MAJOR_INTERVAL 16         // debug_stress_gc: 每这么多次分配开始一轮 major gc, 其余做 minor gc
+#define GC_SIZE_CLASS_GRANULE SLAB_GRANULE
+#define GC_SIZE_CLASS_COUNT SLAB_CLASS_COUNT    // 16, 32, ..., 256 字节的对象从 slab 分配
+#define GC_POOLED_CLASS     UINT8_MAX       // size_class 取此值: 对象来自对象池(GcPool)
+#define GC_POOL_ENUM_VALUES 2               // 负载不超过这么多个值的 EnumInstance 从对象池分配
+#define GC_POOL_CAPACITY    1024            // 对象池每块内存的节点数
+#define GC_POOL_BATCH       64              // 清扫攒够这么多个池对象再批量还给对象池
+
+/*
+* 分代 mark-sweep.
+*
+* 新分配的对象挂在新生代链表 nursery 上; 分配量超过 GC_NURSERY_SIZE 时做 minor gc:
+* 只标记、清扫新生代, 老年代对象视为存活, 幸存对象直接晋升到老年代链表 vm->objects.
+* 堆总量超过 next_gc 时做 major gc, 标记清扫全部对象.
+*
+* 对象不移动(C 代码里到处持有裸指针), 所以新生代不是复制式的 bump 区, 而是一条独立的链表.
+*
+* 老年代对象写入新生代对象的引用时必须经过写屏障 gc_write_barrier, 把该老年代对象记入记忆集;
+* minor gc 把记忆集中的对象当作额外的根扫描.
+*
+* 增量模式(max_pause_us > 0): major gc 不再一次做完, 而是拆成若干步穿插在分配之间,
+* 每步最多暂停 max_pause_us 微秒:
+*   mark  — 扫描根之后, 每步从灰色栈取出一部分对象染黑; 灰色栈清空时做一次原子的收尾:
+*           重新扫描根(栈、全局变量等没有写屏障), 清除字符串池中的白色字符串, 新生代整体晋升.
+*   sweep — 老年代链表摘下来逐步清扫, 清扫期间新晋升的对象接在 vm->objects 上.
+* 标记期间暂停 minor gc(新生代对象也在本轮标记范围内); 新分配的对象为白色, 收尾时由根重新扫描到.
+* 扫描的最小单位是一个对象: 元素很多的 Vec / 方法很多的类一次扫完, 单步可能超过 max_pause_us.
+* 写屏障同时维护三色不变式: 黑色对象写入白色对象的引用时把白色对象染灰(Dijkstra 插入屏障).
+*
+* 并行标记(mark_workers > 1): major gc 清空灰色栈(stop-the-world 的整个标记, 或增量模式的收尾)时,
+* 灰色对象分给 mark_workers 个线程(含当前线程), 每个线程一个工作窃取队列(work_deque.h),
+* 自己的队列空了就去窃取别人的. is_marked 是原子的, 同一个对象只有交换成功的线程负责扫描.
+* 标记只读对象图, 不分配、不触发 gc; minor gc 与增量标记的分步仍是单线程.
+*
+* 空闲链表: 不超过 256 字节的对象按 16 字节分尺寸类, 从 slab(slab.h)中切出; 释放后的内存块
+* 挂回所属尺寸类的空闲链表, allocate_object 优先从链表取, 链表空了才从 slab 切新的.
+* 内存块不会单独 free, 空闲链表的总量即各尺寸类历史峰值减去存活量.
+*
+* 后台清扫(background_sweep): 标记收尾之后, 摘下来的老年代链表交给一个后台线程清扫,
+* 当前线程继续执行(期间照常 minor gc, 不开始下一轮 major gc). 后台线程把释放的内存块放进
+* 自己的空闲链表、释放的字节数单独计数, 当前线程在分配时发现它结束后再合并, 两边不共享可变状态.
+*
+* 对象池: 大小固定、成批创建又成批死亡的短命对象不走尺寸类, 而是每种一个无锁对象池
+* (pool.h, 紧凑节点), size_class 记为 GC_POOLED_CLASS: Upvalue(闭包捕获变量)、BoundMethod
+* (取方法)、Pair 以及负载不超过 GC_POOL_ENUM_VALUES 个值的 EnumInstance(负载内联在对象后,
+* 节点按上限分配; 更大的照常走尺寸类). 清扫时死掉的池对象按池攒进 PoolBatch, 攒满或清扫结束时
+* 用 pool_free_batch 成批还回; 后台清扫线程有自己的一组 PoolBatch, 退出前把线程缓存刷回对象池.
+* 对象池本身是无锁的, 后台线程归还与当前线程分配可以同时进行.
+*/
+
+typedef struct FreeCell {
+    struct FreeCell* next;
+} FreeCell;
+
+typedef struct FreeList {
+    FreeCell* head;
+    FreeCell* tail;
+    size_t count;
+} FreeList;
+
+typedef struct PoolBatch {
+    void* items[GC_POOL_BATCH];
+    int count;
+} PoolBatch;
+
+/* 从对象池分配的对象, 每种一个池 */
+typedef enum GcPool {
+    gc_pool_upvalue,
+    gc_pool_bound_method,
+    gc_pool_pair,
+    gc_pool_enum_instance,
+    gc_pool_count,
+} GcPool;
+
+typedef enum GcPhase {
+    gc_phase_idle,                  // 没有进行中的 major gc
+    gc_phase_mark,                  // 增量标记
+    gc_phase_sweep,                 // 惰性清扫
+} GcPhase;
 
 typedef struct GarbageCollector {
     int gray_count;
@@ -14,11 +100,79 @@ typedef struct GarbageCollector {
     Object** gray_stack;
     size_t bytes_allocated;
     size_t next_gc;
+
+    Object* nursery;                // 新生代对象链表
+    size_t nursery_allocated;       // 上次 gc 以来分配的字节数
+    bool is_minor;                  // 正在进行 minor gc
+
+    int remembered_count;           // 记忆集: 引用了新生代对象的老年代对象
+    int remembered_capacity;
+    Object** remembered;
+
+    GcPhase phase;
+    uint32_t max_pause_us;          // 增量模式单步暂停上限(微秒), 0 表示 stop-the-world
+    size_t step_allocated;          // 上一步以来分配的字节数
+    Object* sweeping;               // 待清扫的老年代对象
+    Object* swept;                  // 已清扫的存活对象, 清扫完成后接回 vm->objects
+    Object** swept_tail;
+
+    int mark_workers;               // 并行标记线程数(含当前线程), 1 表示单线程
+    bool is_parallel;               // 正在并行标记
+
+    SlabAllocator slab;             // 小对象的内存来源
+    FreeList free_lists[GC_SIZE_CLASS_COUNT];   // 下标为 size_class - 1
+    bool background_sweep;          // major gc 在后台线程清扫
+    struct Sweeper* sweeper;        // 进行中的后台清扫
+    size_t stress_count;            // debug_stress_gc: 分配次数
+    Pool* pools[gc_pool_count];                 // 对象池, 下标为 GcPool
+    PoolBatch pool_freed[gc_pool_count];        // 清扫释放、还没还给对象池的池对象
 } Gc;
 
 Gc new_garbage_collector();
 void free_garbage_collector(Gc* self);
+void free_gc_heap(VirtualMachine* vm);
 
+void gc_on_allocate(VirtualMachine* vm, size_t size);
+void gc_step(VirtualMachine* vm);
 void collect_garbage(VirtualMachine* vm);
+void collect_nursery(VirtualMachine* vm);
+void gc_remember(Object* object);
+void gc_barrier_gray(Object* owner, Object* target);
+void gc_barrier_rescan(Object* owner);
+
+void* gc_allocate_cell(VirtualMachine* vm, uint8_t size_class);
+void gc_release_cell(VirtualMachine* vm, void* cell, uint8_t size_class);
+bool gc_sweeper_free(void* pointer, size_t size);
+int gc_pool_of(ObjectType type, size_t size);
+void* gc_allocate_pooled(VirtualMachine* vm, GcPool pool, size_t size);
+void gc_release_pooled(VirtualMachine* vm, void* cell, GcPool pool, size_t size);
+
+/* 对象大小 -> 尺寸类, 0 表示大对象 */
+static inline uint8_t gc_size_class(size_t size) {
+    if (size > GC_SIZE_CLASS_COUNT * GC_SIZE_CLASS_GRANULE) return 0;
+    return (uint8_t)((size + GC_SIZE_CLASS_GRANULE - 1) / GC_SIZE_CLASS_GRANULE);
+}
+
+/* 写屏障: owner 中刚写入了 value(写入之后调用, 写入前的分配可能已经让 owner 晋升) */
+static inline void gc_write_barrier(Object* owner, Value value) {
+    if (!macro_is_gc_ref(value)) return;
+    Object* target = macro_as_gc_ref(value);
+    if (owner->is_old && !target->is_old) {
+        gc_remember(owner);
+    }
+    // 只有 major gc 进行中才会有已标记的对象
+    if (atomic_load_explicit(&owner->is_marked, memory_order_relaxed)
+        && !atomic_load_explicit(&target->is_marked, memory_order_relaxed)) {
+        gc_barrier_gray(owner, target);
+    }
+}
+
+/* 写屏障: owner 中写入了一批引用(不逐个检查), 下次 minor gc 与本轮标记都重新扫描 owner */
+static inline void gc_write_barrier_bulk(Object* owner) {
+    gc_remember(owner);
+    if (atomic_load_explicit(&owner->is_marked, memory_order_relaxed)) {
+        gc_barrier_rescan(owner);
+    }
+}
 
 #endif //JOKER_GC_H
@@ -7,7 +7,7 @@
 #define JOKER_INSTANCE_H
 #include "common.h"
 #include "object.h"
-#include "hashmap.h"
+#include "shape.h"
 
 #define macro_is_instance(value)   is_obj_type(value, OBJ_INSTANCE)
 #define macro_as_instance(value)   ((Instance*)macro_as_obj(value))
@@ -17,12 +17,16 @@
 typedef struct Instance {
     Object base;
     Class* klass;
-    HashMap fields;
+    Shape* shape;       // 字段布局, fields[i] 对应 shape->keys[i]
+    int capacity;
+    Value* fields;
 } Instance;
 
 Instance *new_instance(VirtualMachine *vm, Class* klass);
 bool instance_equal(Instance* left, Instance* right);
 void free_instance(Instance* self);
+Value instance_get_field(Instance* self, String* name);
+void instance_set_field(Instance* self, String* name, Value value);
 void print_instance(Instance* self);
 int snprintf_instance(Instance* self, char* buf, size_t size);
 
@@ -5,6 +5,8 @@
 
 #ifndef JOKER_OBJ_H
 #define JOKER_OBJ_H
+#include <stdatomic.h>
+
 #include "common.h"
 #include "value.h"
 
@@ -30,6 +32,7 @@ typedef enum ObjectType {
     OBJ_ENUM,
     OBJ_ENUM_INSTANCE,
     OBJ_TYPE,
+    OBJ_BOXED_I64,
 } ObjectType;
 
 
@@ -206,13 +209,17 @@ typedef struct Object {
     VirtualMachine *vm;
     const ObjectVTable* vtable;
     ObjectType type;	    // label of an object type
-    bool is_marked;
+    atomic_bool is_marked;  // 并行标记时多个线程竞争设置
+    bool is_old;            // 已晋升到老年代
+    bool is_remembered;     // 已在记忆集中
+    uint8_t size_class;     // 所属尺寸类(gc.h), 0 表示大对象, 不走空闲链表; GC_POOLED_CLASS 表示来自对象池
     struct Object* next;
 } Object;
 
 Object* allocate_object(VirtualMachine *vm, size_t size, ObjectType type);
 bool object_equal(Object* left, Object* right);
 void free_object(Object* object);
+void release_object(Object* object, size_t size);
 void free_objects(Object* object);
 void print_object(Object* object);
 int snprintf_object(Object* object, char* buf, size_t size);
@@ -221,6 +228,9 @@ int snprintf_object(Object* object, char* buf, size_t size);
 // macro for allocate object
 #define macro_allocate_object(vm, type, object_type) \
 	(type*)allocate_object(vm, sizeof(type), object_type)
+// macro for release a fixed size object
+#define macro_release_object(self, type) \
+    release_object(&(self)->base, sizeof(type))
 
 /* Why not just put the body of this function right in the macro?
 * It's not a good practice to put a function body inside a macro, because it can cause
@@ -246,6 +256,7 @@ static inline bool is_obj_type(Value value, ObjectType type) {
     type == OBJ_ENUM ? "ENUM" :         \
     type == OBJ_ENUM_INSTANCE ? "ENUM_INSTANCE" :   \
     type == OBJ_TYPE ? "TYPE" :                     \
+    type == OBJ_BOXED_I64 ? "BOXED_I64" :           \
     "UNKNOWN")
 
 #endif //JOKER_OBJ_H
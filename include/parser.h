@@ -7,18 +7,25 @@
 #define JOKER_PARSER_H
 #include "common.h"
 #include "token.h"
+#include "scanner.h"
+
+#define parser_window_size 16       // 环形缓冲大小(2 的幂): pprev, prev, curr 与向前看的 token
+#define parser_lookahead_max 2      // curr 之后最多向前看的 token 数
 
 typedef struct Parser {
     VirtualMachine *vm;
-	TokenList* tokens;
-	Token* curr;
-    Token* prev;
+    Scanner* scanner;                       // 按需扫描: 前进时才向 scanner 要下一个 token
+    Token window[parser_window_size];
+    uint32_t position;                      // curr 的序号
+    uint32_t scanned;                       // 已扫描的 token 数
+	Token* curr;                            // 指向 window; 前进 parser_window_size - 3 次之后被覆盖,
+    Token* prev;                            // 需要保留更久的 token 拷贝一份
     Token* pprev;
 	bool had_error;
 	bool panic_mode;
 } Parser;
 
-void init_parser(Parser* self, VirtualMachine *vm, TokenList* tokens);
+void init_parser(Parser* self, VirtualMachine *vm, Scanner* scanner);
 void free_parser(Parser* self);
 void print_parser(Parser* self);
 
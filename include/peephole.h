@@ -0,0 +1,27 @@
+//
+// Created by Kilig on 2025/5/6.
+//
+#pragma once
+
+#ifndef JOKER_PEEPHOLE_H
+#define JOKER_PEEPHOLE_H
+#include "common.h"
+#include "chunk.h"
+
+/* Peephole: 函数编译完成后对 Chunk.code 做一次窥孔优化
+*
+* 单趟 Pratt 解析器按 AST 顺序逐条发出栈指令, run() 的分派开销占比很高.
+* 本 pass 把常见的指令序列合并为超级指令(superinstruction):
+*
+*   get_local a; get_local b; add              => add_local_local a, b
+*   get_local a; get_local b                   => get_local_local a, b
+*   get_local a; constant k; less; jump_if_false
+*   get_local a; constant k; less_jump_i32     => compare_local_constant_jump a, k, <, offset
+*   get_local 0; get_property name, cache      => get_self_property name, cache
+*
+* 合并后重新计算所有跳转偏移, 并按新指令位置重建 RLE 行号(合并指令取首条指令的行号).
+* 序列内部的指令若是某条跳转的目标则不合并.
+*/
+void peephole_optimize(Chunk* chunk);
+
+#endif //JOKER_PEEPHOLE_H
@@ -7,6 +7,10 @@
  * @author Kilig
  * @date 2025/4/19
  * @version 0.1
+ *
+ * 虚拟机里的使用者: gc 的对象池(gc.h GcPool: Upvalue / BoundMethod / Pair / EnumInstance, pool_create_packed),
+ * 清扫时 pool_free_batch 成批归还.
+ * 词法单元不再从对象池分配, 而是随编译期 arena(arena.h)整体释放.
  */
 #ifndef JOKER_POOL_H
 #define JOKER_POOL_H
@@ -16,6 +20,8 @@
 #include <stdatomic.h>
 #include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <stddef.h>
 
 #include "common.h"
 
@@ -67,17 +73,26 @@ typedef struct ALIGNED_16 TaggedPointer {
 #define tagged_pointer_init(PTR, VER)   ((TaggedPointer){.ptr = (uint64_t)(PTR), .ver = VER})
 typedef _Atomic(TaggedPointer) atomic_tp_t;
 
-typedef struct ALIGNED_CACHE_LINE Node {
-    atomic_tp_t next ALIGNED_16;    // 原子指针+版本号
+/* 节点按池的 node_align 排列: 默认独占缓存行, 紧凑池(pool_create_packed)只按 16 字节对齐 */
+typedef struct ALIGNED_16 Node {
+    atomic_tp_t next;               // 原子指针+版本号
     uint8_t data[];                 // 用户数据区
 } Node;
 
+/* 内存块头: 节点不够时再申请一块挂到链上, 销毁时一起释放 */
+typedef struct ALIGNED_CACHE_LINE PoolBlock {
+    struct PoolBlock* next;
+    uint8_t nodes[];           // capacity 个节点
+} PoolBlock;
+
 typedef struct ALIGNED_CACHE_LINE Pool {
-    void* memory;              // 预分配内存块
+    _Atomic(PoolBlock*) blocks;     // 已申请的内存块链
     atomic_tp_t head;          // 无锁队列头（独立缓存行）
     atomic_tp_t free_list;     // 缓存释放对象的链表
     size_t node_size;          // 对齐后的对象大小+头信息
-    size_t capacity;           // 池容量
+    size_t node_align;         // 节点对齐: CACHE_LINE_SIZE 或 16(紧凑)
+    size_t capacity;           // 每块内存的节点数
+    atomic_uintptr_t block_cnt;   // 内存块数
     atomic_uintptr_t alloc_cnt;   // 分配计数器（调试用）
     atomic_uintptr_t free_cnt;    // 释放计数器（调试用）
     atomic_uintptr_t contention_counter;   // 冲突计数器（调试用）
@@ -88,19 +103,20 @@ typedef struct ALIGNED_CACHE_LINE Pool {
 #define ALIGN_UP(size, align) (((size) + (align)-1) & ~((align)-1))
 #define NODE_DATA_SIZE(obj_size) ALIGN_UP(obj_size, 16)
 #define NODE_TOTAL_SIZE(obj_size) ALIGN_UP(16 + NODE_DATA_SIZE(obj_size), CACHE_LINE_SIZE)
+#define NODE_PACKED_SIZE(obj_size) (16 + NODE_DATA_SIZE(obj_size))
 
 
-// 静态断言确保结构体对齐
-static_assert(sizeof(Node) % CACHE_LINE_SIZE == 0,
-              "Node structure requires cache line alignment");
+// 静态断言确保数据区紧跟在节点头之后且 16 字节对齐
+static_assert(sizeof(Node) == tagged_pointer_size && offsetof(Node, data) == tagged_pointer_size,
+              "Node header must be exactly one tagged pointer");
 
 
-#define PROFILE_ENABLED 1
-#if PROFILE_ENABLED
+// 分配路径上的采样打印, 默认关闭(common.h debug_pool_probe)
+#if debug_pool_probe
 #define PROBE() do{ \
        static __thread uint64_t cnt = 0; \
        if(cnt++ % 100000 == 0) \
-           printf("[PROBE] %s:%d\n", __func__, cnt); \
+           printf("[PROBE] %s:%" PRIu64 "\n", __func__, cnt); \
    }while(0)
 #else
 #define PROBE()
@@ -109,6 +125,7 @@ static_assert(sizeof(Node) % CACHE_LINE_SIZE == 0,
 
 
 Pool* pool_create(size_t obj_size, size_t capacity);
+Pool* pool_create_packed(size_t obj_size, size_t capacity);
 void* pool_alloc(Pool* pool);
 void pool_free(Pool* pool, void* data);
 size_t pool_alloc_batch(Pool* pool, void** objs, size_t count);
@@ -10,14 +10,13 @@
 
 typedef struct Scanner {
     VirtualMachine *vm;
-	TokenList* tokens;
 	const char* start;
 	const char* current;
+	const char* end;                // 源码末尾的 '\0', 成段扫描据此判断还能不能整块加载
 	line_t line;
 } Scanner;
 
 void init_scanner(Scanner* self, VirtualMachine *vm, const char* source);
 void free_scanner(Scanner* self);
-Token* scan_token(Scanner* self);
-void scan_tokens(Scanner* self);
+Token scan_token(Scanner* self);       // 由 parser 按需调用; 到达末尾后一直返回 eof
 #endif //JOKER_SCANNER_H
@@ -0,0 +1,32 @@
+//
+// Created by Kilig on 2025/4/20.
+//
+#pragma once
+
+#ifndef JOKER_SHAPE_H
+#define JOKER_SHAPE_H
+#include "common.h"
+
+/* Shape(hidden class): 描述 instance 字段布局
+*
+* 每个 Class 拥有一棵 transition 树, root 为空布局.
+* 给 instance 新增字段 key 时, 沿 shape->children 找到(或创建)对应子节点,
+* 相同赋值顺序的 instance 共享同一个 Shape, 字段值存放在 instance 的扁平 Value[] 中,
+* 字段访问 = shape_find_slot + 下标读写.
+*/
+typedef struct Shape {
+    struct Shape* parent;
+    String* key;                // 本次 transition 新增的字段名(root 为 NULL)
+    int slot_count;             // 字段数, key 位于 slot (slot_count - 1)
+    String** keys;              // [0, slot_count) 按 slot 顺序的字段名
+    struct Shape* children;     // transition 子节点链表
+    struct Shape* sibling;
+} Shape;
+
+void init_root_shape(Shape* root);
+void free_shape_tree(VirtualMachine* vm, Shape* root);
+Shape* shape_transition(VirtualMachine* vm, Shape* self, String* key);
+int shape_find_slot(Shape* self, String* key);
+void mark_shape_tree(VirtualMachine* vm, Shape* root, void (*mark)(VirtualMachine* vm, Object* object));
+
+#endif //JOKER_SHAPE_H
@@ -0,0 +1,41 @@
+//
+// Created by Kilig on 2025/5/25.
+//
+#pragma once
+
+#ifndef JOKER_SLAB_H
+#define JOKER_SLAB_H
+#include "common.h"
+
+#define SLAB_SIZE           (64 * 1024)     // 每块 slab 的大小
+#define SLAB_CLASS_COUNT    16              // 与 gc 的尺寸类一一对应: 16, 32, ..., 256 字节
+#define SLAB_GRANULE        16
+
+/*
+* 按尺寸类切分的 slab 分配器(每个虚拟机一个).
+*
+* 每个尺寸类有一块当前 slab, 从中顺序切出内存块; 切完了再 malloc 一块新的.
+* 内存块释放后不还给 slab, 而是挂到 gc 的空闲链表上(gc.h), 下次同尺寸类的分配优先复用,
+* 所以 slab 只增不减, 虚拟机销毁时整块释放.
+* 只在主线程上切分; 后台清扫线程释放的块进它自己的空闲链表, 不碰 slab.
+* slab 内存直接 malloc, 不计入 bytes_allocated(统计的是切出去的内存块).
+*/
+
+typedef struct Slab {
+    struct Slab* next;
+    size_t size_class;
+    // 之后是内存块, 16 字节对齐
+} Slab;
+
+typedef struct SlabAllocator {
+    Slab* slabs;                            // 全部 slab, 销毁时释放
+    char* cursors[SLAB_CLASS_COUNT];        // 当前 slab 中尚未切出的起点, 下标为 size_class - 1
+    char* limits[SLAB_CLASS_COUNT];
+    size_t slab_count;
+} SlabAllocator;
+
+void slab_init(SlabAllocator* self);
+void slab_free(SlabAllocator* self);
+void* slab_carve(SlabAllocator* self, uint8_t size_class);
+
+#endif //JOKER_SLAB_H
@@ -0,0 +1,36 @@
+//
+// Created by Kilig on 2025/6/15.
+//
+#pragma once
+
+#ifndef JOKER_SNAPSHOT_H
+#define JOKER_SNAPSHOT_H
+#include "common.h"
+#include "bytecode.h"
+
+#define snapshot_magic          "JKS"           // 含结尾 '\0' 共 4 字节
+#define snapshot_version        1
+#define snapshot_extension      ".jks"
+
+/*
+* 堆快照(.jks): 运行完 prelude 脚本后, 把全局变量以及从它们可达的整张对象图
+* (字符串、函数、闭包、类与方法、结构体、枚举、实例、Vec ...)写进一个映像;
+* 之后的启动直接从映像恢复这些全局变量, 不再扫描 / 编译 / 执行 prelude.
+*
+* 文件布局(小端, 整数编码同 bytecode.h):
+*   header   同 .jkc, magic 为 "JKS", 源码戳对应 prelude
+*   object_count:u32
+*   shell    [object_count]  kind:u8 + 创建对象所需的数据(字符串内容, Fn 记录, 原生函数名 ...)
+*   link     [object_count]  对象之间的引用, 引用写成对象下标(没有引用的 kind 没有 link)
+*   global_count:u32 (name:ref value)[global_count]
+*
+* 加载时先按 shell 创建全部对象, 再按 link 把下标换回指针(指针修正), 所以对象图可以有环.
+* 映像整个只读 mmap, Fn 的指令和行号表与 .jkc 一样就地使用; 对象头有 gc 标记位, 仍在堆上分配.
+* 原生函数与内置类型(Vec)按名字重新解析到当前虚拟机中的对象, 不保存函数指针.
+* 仍打开的 upvalue 与 Type 对象不能保存, 生成快照时报错.
+*/
+
+bool save_snapshot(VirtualMachine* vm, const SourceStamp* stamp, const char* path, const char** error);
+bool load_snapshot(VirtualMachine* vm, const char* path, const char* source_path);
+
+#endif //JOKER_SNAPSHOT_H
@@ -21,8 +21,7 @@
 
 #define macro_stored_string(destValuePtr, string) \
     do {                                          \
-        destValuePtr->type  = VAL_OBJECT;         \
-        destValuePtr->as.object = (Object*)string;\
+        macro_set_obj(destValuePtr, string);      \
     } while(0)
 
 /* flexible array members( 灵活数组成员):
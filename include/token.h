@@ -143,38 +143,22 @@ typedef enum TokenType {
 	token_error, token_eof
 } TokenType;
 
-/* Token struct */
+/* Token struct: 16 字节, 按值传递, 在 parser 的环形缓冲中存放(行号 24 bit, 类型 8 bit) */
 typedef struct Token {
-	const char* start;
+	const char* start;              // 指向源码; 合成的 token(self / super, 错误信息)指向字面量
 	int length;
-	line_t line;
-	TokenType type;
-    struct Token *next;
+	unsigned line : 24;
+	unsigned type : 8;              // TokenType
 } Token;
 
+_Static_assert(sizeof(Token) == 16, "Token is expected to be packed into 16 bytes");
+
 Token make_token(TokenType type, const char* start, int length, line_t line);
-Token* new_token(VirtualMachine*vm, const char* start, int length, line_t line, TokenType type);
-Token* eof_token(VirtualMachine *vm, line_t line);
-void free_token(VirtualMachine *vm, Token* token);
 void reset_token(Token* token);
 bool equal_token(Token* left, Token* right);
 bool equal_tkn(Token* left, const char* name);
 void print_token(Token* token);
 
 
-typedef struct TokenList {
-    Token* head;
-    Token* tail;
-} TokenList;
-
-TokenList* new_token_list(VirtualMachine* vm);
-void list_add_token(TokenList* list, Token* token);
-void list_extend_token(TokenList* to, TokenList* from, VirtualMachine* vm) ;
-void print_tokens(TokenList* list);
-void free_tokens(TokenList* list, VirtualMachine* vm);
-Token* first_token(TokenList* list);
-Token* last_token(TokenList* list);
-Token* nth_token(TokenList* list, size_t n);
-
 void tests();
 #endif //JOKER_TOKEN_H
@@ -34,7 +34,7 @@ bool upvalue_equal(UpvaluePtr a, UpvaluePtr b);
 void print_upvalues(UpvaluePtr self);
 void print_upvalue(UpvaluePtr self);
 Upvalue* capture_upvalue(VirtualMachine *vm, Value* local);
-void close_upvalues(UpvaluePtr root, Value* last);
+void close_upvalues(UpvaluePtrRef root_ref, Value* last);
 int snprintf_upvalue(UpvaluePtr self, char* buf, size_t size);
 
 #endif //JOKER_UPVALUE_H
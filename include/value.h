@@ -13,64 +13,165 @@
 #include "error.h"
 #include "operator.h"
 
-#ifdef NAN_BOXING  // improve performance 35% faster
-#include <string.h>
-#define SIGN_BIT    ((uint64_t)0x8000000000000000)
-#define QNAN        ((uint64_t)0x7ffc000000000000)
-
+/* 值类型 */
+typedef enum {
+	VAL_I32,
+	VAL_I64,
+	VAL_F32,
+	VAL_F64,
+	VAL_BOOL,
+	VAL_OBJECT,
+    VAL_NONE,
+    VAL_NULL,
+} ValueType;
 
-#define TAG_NULL    1  // 01
-#define TAG_FALSE   2  // 10
-#define TAG_TRUE    3  // 11
+#define VALUE_COUNT 8
 
+#ifdef NAN_BOXING  // improve performance 35% faster
+/* NaN-boxing: Value 为 8 字节 uint64_t.
+*
+* f64: 非 QNAN 模式的位直接存储(计算出的 NaN 会被规范化为 CANONICAL_NAN).
+* 其余类型存放在 quiet NaN 的 payload 中:
+*
+*   sign | QNAN(bits 50..62) | tag(bits 48..49) | payload(bits 0..47)
+*    1   |       QNAN        |        00        | Object* (48 bit pointer)
+*    0   |       QNAN        |   TAG_SPECIAL    | null / false / true / None
+*    0   |       QNAN        |   TAG_I32        | int32_t
+*    0   |       QNAN        |   TAG_F32        | float bits
+*    0   |       QNAN        |   TAG_I64        | int64_t (48 bit small int, sign extended)
+*    1   |       QNAN        |   TAG_I64        | BoxedI64* (boxed_i64.h)
+*
+* i64 使用 small-int 方案: [I64_BOX_MIN, I64_BOX_MAX] 范围内的值直接存放在 payload 中,
+* 超出范围的值装箱到堆上, 结果与非 NaN-boxing 构建一致. 构造 i64 可能分配, 所以需要 vm
+* (macro_val_from_i64 / macro_set_i64); 装箱值和对象都是 gc 引用(macro_is_gc_ref).
+*/
+#define SIGN_BIT        ((uint64_t)0x8000000000000000)
+#define QNAN            ((uint64_t)0x7ffc000000000000)
+#define CANONICAL_NAN   ((uint64_t)0x7ff8000000000000)
+#define TAG_MASK        ((uint64_t)0x0003000000000000)
+#define PAYLOAD_MASK    ((uint64_t)0x0000ffffffffffff)
+
+#define TAG_SPECIAL     ((uint64_t)0x0000000000000000)
+#define TAG_I32         ((uint64_t)0x0001000000000000)
+#define TAG_F32         ((uint64_t)0x0002000000000000)
+#define TAG_I64         ((uint64_t)0x0003000000000000)
+
+#define TAG_NULL    1  // 001
+#define TAG_FALSE   2  // 010
+#define TAG_TRUE    3  // 011
+#define TAG_NONE    4  // 100
+
+#define I64_BOX_MAX     ((int64_t)0x00007fffffffffff)
+#define I64_BOX_MIN     (-I64_BOX_MAX - 1)
+
+#define macro_nan_tag(value)    ((value) & (SIGN_BIT | QNAN | TAG_MASK))
+
+#define macro_val_from_i32(i32_)	((Value)(QNAN | TAG_I32 | (uint64_t)(uint32_t)(int32_t)(i32_)))
+#define macro_val_from_i64(vm, i64_)	(i64_to_value(vm, i64_))
+#define macro_val_from_small_i64(i64_)	((Value)(QNAN | TAG_I64 | ((uint64_t)(int64_t)(i64_) & PAYLOAD_MASK)))
+#define macro_val_from_f32(f32_)	(f32_to_value(f32_))
+#define macro_val_from_f64(f64_)	(f64_to_value(f64_))
+#define macro_val_from_bool(bool_)	((bool_) ? macro_val_true : macro_val_false)
+#define macro_val_from_obj(obj_)	((Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(obj_)))  // value need ownership of object
+#define macro_val_false             ((Value)(QNAN | TAG_SPECIAL | TAG_FALSE))
+#define macro_val_true              ((Value)(QNAN | TAG_SPECIAL | TAG_TRUE))
+#define macro_val_null				((Value)(QNAN | TAG_SPECIAL | TAG_NULL))
+#define macro_val_none				((Value)(QNAN | TAG_SPECIAL | TAG_NONE))
+
+#define macro_is_f64(value)		(((value) & QNAN) != QNAN)
+#define macro_is_i32(value)		(macro_nan_tag(value) == (QNAN | TAG_I32))
+#define macro_is_i64(value)		(((value) & (QNAN | TAG_MASK)) == (QNAN | TAG_I64))   // small int 或装箱
+#define macro_is_f32(value)		(macro_nan_tag(value) == (QNAN | TAG_F32))
+#define macro_is_bool(value)	(((value) | 1) == macro_val_true)
+#define macro_is_obj(value)		(macro_nan_tag(value) == (SIGN_BIT | QNAN))
+#define macro_is_none(value)	((value) == macro_val_none)
+#define macro_is_null(value)	((value) == macro_val_null)      // hashmap empty value slot default
+#define macro_is_number(value)	(macro_is_f64(value) || ((value) & TAG_MASK) != TAG_SPECIAL)
+#define macro_is_gc_ref(value)	(((value) & (SIGN_BIT | QNAN)) == (SIGN_BIT | QNAN))    // 对象或装箱 i64
+#define macro_is_obj_ptr(value_ptr)		((value_ptr) && macro_is_obj(*(value_ptr)))
+
+#define macro_as_i32(value)		((int32_t)(uint32_t)((value) & 0xffffffff))
+#define macro_as_i64(value)		(value_as_i64(value))
+#define macro_as_f32(value)		(value_as_f32(value))
+#define macro_as_f64(value)		(value_as_f64(value))
+#define macro_as_bool(value)	((value) == macro_val_true)
+#define macro_as_obj(value)		((Object*)(uintptr_t)((value) & PAYLOAD_MASK))
+#define macro_as_gc_ref(value)	macro_as_obj(value)
+#define macro_as_obj_ptr(value_ptr)		macro_as_obj(*(value_ptr))
+#define macro_as_i32_ptr(value_ptr)		macro_as_i32(*(value_ptr))
+#define macro_as_i64_ptr(value_ptr)		macro_as_i64(*(value_ptr))
+#define macro_as_f32_ptr(value_ptr)		macro_as_f32(*(value_ptr))
+#define macro_as_f64_ptr(value_ptr)		macro_as_f64(*(value_ptr))
+#define macro_as_bool_ptr(value_ptr)	macro_as_bool(*(value_ptr))
+
+static inline Value __attribute__((unused)) f64_to_value(double num) {
+    Value value;
+    memcpy(&value, &num, sizeof(num));
+    // 计算得到的 NaN 可能与 tag 冲突, 统一规范化
+    return (value & QNAN) == QNAN ? CANONICAL_NAN : value;
+}
 
-// #define IS_BOOL(v) ((v) == TRUE_VAL || (v) == FALSE_VAL)
-#define macro_is_bool(value)    (((value) | 1) == macro_true_val)
-#define macro_is_null(value)    ((value) == macro_null_val)
-#define macro_is_obj(value) \
-    (((value) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
+static inline double __attribute__((unused)) value_as_f64(Value value) {
+    double num;
+    memcpy(&num, &value, sizeof(num));
+    return num;
+}
 
-#define macro_is_number(value)  (((value) & QNAN) != QNAN)
-#define macro_as_bool(value)    ((value) == macro_true_val)
-#define macro_as_number(value)  Valueto_num(value)
-#define macro_as_obj(value) \
-    ((Object*)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
+static inline Value __attribute__((unused)) f32_to_value(float num) {
+    uint32_t bits;
+    memcpy(&bits, &num, sizeof(num));
+    return QNAN | TAG_F32 | (uint64_t)bits;
+}
 
+static inline float __attribute__((unused)) value_as_f32(Value value) {
+    uint32_t bits = (uint32_t)(value & 0xffffffff);
+    float num;
+    memcpy(&num, &bits, sizeof(num));
+    return num;
+}
 
-#define macro_false_val         ((Value)(uint64_t)(QNAN | TAG_FALSE))
-#define macro_true_val          ((Value)(uint64_t)(QNAN | TAG_TRUE))
-#define macro_null_val		    ((Value)(uint64_t)(QNAN | TAG_NULL))
-#define macro_bool_val(b)       ((b) ? macro_true_val : macro_false_val)
-#define macro_number_val(num)   num_to_value(num)
-#define macro_obj_val(obj) \
-    (Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(obj))
+Value box_i64(VirtualMachine* vm, int64_t value);
+int64_t unbox_i64(Value value);
 
+static inline Value __attribute__((unused)) i64_to_value(VirtualMachine* vm, int64_t num) {
+    if (num >= I64_BOX_MIN && num <= I64_BOX_MAX) return macro_val_from_small_i64(num);
+    return box_i64(vm, num);
+}
 
-static inline double value_to_num(Value value) {
-    double num;
-    memcpy(&num, &value, sizeof(num));
-    return num;
+static inline int64_t __attribute__((unused)) value_as_i64(Value value) {
+    if (value & SIGN_BIT) return unbox_i64(value);
+    return (int64_t)(value << 16) >> 16;
 }
 
-static inline Value num_to_value(double num) {
-    Value value;
-    memcpy(&value, &num, sizeof(num));
-    return value;
+static inline ValueType __attribute__((unused)) value_type(Value value) {
+    if (macro_is_f64(value)) return VAL_F64;
+    if (value & SIGN_BIT) return (value & TAG_MASK) == TAG_I64 ? VAL_I64 : VAL_OBJECT;
+    switch (value & TAG_MASK) {
+        case TAG_I32: return VAL_I32;
+        case TAG_F32: return VAL_F32;
+        case TAG_I64: return VAL_I64;
+        default:
+            switch (value & PAYLOAD_MASK) {
+                case TAG_FALSE:
+                case TAG_TRUE: return VAL_BOOL;
+                case TAG_NONE: return VAL_NONE;
+                default:       return VAL_NULL;
+            }
+    }
 }
 
-#else
-/* 值类型 */
-typedef enum {
-	VAL_I32,
-	VAL_I64,
-	VAL_F32,
-	VAL_F64,
-	VAL_BOOL,
-	VAL_OBJECT,
-    VAL_NONE,
-    VAL_NULL,
-} ValueType;
+#define macro_value_type(value)			(value_type(value))
 
+#define macro_set_i32(value_ptr, value)  (*(value_ptr) = macro_val_from_i32(value))
+#define macro_set_i64(vm, value_ptr, value)  (*(value_ptr) = macro_val_from_i64(vm, value))
+#define macro_set_small_i64(value_ptr, value)  (*(value_ptr) = macro_val_from_small_i64(value))
+#define macro_set_f32(value_ptr, value)  (*(value_ptr) = macro_val_from_f32(value))
+#define macro_set_f64(value_ptr, value)  (*(value_ptr) = macro_val_from_f64(value))
+#define macro_set_bool(value_ptr, value) (*(value_ptr) = macro_val_from_bool(value))
+#define macro_set_obj(value_ptr, value)  (*(value_ptr) = macro_val_from_obj(value))
+#define macro_set_none(value_ptr)        (*(value_ptr) = macro_val_none)
+
+#else
 /* 值: 存储在栈中的值
 *
 * TODO: Value Hashes
@@ -88,12 +189,9 @@ typedef struct Value {
 } Value;
 
 
-#define VALUE_COUNT 8
-#define macro_matches(value, t)			((value).type == (t))
-#define macro_matches_ptr(value_ptr, t) ((value_ptr) && (value_ptr)->type == (t))
-
 #define macro_val_from_i32(i32_)	((Value){ VAL_I32,	{ .i32 = (i32_) } })
-#define macro_val_from_i64(i64_)	((Value){ VAL_I64,	{ .i64 = (i64_) } })
+#define macro_val_from_i64(vm, i64_)	((void)(vm), (Value){ VAL_I64,	{ .i64 = (i64_) } })
+#define macro_val_from_small_i64(i64_)	((Value){ VAL_I64,	{ .i64 = (i64_) } })
 #define macro_val_from_f32(f32_)	((Value){ VAL_F32,	{ .f32 = (f32_) } })
 #define macro_val_from_f64(f64_)	((Value){ VAL_F64,	{ .f64 = (f64_) } })
 #define macro_val_from_bool(bool_)	((Value){ VAL_BOOL, { .boolean = (bool_) } })
@@ -116,6 +214,7 @@ typedef struct Value {
      macro_matches(value, VAL_F64)	  \
 	)
 #define macro_is_obj_ptr(value_ptr)		((value_ptr) && (value_ptr)->type == VAL_OBJECT)
+#define macro_is_gc_ref(value)	macro_is_obj(value)
 
 #define macro_set_i32(value_ptr, value) \
 	do {								\
@@ -123,12 +222,15 @@ typedef struct Value {
 		(value_ptr)->as.i32 = (value);	\
 	} while (0)
 
-#define macro_set_i64(value_ptr, value) \
+#define macro_set_i64(vm, value_ptr, value) \
 	do {								\
+		(void)(vm);						\
 		(value_ptr)->type = VAL_I64;	\
 		(value_ptr)->as.i64 = (value);	\
 	} while (0)
 
+#define macro_set_small_i64(value_ptr, value) macro_set_i64(NULL, value_ptr, value)
+
 #define macro_set_f32(value_ptr, value) \
 	do {								\
 		(value_ptr)->type = VAL_F32;	\
@@ -150,7 +252,7 @@ typedef struct Value {
 #define macro_set_obj(value_ptr, value) \
 	do {								\
 		(value_ptr)->type = VAL_OBJECT;	\
-		(value_ptr)->as.object = (value);	\
+		(value_ptr)->as.object = (Object*)(value);	\
 	} while (0)
 
 #define macro_set_none(value_ptr)       \
@@ -166,6 +268,7 @@ typedef struct Value {
 #define macro_as_f64(value)		((value).as.f64)
 #define macro_as_bool(value)	((value).as.boolean)
 #define macro_as_obj(value)		((value).as.object)
+#define macro_as_gc_ref(value)	macro_as_obj(value)
 #define macro_as_obj_ptr(value_ptr)		((value_ptr)->as.object)
 #define macro_as_i32_ptr(value_ptr)		((value_ptr)->as.i32)
 #define macro_as_i64_ptr(value_ptr)		((value_ptr)->as.i64)
@@ -173,16 +276,22 @@ typedef struct Value {
 #define macro_as_f64_ptr(value_ptr)		((value_ptr)->as.f64)
 #define macro_as_bool_ptr(value_ptr)		((value_ptr)->as.boolean)
 
+#define macro_value_type(value)			((value).type)
+#endif
+
+#define macro_matches(value, t)			(macro_value_type(value) == (t))
+#define macro_matches_ptr(value_ptr, t) ((value_ptr) && macro_value_type(*(value_ptr)) == (t))
+
 #define macro_type_name(value)					\
 	(											\
-		(value).type == VAL_I32 ? "i32" :		\
-		(value).type == VAL_I64 ? "i64" :		\
-		(value).type == VAL_F32 ? "f32" :		\
-		(value).type == VAL_F64 ? "f64" :		\
-		(value).type == VAL_BOOL? "bool" :		\
-		(value).type == VAL_NULL? "null" :		\
-		(value).type == VAL_NONE? "None" :		\
-		(value).type == VAL_OBJECT? "Object" :	\
+		macro_matches(value, VAL_I32) ? "i32" :		\
+		macro_matches(value, VAL_I64) ? "i64" :		\
+		macro_matches(value, VAL_F32) ? "f32" :		\
+		macro_matches(value, VAL_F64) ? "f64" :		\
+		macro_matches(value, VAL_BOOL)? "bool" :		\
+		macro_matches(value, VAL_NULL)? "null" :		\
+		macro_matches(value, VAL_NONE)? "None" :		\
+		macro_matches(value, VAL_OBJECT)? "Object" :	\
 		"Unknown"								\
 	)
 #define macro_type_name_ptr(value_ptr)	macro_type_name(*value_ptr)
@@ -192,27 +301,27 @@ typedef struct Value {
             panic("[ {PANIC} Value::macro_check_nullptr] Nullptr value pointer."); \
 		}												\
 	} while (0)
-#endif
 
 
 #define macro_to_f32(value_ptr) do {    \
-    value_ptr->type = VAL_F32;          \
-    value_ptr->as.f32 = (float)value_to_i32(*value_ptr); \
+    float f32_ = value_to_f32(*(value_ptr));  \
+    macro_set_f32(value_ptr, f32_);     \
 } while(0)
 
 #define macro_to_f64(value_ptr) do {    \
-    value_ptr->type = VAL_F64;          \
-    value_ptr->as.f64 = (double)value_to_i32(*value_ptr); \
+    double f64_ = value_to_f64(*(value_ptr)); \
+    macro_set_f64(value_ptr, f64_);     \
 } while(0)
 
 #define macro_to_i32(value_ptr) do {    \
-    value_ptr->type = VAL_I32;          \
-    value_ptr->as.i32 = value_to_i32(*value_ptr); \
+    int32_t i32_ = value_to_i32(*(value_ptr)); \
+    macro_set_i32(value_ptr, i32_);     \
 } while(0)
 
+// 只用于把 i32 加宽为 i64, 结果总能放进 small int, 不需要分配
 #define macro_to_i64(value_ptr) do {    \
-    value_ptr->type = VAL_I64;          \
-    value_ptr->as.i64 = value_to_i64(*value_ptr); \
+    int64_t i64_ = value_to_i64(*(value_ptr)); \
+    macro_set_small_i64(value_ptr, i64_);     \
 } while(0)
 
 
@@ -230,7 +339,6 @@ typedef struct Value {
     } while(0)
 
 
-
 // 值数组类型
 typedef struct Values {
     VirtualMachine *vm;
@@ -250,52 +358,55 @@ int snprintf_value(Value value, char* buf, size_t size);
 
 
 static inline int32_t __attribute__((unused)) value_to_i32(Value val) {
-    switch(val.type) {
-        case VAL_I32: return val.as.i32;
-        case VAL_I64: return (int32_t)val.as.i64;
-        case VAL_F32: return (int32_t)val.as.f32;
-        case VAL_F64: return (int32_t)val.as.f64;
+    switch(macro_value_type(val)) {
+        case VAL_I32: return macro_as_i32(val);
+        case VAL_I64: return (int32_t)macro_as_i64(val);
+        case VAL_F32: return (int32_t)macro_as_f32(val);
+        case VAL_F64: return (int32_t)macro_as_f64(val);
         default: return 0;
     }
 }
 static inline int64_t __attribute__((unused)) value_to_i64(Value val) {
-    switch(val.type) {
-        case VAL_I32: return (int64_t)val.as.i32;
-        case VAL_I64: return val.as.i64;
-        case VAL_F32: return (int64_t)val.as.f32;
-        case VAL_F64: return (int64_t)val.as.f64;
+    switch(macro_value_type(val)) {
+        case VAL_I32: return (int64_t)macro_as_i32(val);
+        case VAL_I64: return macro_as_i64(val);
+        case VAL_F32: return (int64_t)macro_as_f32(val);
+        case VAL_F64: return (int64_t)macro_as_f64(val);
         default: return 0;
     }
 }
 static inline float __attribute__((unused)) value_to_f32(Value val) {
-    switch(val.type) {
-        case VAL_I32: return (float)val.as.i32;
-        case VAL_I64: return (float)val.as.i64;
-        case VAL_F32: return val.as.f32;
-        case VAL_F64: return (float)val.as.f64;
+    switch(macro_value_type(val)) {
+        case VAL_I32: return (float)macro_as_i32(val);
+        case VAL_I64: return (float)macro_as_i64(val);
+        case VAL_F32: return macro_as_f32(val);
+        case VAL_F64: return (float)macro_as_f64(val);
         default: return 0.0f;
     }
 }
 static inline double __attribute__((unused)) value_to_f64(Value val) {
-    switch(val.type) {
-        case VAL_I32: return (double)val.as.i32;
-        case VAL_I64: return (double)val.as.i64;
-        case VAL_F32: return (double)val.as.f32;
-        case VAL_F64: return val.as.f64;
+    switch(macro_value_type(val)) {
+        case VAL_I32: return (double)macro_as_i32(val);
+        case VAL_I64: return (double)macro_as_i64(val);
+        case VAL_F32: return (double)macro_as_f32(val);
+        case VAL_F64: return macro_as_f64(val);
         default: return 0.0;
     }
 }
 
 static inline void __attribute__((unused)) numeric_type_promotion(Value* a, Value* b) {
-    if (a->type == VAL_F64 || b->type == VAL_F64) {
+    ValueType a_type = macro_value_type(*a);
+    ValueType b_type = macro_value_type(*b);
+    if (a_type == VAL_F64 || b_type == VAL_F64) {
         macro_to_f64(a);
         macro_to_f64(b);
-    } else if (a->type == VAL_F32 || b->type == VAL_F32) {
+    } else if (a_type == VAL_F32 || b_type == VAL_F32) {
         macro_to_f32(a);
         macro_to_f32(b);
-    } else if (a->type == VAL_I64 || b->type == VAL_I64) {
-        macro_to_i64(a);
-        macro_to_i64(b);
+    } else if (a_type == VAL_I64 || b_type == VAL_I64) {
+        // 已经是 i64 的一侧不动(NaN-boxing 下可能是装箱值), 另一侧是 i32
+        if (a_type != VAL_I64) macro_to_i64(a);
+        if (b_type != VAL_I64) macro_to_i64(b);
     }
 }
 
@@ -16,22 +16,42 @@
 #define macro_as_vec_from_value_ptr(value_ptr) ((Vec*)(macro_as_obj_ptr(value_ptr)))
 #define macro_vec_to_obj(vec)      ((Object*)(vec))
 
-//typedef struct Vec_base {
-//    Value* start;
-//    Value* finish;
-//    Value* end;
-//} Vec_base;
-
+/* Vec 元素的存储类型 */
+typedef enum VecKind {
+    vec_kind_value,         // 通用 Value[]
+    vec_kind_i32,           // int32_t[]
+    vec_kind_i64,           // int64_t[]
+    vec_kind_f64,           // double[]
+} VecKind;
+
+/*
+* Vec: 一等公民的动态数组对象([1, 2, 3] 直接得到 OBJ_VEC, 方法由 vm->vec_class 提供).
+*
+* 所有元素同为 i32 / i64 / f64 时以紧凑的原生数组存储, 比 16 字节的 Value 省 2~4 倍内存,
+* 遍历对缓存友好, 原生算法(sum / sort / search)可以直接在裸数组上运行;
+* 第一次写入不同类型的元素时退化为通用 Value[](vec_generalize), 之后不再特化.
+* 空 Vec 在第一次写入时按元素类型重新选择存储.
+*/
 typedef struct Vec {
     Object base;
-    Value* start;
-    Value* finish;
-    Value* end;
+    VecKind kind;
+    size_t count;
+    size_t capacity;        // 以当前 kind 的元素计
+    union {
+        void* data;
+        Value* values;
+        int32_t* i32s;
+        int64_t* i64s;
+        double* f64s;
+    } as;
 } Vec;
 
 Vec* new_vec(VirtualMachine* vm);
 Vec* new_vec_with_capacity(VirtualMachine* vm, size_t capacity);
+Vec* new_vec_with_kind(VirtualMachine* vm, VecKind kind, size_t capacity);
 void free_vec(Vec* vec);
+VecKind vec_kind_of(Value value);
+void vec_generalize(Vec* vec);
 size_t vec_capacity(Vec* vec);
 size_t vec_len(Vec* vec);
 void vec_push(Vec* vec, Value element);
@@ -45,12 +65,28 @@ void vec_remove(Vec* vec, size_t index);
 void vec_extend(Vec* vec, Vec* other);
 void vec_clear(Vec* vec);
 void vec_reverse(Vec* vec);
+void vec_fill(Vec* vec, Value element);
 bool vec_is_empty(Vec* vec);
 void print_vec(Vec* vec);
 int snprintf_vec(Vec* vec, char* buf, size_t size);
 
 bool vec_equal(Vec* left, Vec* right);
 
+/* 按存储类型 kind 读取 data 的第 index 个元素并装箱为 Value(NaN-boxing 下大的 i64 会分配) */
+static inline Value vec_load(VirtualMachine* vm, VecKind kind, void* data, size_t index) {
+    switch (kind) {
+        case vec_kind_i32: return macro_val_from_i32(((int32_t*)data)[index]);
+        case vec_kind_i64: return macro_val_from_i64(vm, ((int64_t*)data)[index]);
+        case vec_kind_f64: return macro_val_from_f64(((double*)data)[index]);
+        default:           return ((Value*)data)[index];
+    }
+}
+
+/* 读取第 index 个元素并装箱为 Value(调用方保证不越界) */
+static inline Value vec_at(Vec* vec, size_t index) {
+    return vec_load(vec->base.vm, vec->kind, vec->as.data, index);
+}
+
 
 
 
@@ -62,19 +98,13 @@ bool vec_equal(Vec* left, Vec* right);
 
 
 static InterpretResult vec_add(Value* left, Value* right) {
-    Instance* left_inst = macro_as_instance_from_value_ptr(left);
-    Instance* right_inst = macro_as_instance_from_value_ptr(right);
-    Vec* left_vec = macro_as_vec(hashmap_get(
-            &left_inst->fields,
-            new_string(left_inst->base.vm, "_data", 5)
-    ));
-    Vec* right_vec = macro_as_vec(hashmap_get(
-            &right_inst->fields,
-            new_string(right_inst->base.vm, "_data", 5)
-    ));
-
-    Vec* result = new_vec_with_capacity(
-        left_inst->base.vm,
+    if (!macro_is_vec(*right)) return interpret_runtime_error;
+    Vec* left_vec = macro_as_vec_from_value_ptr(left);
+    Vec* right_vec = macro_as_vec_from_value_ptr(right);
+
+    Vec* result = new_vec_with_kind(
+        left_vec->base.vm,
+        left_vec->kind == right_vec->kind ? left_vec->kind : vec_kind_value,
         vec_len(left_vec) + vec_len(right_vec)
     );
 
@@ -86,18 +116,9 @@ static InterpretResult vec_add(Value* left, Value* right) {
 }
 
 static InterpretResult vec_eq(Value* left, Value* right) {
-    Instance* left_inst = macro_as_instance_from_value_ptr(left);
-    Instance* right_inst = macro_as_instance_from_value_ptr(right);
-    Vec* left_vec = macro_as_vec(hashmap_get(
-            &left_inst->fields,
-            new_string(left_inst->base.vm, "_data", 5)
-    ));
-    Vec* right_vec = macro_as_vec(hashmap_get(
-            &right_inst->fields,
-            new_string(right_inst->base.vm, "_data", 5)
-    ));
-
-    macro_set_bool(left, vec_equal(left_vec, right_vec));
+    bool equal = macro_is_vec(*right)
+            && vec_equal(macro_as_vec_from_value_ptr(left), macro_as_vec_from_value_ptr(right));
+    macro_set_bool(left, equal);
     return interpret_ok;
 }
 static InterpretResult vec_neq(Value* left, Value* right) {
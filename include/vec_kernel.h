@@ -0,0 +1,56 @@
+//
+// Created by Kilig on 2025/5/10.
+//
+#pragma once
+
+#ifndef JOKER_VEC_KERNEL_H
+#define JOKER_VEC_KERNEL_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+* Vec 批量内核: 直接在 Vec 的紧凑存储(int32_t[] / int64_t[] / double[])上运行.
+*
+* 指令集在编译期选择: 定义了 __AVX2__ 时使用 256 位内核, 否则 __SSE2__(x86-64 默认可用)使用 128 位内核,
+* 都没有时退回标量循环. 所有内核都以标量循环处理尾部元素, 对指针对齐没有要求.
+*
+* 约定:
+*   - i32 求和 / 点积以 int64_t 累加, 不会中途溢出; i64 按补码回绕.
+*   - min / max 要求 count > 0.
+*   - index_of 返回第一个相等元素的下标, 不存在时返回 -1.
+*   - f64 比较按 C 的 == 语义(NaN 不等于任何值, +0 == -0); 含 NaN 时 min / max 的结果未定义.
+*   - f64 求和 / 点积按车道分组累加, 与逐个相加相比最低位的舍入可能不同.
+*/
+
+int64_t kernel_sum_i32(const int32_t* data, size_t count);
+int64_t kernel_sum_i64(const int64_t* data, size_t count);
+double kernel_sum_f64(const double* data, size_t count);
+
+int32_t kernel_min_i32(const int32_t* data, size_t count);
+int32_t kernel_max_i32(const int32_t* data, size_t count);
+int64_t kernel_min_i64(const int64_t* data, size_t count);
+int64_t kernel_max_i64(const int64_t* data, size_t count);
+double kernel_min_f64(const double* data, size_t count);
+double kernel_max_f64(const double* data, size_t count);
+
+int64_t kernel_dot_i32(const int32_t* left, const int32_t* right, size_t count);
+int64_t kernel_dot_i64(const int64_t* left, const int64_t* right, size_t count);
+double kernel_dot_f64(const double* left, const double* right, size_t count);
+
+/* data[i] += addend; i32 版本调用方需先保证不溢出 */
+void kernel_add_i32(int32_t* data, size_t count, int32_t addend);
+void kernel_add_i64(int64_t* data, size_t count, int64_t addend);
+void kernel_add_f64(double* data, size_t count, double addend);
+
+void kernel_fill_i32(int32_t* data, size_t count, int32_t value);
+void kernel_fill_i64(int64_t* data, size_t count, int64_t value);
+void kernel_fill_f64(double* data, size_t count, double value);
+
+int64_t kernel_index_of_i32(const int32_t* data, size_t count, int32_t value);
+int64_t kernel_index_of_i64(const int64_t* data, size_t count, int64_t value);
+int64_t kernel_index_of_f64(const double* data, size_t count, double value);
+
+bool kernel_equal_f64(const double* left, const double* right, size_t count);
+
+#endif //JOKER_VEC_KERNEL_H
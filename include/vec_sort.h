@@ -0,0 +1,33 @@
+//
+// Created by Kilig on 2025/5/11.
+//
+#pragma once
+
+#ifndef JOKER_VEC_SORT_H
+#define JOKER_VEC_SORT_H
+#include "common.h"
+#include "value.h"
+#include "vec.h"
+
+/*
+* Vec 排序.
+*
+* 紧凑存储(i32 / i64 / f64): 元素映射为保序的无符号键后做 LSD 基数排序(每趟 8 bit),
+* 所有元素某一字节都相同的趟直接跳过; 元素较少时改用插入排序.
+* f64 按 IEEE 全序排列: -NaN < -inf < ... < -0 < +0 < ... < +inf < +NaN.
+*
+* 通用 Value[]: 稳定归并排序, 比较函数由调用方提供(自然顺序或脚本闭包).
+*/
+
+/* a < b 写入 *less; 比较出错(如回调脚本失败)返回 false */
+typedef bool (*ValueLess)(void* context, Value a, Value b, bool* less);
+
+void vec_sort_packed(Vec* vec);
+
+/*
+* 稳定归并排序, scratch 至少 count / 2 + 1 个元素.
+* less 出错时立即返回 false: values 只是部分有序, 但元素不会丢失或重复.
+*/
+bool values_merge_sort(Value* values, Value* scratch, size_t count, ValueLess less, void* context);
+
+#endif //JOKER_VEC_SORT_H
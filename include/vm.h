@@ -18,6 +18,7 @@
 
 #define frames_stack_max 64                // static const int frames_stack_max = 64;
 #define constant_stack_max (frames_stack_max * uint8_count)
+#define frame_stack_reserve 16             // call() 检查栈空间时为 native 调用等额外压栈预留的槽位
 
 typedef struct CallFrame {
 	Value* slots;                           // vm stack get function base address. (ptr ->slots {Value, Value, ...})
@@ -40,17 +41,24 @@ call func1()
 	-> execute func3->ip  ---(over func3)---> continue execute func2->ip
 */
 
+/* 预驻留的常用字符串: 初始化时 new_string() 一次, 运行期直接取用, 免去每次哈希 + 驻留表查找 */
+typedef enum WellKnownString {
+    string_vec,                             // "Vec"
+    well_known_string_count,
+} WellKnownString;
+
 typedef struct VirtualMachine {
-    TokenList *tokens;
+    struct Arena* arena;                    // 编译期 arena(编译器临时数组), 只在 compile() 期间有效
 
 	CallFrame frames[frames_stack_max];     // the func stack: {vm->ip} goto {vm->frames[index]->ip}
 	int frame_count;                        // the call stack count
+	int frame_base;                         // run() 在 frame_count 回落到此值时返回(vm_call 嵌套执行时 > 0)
 	Value stack[constant_stack_max];        // the stack
 	Value* stack_top;                       // top of the stack
 
 	HashMap strings;                        // string constants
 	HashMap globals;                        // global variables
-    Object *objects;                        // object list
+    Object *objects;                        // object list(老年代, 新生代在 gc.nursery)
 	Upvalue* open_upv_ptr;                  // upvalue pointer header node
 	Compiler* compiler;                     // the compiler
     ClassCompiler* class_compiler;          // class compiler
@@ -61,8 +69,13 @@ typedef struct VirtualMachine {
     Allocator* allocator;                   // allocator
 #endif
     String* init_string;                    // the init string
+    String* well_known[well_known_string_count];    // 预驻留字符串, 按 WellKnownString 下标
+    Class* vec_class;                       // 内置 Vec 类型(type_register 注册), 提供 Vec 对象的方法
 
     HashMap types;                          // type
+    uint32_t class_version;                 // class version 全局计数(inline cache)
+    bool register_mode;                     // 寄存器指令 + run_register() 执行(-r)
+    struct BytecodeImage* images;           // 已加载的 .jkc 映像, Fn 直接引用其中的指令与行号表, 虚拟机销毁时释放
 } VirtualMachine;
 
 void init_virtual_machine(VirtualMachine* self);
@@ -70,8 +83,16 @@ void free_virtual_machine(VirtualMachine* self);
 
 Compiler* replace_compiler(VirtualMachine* self, Compiler* compiler);
 InterpretResult interpret(VirtualMachine* self, const char* source);
+InterpretResult interpret_fn(VirtualMachine* self, Fn* fn);
 void runtime_error(VirtualMachine* self, const char* message, ...);
 
+/*
+* 原生函数回调脚本: 调用 callee(args[0..arg_count)), 返回值写入 *result.
+* 脚本函数在嵌套的解释循环中执行到该帧返回; 出错时已报告运行期错误(栈已重置), 返回 false,
+* 调用方(原生函数)应直接返回.
+*/
+bool vm_call(VirtualMachine* self, Value callee, int arg_count, Value* args, Value* result);
+
 /* Value stack operations */
 void push(VirtualMachine* self, Value value);
 Value pop(VirtualMachine* self);
@@ -0,0 +1,41 @@
+//
+// Created by Kilig on 2025/5/18.
+//
+#pragma once
+
+#ifndef JOKER_WORK_DEQUE_H
+#define JOKER_WORK_DEQUE_H
+#include <stdatomic.h>
+
+#include "common.h"
+
+/*
+* Chase-Lev 工作窃取双端队列(C11 内存序版本, Lê et al. 2013).
+*
+* 只有拥有者线程 push / pop(栈顶, LIFO), 其他线程从另一端 steal(FIFO).
+* 数组满了翻倍扩容; 旧数组可能还有窃取者在读, 挂在 prev 上等销毁时一起释放.
+* 内存直接 malloc, 不经过 reallocate(并行标记期间不能触发 gc, 也不能碰 vm 的分配统计).
+*/
+
+typedef struct WorkBuffer {
+    int64_t capacity;               // 2 的幂
+    struct WorkBuffer* prev;        // 扩容前的数组
+    _Atomic(void*) items[];
+} WorkBuffer;
+
+typedef struct WorkDeque {
+    _Atomic(int64_t) top;           // 窃取端
+    char pad[64];                   // top / bottom 分属不同缓存行, 避免伪共享
+    _Atomic(int64_t) bottom;        // 拥有者端
+    _Atomic(WorkBuffer*) buffer;
+} WorkDeque;
+
+void work_deque_init(WorkDeque* self, int64_t capacity);
+void work_deque_free(WorkDeque* self);
+
+void work_deque_push(WorkDeque* self, void* item);
+void* work_deque_pop(WorkDeque* self);
+void* work_deque_steal(WorkDeque* self);
+bool work_deque_is_empty(WorkDeque* self);
+
+#endif //JOKER_WORK_DEQUE_H
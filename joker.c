@@ -30,6 +30,7 @@ int main(int argc, char* argv[]) {
     test_object_lifecycle();
     test_statistics();
     test_alignment();
+    test_packed_pool();
 
     return 0;
 }
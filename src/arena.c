@@ -0,0 +1,106 @@
+//
+// Created by Kilig on 2025/6/1.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "error.h"
+
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static void use_block(Arena* self, ArenaBlock* block) {
+    self->current = block;
+    self->cursor = block->data;
+    self->limit = block->data + block->size;
+}
+
+/* 当前块放不下 size: 下一块是备用块且够大就用它, 否则新申请一块插在当前块之后 */
+static void next_block(Arena* self, size_t size) {
+    ArenaBlock* spare = self->current == NULL ? self->head : self->current->next;
+    if (spare != NULL && spare->size >= size) {
+        use_block(self, spare);
+        return;
+    }
+
+    size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + block_size);
+    if (block == NULL) {
+        panic(" {PANIC} [arena::next_block] arena malloc memory fail.");
+    }
+    block->size = block_size;
+    block->next = spare;
+    if (self->current == NULL) {
+        self->head = block;
+    } else {
+        self->current->next = block;
+    }
+    self->block_count++;
+    use_block(self, block);
+}
+
+void arena_init(Arena* self) {
+    self->head = NULL;
+    self->current = NULL;
+    self->cursor = NULL;
+    self->limit = NULL;
+    self->block_count = 0;
+}
+
+void arena_free(Arena* self) {
+    ArenaBlock* block = self->head;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(self);
+}
+
+void* arena_alloc(Arena* self, size_t size) {
+    size = size == 0 ? ARENA_ALIGNMENT : align_up(size);
+    if ((size_t)(self->limit - self->cursor) < size) {
+        next_block(self, size);
+    }
+    void* pointer = self->cursor;
+    self->cursor += size;
+    return pointer;
+}
+
+/* 扩大 pointer: 它是最近一次分配且当前块还放得下时原地扩大, 否则分配新的并拷贝(旧的不回收) */
+void* arena_grow(Arena* self, void* pointer, size_t old_size, size_t new_size) {
+    if (pointer == NULL) return arena_alloc(self, new_size);
+
+    char* start = pointer;
+    if (start + align_up(old_size) == self->cursor
+        && (size_t)(self->limit - start) >= align_up(new_size)) {
+        self->cursor = start + align_up(new_size);
+        return pointer;
+    }
+    if (new_size <= old_size) return pointer;
+
+    void* new_pointer = arena_alloc(self, new_size);
+    memcpy(new_pointer, pointer, old_size);
+    return new_pointer;
+}
+
+ArenaMark arena_save(Arena* self) {
+    return (ArenaMark){ self->current, self->cursor };
+}
+
+/* 回退到 mark: 之后分配的内存全部作废 */
+void arena_restore(Arena* self, ArenaMark mark) {
+    if (mark.block == NULL) {
+        self->current = NULL;
+        self->cursor = NULL;
+        self->limit = NULL;
+        return;
+    }
+    self->current = mark.block;
+    self->cursor = mark.cursor;
+    self->limit = mark.block->data + mark.block->size;
+}
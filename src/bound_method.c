@@ -16,7 +16,7 @@ BoundMethod* new_bound_method(VirtualMachine *vm, Value receiver, Closure *metho
 
 void free_bound_method(BoundMethod* self) {
     if (self != NULL) {
-        macro_free(self->base.vm, BoundMethod, self);
+        macro_release_object(self, BoundMethod);
     }
 }
 
@@ -0,0 +1,46 @@
+//
+// Created by Kilig on 2025/6/8.
+//
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "memory.h"
+#include "object.h"
+#include "boxed_i64.h"
+
+
+BoxedI64 *new_boxed_i64(VirtualMachine *vm, int64_t value) {
+    BoxedI64 *box = macro_allocate_object(vm, BoxedI64, OBJ_BOXED_I64);
+    box->value = value;
+    return box;
+}
+
+void free_boxed_i64(BoxedI64 *self) {
+    if (self != NULL) {
+        macro_release_object(self, BoxedI64);
+    }
+}
+
+bool boxed_i64_equal(BoxedI64 *left, BoxedI64 *right) {
+    return left->value == right->value;
+}
+
+void print_boxed_i64(BoxedI64 *self) {
+    printf("%" PRId64, self->value);
+}
+
+int snprintf_boxed_i64(BoxedI64 *self, char *buf, size_t size) {
+    return snprintf(buf, size, "%" PRId64, self->value);
+}
+
+#ifdef NAN_BOXING
+Value box_i64(VirtualMachine *vm, int64_t value) {
+    BoxedI64 *box = new_boxed_i64(vm, value);
+    return (Value)(SIGN_BIT | QNAN | TAG_I64 | (uint64_t)(uintptr_t)box);
+}
+
+int64_t unbox_i64(Value value) {
+    return macro_as_boxed_i64_from_obj(macro_as_gc_ref(value))->value;
+}
+#endif
@@ -0,0 +1,742 @@
+//
+// Created by Kilig on 2025/6/8.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "bytecode.h"
+#include "memory.h"
+#include "chunk.h"
+#include "fn.h"
+#include "string_.h"
+#include "gc.h"
+#include "vm.h"
+#include "error.h"
+#include "arena.h"
+#include "compiler.h"
+
+#define bytecode_flag_register  0x1             // 寄存器模式编译出的指令
+#define bytecode_max_depth      1024            // 嵌套函数层数上限, 防止损坏的文件把递归读爆
+#define bytecode_line_align     4               // 行号表在映像中的对齐, 就地当作 RleLine 数组使用
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "bytecode images are little-endian and used in place; big-endian hosts are not supported"
+#endif
+_Static_assert(sizeof(RleLine) == 8 && _Alignof(RleLine) <= bytecode_line_align,
+               "RleLine must match the (line:i32 count:i32) layout of bytecode images");
+
+
+/* FNV-1a 64 */
+uint64_t hash_source(const char* source, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)source[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool stamp_source(const char* path, const char* source, SourceStamp* stamp) {
+    struct stat info;
+    if (stat(path, &info) != 0) return false;
+    stamp->size = (uint64_t)info.st_size;
+    stamp->mtime = (int64_t)info.st_mtime;
+    stamp->hash = hash_source(source, strlen(source));
+    return true;
+}
+
+/* 映像放在源码旁边: foo.jk -> foo<extension>, 其他后缀直接追加; 返回值由调用者 free */
+char* image_path(const char* source_path, const char* extension) {
+    size_t length = strlen(source_path);
+    if (length >= 3 && strcmp(source_path + length - 3, ".jk") == 0) length -= 3;
+    char* path = malloc(length + strlen(extension) + 1);
+    if (path == NULL) {
+        panic(" {PANIC} [bytecode::image_path] image path malloc memory fail.");
+    }
+    memcpy(path, source_path, length);
+    strcpy(path + length, extension);
+    return path;
+}
+
+bool has_extension(const char* path, const char* extension) {
+    size_t length = strlen(path);
+    size_t suffix = strlen(extension);
+    return length > suffix && strcmp(path + length - suffix, extension) == 0;
+}
+
+char* bytecode_path(const char* source_path) {
+    return image_path(source_path, bytecode_extension);
+}
+
+bool is_bytecode_path(const char* path) {
+    return has_extension(path, bytecode_extension);
+}
+
+static uint32_t current_flags(VirtualMachine* vm) {
+    return vm->register_mode ? bytecode_flag_register : 0;
+}
+
+/* 整个文件读进内存; 打不开返回 NULL(缓存不存在是正常情况, 不报错) */
+static uint8_t* read_whole_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    fseek(file, 0L, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+    if (file_size < 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    uint8_t* buffer = malloc((size_t)file_size + 1);
+    if (buffer == NULL) {
+        panic(" {PANIC} [bytecode::read_whole_file] file buffer malloc memory fail.");
+    }
+    size_t bytes_read = fread(buffer, 1, (size_t)file_size, file);
+    fclose(file);
+    if (bytes_read != (size_t)file_size) {
+        free(buffer);
+        return NULL;
+    }
+    buffer[bytes_read] = '\0';
+    *size = bytes_read;
+    return buffer;
+}
+
+
+/*===============================================================================*/
+// 写
+/*===============================================================================*/
+
+void put_bytes(BytecodeWriter* self, const void* bytes, size_t size) {
+    if (self->count + size > self->capacity) {
+        size_t capacity = self->capacity < 4096 ? 4096 : self->capacity;
+        while (capacity < self->count + size) capacity *= 2;
+        uint8_t* data = realloc(self->data, capacity);
+        if (data == NULL) {
+            panic(" {PANIC} [bytecode::put_bytes] bytecode buffer realloc memory fail.");
+        }
+        self->data = data;
+        self->capacity = capacity;
+    }
+    if (size > 0) memcpy(self->data + self->count, bytes, size);
+    self->count += size;
+}
+
+void put_u8(BytecodeWriter* self, uint8_t value) {
+    put_bytes(self, &value, 1);
+}
+
+void put_u64(BytecodeWriter* self, uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) bytes[i] = (uint8_t)(value >> (i * 8));
+    put_bytes(self, bytes, 8);
+}
+
+void put_u32(BytecodeWriter* self, uint32_t value) {
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; i++) bytes[i] = (uint8_t)(value >> (i * 8));
+    put_bytes(self, bytes, 4);
+}
+
+void put_u16(BytecodeWriter* self, uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    put_bytes(self, bytes, 2);
+}
+
+void put_i32(BytecodeWriter* self, int32_t value) {
+    put_u32(self, (uint32_t)value);
+}
+
+void put_align(BytecodeWriter* self, size_t align) {
+    static const uint8_t zeros[8] = { 0 };
+    put_bytes(self, zeros, (align - self->count % align) % align);
+}
+
+void put_string(BytecodeWriter* self, String* string) {
+    if (string == NULL) {
+        put_i32(self, -1);
+        return;
+    }
+    put_i32(self, string->length);
+    put_bytes(self, string->chars, (size_t)string->length);
+}
+
+static bool put_constant(BytecodeWriter* self, Value value) {
+    if (macro_is_i32(value)) {
+        put_u8(self, bytecode_constant_i32);
+        put_i32(self, macro_as_i32(value));
+    } else if (macro_is_i64(value)) {
+        put_u8(self, bytecode_constant_i64);
+        put_u64(self, (uint64_t)macro_as_i64(value));
+    } else if (macro_is_f32(value)) {
+        float f32 = macro_as_f32(value);
+        uint32_t bits;
+        memcpy(&bits, &f32, sizeof(bits));
+        put_u8(self, bytecode_constant_f32);
+        put_u32(self, bits);
+    } else if (macro_is_string(value)) {
+        put_u8(self, bytecode_constant_string);
+        put_string(self, macro_as_string(value));
+    } else if (macro_is_fn(value)) {
+        put_u8(self, bytecode_constant_fn);
+        return put_fn(self, macro_as_fn(value));
+    } else if (macro_is_f64(value)) {
+        double f64 = macro_as_f64(value);
+        uint64_t bits;
+        memcpy(&bits, &f64, sizeof(bits));
+        put_u8(self, bytecode_constant_f64);
+        put_u64(self, bits);
+    } else {
+        return false;   // 编译器只会产生以上几种常量
+    }
+    return true;
+}
+
+bool put_fn(BytecodeWriter* self, Fn* fn) {
+    Chunk* chunk = &fn->chunk;
+    put_i32(self, fn->arity);
+    put_i32(self, fn->upvalue_count);
+    put_i32(self, fn->max_stack);
+    put_string(self, fn->name);
+
+    put_i32(self, chunk->count);
+    put_bytes(self, chunk->code, (size_t)chunk->count);
+
+    put_align(self, bytecode_line_align);
+    put_i32(self, chunk->lines.count);
+    for (int i = 0; i < chunk->lines.count; i++) {
+        put_i32(self, chunk->lines.lines[i].line);
+        put_i32(self, chunk->lines.lines[i].count);
+    }
+
+    put_i32(self, chunk->caches.count);
+
+    put_i32(self, chunk->constants.count);
+    for (int i = 0; i < chunk->constants.count; i++) {
+        if (!put_constant(self, chunk->constants.values[i])) return false;
+    }
+    return true;
+}
+
+/* magic 是含结尾 '\0' 的 4 字节 */
+void put_header(BytecodeWriter* self, VirtualMachine* vm, const char* magic, uint16_t version,
+                const SourceStamp* stamp) {
+    put_bytes(self, magic, 4);
+    put_u16(self, version);
+    put_u16(self, OP_COUNT);
+    put_u32(self, current_flags(vm));
+    put_u64(self, stamp->size);
+    put_u64(self, (uint64_t)stamp->mtime);
+    put_u64(self, stamp->hash);
+}
+
+/* 先写临时文件再改名, 并发运行的进程不会读到写了一半的映像 */
+bool write_image(BytecodeWriter* self, const char* path) {
+    size_t length = strlen(path);
+    char* temp_path = malloc(length + 5);
+    if (temp_path == NULL) {
+        panic(" {PANIC} [bytecode::write_image] temp path malloc memory fail.");
+    }
+    memcpy(temp_path, path, length);
+    strcpy(temp_path + length, ".tmp");
+
+    FILE* file = fopen(temp_path, "wb");
+    bool ok = file != NULL;
+    if (ok) {
+        ok = fwrite(self->data, 1, self->count, file) == self->count;
+        ok = fclose(file) == 0 && ok;
+        if (ok) {
+            remove(path);      // Windows 上 rename 不覆盖已有文件
+            ok = rename(temp_path, path) == 0;
+        }
+        if (!ok) remove(temp_path);
+    }
+    free(temp_path);
+    return ok;
+}
+
+bool save_bytecode(VirtualMachine* vm, Fn* fn, const SourceStamp* stamp, const char* path) {
+    BytecodeWriter writer = { NULL, 0, 0 };
+    put_header(&writer, vm, bytecode_magic, bytecode_version, stamp);
+    bool ok = put_fn(&writer, fn) && write_image(&writer, path);
+    free(writer.data);
+    return ok;
+}
+
+
+/*===============================================================================*/
+// 读
+/*===============================================================================*/
+
+static bool reader_has(BytecodeReader* self, size_t size) {
+    if (!self->ok || (size_t)(self->end - self->cursor) < size) {
+        self->ok = false;
+        return false;
+    }
+    return true;
+}
+
+const uint8_t* get_bytes(BytecodeReader* self, size_t size) {
+    if (!reader_has(self, size)) return NULL;
+    const uint8_t* bytes = self->cursor;
+    self->cursor += size;
+    return bytes;
+}
+
+void get_align(BytecodeReader* self, size_t align) {
+    get_bytes(self, (align - (size_t)(self->cursor - self->base) % align) % align);
+}
+
+uint8_t get_u8(BytecodeReader* self) {
+    const uint8_t* bytes = get_bytes(self, 1);
+    return bytes == NULL ? 0 : bytes[0];
+}
+
+uint64_t get_u64(BytecodeReader* self) {
+    const uint8_t* bytes = get_bytes(self, 8);
+    if (bytes == NULL) return 0;
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value |= (uint64_t)bytes[i] << (i * 8);
+    return value;
+}
+
+uint32_t get_u32(BytecodeReader* self) {
+    const uint8_t* bytes = get_bytes(self, 4);
+    if (bytes == NULL) return 0;
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+uint16_t get_u16(BytecodeReader* self) {
+    const uint8_t* bytes = get_bytes(self, 2);
+    if (bytes == NULL) return 0;
+    return (uint16_t)(bytes[0] | bytes[1] << 8);
+}
+
+int32_t get_i32(BytecodeReader* self) {
+    return (int32_t)get_u32(self);
+}
+
+/* 元素个数: 不能为负, 也不能超过剩余字节能容纳的数量 */
+int get_count(BytecodeReader* self, size_t element_size) {
+    int32_t count = get_i32(self);
+    if (count < 0 || !reader_has(self, (size_t)count * element_size)) {
+        self->ok = false;
+        return 0;
+    }
+    return count;
+}
+
+/* 字符串常量重新驻留(new_string 会拷贝并查驻留表) */
+String* get_string(VirtualMachine* vm, BytecodeReader* self) {
+    int32_t length = get_i32(self);
+    if (length == -1) return NULL;
+    if (length < 0) {
+        self->ok = false;
+        return NULL;
+    }
+    const uint8_t* chars = get_bytes(self, (size_t)length);
+    if (chars == NULL) return NULL;
+    return new_string(vm, (const char*)chars, length);
+}
+
+static Value get_constant(VirtualMachine* vm, BytecodeReader* self, int depth) {
+    switch (get_u8(self)) {
+        case bytecode_constant_i32: return macro_val_from_i32(get_i32(self));
+        case bytecode_constant_i64: return macro_val_from_i64(vm, (int64_t)get_u64(self));
+        case bytecode_constant_f32: {
+            uint32_t bits = get_u32(self);
+            float f32;
+            memcpy(&f32, &bits, sizeof(f32));
+            return macro_val_from_f32(f32);
+        }
+        case bytecode_constant_f64: {
+            uint64_t bits = get_u64(self);
+            double f64;
+            memcpy(&f64, &bits, sizeof(f64));
+            return macro_val_from_f64(f64);
+        }
+        case bytecode_constant_string: {
+            String* string = get_string(vm, self);
+            if (string != NULL) return macro_val_from_obj(string);
+            break;
+        }
+        case bytecode_constant_fn: {
+            Fn* fn = get_fn(vm, self, depth + 1);
+            if (fn != NULL) return macro_val_from_obj(fn);
+            break;
+        }
+        default: break;
+    }
+    self->ok = false;
+    return macro_val_from_i32(0);
+}
+
+/* 2 字节大端操作数 */
+static int operand_short(Chunk* chunk, int offset) {
+    return (chunk->code[offset] << 8) | chunk->code[offset + 1];
+}
+
+static bool is_string_constant(Chunk* chunk, int index) {
+    return index < chunk->constants.count && macro_is_string(chunk->constants.values[index]);
+}
+
+/* 寄存器指令的 RK 操作数: 常量下标在范围内; 寄存器(帧内 slot)记入 max_slot */
+static bool check_rk(Chunk* chunk, uint8_t rk, int* max_slot) {
+    if (macro_rk_is_constant(rk)) return macro_rk_index(rk) < chunk->constants.count;
+    if (rk > *max_slot) *max_slot = rk;
+    return true;
+}
+
+/*
+* 一条指令的操作数: 常量 / 内联缓存 / upvalue 下标在范围内, 按名字取的常量是字符串,
+* op_closure 指向 Fn 常量; 访问的局部变量槽记入 max_slot(包括 op_closure 捕获的外层局部变量).
+* 调用前已确认固定部分的操作数都在 chunk 内.
+*/
+static bool check_operands(VirtualMachine* vm, Fn* fn, int offset, int* max_slot) {
+    Chunk* chunk = &fn->chunk;
+    uint8_t* code = chunk->code + offset;
+    int slot = -1;
+    switch (code[0]) {
+        case op_constant:
+            return code[1] < chunk->constants.count;
+        case op_constant_long:
+            return operand_short(chunk, offset + 1) < chunk->constants.count;
+
+        case op_define_global:
+        case op_get_global:
+        case op_set_global:
+        case op_get_super:
+        case op_get_layer_property:
+        case op_get_type:
+        case op_class:
+        case op_method:
+        case op_super_invoke:
+        case op_struct:
+        case op_member:
+        case op_enum:
+        case op_enum_define_member:
+        case op_enum_get_member:
+        case op_layer_property_call:
+            return is_string_constant(chunk, code[1]);
+        case op_get_property:
+        case op_set_property:
+        case op_get_self_property:
+            return is_string_constant(chunk, code[1]) && operand_short(chunk, offset + 2) < chunk->caches.count;
+        case op_invoke:
+            return is_string_constant(chunk, code[1]) && operand_short(chunk, offset + 3) < chunk->caches.count;
+
+        case op_get_upvalue:
+        case op_set_upvalue:
+            return code[1] < fn->upvalue_count;
+        case op_closure: {
+            if (code[1] >= chunk->constants.count || !macro_is_fn(chunk->constants.values[code[1]])) return false;
+            Fn* inner = macro_as_fn(chunk->constants.values[code[1]]);
+            if (offset + 2 + inner->upvalue_count > chunk->count) return false;
+            for (int i = 0; i < inner->upvalue_count; i++) {
+                uint8_t info = code[2 + i];
+                uint8_t index = info & 0x7F;
+                if (!(info & 0x80) && index >= fn->upvalue_count) return false;
+                if ((info & 0x80) && index > *max_slot) *max_slot = index;
+            }
+            return true;
+        }
+
+        case op_get_local:
+        case op_set_local:
+            slot = code[1];
+            break;
+        case op_get_local_local:
+        case op_add_local_local:
+            slot = code[1] > code[2] ? code[1] : code[2];
+            break;
+        case op_compare_local_constant_jump:
+            if (code[2] >= chunk->constants.count) return false;
+            slot = code[1];
+            break;
+        case op_enum_member_bind:
+            if (offset + 2 + code[1] > chunk->count) return false;
+            for (int i = 0; i < code[1]; i++) {
+                if (code[2 + i] > slot) slot = code[2 + i];
+            }
+            break;
+
+        case op_r_move:
+        case op_r_add:
+        case op_r_subtract:
+        case op_r_multiply:
+        case op_r_divide:
+        case op_r_mod:
+        case op_r_equal:
+        case op_r_not_equal:
+        case op_r_less:
+        case op_r_less_equal:
+        case op_r_greater:
+        case op_r_greater_equal: {
+            if (!vm->register_mode) return false;
+            if (code[1] != reg_push) slot = code[1];
+            int operand_count = code[0] == op_r_move ? 1 : 2;
+            for (int i = 0; i < operand_count; i++) {
+                if (!check_rk(chunk, code[2 + i], max_slot)) return false;
+            }
+            break;
+        }
+        default:
+            return true;
+    }
+    if (slot > *max_slot) *max_slot = slot;
+    return true;
+}
+
+/*
+* 映像内容不可信: 读出来的 Fn 在交给虚拟机之前逐条检查指令.
+*   - 操作码是已知指令, 整条指令(含变长部分)不越过 chunk 末尾, 操作数见 check_operands;
+*   - 跳转目标落在指令边界上(或 chunk 末尾);
+*   - 行号表恰好覆盖全部指令(运行时错误按它查行号).
+* max_stack 不用文件里的值, 由 compute_max_stack 重新分析(call() 只按它检查栈空间), 局部变量槽都要在它之内.
+* 嵌套的 Fn 作为常量先读, 已经校验过.
+*/
+static bool verify_fn(VirtualMachine* vm, Fn* fn) {
+    Chunk* chunk = &fn->chunk;
+    int count = chunk->count;
+    if (fn->arity < 0 || fn->arity > UINT8_MAX || fn->upvalue_count < 0 || fn->upvalue_count > upvalue_index_count) {
+        return false;
+    }
+
+    int total = 0;
+    for (int i = 0; i < chunk->lines.count; i++) {
+        if (chunk->lines.lines[i].count <= 0 || chunk->lines.lines[i].count > count - total) return false;
+        total += chunk->lines.lines[i].count;
+    }
+    if (total != count) return false;
+
+    // 加载时没有进行中的编译: compute_max_stack 的临时数组用一个临时 arena
+    Arena arena;
+    Arena* saved_arena = vm->arena;
+    if (saved_arena == NULL) {
+        arena_init(&arena);
+        vm->arena = &arena;
+    }
+    bool* starts = macro_arena_allocate(vm->arena, bool, count + 1);
+    for (int i = 0; i <= count; i++) starts[i] = false;
+
+    bool valid = true;
+    int max_slot = fn->arity;
+    for (int offset = 0; valid && offset < count; ) {
+        uint8_t opcode = chunk->code[offset];
+        // 先查固定部分再读操作数; 变长部分(op_closure / op_enum_member_bind)在 check_operands 里查
+        valid = opcode < OP_COUNT && instruction_fixed_length(opcode) > 0
+                && offset + instruction_fixed_length(opcode) <= count
+                && check_operands(vm, fn, offset, &max_slot);
+        if (!valid) break;
+        starts[offset] = true;
+        offset += instruction_length(chunk, offset);
+    }
+    starts[count] = true;
+
+    for (int offset = 0; valid && offset < count; ) {
+        int length = instruction_length(chunk, offset);
+        if (jump_direction(chunk->code[offset]) != 0) {
+            int target = jump_target(chunk, offset, length);
+            valid = target >= 0 && target <= count && starts[target];
+        }
+        offset += length;
+    }
+
+    if (valid) {
+        fn->max_stack = compute_max_stack(chunk, fn->arity);
+        valid = max_slot < fn->max_stack && fn->max_stack < constant_stack_max;
+    }
+
+    if (saved_arena == NULL) {
+        vm->arena = NULL;
+        arena_free(&arena);
+    }
+    return valid;
+}
+
+/*
+* 读一个 Fn. 读的过程中 fn 压在虚拟机栈上作为 gc 根;
+* 中途的分配可能触发 minor gc 把 fn 晋升到老年代, 所以之后每次写入引用都走写屏障.
+* code / lines 直接指向映像(is_mapped), 不拷贝.
+* 格式错误返回 NULL, 已分配的对象交给 gc 回收(它们的 chunk 不释放映像内存).
+*/
+Fn* get_fn(VirtualMachine* vm, BytecodeReader* self, int depth) {
+    if (depth > bytecode_max_depth) {
+        self->ok = false;
+        return NULL;
+    }
+
+    Fn* fn = new_fn(vm);
+    push(vm, macro_val_from_obj(fn));
+    Chunk* chunk = &fn->chunk;
+
+    fn->arity = get_i32(self);
+    fn->upvalue_count = get_i32(self);
+    (void)get_i32(self);                // max_stack: 不信任文件里的值, verify_fn 重新计算
+    fn->name = get_string(vm, self);
+    if (fn->name != NULL) gc_write_barrier(&fn->base, macro_val_from_obj(fn->name));
+
+    chunk->is_mapped = true;
+    int code_count = get_count(self, 1);
+    if (code_count > 0) {
+        chunk->code = (uint8_t*)get_bytes(self, (size_t)code_count);
+        chunk->capacity = code_count;
+        chunk->count = code_count;
+    }
+
+    get_align(self, bytecode_line_align);
+    int line_count = get_count(self, sizeof(RleLine));
+    if (line_count > 0) {
+        chunk->lines.lines = (RleLine*)get_bytes(self, (size_t)line_count * sizeof(RleLine));
+        chunk->lines.capacity = line_count;
+        chunk->lines.count = line_count;
+    }
+
+    int cache_count = get_i32(self);
+    if (cache_count < 0 || cache_count > UINT16_MAX) self->ok = false;
+    for (int i = 0; self->ok && i < cache_count; i++) {
+        add_inline_cache(chunk);
+    }
+
+    int constant_count = get_count(self, 1);
+    for (int i = 0; self->ok && i < constant_count; i++) {
+        Value value = get_constant(vm, self, depth);
+        if (!self->ok) break;
+        add_constant(chunk, value);
+        gc_write_barrier(&fn->base, value);
+    }
+    if (self->ok && !verify_fn(vm, fn)) self->ok = false;
+
+    pop(vm);
+    return self->ok ? fn : NULL;
+}
+
+/* 缓存是否与源码对应: 大小和修改时间都没变直接认为有效, 否则比较内容哈希 */
+static bool is_fresh(const char* source_path, uint64_t size, int64_t mtime, uint64_t hash) {
+    struct stat info;
+    if (stat(source_path, &info) != 0) return false;
+    if ((uint64_t)info.st_size != size) return false;
+    if ((int64_t)info.st_mtime == mtime) return true;
+
+    size_t source_size = 0;
+    uint8_t* source = read_whole_file(source_path, &source_size);
+    if (source == NULL) return false;
+    bool same = hash_source((const char*)source, source_size) == hash;
+    free(source);
+    return same;
+}
+
+/*
+* 检查文件头: magic / 格式版本 / 指令集 / 编译模式都要一致;
+* source_path 不为 NULL 时还要求映像与源码对应.
+*/
+bool get_header(BytecodeReader* self, VirtualMachine* vm, const char* magic, uint16_t version,
+                const char* source_path) {
+    const uint8_t* bytes = get_bytes(self, 4);
+    bool valid = bytes != NULL && memcmp(bytes, magic, 4) == 0
+        && get_u16(self) == version
+        && get_u16(self) == OP_COUNT
+        && get_u32(self) == current_flags(vm);
+
+    uint64_t source_size = get_u64(self);
+    int64_t source_mtime = (int64_t)get_u64(self);
+    uint64_t source_hash = get_u64(self);
+    valid = valid && self->ok;
+    if (valid && source_path != NULL) {
+        valid = is_fresh(source_path, source_size, source_mtime, source_hash);
+    }
+    return valid;
+}
+
+/* 只读映射整个文件; 没有 mmap 的平台读进内存. 打不开或是空文件返回 false */
+bool map_image(const char* path, BytecodeImage* image) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void* base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);      // 映射建立后文件描述符可以关闭
+    if (base == MAP_FAILED) return false;
+    image->base = base;
+    image->size = (size_t)info.st_size;
+    image->is_mapped = true;
+#else
+    image->base = read_whole_file(path, &image->size);
+    if (image->base == NULL) return false;
+    image->is_mapped = false;
+#endif
+    return true;
+}
+
+void unmap_image(BytecodeImage* image) {
+#ifndef _WIN32
+    if (image->is_mapped) {
+        munmap(image->base, image->size);
+        return;
+    }
+#endif
+    free(image->base);
+}
+
+/* 映像交给虚拟机, 一直保留到虚拟机销毁 */
+void keep_image(VirtualMachine* vm, const BytecodeImage* image) {
+    BytecodeImage* owned = malloc(sizeof(BytecodeImage));
+    if (owned == NULL) {
+        panic(" {PANIC} [bytecode::keep_image] bytecode image malloc memory fail.");
+    }
+    *owned = *image;
+    owned->next = vm->images;
+    vm->images = owned;
+}
+
+/* 在 free_gc_heap 之后调用: 此时已经没有 chunk 指向映像 */
+void free_bytecode_images(VirtualMachine* vm) {
+    BytecodeImage* image = vm->images;
+    while (image != NULL) {
+        BytecodeImage* next = image->next;
+        unmap_image(image);
+        free(image);
+        image = next;
+    }
+    vm->images = NULL;
+}
+
+/*
+* 加载 .jkc; source_path 不为 NULL 时先检查缓存是否与源码对应.
+* 文件不存在、格式版本 / 指令集 / 编译模式不符、缓存过期或文件损坏都返回 NULL, 由调用者重新编译.
+* 成功时映像挂到 vm->images 上, 一直保留到虚拟机销毁.
+* 返回的 Fn 没有挂在任何根上, 调用者要在下一次分配之前把它压栈(interpret_fn).
+*/
+Fn* load_bytecode(VirtualMachine* vm, const char* path, const char* source_path) {
+    BytecodeImage image;
+    if (!map_image(path, &image)) return NULL;
+
+    const uint8_t* data = image.base;
+    BytecodeReader reader = { data, data, data + image.size, true };
+    Fn* fn = NULL;
+    if (get_header(&reader, vm, bytecode_magic, bytecode_version, source_path)) {
+        fn = get_fn(vm, &reader, 0);
+        if (reader.cursor != reader.end) fn = NULL;    // 尾部有多余数据, 当作损坏
+    }
+    if (fn == NULL) {
+        // 失败时读出来的 Fn 已经不可达, 但 gc 释放它们时不会碰映像, 可以立刻解除映射
+        unmap_image(&image);
+        return NULL;
+    }
+    keep_image(vm, &image);
+    return fn;
+}
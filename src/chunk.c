@@ -5,6 +5,7 @@
 #include "error.h"
 #include "memory.h"
 #include "chunk.h"
+#include "fn.h"
 #include "vm.h"
 
 
@@ -49,16 +50,27 @@ void init_chunk(Chunk* chunk, VirtualMachine* vm) {
 	chunk->code = NULL;
 	init_rle_lines(&chunk->lines);
 	init_value_array(&chunk->constants, vm);
+    chunk->caches.count = 0;
+    chunk->caches.capacity = 0;
+    chunk->caches.caches = NULL;
+    chunk->is_mapped = false;
 }
 
 void free_chunk(Chunk* chunk) {
-	macro_free_array(chunk->vm, uint8_t, chunk->code, chunk->capacity);
-	free_rle_lines(chunk->vm, &chunk->lines);
+    if (!chunk->is_mapped) {
+        macro_free_array(chunk->vm, uint8_t, chunk->code, chunk->capacity);
+        free_rle_lines(chunk->vm, &chunk->lines);
+    }
 	free_value_array(&chunk->constants);
+    macro_free_array(chunk->vm, InlineCache, chunk->caches.caches, chunk->caches.capacity);
+    chunk->caches.count = 0;
+    chunk->caches.capacity = 0;
+    chunk->caches.caches = NULL;
     chunk->vm = NULL;
     chunk->count = 0;
     chunk->capacity = 0;
     chunk->code = NULL;
+    chunk->is_mapped = false;
     chunk->constants.vm = NULL;
     chunk->constants.count = 0;
     chunk->constants.capacity = 0;
@@ -150,3 +162,101 @@ void write_constant(Chunk* chunk, Value value, line_t line) {
 		panic("[ {PANIC} Chunk::write_constant] Expected index in uint8_t or uint16_t, Found up overflow.");
 	}
 }
+
+/* 为调用点分配一个空的 inline cache, 返回其下标(由调用点以 16 bit 操作数引用) */
+index_t add_inline_cache(Chunk* chunk) {
+    if (chunk->caches.count >= UINT16_MAX) {
+        panic("[ {PANIC} Chunk::add_inline_cache] Expected inline cache count in uint16_t, Found up overflow.");
+    }
+    if (chunk->caches.capacity < chunk->caches.count + 1) {
+        int old_capacity = chunk->caches.capacity;
+        chunk->caches.capacity = macro_grow_capacity(old_capacity);
+        chunk->caches.caches = macro_grow_array(
+            chunk->vm,
+            InlineCache,
+            chunk->caches.caches,
+            old_capacity,
+            chunk->caches.capacity
+        );
+    }
+    InlineCache* cache = &chunk->caches.caches[chunk->caches.count];
+    cache->count = 0;
+    cache->next = 0;
+    return chunk->caches.count++;
+}
+
+/*
+* 截断 chunk 末尾的指令(register mode 把已发出的栈指令回收为寄存器指令).
+* 同步回退 RLE 行号, 常量池不回收.
+*/
+void truncate_chunk(Chunk* chunk, int count) {
+    if (count < 0 || count > chunk->count) {
+        panic("[ {PANIC} Chunk::truncate_chunk] Expected count in [0, %d], Found %d.", chunk->count, count);
+    }
+    int removed = chunk->count - count;
+    while (removed > 0) {
+        RleLine* last = &chunk->lines.lines[chunk->lines.count - 1];
+        int n = last->count < removed ? last->count : removed;
+        last->count -= n;
+        removed -= n;
+        if (last->count == 0) chunk->lines.count--;
+    }
+    chunk->count = count;
+}
+
+/* 指令长度(字节, 含操作码)的固定部分, 由指令表展开; 0 表示未知操作码 */
+static const uint8_t instruction_sizes[256] = {
+#define OP(opcode, width, handler, flow) [opcode] = (width) + 1,
+#include "op_table.inc"
+#undef OP
+};
+
+/* 指令固定部分的长度(操作码 + 定长操作数), 不读操作数; 未知操作码返回 0 */
+int instruction_fixed_length(uint8_t opcode) {
+    return instruction_sizes[opcode];
+}
+
+/* 指令长度; 未知操作码返回 0 */
+int instruction_length(Chunk* chunk, int offset) {
+    uint8_t opcode = chunk->code[offset];
+    switch (opcode) {
+        case op_closure: {
+            Fn* fn = macro_as_fn(chunk->constants.values[chunk->code[offset + 1]]);
+            return instruction_sizes[opcode] + fn->upvalue_count;
+        }
+        case op_enum_member_bind:
+            return instruction_sizes[opcode] + chunk->code[offset + 1];
+        default:
+            return instruction_sizes[opcode];
+    }
+}
+
+/* 跳转指令的 16 bit 偏移总在指令末尾, 相对于下一条指令; 返回 1 前向, -1 后向, 0 非跳转 */
+int jump_direction(uint8_t opcode) {
+    switch (opcode) {
+        case op_jump_if_false:
+        case op_jump_if_neq:
+        case op_jump:
+        case op_break:
+        case op_match:
+        case op_enum_member_match:
+        case op_less_jump_i32:
+        case op_less_equal_jump_i32:
+        case op_greater_jump_i32:
+        case op_greater_equal_jump_i32:
+        case op_compare_local_constant_jump:
+            return 1;
+        case op_loop:
+        case op_continue:
+            return -1;
+        default:
+            return 0;
+    }
+}
+
+/* 跳转指令(长度 length)的目标偏移 */
+int jump_target(Chunk* chunk, int offset, int length) {
+    int end = offset + length;
+    int jump = (chunk->code[end - 2] << 8) | chunk->code[end - 1];
+    return jump_direction(chunk->code[offset]) > 0 ? end + jump : end - jump;
+}
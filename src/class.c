@@ -6,19 +6,23 @@
 #include "memory.h"
 #include "string_.h"
 #include "class.h"
+#include "vm.h"
 
 
 Class* new_class(VirtualMachine *vm, String* name) {
     Class* klass = macro_allocate_object(vm, Class, OBJ_CLASS);
     klass->name = name;
     init_hashmap(&klass->methods, vm);
+    klass->version = ++vm->class_version;
+    init_root_shape(&klass->root_shape);
     return klass;
 }
 
 void free_class(Class* self) {
     if (self != NULL) {
         free_hashmap(&self->methods);
-        macro_free(self->base.vm, Class, self);
+        free_shape_tree(self->base.vm, &self->root_shape);
+        macro_release_object(self, Class);
     }
 }
 
@@ -37,7 +37,7 @@ Closure* new_closure(Fn* fn) {
 
 void free_closure(Closure* self) {
 	if (self != NULL) {
-        macro_free(self->base.vm, Closure, self);
+        release_object(&self->base, sizeof(Closure) + sizeof(Upvalue*) * self->upvalue_count);
     }
 }
 
@@ -50,11 +50,15 @@
 *
 */
 
+#include <limits.h>
 #include "common.h"
 #include "string_.h"
 #include "compiler.h"
 #include "scanner.h"
 #include "parser.h"
+#include "memory.h"
+#include "fn.h"
+#include "arena.h"
 
 /*
 * TODO: implement
@@ -64,15 +68,9 @@
 * before compiling the operand and then pass that into emitByte(),
 */
 
-static void __attribute__((unused)) free_local_variables(VirtualMachine *vm, LocalVariable local[], int count) {
-	for (int i = 0; i < count; i++) {
-		free_token(vm, &local[i].name);
-	}
-}
-
 void begin_loop(Compiler* self, Loop *curr_loop, int start) {
     curr_loop->start = start;
-    curr_loop->end = -1;
+    curr_loop->break_count = 0;
     curr_loop->enclosing = self->loop;
     self->loop = curr_loop;
 }
@@ -97,6 +95,7 @@ void init_compiler(Compiler* self, VirtualMachine *vm, FnType type) {
 	LocalVariable* local = &self->locals[self->local_count++];
 	local->depth = 0;
 	local->is_captured = false;
+	local->type = type_unknown;
     switch (type) {
     case type_initializer:
     case type_method:
@@ -104,7 +103,6 @@ void init_compiler(Compiler* self, VirtualMachine *vm, FnType type) {
         local->name.start = "self";
         local->name.length = 4;
         local->name.line = 0;
-        local->name.next = NULL;
         break;
     case type_fn:
     case type_lambda:
@@ -113,11 +111,18 @@ void init_compiler(Compiler* self, VirtualMachine *vm, FnType type) {
         local->name.start = "";
         local->name.length = 0;
         local->name.line = 0;
-        local->name.next = NULL;
         break;
     }
 
     self->loop = NULL;
+
+    self->reg_operands[0] = self->reg_operands[1] = -1;
+    self->reg_last_op = -1;
+    self->reg_last_set = -1;
+    self->jump_target = 0;
+    self->typed_count = 0;
+    self->typed_last_op = -1;
+    self->constant_count = 0;
 }
 
 void free_compiler(Compiler* self) {
@@ -157,29 +162,281 @@ void print_locals(Compiler* self) {
 }
 
 
+/* 单条指令的栈效应(执行后栈深度的变化); 未知指令返回 stack_effect_unknown */
+#define stack_effect_unknown INT_MIN
+static int stack_effect(Chunk* chunk, int offset) {
+    uint8_t* code = chunk->code + offset;
+    switch (code[0]) {
+        case op_dup:
+        case op_constant:
+        case op_constant_long:
+        case op_value:
+        case op_none:
+        case op_true:
+        case op_false:
+        case op_get_global:
+        case op_get_local:
+        case op_get_upvalue:
+        case op_get_type:
+        case op_closure:
+        case op_class:
+        case op_struct:
+        case op_enum:
+        case op_enum_get_member:
+        case op_add_local_local:
+        case op_compare_local_constant_jump:
+        case op_get_self_property:
+            return 1;
+
+        case op_get_local_local:
+            return 2;
+
+        case op_not:
+        case op_negate:
+        case op_bw_not:
+        case op_set_global:
+        case op_set_local:
+        case op_set_upvalue:
+        case op_get_property:
+        case op_get_layer_property:
+        case op_jump_if_false:
+        case op_jump:
+        case op_loop:
+        case op_break:
+        case op_continue:
+        case op_match:
+        case op_return:
+        case op_enum_member_bind:
+        case op_enum_member_match:      // 命中分支额外压入的绑定值由调用方处理
+        case op_r_move:
+            return 0;
+
+        case op_pop:
+        case op_equal:
+        case op_not_equal:
+        case op_less:
+        case op_less_equal:
+        case op_greater:
+        case op_greater_equal:
+        case op_add:
+        case op_subtract:
+        case op_multiply:
+        case op_divide:
+        case op_mod:
+        case op_bw_and:
+        case op_bw_or:
+        case op_bw_xor:
+        case op_bw_sl:
+        case op_bw_sr:
+        case op_define_global:
+        case op_set_property:
+        case op_get_super:
+        case op_jump_if_neq:
+        case op_close_upvalue:
+        case op_print:
+        case op_method:
+        case op_inherit:
+        case op_member:
+        case op_struct_inherit:
+        case op_enum_define_member:
+        case op_vector_get:
+        case op_add_i32:
+        case op_subtract_i32:
+        case op_multiply_i32:
+        case op_equal_i32:
+        case op_not_equal_i32:
+        case op_less_i32:
+        case op_less_equal_i32:
+        case op_greater_i32:
+        case op_greater_equal_i32:
+        case op_add_f64:
+        case op_subtract_f64:
+        case op_multiply_f64:
+        case op_divide_f64:
+        case op_less_f64:
+        case op_less_equal_f64:
+        case op_greater_f64:
+        case op_greater_equal_f64:
+        case op_less_jump_i32:
+        case op_less_equal_jump_i32:
+        case op_greater_jump_i32:
+        case op_greater_equal_jump_i32:
+            return -1;
+
+        case op_vector_set:
+            return -2;
+        case op_call:
+            return -code[1];
+        case op_invoke:
+            return -code[2];
+        case op_layer_property_call:
+            return -code[2];
+        case op_super_invoke:
+            return -code[2] - 1;
+        case op_vector_new:
+            return 1 - code[1];
+
+        case op_r_add:
+        case op_r_subtract:
+        case op_r_multiply:
+        case op_r_divide:
+        case op_r_mod:
+        case op_r_equal:
+        case op_r_not_equal:
+        case op_r_less:
+        case op_r_less_equal:
+        case op_r_greater:
+        case op_r_greater_equal:
+            return code[1] == reg_push ? 1 : 0;
+
+        default:
+            return stack_effect_unknown;
+    }
+}
+
+/*
+* 栈深度分析: 沿控制流前向传播每条指令入口处的栈深度, 取所有前驱的最大值.
+* 返回函数执行期间相对 frame->slots 的最大深度(slot 0 与参数计入), call() 据此一次性检查栈空间,
+* run() 内的 push / pop 不再逐条检查边界.
+* 无法分析(循环使深度持续增长 / 跳转越界)时退回 stack_upper_bound.
+*/
+#define stack_analysis_visit_max 64
+
+/*
+* 不看控制流的上界: 入口深度加上每条指令压栈量(正的栈效应)之和.
+* 每条指令在一次循环迭代内至多执行一次, 编译器生成的循环体栈平衡, 所以这是真正的上界;
+* 解不出指令长度 / 栈效应时返回 constant_stack_max, call() 会报栈溢出而不是越界写.
+*/
+static int stack_upper_bound(Chunk* chunk, int arity) {
+    int bound = arity + 1;
+    for (int offset = 0; offset < chunk->count; ) {
+        int length = instruction_length(chunk, offset);
+        int effect = length > 0 ? stack_effect(chunk, offset) : stack_effect_unknown;
+        if (effect == stack_effect_unknown || offset + length > chunk->count) return constant_stack_max;
+
+        // 命中的 op_enum_member_match 压入的绑定值, 个数记在紧随其后的 op_enum_member_bind 上
+        if (chunk->code[offset] == op_enum_member_bind) effect = chunk->code[offset + 1];
+        if (effect > 0) bound += effect;
+        if (bound >= constant_stack_max) return constant_stack_max;
+        offset += length;
+    }
+    return bound;
+}
+
+int compute_max_stack(Chunk* chunk, int arity) {
+    VirtualMachine* vm = chunk->vm;
+    int count = chunk->count;
+    int entry = arity + 1;
+    if (count == 0) return entry;
+
+    ArenaMark mark = arena_save(vm->arena);
+    int* depths = macro_arena_allocate(vm->arena, int, count);     // depths[offset]: 入口深度, -1 表示尚未到达
+    int* visits = macro_arena_allocate(vm->arena, int, count);
+    int* worklist = macro_arena_allocate(vm->arena, int, count);
+    bool* queued = macro_arena_allocate(vm->arena, bool, count);
+    int top = 0;
+    for (int i = 0; i < count; i++) {
+        depths[i] = -1;
+        visits[i] = 0;
+        queued[i] = false;
+    }
+
+    int max = entry;
+    bool valid = true;
+    depths[0] = entry;
+    worklist[top++] = 0;
+    queued[0] = true;
+
+    while (top > 0 && valid) {
+        int offset = worklist[--top];
+        queued[offset] = false;
+        int length = instruction_length(chunk, offset);
+        int effect = length > 0 ? stack_effect(chunk, offset) : stack_effect_unknown;
+        if (effect == stack_effect_unknown || offset + length > count || ++visits[offset] > stack_analysis_visit_max) {
+            valid = false;
+            break;
+        }
+
+        uint8_t opcode = chunk->code[offset];
+        int depth = depths[offset] + effect;
+        if (depth < 0) depth = 0;
+        if (depth > max) max = depth;
+
+        // 后继: (目标偏移, 到达时的深度)
+        int successors[2][2];
+        int successor_count = 0;
+        bool fallthrough = opcode != op_return && opcode != op_jump && opcode != op_loop
+                && opcode != op_break && opcode != op_continue;
+
+        if (opcode == op_enum_member_match) {
+            // 命中: 压入枚举实例携带的值, 数量以紧随其后的 op_enum_member_bind 为准; 未命中: 跳走
+            int next = offset + length;
+            int bind = next < count && chunk->code[next] == op_enum_member_bind ? chunk->code[next + 1] : 0;
+            int matched = depths[offset] - 2 + bind;
+            if (matched > max) max = matched;
+            successors[successor_count][0] = next;
+            successors[successor_count++][1] = matched;
+            successors[successor_count][0] = jump_target(chunk, offset, length);
+            successors[successor_count++][1] = depths[offset] - 2;
+            fallthrough = false;
+        } else if (jump_direction(opcode) != 0) {
+            successors[successor_count][0] = jump_target(chunk, offset, length);
+            successors[successor_count++][1] = depth;
+        }
+        if (fallthrough) {
+            successors[successor_count][0] = offset + length;
+            successors[successor_count++][1] = depth;
+        }
+
+        for (int i = 0; i < successor_count; i++) {
+            int target = successors[i][0];
+            int target_depth = successors[i][1] < 0 ? 0 : successors[i][1];
+            if (target == count) continue;      // 落到 chunk 末尾(不会执行到)
+            if (target < 0 || target > count) {
+                valid = false;
+                break;
+            }
+            if (target_depth > depths[target]) {
+                depths[target] = target_depth;
+                if (!queued[target]) {
+                    queued[target] = true;
+                    worklist[top++] = target;
+                }
+            }
+        }
+    }
+
+    arena_restore(vm->arena, mark);
+    return valid ? max : stack_upper_bound(chunk, arity);
+}
+
+/* parser 边解析边向 scanner 要 token, token 只在 parser 的环形缓冲里, 内存与源码大小无关;
+ * 编译器的临时数组分配在本次编译的 arena 上, 结束后一次释放;
+ * 需要活过编译的标识符 / 字符串已经在解析时拷进了驻留的 String */
 Fn* compile(VirtualMachine* vm, const char* source) {
+    Arena arena;
+    arena_init(&arena);
+    vm->arena = &arena;
+
 	Scanner scanner;
 	init_scanner(&scanner, vm, source);
-    scan_tokens(&scanner);
-
-    // print_tokens(scanner.tokens);
 
 	Parser parser;
-	init_parser(&parser, vm, scanner.tokens);
+	init_parser(&parser, vm, &scanner);
 
 	Compiler top_compiler;
 	init_compiler(&top_compiler, vm, type_script);
 	vm->compiler = &top_compiler;
 
 	Fn* fn = parse_tokens(&parser, vm);
-
-    // extend tokens: will tokens lifetime equal vm.
-    list_extend_token(vm->tokens, scanner.tokens, vm);
+	bool had_error = parser.had_error;     // free_parser() 会重置 had_error
 
     free_parser(&parser);
 	free_scanner(&scanner);
+    vm->arena = NULL;
+    arena_free(&arena);
     // free_compiler(vm->compiler) ; in parse_tokens() free
 
 	// TODO: return compile status can be improved(e.g. return detailed error message and more status information)
-	return parser.had_error ? NULL : fn;
+	return had_error ? NULL : fn;
 }
@@ -18,10 +18,16 @@ void console_help(int argc, char **argv) {
     printf("  -v, --version            Print the version number and exit.\n");
     printf("  -i, --interactive        Start an interactive shell.\n");
     printf("  -e, --eval <code>        Evaluate the given code.\n");
-    printf("  -c, --compile <file>     Compile the given file.\n");
+    printf("  -g, --gc-pause <us> <file> Run the given file with incremental gc, pausing at most <us> microseconds per step.\n");
+    printf("  -j, --gc-workers <n> <file> Run the given file with <n> threads marking in parallel during major gc.\n");
+    printf("  -l, --lex <file>         Scan the given file only and report the lexing throughput (MB/s).\n");
+    printf("  -c, --compile <file>     Compile the given file to bytecode (foo.jk -> foo.jkc, picked up by later runs).\n");
     printf("  -m, --match <option>     Match the given option.\n");
-    printf("  -o, --output <file>      Specify the output file.\n");
+    printf("  -o, --output <file>      Specify the output file (with -c or -S).\n");
+    printf("  -p, --prelude <prelude> <file> Restore the globals of <prelude> from its snapshot (foo.jks), then run the given file.\n");
+    printf("  -r, --register <file>    Run the given file on the register-based VM.\n");
     printf("  -s, --stdin              Read from stdin.\n");
+    printf("  -S, --snapshot <file>    Run the given prelude and snapshot its globals (foo.jk -> foo.jks).\n");
     printf("  -t, --test <file>        Run the given file as a test.\n");
     printf("  -w, --watch <file>       Watch the given file.\n");
 }
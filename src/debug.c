@@ -16,6 +16,7 @@
 #include "value.h"
 #include "Fn.h"
 #include "chunk.h"
+#include "operator.h"
 
 // Forward declarations of helper functions
 static int simple_instruction(const char* name, int offset);
@@ -24,7 +25,12 @@ static int constant_long_instruction(const char* name, Chunk* chunk, int offset)
 static int byte_instruction(const char* name, Chunk* chunk, int offset);
 static int jump_instruction(const char* name, int sign, Chunk* chunk, int offset);
 static int invoke_instruction(const char* name, Chunk* chunk, int offset);
+static int property_cache_instruction(const char* name, Chunk* chunk, int offset);
+static int invoke_cache_instruction(const char* name, Chunk* chunk, int offset);
 static int args_instruction(const char* name, Chunk* chunk, int offset);
+static int register_instruction(const char* name, Chunk* chunk, int offset, int operand_count);
+static int byte_pair_instruction(const char* name, Chunk* chunk, int offset);
+static int compare_jump_instruction(const char* name, Chunk* chunk, int offset);
 
 
 void disassemble_chunk(Chunk* chunk, const char* name) {
@@ -79,8 +85,8 @@ int disassemble_instruction(Chunk* chunk, int offset) {
 	case op_set_local:    return byte_instruction("op_set_local", chunk, offset);
 	case op_get_upvalue:  return byte_instruction("op_get_upvalue", chunk, offset);
 	case op_set_upvalue:  return byte_instruction("op_set_upvalue", chunk, offset);
-    case op_get_property: return constant_instruction("op_get_property", chunk, offset);
-    case op_set_property: return constant_instruction("op_set_property", chunk, offset);
+    case op_get_property: return property_cache_instruction("op_get_property", chunk, offset);
+    case op_set_property: return property_cache_instruction("op_set_property", chunk, offset);
     case op_get_super:    return constant_instruction("op_get_super", chunk, offset);
     case op_get_layer_property: return constant_instruction("op_get_layer_property", chunk, offset);
 
@@ -117,7 +123,7 @@ int disassemble_instruction(Chunk* chunk, int offset) {
     case op_class: return constant_instruction("op_class", chunk, offset);
     case op_method:return constant_instruction("op_method", chunk, offset);
     case op_inherit:return simple_instruction("op_inherit", offset);
-    case op_invoke:return invoke_instruction("op_invoke", chunk, offset);
+    case op_invoke:return invoke_cache_instruction("op_invoke", chunk, offset);
     case op_super_invoke:return invoke_instruction("op_super_invoke", chunk, offset);
     case op_struct:return constant_instruction("op_struct", chunk, offset);
     case op_member:return constant_instruction("op_member", chunk, offset);
@@ -132,6 +138,46 @@ int disassemble_instruction(Chunk* chunk, int offset) {
     case op_vector_new:return constant_instruction("op_vector_new", chunk, offset);
     case op_vector_get:return simple_instruction("op_vector_get", offset);
     case op_vector_set: return simple_instruction("op_vector_set", offset);
+
+    case op_r_move:         return register_instruction("op_r_move", chunk, offset, 1);
+    case op_r_add:          return register_instruction("op_r_add", chunk, offset, 2);
+    case op_r_subtract:     return register_instruction("op_r_subtract", chunk, offset, 2);
+    case op_r_multiply:     return register_instruction("op_r_multiply", chunk, offset, 2);
+    case op_r_divide:       return register_instruction("op_r_divide", chunk, offset, 2);
+    case op_r_mod:          return register_instruction("op_r_mod", chunk, offset, 2);
+    case op_r_equal:        return register_instruction("op_r_equal", chunk, offset, 2);
+    case op_r_not_equal:    return register_instruction("op_r_not_equal", chunk, offset, 2);
+    case op_r_less:         return register_instruction("op_r_less", chunk, offset, 2);
+    case op_r_less_equal:   return register_instruction("op_r_less_equal", chunk, offset, 2);
+    case op_r_greater:      return register_instruction("op_r_greater", chunk, offset, 2);
+    case op_r_greater_equal:return register_instruction("op_r_greater_equal", chunk, offset, 2);
+
+    case op_add_i32: return simple_instruction("op_add_i32", offset);
+    case op_subtract_i32: return simple_instruction("op_subtract_i32", offset);
+    case op_multiply_i32: return simple_instruction("op_multiply_i32", offset);
+    case op_equal_i32: return simple_instruction("op_equal_i32", offset);
+    case op_not_equal_i32: return simple_instruction("op_not_equal_i32", offset);
+    case op_less_i32: return simple_instruction("op_less_i32", offset);
+    case op_less_equal_i32: return simple_instruction("op_less_equal_i32", offset);
+    case op_greater_i32: return simple_instruction("op_greater_i32", offset);
+    case op_greater_equal_i32: return simple_instruction("op_greater_equal_i32", offset);
+    case op_add_f64: return simple_instruction("op_add_f64", offset);
+    case op_subtract_f64: return simple_instruction("op_subtract_f64", offset);
+    case op_multiply_f64: return simple_instruction("op_multiply_f64", offset);
+    case op_divide_f64: return simple_instruction("op_divide_f64", offset);
+    case op_less_f64: return simple_instruction("op_less_f64", offset);
+    case op_less_equal_f64: return simple_instruction("op_less_equal_f64", offset);
+    case op_greater_f64: return simple_instruction("op_greater_f64", offset);
+    case op_greater_equal_f64: return simple_instruction("op_greater_equal_f64", offset);
+    case op_less_jump_i32: return jump_instruction("op_less_jump_i32", 1, chunk, offset);
+    case op_less_equal_jump_i32: return jump_instruction("op_less_equal_jump_i32", 1, chunk, offset);
+    case op_greater_jump_i32: return jump_instruction("op_greater_jump_i32", 1, chunk, offset);
+    case op_greater_equal_jump_i32: return jump_instruction("op_greater_equal_jump_i32", 1, chunk, offset);
+
+    case op_get_local_local:    return byte_pair_instruction("op_get_local_local", chunk, offset);
+    case op_add_local_local:    return byte_pair_instruction("op_add_local_local", chunk, offset);
+    case op_compare_local_constant_jump: return compare_jump_instruction("op_compare_local_constant_jump", chunk, offset);
+    case op_get_self_property:  return property_cache_instruction("op_get_self_property", chunk, offset);
 	default:
         warning("{WAINING} [debug::disassemble_instruction] unknown opcode %d\n", instruction);
         return offset + 1;
@@ -180,6 +226,25 @@ static int invoke_instruction(const char* name, Chunk* chunk, int offset) {
 	return offset + 3;
 }
 
+static int property_cache_instruction(const char* name, Chunk* chunk, int offset) {
+	uint8_t constant = chunk->code[offset + 1];
+	uint16_t cache = (uint16_t)(chunk->code[offset + 2] << 8) | chunk->code[offset + 3];
+	printf("%-16s %4d '", name, constant);
+	print_value(chunk->constants.values[constant]);
+	printf("' (ic %d)\n", cache);
+	return offset + 4;
+}
+
+static int invoke_cache_instruction(const char* name, Chunk* chunk, int offset) {
+	uint8_t constant = chunk->code[offset + 1];
+	uint8_t arg_count = chunk->code[offset + 2];
+	uint16_t cache = (uint16_t)(chunk->code[offset + 3] << 8) | chunk->code[offset + 4];
+	printf("%-16s (%d args) %4d '", name, arg_count, constant);
+	print_value(chunk->constants.values[constant]);
+	printf("' (ic %d)\n", cache);
+	return offset + 5;
+}
+
 static int args_instruction(const char* name, Chunk* chunk, int offset) {
 	uint8_t bind_count = chunk->code[offset + 1];
 	printf("%-16s (%d args)\n", name, bind_count);
@@ -189,3 +254,38 @@ static int args_instruction(const char* name, Chunk* chunk, int offset) {
     }
 	return offset + 2 + bind_count;
 }
+
+/* A, RK(B)[, RK(C)]: r<n> 为帧内 slot, k<n> 为常量 */
+static int register_instruction(const char* name, Chunk* chunk, int offset, int operand_count) {
+	uint8_t dst = chunk->code[offset + 1];
+	dst == reg_push ? printf("%-16s push", name) : printf("%-16s r%-3d", name, dst);
+	for (int i = 0; i < operand_count; i++) {
+		uint8_t rk = chunk->code[offset + 2 + i];
+		if (macro_rk_is_constant(rk)) {
+			printf(" k%d'", macro_rk_index(rk));
+			print_value(chunk->constants.values[macro_rk_index(rk)]);
+			printf("'");
+		} else {
+			printf(" r%d", rk);
+		}
+	}
+	printf("\n");
+	return offset + 2 + operand_count;
+}
+
+static int byte_pair_instruction(const char* name, Chunk* chunk, int offset) {
+	printf("%-16s %4d %4d\n", name, chunk->code[offset + 1], chunk->code[offset + 2]);
+	return offset + 3;
+}
+
+/* slot, constant, operator, offset */
+static int compare_jump_instruction(const char* name, Chunk* chunk, int offset) {
+	uint8_t slot = chunk->code[offset + 1];
+	uint8_t constant = chunk->code[offset + 2];
+	Operator op = (Operator)chunk->code[offset + 3];
+	uint16_t jump_offset = (uint16_t)(chunk->code[offset + 4] << 8) | chunk->code[offset + 5];
+	printf("%-16s %4d %s '", name, slot, macro_ops_to_string(op));
+	print_value(chunk->constants.values[constant]);
+	printf("' -> %d\n", offset + 6 + jump_offset);
+	return offset + 6;
+}
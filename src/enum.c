@@ -24,7 +24,7 @@ void print_enum(Enum *self) {
 
 void free_enum(Enum *self) {
     if (self != NULL) {
-        macro_free(self->base.vm, Enum, self);
+        macro_release_object(self, Enum);
     }
 }
 
@@ -23,11 +23,15 @@ EnumInstance* new_enum_instance(VirtualMachine *vm, Enum* enum_type, String* nam
         instance->values = (Vec*)((char*)instance + sizeof(EnumInstance));
         instance->values->base.vm = vm;
         instance->values->base.type = OBJ_VEC;
-        instance->values->base.is_marked = false;
+        atomic_init(&instance->values->base.is_marked, false);
+        instance->values->base.is_old = false;
+        instance->values->base.is_remembered = false;
+        instance->values->base.size_class = 0;     // 内嵌在 EnumInstance 中, 不单独释放
         instance->values->base.next = NULL;
-        instance->values->start = (Value*)((char*)instance->values + sizeof(Vec));
-        instance->values->finish = instance->values->start + capacity;
-        instance->values->end = instance->values->start + capacity;
+        instance->values->kind = vec_kind_value;    // 内联存储, 不会扩容或改变存储类型
+        instance->values->count = capacity;
+        instance->values->capacity = capacity;
+        instance->values->as.values = (Value*)((char*)instance->values + sizeof(Vec));
     }
     return instance;
 }
@@ -40,7 +44,8 @@ void print_enum_instance(EnumInstance *self) {
 
 void free_enum_instance(EnumInstance *self) {
     if (self != NULL) {
-        macro_free(self->base.vm, EnumInstance, self);
+        size_t capacity = self->values != NULL ? self->values->capacity : 0;
+        release_object(&self->base, sizeof(EnumInstance) + sizeof(Vec) + capacity * sizeof(Value));
     }
 }
 
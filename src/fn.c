@@ -17,6 +17,7 @@ Fn* new_fn(VirtualMachine* vm) {
 	fn->arity = 0;
 	fn->name = NULL;
 	fn->upvalue_count = 0;
+	fn->max_stack = uint8_count;
 	init_chunk(&fn->chunk, vm);
 	return fn;
 }
@@ -24,7 +25,7 @@ Fn* new_fn(VirtualMachine* vm) {
 void free_fn(Fn* self) {
 	if (self != NULL) {
 		free_chunk(&self->chunk);
-		macro_free(self->base.vm, Fn, self);
+		macro_release_object(self, Fn);
 	}
 }
 
@@ -3,6 +3,10 @@
 //
 
 
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
 #include "common.h"
 #include "type.h"
 #include "gc.h"
@@ -20,6 +24,7 @@
 #include "vec.h"
 #include "enum.h"
 #include "enum_instance.h"
+#include "work_deque.h"
 
 
 #if debug_log_gc
@@ -30,6 +35,8 @@
 #include "allocator.h"
 #endif
 
+// EnumInstance 的负载(Vec 头和值)内联在对象后, 对象池按 GC_POOL_ENUM_VALUES 个值的上限分配节点
+#define gc_pooled_enum_instance_size (sizeof(EnumInstance) + sizeof(Vec) + GC_POOL_ENUM_VALUES * sizeof(Value))
 
 static void mark_roots(VirtualMachine *vm);
 static void mark_value(VirtualMachine *vm, Value value);
@@ -37,10 +44,17 @@ static void mark_object(VirtualMachine *vm, Object* object);
 static void mark_hashmap(VirtualMachine *vm, HashMap* hashmap);
 static void mark_compiler_roots(VirtualMachine *vm, Compiler* compiler);
 
+static void push_gray(VirtualMachine* vm, Object* object);
+static void mark_object_parallel(Object* object);
+static void trace_references_parallel(VirtualMachine* vm);
 static void trace_references(VirtualMachine* vm);
 static void blacken_object(VirtualMachine* vm, Object* object);
 static void mark_vec(VirtualMachine* vm, Vec* vec);
 static void mark_values(VirtualMachine* vm, Values* values);
+static void mark_remembered(VirtualMachine* vm);
+static void forget_remembered(VirtualMachine* vm);
+static bool start_sweeper(VirtualMachine* vm);
+static void flush_pool_batches(Pool** pools, PoolBatch* batches);
 
 
 
@@ -51,20 +65,76 @@ Gc new_garbage_collector() {
         .gray_count = 0,
         .gray_stack = NULL,
         .next_gc = (1024 * 1024),
+        .nursery = NULL,
+        .nursery_allocated = 0,
+        .is_minor = false,
+        .remembered_count = 0,
+        .remembered_capacity = 0,
+        .remembered = NULL,
+        .phase = gc_phase_idle,
+        .max_pause_us = 0,
+        .step_allocated = 0,
+        .sweeping = NULL,
+        .swept = NULL,
+        .swept_tail = NULL,
+        .mark_workers = 1,
+        .is_parallel = false,
+        .slab = { .slabs = NULL, .cursors = { NULL }, .limits = { NULL }, .slab_count = 0 },
+        .free_lists = { { NULL, NULL, 0 } },
+        // 日志按顺序打印清扫的对象; 调试分配器不是线程安全的
+        .background_sweep = !debug_log_gc && !debug_enable_allocator,
+        .sweeper = NULL,
+        .stress_count = 0,
+        .pools = {
+            [gc_pool_upvalue] = pool_create_packed(sizeof(Upvalue), GC_POOL_CAPACITY),
+            [gc_pool_bound_method] = pool_create_packed(sizeof(BoundMethod), GC_POOL_CAPACITY),
+            [gc_pool_pair] = pool_create_packed(sizeof(Pair), GC_POOL_CAPACITY),
+            [gc_pool_enum_instance] = pool_create_packed(gc_pooled_enum_instance_size, GC_POOL_CAPACITY),
+        },
+        .pool_freed = { { .count = 0 } },
     };
 }
 
 void free_garbage_collector(Gc* self) {
     if (self != NULL) {
         free(self->gray_stack);
+        free(self->remembered);
     }
 }
 
+/* 对象指针数组扩容; 不经过 reallocate, 避免在 gc 过程中再触发 gc */
+static Object** grow_object_stack(VirtualMachine* vm, Object** stack, int capacity) {
+#if debug_trace_allocator
+    return reallocate_memory(vm->allocator, stack, capacity * sizeof(Object*));
+#else
+    (void)vm;
+    Object** new_stack = realloc(stack, capacity * sizeof(Object*));
+    if (new_stack == NULL) {
+        panic(" {PANIC} [gc::grow_object_stack] gc object stack realloc memory fail.");
+    }
+    return new_stack;
+#endif
+}
+
+/* 记入记忆集(只记老年代对象, 每个对象最多一次) */
+void gc_remember(Object* object) {
+    if (!object->is_old || object->is_remembered) return;
+    Gc* gc = &object->vm->gc;
+    if (gc->remembered_capacity < gc->remembered_count + 1) {
+        gc->remembered_capacity = macro_grow_capacity(gc->remembered_capacity);
+        gc->remembered = grow_object_stack(object->vm, gc->remembered, gc->remembered_capacity);
+    }
+    object->is_remembered = true;
+    gc->remembered[gc->remembered_count++] = object;
+}
+
+#if debug_log_gc
 static void print_unreached(Object* unreached) {
     printf("[gc::print_unreached] unreached object: ");
     print_object(unreached);
     printf("\n");
 }
+#endif
 
 static void mark_roots(VirtualMachine *vm) {
     // stack
@@ -77,11 +147,11 @@ static void mark_roots(VirtualMachine *vm) {
         mark_object(vm, macro_into_object(vm->frames[i].closure));
     }
 
-    // open upvalues
+    // open upvalues(location 指向栈槽, 栈上的值已经标记过)
     for (Upvalue* upvalue = vm->open_upv_ptr;
         upvalue != NULL;
         upvalue = upvalue->next) {
-        mark_object(vm, macro_into_object(upvalue->location));
+        mark_object(vm, macro_into_object(upvalue));
     }
 
     // globals
@@ -92,17 +162,26 @@ static void mark_roots(VirtualMachine *vm) {
 
     // init string
     mark_object(vm, macro_into_object(vm->init_string));
+    for (int i = 0; i < well_known_string_count; i++) {
+        mark_object(vm, macro_into_object(vm->well_known[i]));
+    }
+    mark_object(vm, macro_into_object(vm->vec_class));
 }
 
 static void mark_value(VirtualMachine *vm, Value value) {
-    if (macro_is_obj(value)) {
-        mark_object(vm, macro_as_obj(value));
+    if (macro_is_gc_ref(value)) {
+        mark_object(vm, macro_as_gc_ref(value));
     }
 }
 
 static void mark_object(VirtualMachine *vm, Object* object) {
     if (object == NULL) return;
-    if (object->is_marked) return;
+    if (atomic_load_explicit(&object->is_marked, memory_order_relaxed)) return;
+    if (vm->gc.is_minor && object->is_old) return;  // minor gc: 老年代对象视为存活
+    if (vm->gc.is_parallel) {
+        mark_object_parallel(object);
+        return;
+    }
 
 #if debug_log_gc
     printf("[gc::mark_object] %p mark ", (void*)object);
@@ -110,30 +189,8 @@ static void mark_object(VirtualMachine *vm, Object* object) {
     printf("\n");
 #endif
 
-    object->is_marked = true;
-
-    // gray stack
-    if (vm->gc.gray_capacity < vm->gc.gray_count + 1) {
-        vm->gc.gray_capacity = macro_grow_capacity(vm->gc.gray_capacity);
-#if debug_trace_allocator
-        vm->gc.gray_stack = reallocate_memory(
-            vm->allocator,
-            vm->gc.gray_stack,
-            vm->gc.gray_capacity * sizeof(Object*)
-        );
-#else
-        void* new_stack = realloc(
-                vm->gc.gray_stack,
-                vm->gc.gray_capacity * sizeof(Object*)
-        );
-        if (new_stack == NULL) {
-            panic(" {PANIC} [gc::mark_object] gc::gray_stack realloc memory fail.");
-        }
-        vm->gc.gray_stack = new_stack;
-#endif
-    }
-
-    vm->gc.gray_stack[vm->gc.gray_count++] = object;
+    atomic_store_explicit(&object->is_marked, true, memory_order_relaxed);
+    push_gray(vm, object);
 }
 
 static void mark_hashmap(VirtualMachine *vm, HashMap* hashmap) {
@@ -149,18 +206,162 @@ static void mark_hashmap(VirtualMachine *vm, HashMap* hashmap) {
 static void mark_compiler_roots(VirtualMachine *vm, Compiler* compiler) {
     Compiler *curr = compiler;
     while (curr != NULL) {
-        mark_object(vm, macro_into_object(curr->fn));
+        Object* fn = macro_into_object(curr->fn);
+        if ((vm->gc.is_minor && fn->is_old) || atomic_load_explicit(&fn->is_marked, memory_order_relaxed)) {
+            blacken_object(vm, fn);     // 编译中的函数常量表写入没有写屏障, 直接扫描
+        } else {
+            mark_object(vm, fn);
+        }
         curr = curr->enclosing;
     }
 }
 
+static void push_gray(VirtualMachine* vm, Object* object) {
+    if (vm->gc.gray_capacity < vm->gc.gray_count + 1) {
+        vm->gc.gray_capacity = macro_grow_capacity(vm->gc.gray_capacity);
+        vm->gc.gray_stack = grow_object_stack(vm, vm->gc.gray_stack, vm->gc.gray_capacity);
+    }
+    vm->gc.gray_stack[vm->gc.gray_count++] = object;
+}
+
 static void trace_references(VirtualMachine* vm) {
+    // 压力测试下不看堆大小, 小堆也走并行标记
+    if (!vm->gc.is_minor && vm->gc.mark_workers > 1
+        && (debug_stress_gc || vm->gc.bytes_allocated >= GC_PARALLEL_MIN_HEAP)) {
+        trace_references_parallel(vm);
+        return;
+    }
     while (vm->gc.gray_count > 0) {
         Object* object = vm->gc.gray_stack[--vm->gc.gray_count];
         blacken_object(vm, object);
     }
 }
 
+/*===============================================================================*/
+// 并行标记
+/*===============================================================================*/
+
+typedef struct MarkWorker {
+    VirtualMachine* vm;
+    WorkDeque deque;                // 本线程的灰色对象
+    struct ParallelMark* shared;
+    int index;
+    pthread_t thread;
+} MarkWorker;
+
+typedef struct ParallelMark {
+    MarkWorker* workers;
+    int worker_count;
+    atomic_int active;              // 手上有活的线程数: 为 0 时所有队列都空, 标记结束
+} ParallelMark;
+
+static __thread MarkWorker* current_worker = NULL;
+
+/* 并行标记: 抢到标记位的线程把对象放进自己的队列 */
+static void mark_object_parallel(Object* object) {
+    if (atomic_exchange_explicit(&object->is_marked, true, memory_order_relaxed)) return;
+    work_deque_push(&current_worker->deque, object);
+}
+
+/* 先登记为活跃再窃取, 保证 active 为 0 时没有线程手里拿着未扫描的对象 */
+static Object* steal_work(MarkWorker* self) {
+    ParallelMark* shared = self->shared;
+    for (int i = 1; i < shared->worker_count; i++) {
+        MarkWorker* victim = &shared->workers[(self->index + i) % shared->worker_count];
+        if (work_deque_is_empty(&victim->deque)) continue;
+        atomic_fetch_add(&shared->active, 1);
+        Object* object = work_deque_steal(&victim->deque);
+        if (object != NULL) return object;
+        atomic_fetch_sub(&shared->active, 1);
+    }
+    return NULL;
+}
+
+static void mark_worker_loop(MarkWorker* self, bool is_active) {
+    ParallelMark* shared = self->shared;
+    current_worker = self;
+    for (;;) {
+        if (is_active) {
+            Object* object;
+            while ((object = work_deque_pop(&self->deque)) != NULL) {
+                blacken_object(self->vm, object);
+            }
+            atomic_fetch_sub(&shared->active, 1);
+        }
+
+        Object* stolen = NULL;
+        while (stolen == NULL) {
+            if (atomic_load(&shared->active) == 0) {
+                current_worker = NULL;
+                return;
+            }
+            stolen = steal_work(self);
+            if (stolen == NULL) sched_yield();
+        }
+        blacken_object(self->vm, stolen);
+        is_active = true;
+    }
+}
+
+static void* mark_worker_entry(void* arg) {
+    mark_worker_loop(arg, false);
+    return NULL;
+}
+
+/* 清空灰色栈: 当前线程作为 0 号线程拿走全部灰色对象, 其余线程从窃取开始 */
+static void trace_references_parallel(VirtualMachine* vm) {
+    int worker_count = vm->gc.mark_workers;
+    MarkWorker* workers = malloc(worker_count * sizeof(MarkWorker));
+    if (workers == NULL) {
+        panic(" {PANIC} [gc::trace_references_parallel] mark worker malloc memory fail.");
+    }
+    ParallelMark shared = { .workers = workers, .worker_count = worker_count };
+    atomic_init(&shared.active, 1);
+
+    for (int i = 0; i < worker_count; i++) {
+        workers[i] = (MarkWorker){ .vm = vm, .shared = &shared, .index = i };
+        work_deque_init(&workers[i].deque, 1024);
+    }
+    for (int i = 0; i < vm->gc.gray_count; i++) {
+        work_deque_push(&workers[0].deque, vm->gc.gray_stack[i]);
+    }
+    vm->gc.gray_count = 0;
+    vm->gc.is_parallel = true;
+
+    // 线程创建失败就少一个帮手, 它的队列一直为空
+    bool* is_started = calloc(worker_count, sizeof(bool));
+    if (is_started == NULL) {
+        panic(" {PANIC} [gc::trace_references_parallel] mark worker malloc memory fail.");
+    }
+    for (int i = 1; i < worker_count; i++) {
+        is_started[i] = pthread_create(&workers[i].thread, NULL, mark_worker_entry, &workers[i]) == 0;
+    }
+    mark_worker_loop(&workers[0], true);
+    for (int i = 1; i < worker_count; i++) {
+        if (is_started[i]) pthread_join(workers[i].thread, NULL);
+    }
+
+    vm->gc.is_parallel = false;
+    for (int i = 0; i < worker_count; i++) {
+        work_deque_free(&workers[i].deque);
+    }
+    free(is_started);
+    free(workers);
+}
+
+
+/* 写屏障: 已标记的 owner 写入了白色的 target, 增量标记期间把 target 染灰 */
+void gc_barrier_gray(Object* owner, Object* target) {
+    VirtualMachine* vm = owner->vm;
+    if (vm->gc.phase == gc_phase_mark) mark_object(vm, target);
+}
+
+/* 写屏障: 已标记的 owner 写入了一批引用, 增量标记期间重新放回灰色栈 */
+void gc_barrier_rescan(Object* owner) {
+    VirtualMachine* vm = owner->vm;
+    if (vm->gc.phase == gc_phase_mark) push_gray(vm, owner);
+}
+
 static void blacken_object(VirtualMachine* vm, Object* object) {
 #if debug_log_gc
     printf("[gc::blacken_object] %p blacken ", (void*)object);
@@ -199,8 +400,9 @@ static void blacken_object(VirtualMachine* vm, Object* object) {
     }
     case OBJ_STRUCT: {
         Struct* struct_ = macro_as_struct_from_obj(object);
+        mark_object(vm, macro_into_object(struct_->name));
         mark_hashmap(vm, &struct_->fields);
-        mark_vec(vm, struct_->names);
+        mark_object(vm, macro_into_object(struct_->names));     // names 是独立分配的 Vec 对象
         break;
     }
     case OBJ_BOUND_METHOD: {
@@ -212,13 +414,16 @@ static void blacken_object(VirtualMachine* vm, Object* object) {
     case OBJ_INSTANCE: {
         Instance *instance = macro_as_instance_from_obj(object);
         mark_object(vm, macro_into_object(instance->klass));
-        mark_hashmap(vm, &instance->fields);
+        for (int i = 0; i < instance->shape->slot_count; i++) {
+            mark_value(vm, instance->fields[i]);
+        }
         break;
     }
     case OBJ_CLASS: {
         Class* cls = macro_as_class_from_obj(object);
         mark_object(vm, macro_into_object(cls->name));
         mark_hashmap(vm, &cls->methods);
+        mark_shape_tree(vm, &cls->root_shape, mark_object);
         break;
     }
     case OBJ_CLOSURE: {
@@ -238,13 +443,16 @@ static void blacken_object(VirtualMachine* vm, Object* object) {
     case OBJ_UPVALUE: mark_value(vm, macro_as_upvalue_from_obj(object)->closed); break;
     case OBJ_NATIVE:
     case OBJ_STRING:
+    case OBJ_BOXED_I64:
         break;
     }
 }
 
 static void mark_vec(VirtualMachine* vm, Vec* vec) {
+    // 紧凑存储(i32 / i64 / f64)不含对象引用
+    if (vec == NULL || vec->kind != vec_kind_value) return;
     for (size_t i = 0; i < vec_len(vec); i++) {
-        mark_value(vm, vec->start[i]);
+        mark_value(vm, vec->as.values[i]);
     }
 }
 
@@ -254,53 +462,365 @@ static void mark_values(VirtualMachine* vm, Values* values) {
     }
 }
 
-static void hashmap_remove_white(HashMap* hashmap) {
+/* 记忆集中的老年代对象作为 minor gc 的额外根: 扫描其引用, 对象本身不标记 */
+static void mark_remembered(VirtualMachine* vm) {
+    for (int i = 0; i < vm->gc.remembered_count; i++) {
+        Object* object = vm->gc.remembered[i];
+        object->is_remembered = false;
+        blacken_object(vm, object);
+    }
+    vm->gc.remembered_count = 0;
+}
+
+/* gc 之后新生代为空, 不再有老年代 -> 新生代的引用 */
+static void forget_remembered(VirtualMachine* vm) {
+    for (int i = 0; i < vm->gc.remembered_count; i++) {
+        vm->gc.remembered[i]->is_remembered = false;
+    }
+    vm->gc.remembered_count = 0;
+}
+
+static bool is_reachable(VirtualMachine* vm, Object* object) {
+    return atomic_load_explicit(&object->is_marked, memory_order_relaxed) || (vm->gc.is_minor && object->is_old);
+}
+
+static void hashmap_remove_white(VirtualMachine* vm, HashMap* hashmap) {
     for (int i = 0; i < hashmap->capacity; i++) {
         Entry* entry = &hashmap->entries[i];
-        if (!is_empty_entry(entry) && !entry->key->base.is_marked) {
+        // 墓碑(key 为 NULL)跳过
+        if (entry->key != NULL && !is_reachable(vm, &entry->key->base)) {
             hashmap_remove(hashmap, entry->key);
         }
     }
 }
 
-static void sweep(VirtualMachine* vm) {
-    Object* prev = NULL;
-    Object* object = vm->objects;
+/*
+* 新生代(清扫后剩下的)对象整体接到老年代链表表头: 新生代都比老年代新,
+* 保持整条链表从新到旧的顺序(与不分代时一致).
+*/
+static void promote_nursery(VirtualMachine* vm) {
+    Object** tail = &vm->gc.nursery;
+    for (Object* object = vm->gc.nursery; object != NULL; object = object->next) {
+        object->is_old = true;
+        tail = &object->next;
+    }
+    *tail = vm->objects;
+    vm->objects = vm->gc.nursery;
+    vm->gc.nursery = NULL;
+}
 
-    while (object != NULL) {
-        if (object->is_marked) {
-            object->is_marked = false;  // unmark; next gc
-            prev = object;
-            object = object->next;
+/* 清扫新生代: 未标记的释放, 存活对象晋升到老年代 */
+static void sweep_nursery(VirtualMachine* vm) {
+    Object** link = &vm->gc.nursery;
+    while (*link != NULL) {
+        Object* object = *link;
+        if (atomic_load_explicit(&object->is_marked, memory_order_relaxed)) {
+            atomic_store_explicit(&object->is_marked, false, memory_order_relaxed);
+            link = &object->next;
         } else {
-            Object* unreached = object;
-            object = object->next;
-            if (prev != NULL) {
-                prev->next = object;
-            } else {
-                vm->objects = object;
-            }
-            print_unreached(unreached);
-            free_object(unreached);
+            *link = object->next;
+#if debug_log_gc
+            print_unreached(object);
+#endif
+            free_object(object);
         }
     }
+    flush_pool_batches(vm->gc.pools, vm->gc.pool_freed);
+    promote_nursery(vm);
 }
 
+#define gc_clock_interval   64      // 增量模式: 每处理这么多对象查看一次时间
 
-void collect_garbage(VirtualMachine* vm) {
-#if debug_log_gc
-    printf("-- GC BEGIN\n");
-    size_t before = vm->gc.bytes_allocated;
-#endif
-    // Used: mark-sweep
+static uint64_t clock_us(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void begin_mark(VirtualMachine* vm) {
+    vm->gc.phase = gc_phase_mark;
+    vm->gc.step_allocated = 0;
+    mark_roots(vm);
+}
+
+/* 一步标记, 到 deadline 为止; 灰色栈清空返回 true */
+static bool mark_slice(VirtualMachine* vm, uint64_t deadline) {
+    int count = 0;
+    while (vm->gc.gray_count > 0) {
+        Object* object = vm->gc.gray_stack[--vm->gc.gray_count];
+        blacken_object(vm, object);
+        if (++count == gc_clock_interval) {
+            count = 0;
+            if (clock_us() >= deadline) break;
+        }
+    }
+    return vm->gc.gray_count == 0;
+}
+
+/*
+* 标记收尾(原子): 根没有写屏障, 重新扫描后清空灰色栈.
+* 之后新生代整体晋升, 老年代链表摘下来等待清扫.
+*/
+static void finish_mark(VirtualMachine* vm) {
     mark_roots(vm);
     trace_references(vm);
     // weak ref and string pool
-    hashmap_remove_white(&vm->strings);
-    sweep(vm);
+    hashmap_remove_white(vm, &vm->strings);
+    promote_nursery(vm);
+    forget_remembered(vm);
+    vm->gc.nursery_allocated = 0;
+
+    vm->gc.sweeping = vm->objects;
+    vm->objects = NULL;
+    vm->gc.swept = NULL;
+    vm->gc.swept_tail = &vm->gc.swept;
+    vm->gc.phase = gc_phase_sweep;
+    if (vm->gc.background_sweep) start_sweeper(vm);
+}
+
+/* 一步清扫, 到 deadline 为止; 清扫完返回 true */
+static bool sweep_slice(VirtualMachine* vm, uint64_t deadline) {
+    int count = 0;
+    while (vm->gc.sweeping != NULL) {
+        Object* object = vm->gc.sweeping;
+        vm->gc.sweeping = object->next;
+        if (atomic_load_explicit(&object->is_marked, memory_order_relaxed)) {
+            atomic_store_explicit(&object->is_marked, false, memory_order_relaxed);  // unmark; next gc
+            object->next = NULL;
+            *vm->gc.swept_tail = object;
+            vm->gc.swept_tail = &object->next;
+        } else {
+#if debug_log_gc
+            print_unreached(object);
+#endif
+            free_object(object);
+        }
+        if (++count == gc_clock_interval) {
+            count = 0;
+            if (clock_us() >= deadline) break;
+        }
+    }
+    return vm->gc.sweeping == NULL;
+}
+
+/*===============================================================================*/
+// 空闲链表与后台清扫
+/*===============================================================================*/
+
+typedef struct Sweeper {
+    VirtualMachine* vm;
+    pthread_t thread;
+    atomic_bool is_done;
+    FreeList free_lists[GC_SIZE_CLASS_COUNT];   // 清扫释放的内存块, 结束后并入 vm->gc.free_lists
+    size_t freed_bytes;                         // 清扫释放的字节数, 结束后从 bytes_allocated 扣除
+    PoolBatch pool_freed[gc_pool_count];        // 清扫释放的池对象, 直接还给(无锁的)对象池
+} Sweeper;
+
+static __thread Sweeper* current_sweeper = NULL;
+
+void* gc_allocate_cell(VirtualMachine* vm, uint8_t size_class) {
+    size_t size = (size_t)size_class * GC_SIZE_CLASS_GRANULE;
+    FreeList* list = &vm->gc.free_lists[size_class - 1];
+    FreeCell* cell = list->head;
+    if (cell != NULL) {
+        list->head = cell->next;
+        if (list->head == NULL) list->tail = NULL;
+        list->count--;
+    } else {
+        cell = slab_carve(&vm->gc.slab, size_class);
+    }
+
+    // 与 reallocate 相同的统计和触发(取出的块不在任何链表上, gc 看不到它)
+    vm->gc.bytes_allocated += size;
+    gc_on_allocate(vm, size);
+    return cell;
+}
+
+/* 后台清扫线程上释放的块进它自己的链表 */
+void gc_release_cell(VirtualMachine* vm, void* cell, uint8_t size_class) {
+    size_t size = (size_t)size_class * GC_SIZE_CLASS_GRANULE;
+    FreeList* list;
+    if (current_sweeper != NULL) {
+        list = &current_sweeper->free_lists[size_class - 1];
+        current_sweeper->freed_bytes += size;
+    } else {
+        list = &vm->gc.free_lists[size_class - 1];
+        vm->gc.bytes_allocated -= size;
+    }
+
+    FreeCell* free_cell = cell;
+    free_cell->next = list->head;
+    list->head = free_cell;
+    if (list->tail == NULL) list->tail = free_cell;
+    list->count++;
+}
+
+/* reallocate 释放内存时调用: 在后台清扫线程上不碰 vm 的统计, 记到清扫线程自己的计数里 */
+bool gc_sweeper_free(void* pointer, size_t size) {
+    if (current_sweeper == NULL) return false;
+    current_sweeper->freed_bytes += size;
+    free(pointer);
+    return true;
+}
+
+/* 攒下的池对象成批还给对象池 */
+static void flush_pool_batch(Pool* pool, PoolBatch* batch) {
+    if (batch->count == 0) return;
+    pool_free_batch(pool, batch->items, batch->count);
+    batch->count = 0;
+}
+
+static void flush_pool_batches(Pool** pools, PoolBatch* batches) {
+    for (int i = 0; i < gc_pool_count; i++) {
+        flush_pool_batch(pools[i], &batches[i]);
+    }
+}
+
+/* 对象从哪个对象池分配, -1 表示不用对象池 */
+int gc_pool_of(ObjectType type, size_t size) {
+    switch (type) {
+    case OBJ_UPVALUE:       return gc_pool_upvalue;
+    case OBJ_BOUND_METHOD:  return gc_pool_bound_method;
+    case OBJ_PAIR:          return gc_pool_pair;
+    case OBJ_ENUM_INSTANCE: return size <= gc_pooled_enum_instance_size ? gc_pool_enum_instance : -1;
+    default:                return -1;
+    }
+}
+
+/* 池对象的统计和触发与 gc_allocate_cell 相同 */
+void* gc_allocate_pooled(VirtualMachine* vm, GcPool pool, size_t size) {
+    void* cell = pool_alloc(vm->gc.pools[pool]);
+    vm->gc.bytes_allocated += size;
+    gc_on_allocate(vm, size);
+    return cell;
+}
+
+/* 清扫释放的池对象先攒着, 攒满一批再还; 后台清扫线程攒在它自己的批里 */
+void gc_release_pooled(VirtualMachine* vm, void* cell, GcPool pool, size_t size) {
+    PoolBatch* batch;
+    if (current_sweeper != NULL) {
+        batch = &current_sweeper->pool_freed[pool];
+        current_sweeper->freed_bytes += size;
+    } else {
+        batch = &vm->gc.pool_freed[pool];
+        vm->gc.bytes_allocated -= size;
+    }
+    batch->items[batch->count++] = cell;
+    if (batch->count == GC_POOL_BATCH) flush_pool_batch(vm->gc.pools[pool], batch);
+}
+
+static void* sweeper_entry(void* arg) {
+    Sweeper* self = arg;
+    current_sweeper = self;
+    sweep_slice(self->vm, UINT64_MAX);
+    // 线程缓存随线程退出而失效, 先刷回对象池
+    flush_pool_batches(self->vm->gc.pools, self->pool_freed);
+    for (int i = 0; i < gc_pool_count; i++) {
+        pool_flush_cache(self->vm->gc.pools[i]);
+    }
+    current_sweeper = NULL;
+    atomic_store_explicit(&self->is_done, true, memory_order_release);
+    return NULL;
+}
+
+/* 把摘下来的老年代链表交给后台线程; 线程创建失败返回 false, 由当前线程清扫 */
+static bool start_sweeper(VirtualMachine* vm) {
+    Sweeper* sweeper = malloc(sizeof(Sweeper));
+    if (sweeper == NULL) return false;
+    sweeper->vm = vm;
+    atomic_init(&sweeper->is_done, false);
+    for (int i = 0; i < GC_SIZE_CLASS_COUNT; i++) {
+        sweeper->free_lists[i] = (FreeList){ NULL, NULL, 0 };
+    }
+    sweeper->freed_bytes = 0;
+    for (int i = 0; i < gc_pool_count; i++) {
+        sweeper->pool_freed[i].count = 0;
+    }
+    if (pthread_create(&sweeper->thread, NULL, sweeper_entry, sweeper) != 0) {
+        free(sweeper);
+        return false;
+    }
+    vm->gc.sweeper = sweeper;
+    return true;
+}
+
+static bool is_sweeper_done(Sweeper* sweeper) {
+    return atomic_load_explicit(&sweeper->is_done, memory_order_acquire);
+}
+
+/* 等后台清扫结束, 合并它的空闲链表和释放统计 */
+static void join_sweeper(VirtualMachine* vm) {
+    Sweeper* sweeper = vm->gc.sweeper;
+    pthread_join(sweeper->thread, NULL);
+    for (int i = 0; i < GC_SIZE_CLASS_COUNT; i++) {
+        FreeList* from = &sweeper->free_lists[i];
+        FreeList* to = &vm->gc.free_lists[i];
+        if (from->head == NULL) continue;
+        from->tail->next = to->head;
+        if (to->head == NULL) to->tail = from->tail;
+        to->head = from->head;
+        to->count += from->count;
+    }
+    vm->gc.bytes_allocated -= sweeper->freed_bytes;
+    vm->gc.sweeper = NULL;
+    free(sweeper);
+}
+
+/* 虚拟机销毁: 释放全部对象, 小对象的内存块都回到了空闲链表, 随 slab 整块释放 */
+void free_gc_heap(VirtualMachine* vm) {
+    if (vm->gc.sweeper != NULL) join_sweeper(vm);
+    free_objects(vm->gc.nursery);
+    free_objects(vm->objects);
+    free_objects(vm->gc.sweeping);      // 增量 gc 清扫到一半
+    free_objects(vm->gc.swept);
+    vm->gc.nursery = NULL;
+    vm->objects = NULL;
+    vm->gc.sweeping = NULL;
+    vm->gc.swept = NULL;
+    for (int i = 0; i < GC_SIZE_CLASS_COUNT; i++) {
+        vm->gc.free_lists[i] = (FreeList){ NULL, NULL, 0 };
+    }
+    slab_free(&vm->gc.slab);
+    flush_pool_batches(vm->gc.pools, vm->gc.pool_freed);
+    for (int i = 0; i < gc_pool_count; i++) {
+        pool_destroy(&vm->gc.pools[i]);     // 所有池对象都已归还, 否则 pool_destroy 报泄漏
+    }
+}
+
+/* 清扫做完(后台清扫则等它结束); 存活对象接在清扫期间晋升的对象之后(它们更新), 准备下一轮 */
+static void finish_sweep(VirtualMachine* vm) {
+    if (vm->gc.sweeper != NULL) {
+        join_sweeper(vm);
+    } else {
+        sweep_slice(vm, UINT64_MAX);
+    }
+    flush_pool_batches(vm->gc.pools, vm->gc.pool_freed);
+
+    Object** tail = &vm->objects;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
+    }
+    *tail = vm->gc.swept;
+    vm->gc.swept = NULL;
+    vm->gc.swept_tail = NULL;
+    vm->gc.phase = gc_phase_idle;
 
     // next gc
     vm->gc.next_gc = vm->gc.bytes_allocated * GC_HEAP_GROW_FACTOR;
+}
+
+
+/* major gc: 标记一次做完(进行中的增量 gc 直接做完), 开启后台清扫时清扫在后台继续 */
+void collect_garbage(VirtualMachine* vm) {
+#if debug_log_gc
+    printf("-- GC BEGIN\n");
+    size_t before = vm->gc.bytes_allocated;
+#endif
+    // Used: mark-sweep
+    if (vm->gc.phase == gc_phase_sweep) finish_sweep(vm);   // 上一轮还没清扫完
+    if (vm->gc.phase == gc_phase_idle) begin_mark(vm);
+    finish_mark(vm);
+    if (vm->gc.sweeper == NULL) finish_sweep(vm);
 #if debug_log_gc
     printf("-- GC END\n");
     size_t after = vm->gc.bytes_allocated;
@@ -313,3 +833,97 @@ void collect_garbage(VirtualMachine* vm) {
 #endif
 }
 
+/* 增量 major gc 推进一步, 最多暂停 max_pause_us 微秒 */
+void gc_step(VirtualMachine* vm) {
+#if debug_log_gc
+    printf("-- GC STEP (%s)\n", vm->gc.phase == gc_phase_mark ? "mark" : "sweep");
+#endif
+    vm->gc.step_allocated = 0;
+    uint64_t deadline = clock_us() + vm->gc.max_pause_us;
+
+    if (vm->gc.phase == gc_phase_mark) {
+        // 堆已经涨到下一轮的阈值: 分配比标记快, 不再分步, 直接做完标记
+        bool is_behind = vm->gc.bytes_allocated > vm->gc.next_gc * GC_HEAP_GROW_FACTOR;
+        if (!mark_slice(vm, deadline) && !is_behind) return;
+        finish_mark(vm);
+    }
+    // 后台清扫由 gc_on_allocate 发现结束后收尾
+    if (vm->gc.phase == gc_phase_sweep && vm->gc.sweeper == NULL && sweep_slice(vm, deadline)) {
+        finish_sweep(vm);
+#if debug_log_gc
+        printf("-- GC END (incremental) next at %I64d\n", vm->gc.next_gc);
+#endif
+    }
+}
+
+/* 分配了 size 字节之后调用: 推进进行中的增量 gc, 或按阈值开始一次 gc */
+void gc_on_allocate(VirtualMachine* vm, size_t size) {
+    Gc* gc = &vm->gc;
+    gc->nursery_allocated += size;
+    if (gc->sweeper != NULL && is_sweeper_done(gc->sweeper)) {
+        finish_sweep(vm);
+    }
+#if debug_stress_gc
+    // 每次分配都回收新生代, 每 GC_STRESS_MAJOR_INTERVAL 次开始一轮 major gc(增量模式下逐次推进一步),
+    // 让老年代、记忆集与写屏障、增量 / 并行标记和(后台)清扫都在压力下运行
+    if (gc->phase != gc_phase_idle) {
+        gc_step(vm);
+    } else if (++gc->stress_count % GC_STRESS_MAJOR_INTERVAL == 0) {
+        if (gc->max_pause_us == 0) {
+            collect_garbage(vm);
+            return;
+        }
+        begin_mark(vm);
+        gc_step(vm);
+    }
+    if (gc->phase != gc_phase_mark) {
+        collect_nursery(vm);
+    }
+#else
+    if (gc->phase != gc_phase_idle) {
+        gc->step_allocated += size;
+        if (gc->step_allocated > GC_STEP_SIZE) gc_step(vm);
+    } else if (gc->bytes_allocated > gc->next_gc) {
+        if (gc->max_pause_us == 0) {
+            collect_garbage(vm);
+            return;
+        }
+#if debug_log_gc
+        printf("-- GC BEGIN (incremental)\n");
+#endif
+        begin_mark(vm);
+        gc_step(vm);
+    }
+    // 标记期间新生代也在本轮 major gc 的范围内, 不单独回收
+    if (gc->phase != gc_phase_mark && gc->nursery_allocated > GC_NURSERY_SIZE) {
+        collect_nursery(vm);
+    }
+#endif
+}
+
+
+/* minor gc: 根 + 记忆集出发只标记新生代, 清扫时幸存者全部晋升 */
+void collect_nursery(VirtualMachine* vm) {
+#if debug_log_gc
+    printf("-- MINOR GC BEGIN\n");
+    size_t before = vm->gc.bytes_allocated;
+#endif
+    vm->gc.is_minor = true;
+    mark_roots(vm);
+    mark_remembered(vm);
+    trace_references(vm);
+    hashmap_remove_white(vm, &vm->strings);
+    sweep_nursery(vm);
+    vm->gc.is_minor = false;
+
+    vm->gc.nursery_allocated = 0;
+#if debug_log_gc
+    printf("-- MINOR GC END\n");
+    size_t after = vm->gc.bytes_allocated;
+    printf("[gc::collect_nursery] collected %I64d bytes (from %I64d to %I64d)\n",
+           before - after,
+           before,
+           after
+       );
+#endif
+}
@@ -5,7 +5,7 @@
 #include <string.h>
 
 #include "memory.h"
-#include "hashmap.h"
+#include "gc.h"
 #include "object.h"
 #include "string_.h"
 #include "class.h"
@@ -19,17 +19,49 @@ Instance *new_instance(VirtualMachine *vm, Class* klass) {
     instance->klass = klass;
     instance->base.vtable = klass->base.vtable;
 
-    init_hashmap(&instance->fields, vm);
+    instance->shape = &klass->root_shape;
+    instance->capacity = 0;
+    instance->fields = NULL;
     return instance;
 }
 
 void free_instance(Instance* self) {
     if (self != NULL) {
-        free_hashmap(&self->fields);
-        macro_free(self->base.vm, Instance, self);
+        macro_free_array(self->base.vm, Value, self->fields, self->capacity);
+        macro_release_object(self, Instance);
     }
 }
 
+/* 未定义字段返回 null(与 hashmap_get 一致) */
+Value instance_get_field(Instance* self, String* name) {
+    int slot = shape_find_slot(self->shape, name);
+    return slot < 0 ? macro_val_null : self->fields[slot];
+}
+
+/* 已有字段直接写 slot, 否则沿 transition 树切换 shape 并追加 slot */
+void instance_set_field(Instance* self, String* name, Value value) {
+    int slot = shape_find_slot(self->shape, name);
+    if (slot >= 0) {
+        self->fields[slot] = value;
+        gc_write_barrier(&self->base, value);
+        return;
+    }
+
+    VirtualMachine* vm = self->base.vm;
+    Shape* shape = shape_transition(vm, self->shape, name);
+    if (self->capacity < shape->slot_count) {
+        int old_capacity = self->capacity;
+        int new_capacity = old_capacity < 4 ? 4 : old_capacity * 2;
+        self->fields = macro_grow_array(vm, Value, self->fields, old_capacity, new_capacity);
+        self->capacity = new_capacity;
+    }
+    self->shape = shape;
+    self->fields[shape->slot_count - 1] = value;
+    // transition 树挂在 Class 上, 新的 key 由 Class 引用
+    gc_write_barrier(&self->klass->base, macro_val_from_obj(name));
+    gc_write_barrier(&self->base, value);
+}
+
 bool instance_equal(Instance* left, Instance* right) {
     return string_equal(left->klass->name, right->klass->name);
 }
@@ -39,10 +71,6 @@ void print_instance(Instance* self) {
 }
 
 int snprintf_instance(Instance* self, char* buf, size_t size) {
-    if(strcmp(self->klass->name->chars, "Vec") == 0) {
-        Value data_val = hashmap_get(&self->fields, new_string(self->base.vm, "_data", 5));
-        return snprintf_vec(macro_as_vec(data_val), buf, size);
-    }
     return snprintf(buf, size, "<%s instance>", self->klass->name->chars);
 }
 
@@ -19,16 +19,14 @@
 * Returns the new pointer.
 */
 void* reallocate(VirtualMachine *vm, void* pointer, size_t old_size, size_t new_size) {
+    // 后台清扫线程释放内存不碰 vm 的统计
+    if (new_size == 0 && pointer != NULL && gc_sweeper_free(pointer, old_size)) {
+        return NULL;
+    }
 
     vm->gc.bytes_allocated += (new_size - old_size);
     if (new_size > old_size) {
-#if debug_stress_gc
-        collect_garbage(vm);
-#else
-        if (vm->gc.bytes_allocated > vm->gc.next_gc) {
-            collect_garbage(vm);
-        }
-#endif
+        gc_on_allocate(vm, new_size - old_size);
     }
 
 #if debug_enable_allocator
@@ -22,7 +22,7 @@ Native* new_native(VirtualMachine* vm, NativeFnPtr fn, bool is_builtin_method) {
 
 void free_native(Native* self) {
 	if (self != NULL) {
-		macro_free(self->base.vm, Native, self);
+		macro_release_object(self, Native);
 	}
 }
 
@@ -25,6 +25,7 @@
 #include "vec.h"
 #include "enum.h"
 #include "enum_instance.h"
+#include "boxed_i64.h"
 #include "vm.h"
 
 
@@ -45,17 +46,26 @@
 * The sub object is the actual object data, and its size is determined by the specific type.
 */
 Object* allocate_object(VirtualMachine *vm, size_t size, ObjectType type) {
-	Object* object = (Object*)reallocate(vm, NULL, 0, size);
+    // Upvalue 等短命对象从对象池分配; 其余小对象按尺寸类分配, 优先复用空闲链表
+    int pool = gc_pool_of(type, size);
+    uint8_t size_class = pool >= 0 ? GC_POOLED_CLASS : gc_size_class(size);
+	Object* object = pool >= 0 ? (Object*)gc_allocate_pooled(vm, pool, size)
+        : size_class != 0 ? (Object*)gc_allocate_cell(vm, size_class)
+        : (Object*)reallocate(vm, NULL, 0, size);
 	if (object == NULL) {
 		panic("[ {PANIC} Object::allocate_object] Expected to allocate memory for object, Found NULL");
 	}
     object->vm = vm;
 	object->type = type;
     object->vtable = &default_object_vtable;
-    object->is_marked = false;
+    atomic_init(&object->is_marked, false);
+    object->is_old = false;
+    object->is_remembered = false;
+    object->size_class = size_class;
 
-    object->next = vm->objects;
-    vm->objects = object;
+    // 新对象进入新生代
+    object->next = vm->gc.nursery;
+    vm->gc.nursery = object;
 
 #if debug_print_allocations
     printf("[object::allocate_object] Allocate %zu bytes for %s\n",
@@ -98,10 +108,22 @@ void free_object(Object* object) {
     case OBJ_ENUM:      free_enum(macro_as_enum_from_obj(object)); break;
     case OBJ_ENUM_INSTANCE: free_enum_instance(macro_as_enum_instance_from_obj(object)); break;
     case OBJ_TYPE:       free_type(macro_as_type_from_obj(object)); break;
+    case OBJ_BOXED_I64:  free_boxed_i64(macro_as_boxed_i64_from_obj(object)); break;
 	default:            panic("[ {PANIC} Object::free_object] Unsupported object type {%d}.\n", object->type);
 	}
 }
 
+/* 释放对象本身的内存(各类型 free_* 最后调用): 池对象还给对象池, 小对象回到所属尺寸类的空闲链表 */
+void release_object(Object* object, size_t size) {
+    if (object->size_class == GC_POOLED_CLASS) {
+        gc_release_pooled(object->vm, object, gc_pool_of(object->type, size), size);
+    } else if (object->size_class != 0) {
+        gc_release_cell(object->vm, object, object->size_class);
+    } else {
+        reallocate(object->vm, object, size, 0);
+    }
+}
+
 void free_objects(Object *head) {
     while (head != NULL) {
         Object* next = head->next;
@@ -131,6 +153,7 @@ bool object_equal(Object* left, Object* right) {
     case OBJ_ENUM:      return enum_equal(macro_as_enum_from_obj(left), macro_as_enum_from_obj(right));
     case OBJ_ENUM_INSTANCE: return enum_instance_equal(macro_as_enum_instance_from_obj(left), macro_as_enum_instance_from_obj(right));
     case OBJ_TYPE:      return type_equal(macro_as_type_from_obj(left), macro_as_type_from_obj(right));
+    case OBJ_BOXED_I64: return boxed_i64_equal(macro_as_boxed_i64_from_obj(left), macro_as_boxed_i64_from_obj(right));
     default:            return false;
 	}
 }
@@ -151,6 +174,7 @@ void print_object(Object* object) {
     case OBJ_ENUM:      print_enum(macro_as_enum_from_obj(object)); break;
     case OBJ_ENUM_INSTANCE: print_enum_instance(macro_as_enum_instance_from_obj(object)); break;
     case OBJ_TYPE:      print_type(macro_as_type_from_obj(object)); break;
+    case OBJ_BOXED_I64: print_boxed_i64(macro_as_boxed_i64_from_obj(object)); break;
 	default:			warning("{Warning} [print_object] Unsupported object type: %d\n", object->type);
 	}
 }
@@ -171,6 +195,7 @@ int snprintf_object(Object* object, char* buf, size_t size) {
     case OBJ_ENUM:      return snprintf_enum(macro_as_enum_from_obj(object), buf, size);
     case OBJ_ENUM_INSTANCE: return snprintf_enum_instance(macro_as_enum_instance_from_obj(object), buf, size);
     case OBJ_TYPE:      return snprintf_type(macro_as_type_from_obj(object), buf, size);
+    case OBJ_BOXED_I64: return snprintf_boxed_i64(macro_as_boxed_i64_from_obj(object), buf, size);
     default:            warning("{Warning} [snprintf_object] Unsupported object type: %d\n", object->type);
     }
     return 0;
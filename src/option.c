@@ -54,7 +54,7 @@ void print_option(Option_* option) {
 
 bool match(Option_* option, ValueType expected_type) {
 	if (option->state == SomeState) {
-		return ((Some_*)option)->value.type == expected_type;
+		return macro_matches(((Some_*)option)->value, expected_type);
 	}
 	return false;
 }
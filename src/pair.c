@@ -26,7 +26,7 @@ void print_pair(Pair *self) {
 }
 void free_pair(Pair *self) {
     if (self != NULL) {
-        macro_free(self->base.vm, Pair, self);
+        macro_release_object(self, Pair);
     }
 }
 
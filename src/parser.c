@@ -108,6 +108,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <math.h>
 
 #include "common.h"
 #include "fn.h"
@@ -116,6 +117,7 @@
 #include "compiler.h"
 #include "class_compiler.h"
 #include "parser.h"
+#include "peephole.h"
 
 #if debug_print_code
 #include "debug.h"
@@ -172,11 +174,24 @@ static void emit_constant(Parser* self, Chunk* chunk, Value value);
 static void emit_return(Parser* self, Chunk* chunk);
 static void emit_byte(Parser* self, Chunk* chunk, uint8_t byte);
 static void emit_bytes(Parser* self, Chunk* chunk, uint8_t opcode, uint8_t operand);
+static void emit_inline_cache(Parser* self, Chunk* chunk);
 static int emit_jump(Parser* self, Chunk* chunk, uint8_t opcode);
 static void patch_jump(Parser* self, Chunk* chunk, int offset);
 static void emit_loop(Parser* self, Chunk* chunk, int loop_start);
 static void emit_continue(Parser* self, Chunk* chunk, int loop_start);
 static void emit_break(Parser* self, Chunk* chunk);
+static void emit_binary_op(Parser* self, Chunk* chunk, uint8_t opcode);
+static bool emit_folded_binary(Parser* self, Chunk* chunk, uint8_t opcode);
+static void push_typed_span(Compiler* compiler, int start, int end, uint8_t type);
+static void push_constant_span(Compiler* compiler, int start, int end, Value value);
+static void emit_unary_op(Parser* self, Chunk* chunk, uint8_t opcode);
+static void emit_literal(Parser* self, Chunk* chunk, Value value);
+static bool constant_condition(Parser* self, Chunk* chunk, int* start, bool* truthy);
+static void discard_code(Parser* self, Chunk* chunk, int start);
+static uint8_t annotation_type(Token* token, int token_count);
+static void emit_expr_pop(Parser* self, Chunk* chunk);
+static void emit_get_local(Parser* self, Chunk* chunk, uint8_t slot);
+static void emit_set_local(Parser* self, Chunk* chunk, uint8_t slot);
 
 static void begin_scope(Compiler* compiler);
 static void end_scope(Parser* self, Compiler* compiler, Chunk* chunk);
@@ -195,10 +210,25 @@ ParseRule* get_rule(TokenType type) {
 	return &static_syntax_rules[type];
 }
 
-void init_parser(Parser* self, VirtualMachine *vm, TokenList* tokens) {
+_Static_assert((parser_window_size & (parser_window_size - 1)) == 0, "parser window size must be a power of 2");
+_Static_assert(parser_window_size >= 3 + parser_lookahead_max, "parser window must hold pprev, prev, curr and the lookahead");
+
+/* curr 之后第 n 个 token, 还没扫描到的先从 scanner 取进环形缓冲 */
+static Token* parse_peek(Parser* self, int n) {
+    uint32_t target = self->position + (uint32_t)n;
+    while (self->scanned <= target) {
+        self->window[self->scanned & (parser_window_size - 1)] = scan_token(self->scanner);
+        self->scanned++;
+    }
+    return &self->window[target & (parser_window_size - 1)];
+}
+
+void init_parser(Parser* self, VirtualMachine *vm, Scanner* scanner) {
     self->vm = vm;
-	self->tokens = tokens;
-	self->curr = tokens->head;
+	self->scanner = scanner;
+    self->position = 0;
+    self->scanned = 0;
+	self->curr = parse_peek(self, 0);
 	self->prev = NULL;
     self->pprev = NULL;
 	self->had_error = false;
@@ -207,7 +237,7 @@ void init_parser(Parser* self, VirtualMachine *vm, TokenList* tokens) {
 
 void free_parser(Parser* self) {
     self->vm = NULL;
-	self->tokens = NULL;
+	self->scanner = NULL;
 	self->curr = NULL;
 	self->prev = NULL;
     self->pprev = NULL;
@@ -217,7 +247,6 @@ void free_parser(Parser* self) {
 
 void __attribute__((unused)) print_parser(Parser* self) {
 	printf("Parser:\n");
-	printf("tokens: "); print_tokens(self->tokens);
 	printf("curr: "); print_token(self->curr); printf("\n");
 	printf("prev: "); print_token(self->prev); printf("\n");
     printf("pprev: "); print_token(self->pprev);
@@ -239,7 +268,8 @@ static Token* parse_advance(Parser* self) {
 	if (parse_is_at_end(self)) return NULL;
     self->pprev = self->prev;
 	self->prev = self->curr;
-	self->curr = self->curr->next;
+    self->position++;
+	self->curr = parse_peek(self, 0);
 	return self->prev;
 }
 
@@ -267,7 +297,17 @@ static void emit_byte(Parser* self, Chunk* chunk, uint8_t byte) {
 }
 
 static void emit_constant(Parser* self, Chunk* chunk, Value value) {
+    Compiler* compiler = self->vm->compiler;
+    int offset = chunk->count;
 	write_constant(chunk, value, self->prev->line);
+    if (chunk->code[offset] == op_constant && chunk->code[offset + 1] < reg_max) {
+        compiler->reg_operands[0] = compiler->reg_operands[1];
+        compiler->reg_operands[1] = offset;
+    }
+    if (macro_is_i32(value) || macro_is_f64(value)) {
+        push_typed_span(compiler, offset, chunk->count, macro_value_type(value));
+    }
+    push_constant_span(compiler, offset, chunk->count, value);
 }
 
 static void emit_bytes(Parser* self, Chunk* chunk, uint8_t opcode, uint8_t operand) {
@@ -275,6 +315,13 @@ static void emit_bytes(Parser* self, Chunk* chunk, uint8_t opcode, uint8_t opera
 	emit_byte(self, chunk, operand);
 }
 
+/* 调用点 inline cache 下标: 16 bit(high 8 bit, low 8 bit) */
+static void emit_inline_cache(Parser* self, Chunk* chunk) {
+    index_t cache_index = add_inline_cache(chunk);
+    emit_byte(self, chunk, (uint8_t)(cache_index >> 8));
+    emit_byte(self, chunk, (uint8_t)cache_index);
+}
+
 static void emit_return(Parser* self, Chunk* chunk) {
     Compiler *curr_compiler = self->vm->compiler;
     if (curr_compiler == NULL) {
@@ -289,6 +336,107 @@ static void emit_return(Parser* self, Chunk* chunk) {
 	emit_byte(self, chunk, op_return);
 }
 
+/*
+* 类型特化(typed span):
+*   类型标注(var i: i32, fn f(n: i32))和数值字面量给出操作数的静态类型.
+*   末尾相邻两段 TypedSpan 即二元运算的左右操作数, 类型相同时发出 op_xxx_i32 / op_xxx_f64,
+*   结果也记为 TypedSpan, 所以 2 * i + 1 这样的链式表达式可以继续特化.
+*   静态类型只是提示: 特化指令在运行时检查类型, 不符时改回通用指令(deopt).
+*/
+static void push_typed_span(Compiler* compiler, int start, int end, uint8_t type) {
+    if (compiler->typed_count == typed_span_max) {
+        memmove(compiler->typed, compiler->typed + 1, sizeof(TypedSpan) * (typed_span_max - 1));
+        compiler->typed_count--;
+    }
+    compiler->typed[compiler->typed_count++] = (TypedSpan){ start, end, type };
+}
+
+/* [start, chunk->count) 恰好是一段 TypedSpan 时返回其类型 */
+static uint8_t typed_span_of(Compiler* compiler, Chunk* chunk, int start) {
+    if (compiler->typed_count == 0) return type_unknown;
+    TypedSpan* top = &compiler->typed[compiler->typed_count - 1];
+    if (top->start != start || top->end != chunk->count || compiler->jump_target > start) {
+        return type_unknown;
+    }
+    return top->type;
+}
+
+static inline uint8_t typed_opcode(uint8_t opcode, uint8_t type) {
+    if (type == VAL_I32) {
+        switch (opcode) {
+            case op_add:            return op_add_i32;
+            case op_subtract:       return op_subtract_i32;
+            case op_multiply:       return op_multiply_i32;
+            case op_equal:          return op_equal_i32;
+            case op_not_equal:      return op_not_equal_i32;
+            case op_less:           return op_less_i32;
+            case op_less_equal:     return op_less_equal_i32;
+            case op_greater:        return op_greater_i32;
+            case op_greater_equal:  return op_greater_equal_i32;
+            default:                return OP_COUNT;
+        }
+    }
+    if (type == VAL_F64) {
+        switch (opcode) {
+            case op_add:            return op_add_f64;
+            case op_subtract:       return op_subtract_f64;
+            case op_multiply:       return op_multiply_f64;
+            case op_divide:         return op_divide_f64;
+            case op_less:           return op_less_f64;
+            case op_less_equal:     return op_less_equal_f64;
+            case op_greater:        return op_greater_f64;
+            case op_greater_equal:  return op_greater_equal_f64;
+            default:                return OP_COUNT;
+        }
+    }
+    return OP_COUNT;
+}
+
+static bool emit_typed_binary(Parser* self, Chunk* chunk, uint8_t opcode) {
+    Compiler* compiler = self->vm->compiler;
+    if (compiler->typed_count < 2) return false;
+
+    TypedSpan rhs = compiler->typed[compiler->typed_count - 1];
+    TypedSpan lhs = compiler->typed[compiler->typed_count - 2];
+    if (rhs.end != chunk->count || lhs.end != rhs.start
+        || lhs.type != rhs.type || compiler->jump_target > lhs.start) {
+        return false;
+    }
+    uint8_t typed_op = typed_opcode(opcode, lhs.type);
+    if (typed_op == OP_COUNT) return false;
+
+    bool compare = typed_op != op_add_i32 && typed_op != op_subtract_i32 && typed_op != op_multiply_i32
+                && typed_op != op_add_f64 && typed_op != op_subtract_f64
+                && typed_op != op_multiply_f64 && typed_op != op_divide_f64;
+    compiler->typed_count -= 2;
+    compiler->typed_last_op = chunk->count;
+    emit_byte(self, chunk, typed_op);
+    push_typed_span(compiler, lhs.start, chunk->count, compare ? VAL_BOOL : lhs.type);
+    return true;
+}
+
+/* 紧跟在 i32 比较后的 jump_if_false 与比较合成一条指令 */
+static uint8_t fuse_compare_jump(Parser* self, Chunk* chunk) {
+    Compiler* compiler = self->vm->compiler;
+    int op = compiler->typed_last_op;
+    if (op == -1 || op != chunk->count - 1 || compiler->jump_target > op) {
+        return op_jump_if_false;
+    }
+
+    uint8_t fused;
+    switch (chunk->code[op]) {
+        case op_less_i32:           fused = op_less_jump_i32; break;
+        case op_less_equal_i32:     fused = op_less_equal_jump_i32; break;
+        case op_greater_i32:        fused = op_greater_jump_i32; break;
+        case op_greater_equal_i32:  fused = op_greater_equal_jump_i32; break;
+        default:                    return op_jump_if_false;
+    }
+    truncate_chunk(chunk, op);
+    compiler->typed_count--;
+    compiler->typed_last_op = -1;
+    return fused;
+}
+
 /*
 * chunk->count - 2: return index of jump offset
 *						|----------< -2 >---------|
@@ -296,6 +444,9 @@ static void emit_return(Parser* self, Chunk* chunk) {
 * [code, code , {code, jump_offset, jump_offset}, ...]
 */
 static int emit_jump(Parser* self, Chunk* chunk, uint8_t opcode) {
+    if (opcode == op_jump_if_false) {
+        opcode = fuse_compare_jump(self, chunk);
+    }
 	emit_byte(self, chunk, opcode);
 	emit_byte(self, chunk, 0xff);		// placeholder for jump offset
 	emit_byte(self, chunk, 0xff);		// placeholder for jump offset 2^(8+8) = 65535
@@ -319,6 +470,7 @@ static void patch_jump(Parser* self, Chunk* chunk, int offset) {
 
 	chunk->code[offset] = (jump >> 8) & 0xff;   // high 8 bits of jump offset
 	chunk->code[offset + 1] = jump & 0xff;		// low 8 bits of jump offset
+    self->vm->compiler->jump_target = chunk->count;
 }
 
 /*
@@ -372,7 +524,411 @@ static void emit_break(Parser* self, Chunk* chunk) {
         parse_error_at_curr(self, "[Parser::emit_break] Can't use 'break' outside of a loop.");
         return;
     }
-    patch_jump(self, chunk, curr_loop->end);
+    for (int i = 0; i < curr_loop->break_count; i++) {
+        patch_jump(self, chunk, curr_loop->breaks[i]);
+    }
+}
+
+/*
+* register mode(-r): 寄存器指令的发射.
+*   单趟 Pratt 解析器里操作数先于运算符发出, 因此在发出运算符时回看 chunk 末尾:
+*   若两个操作数恰好是最近两条 op_get_local / op_constant, 就回收它们改写为 3-address 指令.
+*   compiler->jump_target 之前的指令可能是跳转目标, 不做回收.
+*
+*   a < b               : get_local a; get_local b; less       => r_less push, a, b
+*   i += 1; / x = a + b;: get_local i; constant 1; add; set_local i; pop
+*                                                               => r_add i, i, k1
+*   x = y;              : get_local y; set_local x; pop         => r_move x, y
+*/
+static inline uint8_t register_opcode(uint8_t opcode) {
+    switch (opcode) {
+        case op_add:            return op_r_add;
+        case op_subtract:       return op_r_subtract;
+        case op_multiply:       return op_r_multiply;
+        case op_divide:         return op_r_divide;
+        case op_mod:            return op_r_mod;
+        case op_equal:          return op_r_equal;
+        case op_not_equal:      return op_r_not_equal;
+        case op_less:           return op_r_less;
+        case op_less_equal:     return op_r_less_equal;
+        case op_greater:        return op_r_greater;
+        case op_greater_equal:  return op_r_greater_equal;
+        default:                return OP_COUNT;
+    }
+}
+
+/* 把 offset 处的 op_get_local / op_constant 转成 RK 操作数 */
+static inline uint8_t register_rk(Chunk* chunk, int offset) {
+    uint8_t operand = chunk->code[offset + 1];
+    return chunk->code[offset] == op_constant ? macro_rk_constant(operand) : operand;
+}
+
+static void emit_get_local(Parser* self, Chunk* chunk, uint8_t slot) {
+    Compiler* compiler = self->vm->compiler;
+    int offset = chunk->count;
+    if (slot < reg_max) {
+        compiler->reg_operands[0] = compiler->reg_operands[1];
+        compiler->reg_operands[1] = offset;
+    }
+    emit_bytes(self, chunk, op_get_local, slot);
+    if (compiler->locals[slot].type != type_unknown) {
+        push_typed_span(compiler, offset, chunk->count, compiler->locals[slot].type);
+    }
+}
+
+static void emit_set_local(Parser* self, Chunk* chunk, uint8_t slot) {
+    if (slot < reg_max) {
+        self->vm->compiler->reg_last_set = chunk->count;
+    }
+    emit_bytes(self, chunk, op_set_local, slot);
+}
+
+static bool emit_register_binary(Parser* self, Chunk* chunk, uint8_t opcode) {
+    Compiler* compiler = self->vm->compiler;
+    uint8_t reg_op = register_opcode(opcode);
+    int lhs = compiler->reg_operands[0];
+    int rhs = compiler->reg_operands[1];
+
+    if (reg_op == OP_COUNT || lhs != chunk->count - 4 || rhs != chunk->count - 2
+        || compiler->jump_target > lhs) {
+        return false;
+    }
+
+    uint8_t b = register_rk(chunk, lhs);
+    uint8_t c = register_rk(chunk, rhs);
+    truncate_chunk(chunk, lhs);
+    compiler->reg_operands[0] = compiler->reg_operands[1] = -1;
+    compiler->reg_last_op = chunk->count;
+    compiler->typed_count = 0;
+    compiler->constant_count = 0;
+
+    emit_byte(self, chunk, reg_op);
+    emit_byte(self, chunk, reg_push);
+    emit_byte(self, chunk, b);
+    emit_byte(self, chunk, c);
+    return true;
+}
+
+/* 二元运算: 操作数都是字面量时折叠, 其次 register mode 回收为寄存器指令, 再次按静态类型特化, 否则发出通用指令 */
+static void emit_binary_op(Parser* self, Chunk* chunk, uint8_t opcode) {
+    if (emit_folded_binary(self, chunk, opcode)) return;
+    if (self->vm->register_mode && emit_register_binary(self, chunk, opcode)) return;
+    if (emit_typed_binary(self, chunk, opcode)) return;
+    emit_byte(self, chunk, opcode);
+}
+
+/* 表达式语句末尾的 op_pop: register mode 下把 "x = ..." 的结果直接写入寄存器 x */
+static void emit_expr_pop(Parser* self, Chunk* chunk) {
+    Compiler* compiler = self->vm->compiler;
+    int set = compiler->reg_last_set;
+
+    if (self->vm->register_mode && set != -1 && set == chunk->count - 2) {
+        uint8_t slot = chunk->code[set + 1];
+        int op = compiler->reg_last_op;
+        int operand = compiler->reg_operands[1];
+
+        if (op != -1 && op == set - 4 && compiler->jump_target <= op) {
+            chunk->code[op + 1] = slot;
+            truncate_chunk(chunk, set);
+            compiler->reg_last_op = compiler->reg_last_set = -1;
+            compiler->typed_count = 0;
+            compiler->constant_count = 0;
+            return;
+        }
+        if (operand != -1 && operand == set - 2 && compiler->jump_target <= operand) {
+            uint8_t rk = register_rk(chunk, operand);
+            truncate_chunk(chunk, operand);
+            compiler->reg_operands[0] = compiler->reg_operands[1] = -1;
+            compiler->reg_last_set = -1;
+            compiler->typed_count = 0;
+            compiler->constant_count = 0;
+            emit_byte(self, chunk, op_r_move);
+            emit_byte(self, chunk, slot);
+            emit_byte(self, chunk, rk);
+            return;
+        }
+    }
+    emit_byte(self, chunk, op_pop);
+}
+
+/*
+* 常量折叠(constant folding):
+*   运算符的操作数都是字面量时在编译期求值, 回收操作数指令, 只发出结果常量.
+*   结果也记为 ConstantSpan, 所以链式表达式可以继续折叠:
+*
+*   60 * 60 * 24    : constant 60; constant 60; multiply; constant 24; multiply  => constant 86400
+*   !true           : true; not                                                => false
+*   -1              : constant 1; negate                                       => constant -1
+*
+*   求值语义与虚拟机一致(read_binary 的数值类型提升, handle_binary_xxx_op 的逐类型运算);
+*   运行时会报错的运算(i32 溢出、除以 0、类型不支持)不折叠, 仍由运行时报告.
+*   被回收的操作数若在常量表末尾, 一并从常量表删掉.
+*/
+static void push_constant_span(Compiler* compiler, int start, int end, Value value) {
+    if (compiler->constant_count == constant_span_max) {
+        memmove(compiler->constants, compiler->constants + 1, sizeof(ConstantSpan) * (constant_span_max - 1));
+        compiler->constant_count--;
+    }
+    compiler->constants[compiler->constant_count++] = (ConstantSpan){ start, end, value };
+}
+
+/* 从栈顶数第 depth 个常量段(0 为栈顶): 它到 chunk 末尾必须是相邻的字面量指令, 且不跨跳转目标 */
+static ConstantSpan* constant_span_at(Compiler* compiler, Chunk* chunk, int depth) {
+    if (compiler->constant_count <= depth) return NULL;
+
+    int end = chunk->count;
+    ConstantSpan* span = NULL;
+    for (int i = 0; i <= depth; i++) {
+        span = &compiler->constants[compiler->constant_count - 1 - i];
+        uint8_t opcode = chunk->code[span->start];
+        if (span->end != end || (opcode != op_constant && opcode != op_constant_long
+            && opcode != op_true && opcode != op_false && opcode != op_none)) {
+            return NULL;
+        }
+        end = span->start;
+    }
+    return compiler->jump_target > span->start ? NULL : span;
+}
+
+/* 回收 chunk 末尾 [start, chunk->count) 的指令, 丢掉落在这段代码里的发射记录 */
+static void reclaim_code(Compiler* compiler, Chunk* chunk, int start) {
+    truncate_chunk(chunk, start);
+    if (compiler->reg_operands[1] >= start) {
+        compiler->reg_operands[1] = compiler->reg_operands[0] < start ? compiler->reg_operands[0] : -1;
+        compiler->reg_operands[0] = -1;
+    }
+    if (compiler->reg_operands[0] >= start) compiler->reg_operands[0] = -1;
+    if (compiler->reg_last_op >= start) compiler->reg_last_op = -1;
+    if (compiler->reg_last_set >= start) compiler->reg_last_set = -1;
+    if (compiler->typed_last_op >= start) compiler->typed_last_op = -1;
+    if (compiler->jump_target > start) compiler->jump_target = start;
+    while (compiler->typed_count > 0 && compiler->typed[compiler->typed_count - 1].end > start) {
+        compiler->typed_count--;
+    }
+    while (compiler->constant_count > 0 && compiler->constants[compiler->constant_count - 1].end > start) {
+        compiler->constant_count--;
+    }
+}
+
+/* 操作数常量只被它自己的 op_constant 引用, 位于常量表末尾时删掉(先删右操作数) */
+static void reclaim_constant(Chunk* chunk, const ConstantSpan* span) {
+    const uint8_t* code = chunk->code + span->start;
+    int index;
+    switch (code[0]) {
+        case op_constant:       index = code[1]; break;
+        case op_constant_long:  index = (code[1] << 8) | code[2]; break;
+        default:                return;
+    }
+    if (index == chunk->constants.count - 1) {
+        chunk->constants.count--;
+    }
+}
+
+#define macro_fold_compare(a, b)                                                        \
+        case op_equal:          *result = macro_val_from_bool((a) == (b)); return true; \
+        case op_not_equal:      *result = macro_val_from_bool((a) != (b)); return true; \
+        case op_less:           *result = macro_val_from_bool((a) < (b));  return true; \
+        case op_less_equal:     *result = macro_val_from_bool((a) <= (b)); return true; \
+        case op_greater:        *result = macro_val_from_bool((a) > (b));  return true; \
+        case op_greater_equal:  *result = macro_val_from_bool((a) >= (b)); return true;
+
+static bool fold_i32(uint8_t opcode, int32_t a, int32_t b, Value* result) {
+    int64_t value;
+    switch (opcode) {
+        case op_add:        value = (int64_t)a + b; break;
+        case op_subtract:   value = (int64_t)a - b; break;
+        case op_multiply:   value = (int64_t)a * b; break;
+        case op_divide:
+            if (b == 0 || (a == INT32_MIN && b == -1)) return false;
+            value = a / b;
+            break;
+        case op_mod:
+            if (b == 0 || (a == INT32_MIN && b == -1)) return false;
+            value = a % b;
+            break;
+        macro_fold_compare(a, b)
+        default:            return false;
+    }
+    if (value < INT32_MIN || value > INT32_MAX) return false;     // 运行时报 i32 overflow
+    *result = macro_val_from_i32((int32_t)value);
+    return true;
+}
+
+static bool fold_i64(VirtualMachine* vm, uint8_t opcode, int64_t a, int64_t b, Value* result) {
+    int64_t value;
+    switch (opcode) {
+        case op_add:        if (__builtin_add_overflow(a, b, &value)) return false; break;
+        case op_subtract:   if (__builtin_sub_overflow(a, b, &value)) return false; break;
+        case op_multiply:   if (__builtin_mul_overflow(a, b, &value)) return false; break;
+        case op_divide:
+            if (b == 0 || (a == INT64_MIN && b == -1)) return false;
+            value = a / b;
+            break;
+        case op_mod:
+            if (b == 0 || (a == INT64_MIN && b == -1)) return false;
+            value = a % b;
+            break;
+        macro_fold_compare(a, b)
+        default:            return false;
+    }
+    *result = macro_val_from_i64(vm, value);
+    return true;
+}
+
+static bool fold_f32(uint8_t opcode, float a, float b, Value* result) {
+    switch (opcode) {
+        case op_add:        *result = macro_val_from_f32(a + b); return true;
+        case op_subtract:   *result = macro_val_from_f32(a - b); return true;
+        case op_multiply:   *result = macro_val_from_f32(a * b); return true;
+        case op_divide:
+            if (b == 0.0f) return false;
+            *result = macro_val_from_f32(a / b);
+            return true;
+        macro_fold_compare(a, b)
+        default:            return false;
+    }
+}
+
+static bool fold_f64(uint8_t opcode, double a, double b, Value* result) {
+    switch (opcode) {
+        case op_add:        *result = macro_val_from_f64(a + b); return true;
+        case op_subtract:   *result = macro_val_from_f64(a - b); return true;
+        case op_multiply:   *result = macro_val_from_f64(a * b); return true;
+        case op_divide:
+            if (b == 0) return false;
+            *result = macro_val_from_f64(a / b);
+            return true;
+        case op_mod:        *result = macro_val_from_f64(fmod(a, b)); return true;
+        macro_fold_compare(a, b)
+        default:            return false;
+    }
+}
+
+#undef macro_fold_compare
+
+static bool fold_binary(VirtualMachine* vm, uint8_t opcode, Value lhs, Value rhs, Value* result) {
+    if (macro_is_number(lhs) && macro_is_number(rhs)) {
+        numeric_type_promotion(&lhs, &rhs);
+        switch (macro_value_type(lhs)) {
+            case VAL_I32: return fold_i32(opcode, macro_as_i32(lhs), macro_as_i32(rhs), result);
+            case VAL_I64: return fold_i64(vm, opcode, macro_as_i64(lhs), macro_as_i64(rhs), result);
+            case VAL_F32: return fold_f32(opcode, macro_as_f32(lhs), macro_as_f32(rhs), result);
+            case VAL_F64: return fold_f64(opcode, macro_as_f64(lhs), macro_as_f64(rhs), result);
+            default:      return false;
+        }
+    }
+    if (opcode != op_equal && opcode != op_not_equal && opcode != op_add) return false;
+
+    bool equal;
+    if (macro_is_bool(lhs) && macro_is_bool(rhs) && opcode != op_add) {
+        equal = macro_as_bool(lhs) == macro_as_bool(rhs);
+    } else if (macro_is_none(lhs) && opcode != op_add) {
+        equal = macro_is_none(rhs);
+    } else if (macro_is_string(lhs) && macro_is_string(rhs)) {
+        String* left = macro_as_string(lhs);
+        String* right = macro_as_string(rhs);
+        if (opcode == op_add) {
+            String* string = concat_string(&vm->strings, left, right);
+            if (string == NULL) return false;
+            *result = macro_val_from_obj(string);
+            return true;
+        }
+        equal = string_equal(left, right);
+    } else {
+        return false;
+    }
+    *result = macro_val_from_bool(opcode == op_equal ? equal : !equal);
+    return true;
+}
+
+static bool fold_unary(VirtualMachine* vm, uint8_t opcode, Value operand, Value* result) {
+    if (opcode == op_not) {
+        if (!macro_is_bool(operand)) return false;
+        *result = macro_val_from_bool(!macro_as_bool(operand));
+        return true;
+    }
+    switch (macro_value_type(operand)) {
+        case VAL_I32:
+            if (macro_as_i32(operand) == INT32_MIN) return false;
+            *result = macro_val_from_i32(-macro_as_i32(operand));
+            return true;
+        case VAL_I64:
+            if (macro_as_i64(operand) == INT64_MIN) return false;
+            *result = macro_val_from_i64(vm, -macro_as_i64(operand));
+            return true;
+        case VAL_F32: *result = macro_val_from_f32(-macro_as_f32(operand)); return true;
+        case VAL_F64: *result = macro_val_from_f64(-macro_as_f64(operand)); return true;
+        default:      return false;
+    }
+}
+
+/* 字面量: bool / None 用专门的指令(不进常量表, .jkc 也只保存数值、字符串和函数常量), 其余走常量表 */
+static void emit_literal(Parser* self, Chunk* chunk, Value value) {
+    if (!macro_is_bool(value) && !macro_is_none(value)) {
+        emit_constant(self, chunk, value);
+        return;
+    }
+    int offset = chunk->count;
+    emit_byte(self, chunk, macro_is_none(value) ? op_none : macro_as_bool(value) ? op_true : op_false);
+    push_constant_span(self->vm->compiler, offset, chunk->count, value);
+}
+
+static bool emit_folded_binary(Parser* self, Chunk* chunk, uint8_t opcode) {
+    Compiler* compiler = self->vm->compiler;
+    ConstantSpan* rhs = constant_span_at(compiler, chunk, 0);
+    ConstantSpan* lhs = constant_span_at(compiler, chunk, 1);
+    Value result;
+    if (lhs == NULL || rhs == NULL || !fold_binary(self->vm, opcode, lhs->value, rhs->value, &result)) {
+        return false;
+    }
+
+    int start = lhs->start;
+    reclaim_constant(chunk, rhs);
+    reclaim_constant(chunk, lhs);
+    reclaim_code(compiler, chunk, start);
+    emit_literal(self, chunk, result);
+    return true;
+}
+
+/* 一元运算: op_not / op_negate */
+static void emit_unary_op(Parser* self, Chunk* chunk, uint8_t opcode) {
+    Compiler* compiler = self->vm->compiler;
+    ConstantSpan* operand = constant_span_at(compiler, chunk, 0);
+    Value result;
+    if (operand != NULL && fold_unary(self->vm, opcode, operand->value, &result)) {
+        int start = operand->start;
+        reclaim_constant(chunk, operand);
+        reclaim_code(compiler, chunk, start);
+        emit_literal(self, chunk, result);
+        return;
+    }
+    emit_byte(self, chunk, opcode);
+}
+
+/*
+* 死代码消除(dead code elimination):
+*   - 块内 return / break / continue 之后的语句;
+*   - 条件是 bool 字面量(含折叠得到的)的 if 分支, 以及 while (false) 的整个循环.
+*   不可达的语句照常解析(声明变量、报告语法错误), 生成的指令再丢弃.
+*/
+static bool constant_condition(Parser* self, Chunk* chunk, int* start, bool* truthy) {
+    ConstantSpan* condition = constant_span_at(self->vm->compiler, chunk, 0);
+    if (condition == NULL || !macro_is_bool(condition->value)) return false;
+    *start = condition->start;
+    *truthy = macro_as_bool(condition->value);
+    return true;
+}
+
+static void discard_code(Parser* self, Chunk* chunk, int start) {
+    Compiler* compiler = self->vm->compiler;
+    if (chunk->count == start) return;
+
+    reclaim_code(compiler, chunk, start);
+    // 落在丢弃代码里的 break 不再回填; break 按偏移递增记录, 从尾部去掉即可
+    Loop* loop = compiler->loop;
+    while (loop != NULL && loop->break_count > 0 && loop->breaks[loop->break_count - 1] >= start) {
+        loop->break_count--;
+    }
 }
 
 static index_t make_constant(Parser* self, Chunk* chunk, Value value) {
@@ -443,6 +999,7 @@ static void add_local(Parser* self, Compiler* compiler, Token* name) {
     );
 	local->depth = -1;			// default depth is -1, means not defined.
 	local->is_captured = false;
+	local->type = type_unknown;
 }
 
 static void mark_initialized(Compiler* compiler) {
@@ -555,6 +1112,10 @@ static Fn* curr_from_sub_compiler(Parser* self, VirtualMachine* vm) {
 
     // build func return && return parent compiler's func
     Fn* fn = vm->compiler->fn;
+    if (!self->had_error) {
+        peephole_optimize(curr_chunk(vm->compiler));
+        fn->max_stack = compute_max_stack(curr_chunk(vm->compiler), fn->arity);
+    }
 #if debug_print_code
     if (!self->had_error) {
         disassemble_chunk(curr_chunk(vm->compiler),
@@ -571,6 +1132,8 @@ static Fn* curr_from_sub_compiler(Parser* self, VirtualMachine* vm) {
     */
     // sub compiler isn't free, so need to free it
     vm->compiler = vm->compiler->enclosing;
+    // 编译期间常量表的写入没有写屏障(作为编译器根每次 gc 都会扫描), 离开编译器链前补一次批量写屏障
+    gc_write_barrier_bulk(&fn->base);
     return fn;
 }
 
@@ -628,13 +1191,13 @@ static void parse_declaration(Parser* self, VirtualMachine* vm) {
  */
 static void parse_enum_declaration(Parser* self, VirtualMachine* vm) {
     parse_consume(self, token_identifier, "[Parser::parse_enum_declaration] Expected enum name.");
-    Token* enum_name = self->prev;
+    Token enum_name = *self->prev;
     index_t name_index = identifier_constant(self, vm, self->prev);
     declare_variable(self, vm->compiler, self->prev);
 
     emit_bytes(self, curr_chunk(vm->compiler), op_enum, name_index);
     define_variable(self, vm->compiler, name_index);
-    parse_named_variable(self, vm, enum_name, false);
+    parse_named_variable(self, vm, &enum_name, false);
 
     parse_consume(self, token_left_brace, "[Parser::parse_enum_declaration] Expected '{' after enum name.");
     while (!parse_check(self, token_right_brace)) {
@@ -687,7 +1250,7 @@ static void parse_enum_member(Parser* self, VirtualMachine* vm) {
  */
 static void parse_struct_declaration(Parser* self, VirtualMachine* vm) {
     parse_consume(self, token_identifier, "[Parser::parse_struct_declaration] Expected struct name.");
-    Token* struct_name = self->prev;
+    Token struct_name = *self->prev;
     index_t name_index = identifier_constant(self, vm, self->prev);
     declare_variable(self, vm->compiler, self->prev);
 
@@ -699,17 +1262,18 @@ static void parse_struct_declaration(Parser* self, VirtualMachine* vm) {
         parse_consume(self, token_identifier, "[Parser::parse_struct_declaration] Expected super struct name.");
         parse_named_variable(self, vm, self->prev, false);
 
-        if (identifiers_equal(self->prev, struct_name)){
+        if (identifiers_equal(self->prev, &struct_name)){
             parse_error_at_curr(self, "[Parser::parse_struct_declaration] A struct can't inherit from itself.");
         }
 
-        parse_named_variable(self, vm, struct_name, false);
+        parse_named_variable(self, vm, &struct_name, false);
         emit_byte(self, curr_chunk(vm->compiler), op_struct_inherit);
     }
-    parse_named_variable(self, vm, struct_name, false);
+    parse_named_variable(self, vm, &struct_name, false);
 
     parse_consume(self, token_left_brace, "[Parser::parse_struct_declaration] Expected '{' before struct body.");
-    while(!parse_check(self, token_right_brace) && !parse_check(self, token_eof)) {
+    // panic_mode: parse_member 出错后不再前进, 继续循环会无限发出字节
+    while(!parse_check(self, token_right_brace) && !parse_check(self, token_eof) && !self->panic_mode) {
         parse_member(self, vm);
     }
 
@@ -739,7 +1303,7 @@ static void parse_member(Parser* self, VirtualMachine* vm) {
 
 static void parse_class_declaration(Parser* self, VirtualMachine* vm) {
     parse_consume(self, token_identifier, "[Parser::parse_class_declaration] Expected class name.");
-    Token* class_name = self->prev;
+    Token class_name = *self->prev;
 
 
     index_t name_index = identifier_constant(self, vm, self->prev);
@@ -758,7 +1322,7 @@ static void parse_class_declaration(Parser* self, VirtualMachine* vm) {
         parse_named_variable(self, vm, self->prev, false);
 
         // TODO: check superclass
-        if (identifiers_equal(class_name, self->prev)) {
+        if (identifiers_equal(&class_name, self->prev)) {
             parse_error_at_curr(self, "[Parser::parse_class_declaration] A class can't inherit from itself.");
         }
 
@@ -768,14 +1332,14 @@ static void parse_class_declaration(Parser* self, VirtualMachine* vm) {
         add_local(self, vm->compiler, &super);
         define_variable(self, vm->compiler, 0);
 
-        parse_named_variable(self, vm, class_name, false);
+        parse_named_variable(self, vm, &class_name, false);
         emit_byte(self, curr_chunk(vm->compiler), op_inherit);
 
         // set superclass
         set_curr_class_superclass(&class_compiler, true);
     }
 
-    parse_named_variable(self, vm, class_name, false);
+    parse_named_variable(self, vm, &class_name, false);
     parse_consume(self, token_left_brace, "[Parser::parse_class_declaration] Expected '{' before class body.");
     while(!parse_check(self, token_right_brace) && !parse_check(self, token_eof)) {
         parse_class_member(self, vm);
@@ -897,12 +1461,17 @@ static void parse_function(Parser* self, VirtualMachine* vm, FnType type) {
 
             // TODO: type label (parameter: type)*?
             if (parse_match(self, token_colon)) {
+                Token type_token = *self->curr;
+                int type_token_count = 0;
                 do {
                     parse_advance(self);
+                    type_token_count++;
                     if (parse_check(self, token_right_paren)) {
                         break;
                     }
                 }while(!parse_check(self, token_comma));
+                vm->compiler->locals[vm->compiler->local_count - 1].type =
+                    annotation_type(&type_token, type_token_count);
             }
 
 		} while (parse_match(self, token_comma));
@@ -936,6 +1505,25 @@ static void parse_function(Parser* self, VirtualMachine* vm, FnType type) {
     free_compiler(&func_compiler);
 }
 
+/*
+* 类型标注 -> 静态类型: 只识别单个数值类型名(i32 / i64 / f32 / f64 / bool),
+* Vec<i32>, 自定义类型等视为未知.
+*/
+static uint8_t annotation_type(Token* token, int token_count) {
+    static const struct { const char* name; uint8_t type; } annotations[] = {
+        {"i32", VAL_I32}, {"i64", VAL_I64}, {"f32", VAL_F32}, {"f64", VAL_F64}, {"bool", VAL_BOOL},
+    };
+    if (token_count != 1 || token->type != token_identifier) return type_unknown;
+
+    for (size_t i = 0; i < sizeof(annotations) / sizeof(annotations[0]); i++) {
+        size_t length = strlen(annotations[i].name);
+        if ((size_t)token->length == length && memcmp(token->start, annotations[i].name, length) == 0) {
+            return annotations[i].type;
+        }
+    }
+    return type_unknown;
+}
+
 /*
 * parse variable declaration:
 *	- parse_variable(identifier -> constant table && return index): parse variable name, add to constants table, return index.
@@ -947,21 +1535,33 @@ static void parse_var_declaration(Parser* self, VirtualMachine* vm) {
         // 1. 解析变量名
         uint8_t index = parse_variable(self, vm, "[Parser::parse_var_declaration] Expected variable name.");
 
-        // 2. 处理类型标注（语法树暂不处理类型）
+        // 2. 处理类型标注（只记录数值类型, 供类型特化指令使用）
+        uint8_t type = type_unknown;
         if (parse_match(self, token_colon)) {
+            Token type_token = *self->curr;
+            int type_token_count = 0;
             while (!parse_check(self, token_assign) &&
                    !parse_check(self, token_comma) &&
                    !parse_check(self, token_semicolon)) {
                 parse_advance(self); // 跳过类型标记
+                type_token_count++;
             }
+            type = annotation_type(&type_token, type_token_count);
         }
 
-        // 3. 处理初始化表达式
+        // 3. 处理初始化表达式(无标注时由初始化表达式推断)
+        int init_start = curr_chunk(vm->compiler)->count;
         if (parse_match(self, token_assign)) {
             parse_expression(self, vm);
+            if (type == type_unknown) {
+                type = typed_span_of(vm->compiler, curr_chunk(vm->compiler), init_start);
+            }
         } else {
             emit_byte(self, curr_chunk(vm->compiler), op_none);
         }
+        if (vm->compiler->scope_depth > 0) {
+            vm->compiler->locals[vm->compiler->local_count - 1].type = type;
+        }
 
         // 4. 定义变量到当前作用域
         define_variable(self, vm->compiler, index);
@@ -1006,9 +1606,13 @@ static void parse_named_variable(Parser* self, VirtualMachine* vm, Token* var_na
 
     if (can_assign && parse_match(self, token_assign)) {
         parse_expression(self, vm);
-        emit_bytes(self, curr_chunk(vm->compiler), set_op, (uint8_t)index);
+        set_op == op_set_local ?
+            emit_set_local(self, curr_chunk(vm->compiler), (uint8_t)index) :
+            emit_bytes(self, curr_chunk(vm->compiler), set_op, (uint8_t)index);
     } else {
-        emit_bytes(self, curr_chunk(vm->compiler), get_op, (uint8_t)index);
+        get_op == op_get_local ?
+            emit_get_local(self, curr_chunk(vm->compiler), (uint8_t)index) :
+            emit_bytes(self, curr_chunk(vm->compiler), get_op, (uint8_t)index);
     }
 }
 
@@ -1065,14 +1669,13 @@ static void parse_break_statement(Parser* self, VirtualMachine* vm) {
         parse_error_at_curr(self, "[Parser::parse_break_statement] Break statement must be inside a loop.");
         return;
     }
-    if (vm->compiler->loop->end == -1) {
-        // Emit a jump instruction with a placeholder offset
-        int end = emit_jump(self, curr_chunk(vm->compiler), op_break);
-
-        // Store the break jump offset for later patching
-        Loop* loop = vm->compiler->loop;
-        loop->end = end;
+    Loop* loop = vm->compiler->loop;
+    if (loop->break_count == uint8_count) {
+        parse_error_at_curr(self, "[Parser::parse_break_statement] Too many break statements in one loop.");
+        return;
     }
+    // Emit a jump instruction with a placeholder offset, patched when the loop ends
+    loop->breaks[loop->break_count++] = emit_jump(self, curr_chunk(vm->compiler), op_break);
 }
 
 static void parse_continue_statement(Parser* self, VirtualMachine* vm) {
@@ -1178,8 +1781,8 @@ static void parse_match_member(Parser* self, VirtualMachine* vm, Match* match) {
     int jump_if_not_matched;
 
     if (self->curr->type == token_identifier                           // token_identifier
-    && self->curr->next->type == token_layer                           // token_layer             ::
-    && self->curr->next->next->type == token_identifier                // token_identifier
+    && parse_peek(self, 1)->type == token_layer                        // token_layer             ::
+    && parse_peek(self, 2)->type == token_identifier                   // token_identifier
     ) {       // token_left_paren        (
         parse_advance(self);            // token_identifier
         parse_named_variable(self, vm, self->prev, false);
@@ -1193,22 +1796,18 @@ static void parse_match_member(Parser* self, VirtualMachine* vm, Match* match) {
 
         if (parse_match(self, token_left_paren)) {
             // TODO: Bind parameter to variable
+            // 边解析边计数(token 按需扫描, 不能提前数), 绑定数受操作数宽度限制
+            index_t pattern_index[uint8_count];
             int bind_count = 0;
-            Token* counter = self->curr;
-            while(counter->type == token_identifier) {
-                bind_count++;
-                counter = counter->next;
-                if (counter->type == token_comma) {
-                    counter = counter->next;
-                }
-            }
-
-            index_t pattern_index[bind_count], position = 0;
             while(parse_match(self, token_identifier)) {        // identifier, identifier, ...
+                if (bind_count == uint8_count) {
+                    parse_error_at_prev(self, "[Parser::parse_match_member] Too many bindings in match pattern.");
+                    break;
+                }
                 index_t param_index = identifier_constant(self, vm, self->prev);
                 declare_variable(self, vm->compiler, self->prev);
                 define_variable(self, vm->compiler, param_index);
-                pattern_index[position++] = resolve_local(self, vm->compiler, self->prev);
+                pattern_index[bind_count++] = resolve_local(self, vm->compiler, self->prev);
                 if (parse_check(self, token_comma)) {
                     parse_advance(self);
                 }
@@ -1323,7 +1922,7 @@ static void parse_for_statement(Parser* self, VirtualMachine* vm) {
 		int increment_start = curr_chunk(vm->compiler)->count; // label for the increment clause.
 
 		parse_expression(self, vm);
-		emit_byte(self, curr_chunk(vm->compiler), op_pop); // increment
+		emit_expr_pop(self, curr_chunk(vm->compiler)); // increment
 		parse_consume(self, token_right_paren, "[Parser::parse_for_statement] Expected ')' after for clauses.");
 
 		emit_loop(self, curr_chunk(vm->compiler), loop_start);
@@ -1331,7 +1930,9 @@ static void parse_for_statement(Parser* self, VirtualMachine* vm) {
 
         begin_loop(vm->compiler, &curr_loop, loop_start);
 		patch_jump(self, curr_chunk(vm->compiler), body_jump);
-	}
+	} else {
+        begin_loop(vm->compiler, &curr_loop, loop_start);
+    }
 
     // statement: statement;
 	parse_statement(self, vm);
@@ -1344,9 +1945,7 @@ static void parse_for_statement(Parser* self, VirtualMachine* vm) {
 		emit_byte(self, curr_chunk(vm->compiler), op_pop); // condition
 	}
 
-    if (vm->compiler->loop->end != -1) {
-        emit_break(self, curr_chunk(vm->compiler));
-    }
+    emit_break(self, curr_chunk(vm->compiler));
 
     // end loop
     end_loop(vm->compiler);
@@ -1383,6 +1982,16 @@ static void parse_while_statement(Parser* self, VirtualMachine* vm) {
     Loop curr_loop;
     begin_loop(vm->compiler, &curr_loop, loop_start);
 
+    // while (false): 循环体不会执行, 解析后连同条件一起丢弃
+    int condition;
+    bool truthy;
+    if (constant_condition(self, curr_chunk(vm->compiler), &condition, &truthy) && !truthy) {
+        parse_statement(self, vm);
+        end_loop(vm->compiler);
+        discard_code(self, curr_chunk(vm->compiler), loop_start);
+        return;
+    }
+
 	int exit_jump = emit_jump(self, curr_chunk(vm->compiler), op_jump_if_false);
 	emit_byte(self, curr_chunk(vm->compiler), op_pop);
 	parse_statement(self, vm);
@@ -1391,9 +2000,7 @@ static void parse_while_statement(Parser* self, VirtualMachine* vm) {
 	patch_jump(self, curr_chunk(vm->compiler), exit_jump);
 	emit_byte(self, curr_chunk(vm->compiler), op_pop);
 
-    if (vm->compiler->loop->end != -1) {
-        emit_break(self, curr_chunk(vm->compiler));
-    }
+    emit_break(self, curr_chunk(vm->compiler));
     end_loop(vm->compiler);
 }
 
@@ -1419,9 +2026,7 @@ static void parse_loop_statement(Parser* self, VirtualMachine* vm) {
     parse_statement(self, vm);
     emit_loop(self, curr_chunk(vm->compiler), curr_loop.start);
 
-    if (vm->compiler->loop->end != -1) {
-        emit_break(self, curr_chunk(vm->compiler));
-    }
+    emit_break(self, curr_chunk(vm->compiler));
     end_loop(vm->compiler);
 }
 
@@ -1435,6 +2040,22 @@ static void parse_if_statement(Parser* self, VirtualMachine* vm) {
         parse_expression(self, vm);
     }
 
+    // 条件是 bool 字面量: 不发跳转, 只保留会执行的分支, 另一个分支解析后丢弃
+    Chunk* chunk = curr_chunk(vm->compiler);
+    int condition;
+    bool truthy;
+    if (constant_condition(self, chunk, &condition, &truthy)) {
+        discard_code(self, chunk, condition);
+        parse_statement(self, vm);
+        if (!truthy) discard_code(self, chunk, condition);
+        if (parse_match(self, token_else)) {
+            int else_start = chunk->count;
+            parse_statement(self, vm);
+            if (truthy) discard_code(self, chunk, else_start);
+        }
+        return;
+    }
+
 	// backpacking later: chunk [opcode, temp slot, temp slot]
 	int then_jump = emit_jump(self, curr_chunk(vm->compiler), op_jump_if_false);
 	emit_byte(self, curr_chunk(vm->compiler), op_pop);
@@ -1453,8 +2074,18 @@ static void parse_if_statement(Parser* self, VirtualMachine* vm) {
 }
 
 static void parse_block_statement(Parser* self, VirtualMachine* vm) {
+    int dead = -1;      // return / break / continue 之后的语句不可达, 从这里起的指令丢弃
 	while (!parse_check(self, token_right_brace) && !parse_check(self, token_eof)) {
+        bool terminal = parse_check(self, token_return) || parse_check(self, token_break)
+                     || parse_check(self, token_continue);
 		parse_declaration(self, vm);
+
+        Chunk* chunk = curr_chunk(vm->compiler);
+        if (dead != -1) {
+            discard_code(self, chunk, dead);
+        } else if (terminal && !self->panic_mode) {
+            dead = chunk->count;
+        }
 	}
 	parse_consume(self, token_right_brace, "[Parser::parse_block_statement] Expected '}' after block statement.");
 }
@@ -1468,7 +2099,7 @@ static __attribute__((unused)) void parse_print_statement(Parser* self, VirtualM
 static void parse_expr_statement(Parser* self, VirtualMachine* vm) {
 	parse_expression(self, vm);
     parse_match(self, token_semicolon);
-	emit_byte(self, curr_chunk(vm->compiler), op_pop);
+	emit_expr_pop(self, curr_chunk(vm->compiler));
 }
 
 static void parse_expression(Parser* self, VirtualMachine* vm) {
@@ -1554,7 +2185,7 @@ void parse_i64(Parser* self, VirtualMachine* vm, bool _can_assign) {
 
 	// int64_t value = atoll(self->prev->start);
     int64_t value = strtoll(self->prev->start, NULL, 10);
-	emit_constant(self, curr_chunk(vm->compiler), macro_val_from_i64(value));
+	emit_constant(self, curr_chunk(vm->compiler), macro_val_from_i64(vm, value));
 }
 void parse_f32(Parser* self, VirtualMachine* vm, bool _can_assign) {
     (void)_can_assign;
@@ -1613,8 +2244,8 @@ void parse_unary(Parser* self, VirtualMachine* vm, bool _can_assign) {
 
 	// emit the operator instruction
 	switch (operator_type) {
-	case token_not:    emit_byte(self, curr_chunk(vm->compiler), op_not); break;
-	case token_minus:   emit_byte(self, curr_chunk(vm->compiler), op_negate); break;
+	case token_not:     emit_unary_op(self, curr_chunk(vm->compiler), op_not); break;
+	case token_minus:   emit_unary_op(self, curr_chunk(vm->compiler), op_negate); break;
 	default:            panic("[Parser::parse_unary] %s Unreachable.",
                               macro_token_type_to_string(operator_type));
 	}
@@ -1632,17 +2263,17 @@ void parse_binary(Parser* self, VirtualMachine* vm, bool _can_assign) {
 
 	// emit the operator instruction
 	switch (operator_type) {
-	case token_neq:	emit_byte(self, curr_chunk(vm->compiler), op_not_equal); break;
-	case token_eq:  emit_byte(self, curr_chunk(vm->compiler), op_equal); break;
-	case token_gt:  emit_byte(self, curr_chunk(vm->compiler), op_greater); break;
-	case token_egt:	emit_byte(self, curr_chunk(vm->compiler), op_greater_equal); break;
-	case token_le:  emit_byte(self, curr_chunk(vm->compiler), op_less); break;
-	case token_let: emit_byte(self, curr_chunk(vm->compiler), op_less_equal); break;
-	case token_plus:    emit_byte(self, curr_chunk(vm->compiler), op_add); break;
-	case token_minus:   emit_byte(self, curr_chunk(vm->compiler), op_subtract); break;
-	case token_star:    emit_byte(self, curr_chunk(vm->compiler), op_multiply); break;
-    case token_slash:   emit_byte(self, curr_chunk(vm->compiler), op_divide); break;
-    case token_mod:     emit_byte(self, curr_chunk(vm->compiler), op_mod); break;
+	case token_neq:	emit_binary_op(self, curr_chunk(vm->compiler), op_not_equal); break;
+	case token_eq:  emit_binary_op(self, curr_chunk(vm->compiler), op_equal); break;
+	case token_gt:  emit_binary_op(self, curr_chunk(vm->compiler), op_greater); break;
+	case token_egt:	emit_binary_op(self, curr_chunk(vm->compiler), op_greater_equal); break;
+	case token_le:  emit_binary_op(self, curr_chunk(vm->compiler), op_less); break;
+	case token_let: emit_binary_op(self, curr_chunk(vm->compiler), op_less_equal); break;
+	case token_plus:    emit_binary_op(self, curr_chunk(vm->compiler), op_add); break;
+	case token_minus:   emit_binary_op(self, curr_chunk(vm->compiler), op_subtract); break;
+	case token_star:    emit_binary_op(self, curr_chunk(vm->compiler), op_multiply); break;
+    case token_slash:   emit_binary_op(self, curr_chunk(vm->compiler), op_divide); break;
+    case token_mod:     emit_binary_op(self, curr_chunk(vm->compiler), op_mod); break;
     default:    panic("[Parser::parse_unary] %s Unreachable.", macro_token_type_to_string(operator_type));
 	}
 }
@@ -1651,9 +2282,9 @@ void parse_literal(Parser* self, VirtualMachine* vm, bool _can_assign) {
     (void)_can_assign;
 
 	switch (self->prev->type) {
-	case token_false: emit_byte(self, curr_chunk(vm->compiler), op_false); break;
-	case token_true:  emit_byte(self, curr_chunk(vm->compiler), op_true);  break;
-	case token_none:  emit_byte(self, curr_chunk(vm->compiler), op_none);  break;
+	case token_false: emit_literal(self, curr_chunk(vm->compiler), macro_val_from_bool(false)); break;
+	case token_true:  emit_literal(self, curr_chunk(vm->compiler), macro_val_from_bool(true));  break;
+	case token_none:  emit_literal(self, curr_chunk(vm->compiler), macro_val_none);  break;
 	default: panic("[Parser::parse_literal] Unreachable.");
 	}
 }
@@ -1739,16 +2370,19 @@ void parse_dot(Parser* self, VirtualMachine* vm, bool can_assign) {
     if (can_assign && parse_match(self, token_assign)) {
         parse_expression(self, vm);
         emit_bytes(self, curr_ck, op_set_property, property_index);
+        emit_inline_cache(self, curr_ck);
     }
     // optional call
     else if (parse_match(self, token_left_paren)) {
         index_t arg_count = parse_argument_list(self, vm);
         emit_bytes(self, curr_ck, op_invoke, property_index);
         emit_byte(self, curr_ck, arg_count);
+        emit_inline_cache(self, curr_ck);
     }
     // get property
     else {
         emit_bytes(self, curr_ck, op_get_property, property_index);
+        emit_inline_cache(self, curr_ck);
     }
 }
 
@@ -1782,35 +2416,35 @@ void parse_compound_assign(Parser* self, VirtualMachine* vm, bool can_assign) {
     }
 
     // 左值 && 运算符类型 && 解析右表达式
-    Token* var_name = self->pprev;
+    Token var_name = *self->pprev;      // 右侧表达式可能很长, 拷贝一份(环形缓冲会被覆盖)
     TokenType operator_type = self->prev->type;
     parse_precedence(self, vm, prec_assign);
 
     // 生成运算指令
     Chunk* chunk = curr_chunk(vm->compiler);
     switch (operator_type) {
-        case token_plus_assign: emit_byte(self, chunk, op_add); break;
-        case token_minus_assign:emit_byte(self, chunk, op_subtract); break;
-        case token_star_assign: emit_byte(self, chunk, op_multiply); break;
-        case token_slash_assign:emit_byte(self, chunk, op_divide); break;
+        case token_plus_assign: emit_binary_op(self, chunk, op_add); break;
+        case token_minus_assign:emit_binary_op(self, chunk, op_subtract); break;
+        case token_star_assign: emit_binary_op(self, chunk, op_multiply); break;
+        case token_slash_assign:emit_binary_op(self, chunk, op_divide); break;
         case token_shl_assign:  emit_byte(self, chunk, op_bw_sl); break;
         case token_shr_assign:  emit_byte(self, chunk, op_bw_sr); break;
         case token_bit_and_assign: emit_byte(self, chunk, op_bw_and); break;
         case token_bit_or_assign:  emit_byte(self, chunk, op_bw_or); break;
         case token_bit_xor_assign: emit_byte(self, chunk, op_bw_xor); break;
         case token_bit_not_assign: emit_byte(self, chunk, op_bw_not); break;
-        case token_mod_assign:  emit_byte(self, chunk, op_mod); break;
+        case token_mod_assign:  emit_binary_op(self, chunk, op_mod); break;
         default: parse_error_at_curr(self, "[Parser::parse_compound_assign] Unsupported compound operator."); break;
     }
 
     // 生成存储指令（将运算结果存回左值）
-    int index = resolve_local(self, vm->compiler, var_name);
+    int index = resolve_local(self, vm->compiler, &var_name);
     if (index != -1) {
-        emit_bytes(self, chunk, op_set_local, (uint8_t)index);
-    } else if ((index = resolve_upvalue(self, vm->compiler, var_name)) != -1) {
+        emit_set_local(self, chunk, (uint8_t)index);
+    } else if ((index = resolve_upvalue(self, vm->compiler, &var_name)) != -1) {
         emit_bytes(self, chunk, op_set_upvalue, (uint8_t)index);
     } else {
-        index = identifier_constant(self, vm, var_name);
+        index = identifier_constant(self, vm, &var_name);
         emit_bytes(self, chunk, op_set_global, (uint8_t)index);
     }
 }
@@ -1941,7 +2575,7 @@ void parse_error_at_curr(Parser* self, const char* message) {
 
 void parse_error_at_prev(Parser* self, const char* message) {
 	if (self->prev == NULL) {
-		parse_error_at(self, self->tokens->head, "[Parser::parse_error_at_prev] Expected expression, Found end of file.");
+		parse_error_at(self, self->curr, "[Parser::parse_error_at_prev] Expected expression, Found end of file.");
 		return;
 	}
 	parse_error_at(self, self->prev, message);
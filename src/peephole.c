@@ -0,0 +1,232 @@
+//
+// Created by Kilig on 2025/5/6.
+//
+
+#include "memory.h"
+#include "operator.h"
+#include "peephole.h"
+#include "arena.h"
+#include "vm.h"
+
+/* 可与 jump_if_false 合并的比较指令 -> Operator; 不可合并返回 -1 */
+static int compare_operator(uint8_t opcode) {
+    switch (opcode) {
+        case op_equal:
+        case op_equal_i32:          return EQ;
+        case op_not_equal:
+        case op_not_equal_i32:      return NEQ;
+        case op_less:
+        case op_less_i32:
+        case op_less_jump_i32:      return LT;
+        case op_less_equal:
+        case op_less_equal_i32:
+        case op_less_equal_jump_i32:return LTE;
+        case op_greater:
+        case op_greater_i32:
+        case op_greater_jump_i32:   return GT;
+        case op_greater_equal:
+        case op_greater_equal_i32:
+        case op_greater_equal_jump_i32: return GTE;
+        default:                    return -1;
+    }
+}
+
+typedef struct Peephole {
+    Chunk* chunk;
+    int* starts;        // 原指令起始偏移
+    int* lengths;       // 原指令长度
+    int count;          // 原指令条数
+    bool* targets;      // targets[offset]: 原偏移 offset 是跳转目标
+} Peephole;
+
+static inline uint8_t inst_opcode(Peephole* self, int index) {
+    return self->chunk->code[self->starts[index]];
+}
+
+static inline uint8_t inst_operand(Peephole* self, int index, int n) {
+    return self->chunk->code[self->starts[index] + 1 + n];
+}
+
+/* 从第 index 条指令开始的 n 条指令可以合并: 都存在, 且除首条外都不是跳转目标 */
+static bool can_fuse(Peephole* self, int index, int n) {
+    if (index + n > self->count) return false;
+    for (int i = 1; i < n; i++) {
+        if (self->targets[self->starts[index + i]]) return false;
+    }
+    return true;
+}
+
+/*
+* 尝试在第 index 条指令处匹配超级指令, 写入 out 并返回消耗的原指令条数(0 表示不匹配).
+* out 至少 6 字节; *out_length 为新指令长度.
+*/
+static int match_superinstruction(Peephole* self, int index, uint8_t* out, int* out_length) {
+    if (inst_opcode(self, index) != op_get_local) return 0;
+    uint8_t slot = inst_operand(self, index, 0);
+
+    // get_local a; constant k; <cmp>; jump_if_false   |   get_local a; constant k; <cmp>_jump_i32
+    if (can_fuse(self, index, 3) && inst_opcode(self, index + 1) == op_constant) {
+        uint8_t constant = inst_operand(self, index + 1, 0);
+        uint8_t cmp = inst_opcode(self, index + 2);
+        int op = compare_operator(cmp);
+        int consumed = 0;
+        if (op >= 0 && jump_direction(cmp) > 0) {
+            consumed = 3;
+        } else if (op >= 0 && can_fuse(self, index, 4) && inst_opcode(self, index + 3) == op_jump_if_false) {
+            consumed = 4;
+        }
+        if (consumed > 0) {
+            // 偏移由调用方按新布局回填
+            out[0] = op_compare_local_constant_jump;
+            out[1] = slot;
+            out[2] = constant;
+            out[3] = (uint8_t)op;
+            out[4] = 0xff;
+            out[5] = 0xff;
+            *out_length = 6;
+            return consumed;
+        }
+    }
+
+    if (can_fuse(self, index, 2) && inst_opcode(self, index + 1) == op_get_local) {
+        uint8_t other = inst_operand(self, index + 1, 0);
+        uint8_t next = can_fuse(self, index, 3) ? inst_opcode(self, index + 2) : op_pop;
+        out[0] = (next == op_add || next == op_add_i32) ? op_add_local_local : op_get_local_local;
+        out[1] = slot;
+        out[2] = other;
+        *out_length = 3;
+        return out[0] == op_add_local_local ? 3 : 2;
+    }
+
+    // 方法体内 slot 0 即 self
+    if (slot == 0 && can_fuse(self, index, 2) && inst_opcode(self, index + 1) == op_get_property) {
+        out[0] = op_get_self_property;
+        out[1] = inst_operand(self, index + 1, 0);
+        out[2] = inst_operand(self, index + 1, 1);
+        out[3] = inst_operand(self, index + 1, 2);
+        *out_length = 4;
+        return 2;
+    }
+    return 0;
+}
+
+/* 展开 RLE 行号: lines[offset] 为原偏移 offset 的行号 */
+static void expand_lines(Chunk* chunk, line_t* lines) {
+    int offset = 0;
+    for (int i = 0; i < chunk->lines.count; i++) {
+        for (int n = 0; n < chunk->lines.lines[i].count; n++) {
+            lines[offset++] = chunk->lines.lines[i].line;
+        }
+    }
+}
+
+/* 按合并后的新布局重写 chunk; 调用前 self 已完成指令切分且所有跳转目标都是指令起始位置 */
+static void rewrite_chunk(Peephole* self) {
+    Chunk* chunk = self->chunk;
+    VirtualMachine* vm = chunk->vm;
+    int count = chunk->count;
+
+    ArenaMark mark = arena_save(vm->arena);
+    uint8_t* code = macro_arena_allocate(vm->arena, uint8_t, count);
+    line_t* old_lines = macro_arena_allocate(vm->arena, line_t, count);
+    line_t* new_lines = macro_arena_allocate(vm->arena, line_t, count);
+    int* relocation = macro_arena_allocate(vm->arena, int, count + 1);   // relocation[old offset] = new offset(仅指令起始位置有效)
+    int* origins = macro_arena_allocate(vm->arena, int, self->count);    // origins[n] = 第 n 条新指令对应的首条原指令
+    int* new_starts = macro_arena_allocate(vm->arena, int, self->count);
+    int new_count = 0;
+    int new_size = 0;
+    expand_lines(chunk, old_lines);
+
+    // 1. 合并超级指令, 生成新布局(只会变短)
+    for (int i = 0; i < self->count; ) {
+        int old_start = self->starts[i];
+        uint8_t fused[6];
+        int fused_length = 0;
+        int consumed = match_superinstruction(self, i, fused, &fused_length);
+
+        relocation[old_start] = new_size;
+        origins[new_count] = i;
+        new_starts[new_count++] = new_size;
+        if (consumed > 0) {
+            memcpy(code + new_size, fused, fused_length);
+            for (int n = 0; n < fused_length; n++) new_lines[new_size + n] = old_lines[old_start];
+            new_size += fused_length;
+            i += consumed;
+        } else {
+            memcpy(code + new_size, chunk->code + old_start, self->lengths[i]);
+            for (int n = 0; n < self->lengths[i]; n++) new_lines[new_size + n] = old_lines[old_start + n];
+            new_size += self->lengths[i];
+            i++;
+        }
+    }
+    relocation[count] = new_size;
+
+    // 2. 按新布局回填跳转偏移; 合并指令的跳转目标取自被合并的最后一条原指令
+    for (int n = 0; n < new_count; n++) {
+        int start = new_starts[n];
+        int end = n + 1 < new_count ? new_starts[n + 1] : new_size;
+        int direction = jump_direction(code[start]);
+        if (direction == 0) continue;
+
+        int last = (n + 1 < new_count ? origins[n + 1] : self->count) - 1;
+        int target = relocation[jump_target(chunk, self->starts[last], self->lengths[last])];
+        int jump = direction > 0 ? target - end : end - target;
+        code[end - 2] = (jump >> 8) & 0xff;
+        code[end - 1] = jump & 0xff;
+    }
+
+    // 3. 写回 chunk, 行号随 write_chunk 重新做 RLE 压缩(容量足够, 不会扩容)
+    truncate_chunk(chunk, 0);
+    for (int n = 0; n < new_size; n++) {
+        write_chunk(chunk, code[n], new_lines[n]);
+    }
+
+    arena_restore(vm->arena, mark);
+}
+
+void peephole_optimize(Chunk* chunk) {
+    VirtualMachine* vm = chunk->vm;
+    int count = chunk->count;
+    if (count == 0) return;
+
+    Peephole self;
+    self.chunk = chunk;
+    ArenaMark mark = arena_save(vm->arena);
+    self.starts = macro_arena_allocate(vm->arena, int, count);
+    self.lengths = macro_arena_allocate(vm->arena, int, count);
+    self.targets = macro_arena_allocate(vm->arena, bool, count + 1);
+    self.count = 0;
+    memset(self.targets, 0, sizeof(bool) * (count + 1));
+
+    // 切分指令并标记跳转目标; 遇到无法识别的编码或越界跳转直接放弃优化
+    bool valid = true;
+    for (int offset = 0; offset < count && valid; ) {
+        int length = instruction_length(chunk, offset);
+        if (length == 0 || offset + length > count) {
+            valid = false;
+            break;
+        }
+        if (jump_direction(chunk->code[offset]) != 0) {
+            int target = jump_target(chunk, offset, length);
+            valid = target >= 0 && target <= count;
+            if (valid) self.targets[target] = true;
+        }
+        self.starts[self.count] = offset;
+        self.lengths[self.count] = length;
+        self.count++;
+        offset += length;
+    }
+
+    // 跳转目标必须落在指令起始位置
+    for (int i = 0, next = 0; valid && i < count; i++) {
+        if (next < self.count && self.starts[next] == i) {
+            next++;
+        } else if (self.targets[i]) {
+            valid = false;
+        }
+    }
+
+    if (valid) rewrite_chunk(&self);
+
+    arena_restore(vm->arena, mark);
+}
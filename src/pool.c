@@ -11,12 +11,14 @@
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
+/* 线程缓存只属于一个池: 换池释放时先把缓存还给原来的池 */
 typedef struct {
+    Pool* owner;
     void* cache[CACHE_SIZE];
     volatile size_t count;
 } ThreadCache;
 
-static __thread ThreadCache thead_cache = { .count = 0 };
+static __thread ThreadCache thead_cache = { .owner = NULL, .count = 0 };
 
 // 内存屏障包装
 #if defined(__x86_64__) || defined(_M_X64)
@@ -33,51 +35,91 @@ static __thread ThreadCache thead_cache = { .count = 0 };
 
 
 
-Pool* pool_create(size_t obj_size, size_t capacity) {
+/* 申请一块 capacity 个节点的内存, 串成链表整体挂到 head 上; 并发扩容只是多申请一块 */
+static bool grow_pool(Pool* pool) {
+    const size_t header_size = ALIGN_UP(sizeof(PoolBlock), CACHE_LINE_SIZE);
+    PoolBlock* block = aligned_alloc(CACHE_LINE_SIZE, header_size + pool->node_size * pool->capacity);
+    if (!block) return false;
+
+    Node* first = (Node*)((uint8_t*)block + header_size);
+    Node* last = (Node*)((uint8_t*)first + (pool->capacity - 1) * pool->node_size);
+    for (Node* curr = first; curr != last; ) {
+        Node* next = (Node*)((uint8_t*)curr + pool->node_size);
+        atomic_init(&curr->next, tagged_pointer_init(next, 0));
+        curr = next;
+    }
+
+    block->next = atomic_load_explicit(&pool->blocks, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+            &pool->blocks, &block->next, block,
+            memory_order_release,
+            memory_order_relaxed
+    ));
+
+    TaggedPointer old_head, new_head;
+    do {
+        old_head = atomic_load_explicit(&pool->head, memory_order_acquire);
+        atomic_store_explicit(&last->next, tagged_pointer_init(old_head.ptr, 0), memory_order_relaxed);
+        new_head.ptr = (uintptr_t)first;
+        new_head.ver = old_head.ver + 1;
+    } while (!atomic_compare_exchange_weak_explicit(
+            &pool->head, &old_head, new_head,
+            memory_order_release,
+            memory_order_relaxed
+    ));
+
+    atomic_fetch_add_explicit(&pool->block_cnt, 1, memory_order_relaxed);
+    return true;
+}
+
+
+/* capacity 为每块内存的节点数, 用完了自动扩容 */
+static Pool* create_pool(size_t obj_size, size_t capacity, size_t node_size, size_t node_align) {
     if (capacity == 0 || obj_size == 0) {
         errno = EINVAL;
         return NULL;
     }
-    const size_t node_size = NODE_TOTAL_SIZE(obj_size);
-    const size_t total_size = sizeof(Pool) + node_size * capacity;
 
-    Pool* pool = aligned_alloc(CACHE_LINE_SIZE, total_size);
+    Pool* pool = aligned_alloc(CACHE_LINE_SIZE, ALIGN_UP(sizeof(Pool), CACHE_LINE_SIZE));
     if (!pool) return NULL;
 
-    pool->memory = (uint8_t*)pool + ALIGN_UP(sizeof(Pool), CACHE_LINE_SIZE);
     pool->node_size = node_size;
+    pool->node_align = node_align;
     pool->capacity = capacity;
+    atomic_init(&pool->blocks, NULL);
+    atomic_init(&pool->block_cnt, 0);
     atomic_init(&pool->alloc_cnt, 0);
     atomic_init(&pool->free_cnt, 0);
     atomic_init(&pool->contention_counter, 0);
 
-    // 初始化空闲链表（LIFO）
-    Node* prev = NULL;
-    for (size_t i = 0; i < capacity; ++i) {
-        Node* curr = (Node*)((uint8_t*)pool->memory + i * node_size);
-        atomic_init(&curr->next, tagged_pointer_init(prev, 0));
-        prev = curr;
-    }
-
     // 初始化头尾指针
-    atomic_init(&pool->head, tagged_pointer_init(prev, 0));
+    atomic_init(&pool->head, tagged_pointer_init(0, 0));
     atomic_init(&pool->free_list, tagged_pointer_init(0, 0));
 
+    if (!grow_pool(pool)) {
+        aligned_free(pool);
+        return NULL;
+    }
     return pool;
 }
 
+/* 每个节点独占缓存行, 多线程各自分配的对象不会伪共享 */
+Pool* pool_create(size_t obj_size, size_t capacity) {
+    return create_pool(obj_size, capacity, NODE_TOTAL_SIZE(obj_size), CACHE_LINE_SIZE);
+}
 
-void* pool_alloc(Pool* pool) {
-    atomic_tp_t* target_list = &pool->free_list;
+/* 节点只按 16 字节对齐: 适合单线程为主、数量多的小对象(如虚拟机的 Upvalue), 省内存 */
+Pool* pool_create_packed(size_t obj_size, size_t capacity) {
+    return create_pool(obj_size, capacity, NODE_PACKED_SIZE(obj_size), 16);
+}
+
+
+/* 从 list 弹出一个节点, 空返回 NULL */
+static Node* pop_node(atomic_tp_t* list) {
     TaggedPointer old_head, new_head;
     Node* chunk = NULL;
 
-    old_head = atomic_load_explicit(target_list, memory_order_acquire);
-    if (!old_head.ptr) {
-        target_list = &pool->head;
-        old_head = atomic_load_explicit(target_list, memory_order_acquire);
-    }
-
+    old_head = atomic_load_explicit(list, memory_order_acquire);
     do {
         if (!old_head.ptr) return NULL;
         chunk = (Node*)old_head.ptr;
@@ -91,10 +133,26 @@ void* pool_alloc(Pool* pool) {
         new_head.ver = old_head.ver + 1;
 
     } while (!atomic_compare_exchange_weak_explicit(
-            target_list, &old_head, new_head,
+            list, &old_head, new_head,
             memory_order_acq_rel,
             memory_order_acquire
     ));
+    return chunk;
+}
+
+
+void* pool_alloc(Pool* pool) {
+    PROBE();
+    // 先取本线程 pool_free_batch 缓存的对象(缓存中的对象不计入 alloc_cnt / free_cnt)
+    if (thead_cache.owner == pool && thead_cache.count > 0) {
+        return thead_cache.cache[--thead_cache.count];
+    }
+
+    Node* chunk;
+    while ((chunk = pop_node(&pool->free_list)) == NULL
+           && (chunk = pop_node(&pool->head)) == NULL) {
+        if (!grow_pool(pool)) return NULL;
+    }
 
     atomic_fetch_add_explicit(&pool->alloc_cnt, 1, memory_order_relaxed);
     return chunk->data;
@@ -107,7 +165,7 @@ void pool_free(Pool* pool, void* data) {
 
     Node* node = (Node*)((uint8_t*)data - tagged_pointer_size);
     assert((uint8_t*)node->data == data && "Pointer calculation error");
-    assert(((uintptr_t)node % CACHE_LINE_SIZE) == 0);
+    assert(((uintptr_t)node % pool->node_align) == 0);
 
     memset(node->data, 0, pool->node_size - tagged_pointer_size);
     TaggedPointer old_head, new_head;
@@ -144,6 +202,7 @@ static size_t batch_alloc_internal(Pool* pool, void** objs, size_t count) {
 
         // CAS操作获取批量节点
         do {
+            obtained = 0;
             old_head = atomic_load_explicit(target_list, memory_order_acquire);
             if (!old_head.ptr) {
                 target_list = &pool->head;
@@ -172,6 +231,12 @@ static size_t batch_alloc_internal(Pool* pool, void** objs, size_t count) {
                 memory_order_acquire
         ));
 
+        // 两个链表都空了: 扩容后重新从 head 取
+        if (obtained == 0) {
+            if (!grow_pool(pool)) break;
+            continue;
+        }
+
         // 填充结果数组
         for (size_t i = 0; i < obtained; ++i) {
             objs[allocated++] = chunks[i]->data;
@@ -188,7 +253,7 @@ static size_t batch_alloc_internal(Pool* pool, void** objs, size_t count) {
 size_t pool_alloc_batch(Pool* pool, void** objs, size_t count) {
     if (!objs || count == 0) return 0;
 
-    size_t from_cache = MIN(count, thead_cache.count);
+    size_t from_cache = thead_cache.owner == pool ? MIN(count, thead_cache.count) : 0;
 
     // 从线程缓存分配
     if (from_cache > 0) {
@@ -237,10 +302,10 @@ static void pool_free_batch_internal(Pool* pool, void** objs, size_t count) {
             chunks[i] = node;
         }
 
-        // 逆序链接节点以保持LIFO
-        for (size_t i = batch-1; i > 0; --i) {
+        // 串成 chunks[0] -> ... -> chunks[batch-1] -> 原链表头
+        for (size_t i = 0; i + 1 < batch; ++i) {
             atomic_store_explicit(&chunks[i]->next,
-                                  tagged_pointer_init(chunks[i-1], 0),
+                                  tagged_pointer_init(chunks[i+1], 0),
                                   memory_order_relaxed);
         }
 
@@ -267,7 +332,11 @@ static void pool_free_batch_internal(Pool* pool, void** objs, size_t count) {
 void pool_free_batch(Pool* pool, void** objs, size_t count) {
     if (!objs || count == 0) return;
 
-    // 1.尝试缓存释放对象
+    // 1.尝试缓存释放对象(缓存属于别的池时先还回去)
+    if (thead_cache.owner != pool) {
+        if (thead_cache.owner != NULL) pool_flush_cache(thead_cache.owner);
+        thead_cache.owner = pool;
+    }
     size_t to_cache = MIN(count, CACHE_SIZE - thead_cache.count);
     if (to_cache > 0) {
         memcpy(&thead_cache.cache[thead_cache.count], objs, to_cache * sizeof(void*));
@@ -283,7 +352,7 @@ void pool_free_batch(Pool* pool, void** objs, size_t count) {
 
 // 刷新缓存
 void pool_flush_cache(Pool* pool) {
-    if (thead_cache.count > 0) {
+    if (thead_cache.owner == pool && thead_cache.count > 0) {
         pool_free_batch_internal(pool, thead_cache.cache, thead_cache.count);
         thead_cache.count = 0;
     }
@@ -295,15 +364,25 @@ void pool_destroy(Pool** pool_ptr) {
     Pool* pool = *pool_ptr;
     if (pool) {
         pool_flush_cache(pool);
-        // 验证所有对象已回收
+        // 验证所有对象已回收: 默认只报告泄漏, 调试时(common.h debug_pool_leak_abort)直接中止
         uintptr_t alloc = atomic_load_explicit(&pool->alloc_cnt, memory_order_acquire);
         uintptr_t freed = atomic_load_explicit(&pool->free_cnt, memory_order_acquire);
 
         if (alloc != freed) {
-            fprintf(stderr, "[ERROR] Pool leak detected! alloc: %I64u, freed: %I64u\n", alloc, freed);
+            fprintf(stderr, "[WARN] Pool leak detected! alloc: %" PRIuPTR ", freed: %" PRIuPTR "\n", alloc, freed);
+#if debug_pool_leak_abort
             abort();
+#endif
         }
 
+        if (thead_cache.owner == pool) thead_cache.owner = NULL;
+
+        PoolBlock* block = atomic_load_explicit(&pool->blocks, memory_order_acquire);
+        while (block != NULL) {
+            PoolBlock* next = block->next;
+            aligned_free(block);
+            block = next;
+        }
         aligned_free(pool);
         *pool_ptr = NULL;
     }
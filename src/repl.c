@@ -5,10 +5,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <time.h>
 
 #include "common.h"
 #include "string_.h"
 #include "vm.h"
+#include "gc.h"
+#include "scanner.h"
+#include "compiler.h"
+#include "bytecode.h"
+#include "snapshot.h"
 
 #include "repl.h"
 #include "console.h"
@@ -23,6 +29,10 @@ static bool is_repl_command(const char* line);
 static void clear_screen(void);
 
 static void run_file(VirtualMachine* vm, const char* path);
+static void compile_file(VirtualMachine* vm, const char* path, const char* output);
+static void snapshot_file(VirtualMachine* vm, const char* path, const char* output);
+static void load_prelude(VirtualMachine* vm, const char* path);
+static void lex_file(VirtualMachine* vm, const char* path);
 static char* read_file(const char* path);
 
 
@@ -188,14 +198,149 @@ static void repl(VirtualMachine* vm) {
 * If there is a compilation or runtime error, it exits with an appropriate status code.
 * If there is no file specified, it enters a REPL.
 * If there is a file specified, it reads the bytecode from the file and executes it.
+*
+* A .jkc file is loaded directly. For a source file, a fresh .jkc beside it (written by joker -c)
+* is loaded instead of recompiling; a missing, stale or incompatible cache falls back to compiling.
 */
 static void run_file(VirtualMachine* vm, const char* path) {
+    InterpretResult result;
+    if (is_bytecode_path(path)) {
+        Fn* fn = load_bytecode(vm, path, NULL);
+        if (fn == NULL) {
+            fprintf(stderr, "[main::run_file] Error %s:\n\tInvalid or incompatible bytecode file '%s'\n",
+                    macro_code_to_string(enum_file_error), path);
+            exit(enum_file_error);
+        }
+        result = interpret_fn(vm, fn);
+    } else {
+        char* cache_path = bytecode_path(path);
+        Fn* fn = load_bytecode(vm, cache_path, path);
+        free(cache_path);
+        if (fn != NULL) {
+            result = interpret_fn(vm, fn);
+        } else {
+            char* source = read_file(path);
+            result = interpret(vm, source);
+            free(source);
+        }
+    }
+
+    if (result == interpret_compile_error) exit(enum_compiler_error);
+    if (result == interpret_runtime_error) exit(enum_runtime_error);
+}
+
+/*
+* Compiles the source file and writes the bytecode cache without running it.
+* The cache goes beside the source (foo.jk -> foo.jkc) unless an output path is given.
+*/
+static void compile_file(VirtualMachine* vm, const char* path, const char* output) {
     char* source = read_file(path);
-    InterpretResult result = interpret(vm, source);
+    SourceStamp stamp;
+    if (!stamp_source(path, source, &stamp)) {
+        fprintf(stderr, "[main::compile_file] Error %s:\n\tCould not stat file '%s'\n",
+                macro_code_to_string(enum_file_error), path);
+        exit(enum_file_error);
+    }
+    Fn* fn = compile(vm, source);
     free(source);
+    if (fn == NULL) exit(enum_compiler_error);
 
+    char* cache_path = output == NULL ? bytecode_path(path) : NULL;
+    const char* target = output == NULL ? cache_path : output;
+    if (!save_bytecode(vm, fn, &stamp, target)) {
+        fprintf(stderr, "[main::compile_file] Error %s:\n\tCould not write bytecode file '%s'\n",
+                macro_code_to_string(enum_file_error), target);
+        exit(enum_file_error);
+    }
+    free(cache_path);
+}
+
+/*
+* Runs the prelude script and writes a heap snapshot of the resulting globals.
+* The snapshot goes beside the prelude (foo.jk -> foo.jks) unless an output path is given.
+*/
+static void snapshot_file(VirtualMachine* vm, const char* path, const char* output) {
+    char* source = read_file(path);
+    SourceStamp stamp;
+    if (!stamp_source(path, source, &stamp)) {
+        fprintf(stderr, "[main::snapshot_file] Error %s:\n\tCould not stat file '%s'\n",
+                macro_code_to_string(enum_file_error), path);
+        exit(enum_file_error);
+    }
+    InterpretResult result = interpret(vm, source);
+    free(source);
     if (result == interpret_compile_error) exit(enum_compiler_error);
     if (result == interpret_runtime_error) exit(enum_runtime_error);
+
+    char* snapshot_path = output == NULL ? image_path(path, snapshot_extension) : NULL;
+    const char* target = output == NULL ? snapshot_path : output;
+    const char* error = NULL;
+    if (!save_snapshot(vm, &stamp, target, &error)) {
+        fprintf(stderr, "[main::snapshot_file] Error %s:\n\tCould not write snapshot '%s': %s\n",
+                macro_code_to_string(enum_file_error), target, error);
+        exit(enum_file_error);
+    }
+    free(snapshot_path);
+}
+
+/*
+* Restores the globals of a prelude before running a script.
+* A .jks path is loaded directly; for a source prelude a fresh snapshot beside it (foo.jks) is used,
+* otherwise the prelude itself is run.
+*/
+static void load_prelude(VirtualMachine* vm, const char* path) {
+    if (has_extension(path, snapshot_extension)) {
+        if (!load_snapshot(vm, path, NULL)) {
+            fprintf(stderr, "[main::load_prelude] Error %s:\n\tInvalid or incompatible snapshot file '%s'\n",
+                    macro_code_to_string(enum_file_error), path);
+            exit(enum_file_error);
+        }
+        return;
+    }
+
+    char* snapshot_path = image_path(path, snapshot_extension);
+    bool loaded = load_snapshot(vm, snapshot_path, path);
+    free(snapshot_path);
+    if (!loaded) run_file(vm, path);
+}
+
+static double elapsed_seconds(const struct timespec* start) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/*
+* Only scans the file (no parsing / code generation) and reports the lexing throughput.
+* The file is scanned repeatedly for at least lex_bench_seconds so that small files are measurable.
+*/
+#define lex_bench_seconds 0.5
+
+static void lex_file(VirtualMachine* vm, const char* path) {
+    char* source = read_file(path);
+    size_t size = strlen(source);
+    size_t tokens = 0;
+    int rounds = 0;
+
+    struct timespec start;
+    timespec_get(&start, TIME_UTC);
+    double seconds = 0;
+    do {
+        Scanner scanner;
+        init_scanner(&scanner, vm, source);
+        size_t count = 0;
+        while (scan_token(&scanner).type != token_eof) count++;
+        free_scanner(&scanner);
+
+        tokens = count;
+        rounds++;
+        seconds = elapsed_seconds(&start);
+    } while (seconds < lex_bench_seconds);
+
+    double mb = (double)size * rounds / (1024.0 * 1024.0);
+    printf("%s: %zu bytes, %zu tokens, %d rounds in %.3fs, %.1f MB/s, %.1f Mtokens/s\n",
+           path, size, tokens, rounds, seconds, mb / seconds, (double)tokens * rounds / seconds / 1e6);
+    free(source);
 }
 
 /*
@@ -235,7 +380,66 @@ static char* read_file(const char* path) {
     return buffer;
 }
 
+/* 命令行选项的数值参数, 不合法时退出 */
+static uint32_t parse_option_number(const char* text, uint32_t min, uint32_t max, const char* what) {
+    char* end = NULL;
+    unsigned long long number = strtoull(text, &end, 10);
+    if (end == text || *end != '\0' || number < min || number > max) {
+        fprintf(stderr, "Invalid %s: %s (expected %u..%u)\n", what, text, min, max);
+        exit(enum_invalid_arguments);
+    }
+    return (uint32_t)number;
+}
+
 void console_repl(VirtualMachine* vm, int argc, char* argv[]) {
+    // joker -r <script>: 寄存器指令 + run_register()
+    if (argc == 3 && (strcmp(argv[1], "-r") == 0 || strcmp(argv[1], "--register") == 0)) {
+        vm->register_mode = true;
+        run_file(vm, argv[2]);
+        return;
+    }
+    // joker -r <option> ...: 寄存器模式下的其余选项, 如 -r -c <script> 写出寄存器模式的字节码缓存
+    if (argc >= 4 && (strcmp(argv[1], "-r") == 0 || strcmp(argv[1], "--register") == 0)) {
+        vm->register_mode = true;
+        console_repl(vm, argc - 1, argv + 1);
+        return;
+    }
+    // joker -c <script> [-o <out>]: 只编译, 写出字节码缓存
+    if ((argc == 3 || (argc == 5 && (strcmp(argv[3], "-o") == 0 || strcmp(argv[3], "--output") == 0)))
+        && (strcmp(argv[1], "-c") == 0 || strcmp(argv[1], "--compile") == 0)) {
+        compile_file(vm, argv[2], argc == 5 ? argv[4] : NULL);
+        return;
+    }
+    // joker -S <prelude> [-o <out>]: 运行 prelude, 写出全局变量的堆快照
+    if ((argc == 3 || (argc == 5 && (strcmp(argv[3], "-o") == 0 || strcmp(argv[3], "--output") == 0)))
+        && (strcmp(argv[1], "-S") == 0 || strcmp(argv[1], "--snapshot") == 0)) {
+        snapshot_file(vm, argv[2], argc == 5 ? argv[4] : NULL);
+        return;
+    }
+    // joker -p <prelude> <script>: 先从快照恢复 prelude 的全局变量, 再运行脚本
+    if (argc == 4 && (strcmp(argv[1], "-p") == 0 || strcmp(argv[1], "--prelude") == 0)) {
+        load_prelude(vm, argv[2]);
+        run_file(vm, argv[3]);
+        return;
+    }
+    // joker -l <script>: 只做词法分析, 报告吞吐(MB/s)
+    if (argc == 3 && (strcmp(argv[1], "-l") == 0 || strcmp(argv[1], "--lex") == 0)) {
+        lex_file(vm, argv[2]);
+        return;
+    }
+    // joker -g <us> <script>: 增量 gc, 单步暂停不超过 <us> 微秒
+    if (argc == 4 && (strcmp(argv[1], "-g") == 0 || strcmp(argv[1], "--gc-pause") == 0)) {
+        vm->gc.max_pause_us = parse_option_number(argv[2], 0, UINT32_MAX, "gc pause (microseconds)");
+        run_file(vm, argv[3]);
+        return;
+    }
+    // joker -j <n> <script>: major gc 用 <n> 个线程并行标记
+    if (argc == 4 && (strcmp(argv[1], "-j") == 0 || strcmp(argv[1], "--gc-workers") == 0)) {
+        vm->gc.mark_workers = (int)parse_option_number(argv[2], 1, GC_MAX_MARK_WORKERS, "gc mark workers");
+        run_file(vm, argv[3]);
+        return;
+    }
+
     JokerConsoleFn console_fn = console_match(argv[1]);
     if (console_fn != NULL) {
         console_fn(argc, argv);
@@ -250,7 +454,11 @@ int joker_entry(int argc, char* argv[]) {
 
     switch (argc) {
         case 1: repl(&vm); break;
-        case 2: console_repl(&vm, argc, argv); break;
+        case 2:
+        case 3:
+        case 4:
+        case 5:
+        case 6: console_repl(&vm, argc, argv); break;     // 6: -r 加上带参数的选项(-r -c <script> -o <out>)
         default:
             fprintf(stderr, "Usage: joker-compiler-c [path]\n");
             exit(enum_invalid_arguments);
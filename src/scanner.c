@@ -31,6 +31,14 @@
 #include <stdio.h>
 #include <string.h>
 
+// 指令集在编译期选择, 与 vec_kernel.c 一致(x86-64 基线即有 SSE2)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define scanner_use_sse2 1
+#else
+#define scanner_use_sse2 0
+#endif
+
 #include "common.h"
 #include "error.h"
 #include "scanner.h"
@@ -38,32 +46,165 @@
 
 
 static bool is_at_end(Scanner* self);
-static Token* scan_string(Scanner* self);
-static Token* scan_number(Scanner* self);
-static Token* scan_identifier(Scanner* self);
+static Token scan_string(Scanner* self);
+static Token scan_number(Scanner* self);
+static Token scan_identifier(Scanner* self);
 static TokenType identifier_type(Scanner* self);
 
-static bool is_digit(char ch) {
-	return ch >= '0' && ch <= '9';
+/* 字符类别表: 一次查表代替逐个区间比较 */
+#define char_alpha  1           // a-z A-Z _
+#define char_digit  2           // 0-9
+#define char_blank  4           // 空格 \t \r \n
+
+static const uint8_t char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0, 0, 4, 0, 0,     // \t \n \r
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,     // 空格
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0,     // 0-9
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     // A-O
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,     // P-Z _
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     // a-o
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,     // p-z
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,     // 非 ascii 都不是标识符字符
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static inline bool is_digit(char ch) {
+	return char_class[(uint8_t)ch] & char_digit;
+}
+
+static inline bool is_alpha(char ch) {
+	return char_class[(uint8_t)ch] & char_alpha;
+}
+
+/*
+* 成段扫描: 标识符 / 数字 / 空白 / 注释一次看 16 字节(SSE2), 用比较掩码的尾零个数定位段尾.
+* 只在离源码末尾还有 16 字节以上时做向量加载, 不会越过缓冲区; 剩下的尾部逐字节查表,
+* 源码以 '\0' 结尾, 它不属于任何类别, 尾部循环自然停下.
+* 单个空格(最常见的情况)直接前进, 换行之后的缩进才成段跳过: 逐个空格调用成段扫描反而更慢.
+*/
+
+#if scanner_use_sse2
+/* 落在 [lo, hi] 内的字节: 平移到有符号下界 -128 后用一次有符号比较 */
+static inline __m128i bytes_in_range(__m128i chunk, int lo, int hi) {
+	__m128i shifted = _mm_add_epi8(chunk, _mm_set1_epi8((char)(-128 - lo)));
+	return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + (hi - lo) + 1)));
+}
+
+static inline unsigned bytes_equal(__m128i chunk, char ch) {
+	return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(ch)));
+}
+#endif
+
+/* 跳过标识符字符 [a-zA-Z0-9_] */
+static const char* skip_ident_chars(const char* p, const char* end) {
+#if scanner_use_sse2
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		__m128i letter = bytes_in_range(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), 'a', 'z');   // 或上 0x20 统一成小写
+		__m128i ident = _mm_or_si128(_mm_or_si128(letter, bytes_in_range(chunk, '0', '9')),
+		                             _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')));
+		unsigned stop = ~(unsigned)_mm_movemask_epi8(ident) & 0xFFFF;
+		if (stop != 0) return p + __builtin_ctz(stop);
+		p += 16;
+	}
+#endif
+	while (char_class[(uint8_t)*p] & (char_alpha | char_digit)) p++;
+	return p;
+}
+
+/* 跳过数字 [0-9] */
+static const char* skip_digits(const char* p, const char* end) {
+#if scanner_use_sse2
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		unsigned stop = ~(unsigned)_mm_movemask_epi8(bytes_in_range(chunk, '0', '9')) & 0xFFFF;
+		if (stop != 0) return p + __builtin_ctz(stop);
+		p += 16;
+	}
+#endif
+	while (char_class[(uint8_t)*p] & char_digit) p++;
+	return p;
+}
+
+/* 跳过空白, 顺带数换行 */
+static const char* skip_blanks(const char* p, const char* end, line_t* line) {
+#if scanner_use_sse2
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		unsigned newlines = bytes_equal(chunk, '\n');
+		unsigned blank = newlines | bytes_equal(chunk, ' ') | bytes_equal(chunk, '\t') | bytes_equal(chunk, '\r');
+		unsigned stop = ~blank & 0xFFFF;
+		int run = stop != 0 ? __builtin_ctz(stop) : 16;
+		*line += __builtin_popcount(newlines & ((1u << run) - 1));
+		p += run;
+		if (stop != 0) return p;
+	}
+#endif
+	while (char_class[(uint8_t)*p] & char_blank) {
+		if (*p == '\n') (*line)++;
+		p++;
+	}
+	return p;
+}
+
+/* 行注释: 停在 '\n'(留给 skip_blanks 计行)或源码末尾 */
+static const char* skip_line_comment(const char* p, const char* end) {
+#if scanner_use_sse2
+	while (end - p >= 16) {
+		unsigned hit = bytes_equal(_mm_loadu_si128((const __m128i*)p), '\n');
+		if (hit != 0) return p + __builtin_ctz(hit);
+		p += 16;
+	}
+#endif
+	while (*p != '\n' && *p != '\0') p++;
+	return p;
 }
 
-static bool is_alpha(char ch) {
-	return (ch >= 'a' && ch <= 'z')
-		|| (ch >= 'A' && ch <= 'Z')
-		|| ch == '_';
+/* 块注释: p 在 '/' + '*' 之后, 返回 '*' + '/' 之后的位置; 没有闭合返回 NULL */
+static const char* skip_block_comment(const char* p, const char* end, line_t* line) {
+#if scanner_use_sse2
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		unsigned stars = bytes_equal(chunk, '*');
+		unsigned newlines = bytes_equal(chunk, '\n');
+		if (stars == 0) {
+			*line += __builtin_popcount(newlines);
+			p += 16;
+			continue;
+		}
+		int at = __builtin_ctz(stars);
+		*line += __builtin_popcount(newlines & ((1u << at) - 1));
+		p += at;
+		if (p[1] == '/') return p + 2;      // p[1] 最多读到结尾的 '\0'
+		p++;
+	}
+#endif
+	while (*p != '\0') {
+		if (*p == '\n') (*line)++;
+		if (*p == '*' && p[1] == '/') return p + 2;
+		p++;
+	}
+	return NULL;
 }
 
-static Token* make_tk(Scanner* self, TokenType token_type) {
-	return new_token(
-            self->vm,
+static Token make_tk(Scanner* self, TokenType token_type) {
+	return make_token(
+            token_type,
             self->start,
             (int)(self->current - self->start),
-            self->line, token_type
+            self->line
         );
 }
 
-static Token* error_token(Scanner* self, const char* msg) {
-	return new_token(self->vm, msg, (int)strlen(msg), self->line, token_error);
+static Token error_token(Scanner* self, const char* msg) {
+	return make_token(token_error, msg, (int)strlen(msg), self->line);
 }
 
 static char advance(Scanner* self) {
@@ -103,34 +244,24 @@ static void skip_with_espace(Scanner* self) {
 			advance(self);
 			break;
 		case '\n':
+			// 换行之后往往是一段缩进, 成段跳过
 			self->line++;
-			advance(self);
+			self->current = skip_blanks(self->current + 1, self->end, &self->line);
 			break;
 		case '/':
 			switch (peek_next(self))
 			{
 			case '/':
-				while (peek(self) != '\n' && !is_at_end(self)) advance(self);
+				self->current = skip_line_comment(self->current, self->end);
 				break;
-			case '*':
-				advance(self);
-				advance(self);
-
-				bool is_success = false;
-				while (!is_at_end(self)) {
-					if (peek(self) == '\n') self->line++;
-					if (peek(self) == '*' && peek_next(self) == '/') {
-						advance(self);
-						advance(self);
-						is_success = true;
-						break;
-					}
-					advance(self);
-				}
-				if (!is_success) {
+			case '*': {
+				const char* close = skip_block_comment(self->current + 2, self->end, &self->line);
+				if (close == NULL) {
                     panic("[ {PANIC} scanner::skip_with_espace] Unterminated comment.");
 				}
+				self->current = close;
 				break;
+			}
 			default:
 				return;
 			}
@@ -145,32 +276,22 @@ void init_scanner(Scanner* self, VirtualMachine *vm, const char* source) {
     self->vm = vm;
 	self->start = source;
 	self->current = source;
+	self->end = source + strlen(source);
 	self->line = 1;
-	self->tokens = new_token_list(vm);
 }
 
 void free_scanner(Scanner* self) {
 	self->start = NULL;
 	self->current = NULL;
+	self->end = NULL;
 	self->line = 0;
-    // TODO: don't free tokens, because it will be free in the compiler, all variables ref it will be free in the GC.
-	// free_tokens(self->tokens, self->vm);
-	self->tokens = NULL;
     self->vm = NULL;
 }
 
-void scan_tokens(Scanner* self) {
-	while (!is_at_end(self)) {
-		Token* token = scan_token(self);
-        list_add_token(self->tokens, token);
-	}
-    list_add_token(self->tokens, eof_token(self->vm, self->line));
-}
-
 /* scan token
  * TODO: opt used symbol table
  * */
-Token* scan_token(Scanner* self) {
+Token scan_token(Scanner* self) {
 	skip_with_espace(self);
 
 	self->start = self->current;
@@ -250,7 +371,7 @@ Token* scan_token(Scanner* self) {
 }
 
 /* scan string token, handler string interpolation: "literal{expression}{variable}" */
-static Token* scan_string(Scanner* self) {
+static Token scan_string(Scanner* self) {
 	while (peek(self) != '"' && !is_at_end(self)) {
 		// handle escape sequence
 		if (peek(self) == '\n') self->line++;
@@ -264,19 +385,6 @@ static Token* scan_string(Scanner* self) {
 	return make_tk(self, token_string);
 }
 
-static char* strndup(const char* src, size_t n) {
-	if (src == NULL) return NULL;
-	if (n == 0) return NULL;
-
-	char* result = (char*)malloc(n + 1);
-	if (result == NULL) panic("Expected malloc() to succeed, Found memory allocation failure.");
-
-	memset(result, 0, n + 1);
-	memcpy_s(result, n + 1, src, n);
-	result[n] = '\0';
-	return result;
-}
-
 /* scan number token, handler f64 number
 *
 * TODO:
@@ -290,9 +398,6 @@ static char* strndup(const char* src, size_t n) {
 * 2. xxx.xx
 */
 static TokenType check_number(Scanner* self, bool is_float) {
-	char* number_str = strndup(self->start, self->current - self->start);
-	if (number_str == NULL) return token_error;
-
 	// auto check number type
 	TokenType result = token_error;
 	if (is_float) {
@@ -301,7 +406,8 @@ static TokenType check_number(Scanner* self, bool is_float) {
 	else {
 		// default i32, if not type label, it will be i32
 		// if number > i32max value, auto big number
-		size_t val_ = strtoul(number_str, NULL, 10);
+		// 数字后面不是数字字符, strtoul 自己会停下, 不用拷贝一份
+		size_t val_ = strtoul(self->start, NULL, 10);
 		if (val_ > INT32_MAX) {
 			result = token_i64;
 		}
@@ -309,14 +415,12 @@ static TokenType check_number(Scanner* self, bool is_float) {
 			result = token_i32;
 		}
 	}
-	free(number_str);
-
 	return result;
 }
 
-static Token* scan_number(Scanner* self) {
+static Token scan_number(Scanner* self) {
     bool is_float = false;
-	while (is_digit(peek(self))) advance(self);
+	self->current = skip_digits(self->current, self->end);
 
 	// Look for a fractional part.
 	if (peek(self) == '.') {
@@ -328,16 +432,14 @@ static Token* scan_number(Scanner* self) {
 		is_float = true;
 		// Consume the ".".
 		advance(self);
-		while (is_digit(peek(self))) advance(self);
+		self->current = skip_digits(self->current, self->end);
 		// return make_tk(scanner, token_f64);
 	}
 	return make_tk(self, check_number(self, is_float));
 }
 
-static Token* scan_identifier(Scanner* self) {
-	while (is_alpha(peek(self)) || is_digit(peek(self))) {
-        advance(self);
-    }
+static Token scan_identifier(Scanner* self) {
+	self->current = skip_ident_chars(self->current, self->end);
 
     // '_'
     if (self->current - self->start == 1 && memcmp(self->start, "_", 1) == 0) {
@@ -346,70 +448,60 @@ static Token* scan_identifier(Scanner* self) {
     return make_tk(self, identifier_type(self));
 }
 
-/* used to check keyword */
-static TokenType check_keyword(Scanner* self, int start, int length, const char* rest, TokenType type) {
-	if (self->current - self->start == start + length &&
-		memcmp(self->start + start, rest, length) == 0) {
-		return type;
-	}
-	return token_identifier;
+/*
+* 关键字完美哈希: (首字符 * 3 + 尾字符 * 19 + 长度) & 63.
+* 常数是离线穷举 a, b 得到的第一组让全部关键字(含 print)互不冲突的值;
+* 增删关键字后要重新搜索常数, 并把表项挪到新的槽位.
+* 查找只需一次哈希 + 一次长度比较 + 一次 memcmp, 不再逐字符走 switch.
+*/
+#define keyword_table_size  64
+#define keyword_min_length  2
+#define keyword_max_length  8
+
+typedef struct Keyword {
+	const char* name;
+	int length;
+	TokenType type;
+} Keyword;
+
+static const Keyword keyword_table[keyword_table_size] = {
+	[4]  = { "match",    5, token_match },
+	[5]  = { "or",       2, token_or },
+	[6]  = { "return",   6, token_return },
+	[10] = { "enum",     4, token_enum },
+	[15] = { "if",       2, token_if },
+	[18] = { "and",      3, token_and },
+	[20] = { "super",    5, token_super },
+	[24] = { "loop",     4, token_loop },
+	[27] = { "var",      3, token_var },
+	[28] = { "break",    5, token_break },
+	[30] = { "fn",       2, token_fn },
+	[31] = { "true",     4, token_true },
+	[41] = { "while",    5, token_while },
+	[43] = { "for",      3, token_for },
+	[45] = { "None",     4, token_none },
+	[47] = { "self",     4, token_self },
+	[48] = { "continue", 8, token_continue },
+#ifndef deprecated_print_keyword
+	[49] = { "print",    5, token_print },
+#endif
+	[50] = { "else",     4, token_else },
+	[54] = { "false",    5, token_false },
+	[55] = { "class",    5, token_class },
+	[59] = { "struct",   6, token_struct },
+};
+
+static inline int keyword_hash(const char* start, int length) {
+	return ((uint8_t)start[0] * 3 + (uint8_t)start[length - 1] * 19 + length) & (keyword_table_size - 1);
 }
 
-/* used trie to match identifier type */
 static TokenType identifier_type(Scanner* self) {
-	switch (self->start[0]) {
-	case 'a': return check_keyword(self, 1, 2, "nd", token_and);
-	case 'b': return check_keyword(self, 1, 4, "reak", token_break);
-	case 'c':
-		/* exclude one letter identifier */
-		if (self->current - self->start > 1) {
-			switch (self->start[1]) {
-			case 'l': return check_keyword(self, 2, 3, "ass", token_class);
-			case 'o': return check_keyword(self, 2, 6, "ntinue", token_continue);
-			}
-		}
-		break;
-	case 'e':
-        /* exclude one letter identifier */
-        if ((int)(self->current - self->start) > 1) {
-            switch (self->start[1]) {
-            case 'l': return check_keyword(self, 2, 2, "se", token_else);
-            case 'n': return check_keyword(self, 2, 2, "um", token_enum);
-            }
-        }
-        break;
-	case 'f':
-		/* exclude one letter identifier */
-		if (self->current - self->start > 1) {
-			switch (self->start[1]) {
-			case 'a': return check_keyword(self, 2, 3, "lse", token_false);
-			case 'o': return check_keyword(self, 2, 1, "r", token_for);
-			case 'n': return token_fn;
-			}
-		}
-		break;
-	case 'i': return check_keyword(self, 1, 1, "f", token_if);
-    case 'l': return check_keyword(self, 1, 3, "oop", token_loop);
-	case 'm': return check_keyword(self, 1, 4, "atch", token_match);
-	case 'N': return check_keyword(self, 1, 3, "one", token_none);
-	case 'o': return check_keyword(self, 1, 1, "r", token_or);
-#ifndef deprecated_print_keyword
-	case 'p': return check_keyword(self, 1, 4, "rint", token_print);
-#endif
-	case 'r': return check_keyword(self, 1, 5, "eturn", token_return);
-	case 't': return check_keyword(self, 1, 3, "rue", token_true);
-	case 'v': return check_keyword(self, 1, 2, "ar", token_var);
-	case 'w': return check_keyword(self, 1, 4, "hile", token_while);
-	case 's':
-		if (self->current - self->start > 1) {
-			switch (self->start[1]) {
-			case 'e': return check_keyword(self, 2, 2, "lf", token_self);
-			case 'u': return check_keyword(self, 2, 3, "per", token_super);
-            case 't': return check_keyword(self, 2, 4, "ruct", token_struct);
-			}
-		}
-		break;
-	}
+	int length = (int)(self->current - self->start);
+	if (length < keyword_min_length || length > keyword_max_length) return token_identifier;
 
+	const Keyword* keyword = &keyword_table[keyword_hash(self->start, length)];
+	if (keyword->length == length && memcmp(keyword->name, self->start, length) == 0) {
+		return keyword->type;
+	}
 	return token_identifier;
 }
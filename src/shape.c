@@ -0,0 +1,75 @@
+//
+// Created by Kilig on 2025/4/20.
+//
+
+#include "memory.h"
+#include "shape.h"
+
+
+void init_root_shape(Shape* root) {
+    root->parent = NULL;
+    root->key = NULL;
+    root->slot_count = 0;
+    root->keys = NULL;
+    root->children = NULL;
+    root->sibling = NULL;
+}
+
+static void free_shape_children(VirtualMachine* vm, Shape* self) {
+    Shape* child = self->children;
+    while (child != NULL) {
+        Shape* next = child->sibling;
+        free_shape_children(vm, child);
+        macro_free_array(vm, String*, child->keys, child->slot_count);
+        macro_free(vm, Shape, child);
+        child = next;
+    }
+    self->children = NULL;
+}
+
+/* root 内嵌在 Class 中, 只释放其子树 */
+void free_shape_tree(VirtualMachine* vm, Shape* root) {
+    if (root != NULL) {
+        free_shape_children(vm, root);
+    }
+}
+
+/* 查找(或创建) self 新增字段 key 后的 Shape */
+Shape* shape_transition(VirtualMachine* vm, Shape* self, String* key) {
+    for (Shape* child = self->children; child != NULL; child = child->sibling) {
+        if (child->key == key) return child;
+    }
+
+    String** keys = macro_allocate(vm, String*, self->slot_count + 1);
+    for (int i = 0; i < self->slot_count; i++) {
+        keys[i] = self->keys[i];
+    }
+    keys[self->slot_count] = key;
+
+    Shape* shape = macro_allocate(vm, Shape, 1);
+    shape->parent = self;
+    shape->key = key;
+    shape->slot_count = self->slot_count + 1;
+    shape->keys = keys;
+    shape->children = NULL;
+
+    // 构造完成后再挂入 transition 树, 避免 gc 遍历到半初始化节点
+    shape->sibling = self->children;
+    self->children = shape;
+    return shape;
+}
+
+/* strings 已 intern, 指针比较即可; 未找到返回 -1 */
+int shape_find_slot(Shape* self, String* key) {
+    for (int i = self->slot_count - 1; i >= 0; i--) {
+        if (self->keys[i] == key) return i;
+    }
+    return -1;
+}
+
+void mark_shape_tree(VirtualMachine* vm, Shape* root, void (*mark)(VirtualMachine* vm, Object* object)) {
+    for (Shape* child = root->children; child != NULL; child = child->sibling) {
+        mark(vm, (Object*)child->key);
+        mark_shape_tree(vm, child, mark);
+    }
+}
@@ -0,0 +1,58 @@
+//
+// Created by Kilig on 2025/5/25.
+//
+
+#include <stdlib.h>
+
+#include "slab.h"
+#include "error.h"
+
+_Static_assert(sizeof(Slab) % SLAB_GRANULE == 0, "slab header must keep cells 16-byte aligned");
+
+
+void slab_init(SlabAllocator* self) {
+    self->slabs = NULL;
+    for (int i = 0; i < SLAB_CLASS_COUNT; i++) {
+        self->cursors[i] = NULL;
+        self->limits[i] = NULL;
+    }
+    self->slab_count = 0;
+}
+
+void slab_free(SlabAllocator* self) {
+    Slab* slab = self->slabs;
+    while (slab != NULL) {
+        Slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    slab_init(self);
+}
+
+/* 当前 slab 切完了: 再申请一块, 尾部不够一个块的零头丢弃 */
+static void new_slab(SlabAllocator* self, uint8_t size_class) {
+    Slab* slab = malloc(SLAB_SIZE);
+    if (slab == NULL) {
+        panic(" {PANIC} [slab::new_slab] slab malloc memory fail.");
+    }
+    slab->next = self->slabs;
+    slab->size_class = size_class;
+    self->slabs = slab;
+    self->slab_count++;
+
+    size_t size = (size_t)size_class * SLAB_GRANULE;
+    size_t count = (SLAB_SIZE - sizeof(Slab)) / size;
+    self->cursors[size_class - 1] = (char*)(slab + 1);
+    self->limits[size_class - 1] = (char*)(slab + 1) + count * size;
+}
+
+/* 从 size_class 的当前 slab 切出一个内存块 */
+void* slab_carve(SlabAllocator* self, uint8_t size_class) {
+    size_t size = (size_t)size_class * SLAB_GRANULE;
+    if (self->cursors[size_class - 1] == self->limits[size_class - 1]) {
+        new_slab(self, size_class);
+    }
+    void* cell = self->cursors[size_class - 1];
+    self->cursors[size_class - 1] += size;
+    return cell;
+}
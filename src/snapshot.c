@@ -0,0 +1,862 @@
+//
+// Created by Kilig on 2025/6/15.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+#include "memory.h"
+#include "hashmap.h"
+#include "string_.h"
+#include "fn.h"
+#include "native.h"
+#include "closure.h"
+#include "upvalue.h"
+#include "class.h"
+#include "instance.h"
+#include "bound_method.h"
+#include "struct_.h"
+#include "enum.h"
+#include "enum_instance.h"
+#include "pair.h"
+#include "vec.h"
+#include "gc.h"
+#include "vm.h"
+#include "error.h"
+
+#define snapshot_no_ref         UINT32_MAX      // 空引用(匿名 / 全局原生函数没有所属类型)
+
+/* shell 的 kind: 与 ObjectType 基本对应, 内置类型单独一种(按名字解析, 没有 link) */
+typedef enum SnapshotObject {
+    snapshot_string,
+    snapshot_fn,
+    snapshot_native,
+    snapshot_builtin_class,
+    snapshot_class,
+    snapshot_struct,
+    snapshot_enum,
+    snapshot_vec,
+    snapshot_pair,
+    snapshot_upvalue,
+    snapshot_bound_method,
+    snapshot_closure,
+    snapshot_instance,
+    snapshot_enum_instance,
+} SnapshotObject;
+
+typedef enum SnapshotValue {
+    snapshot_value_none,
+    snapshot_value_null,
+    snapshot_value_false,
+    snapshot_value_true,
+    snapshot_value_i32,
+    snapshot_value_i64,
+    snapshot_value_f32,
+    snapshot_value_f64,
+    snapshot_value_object,      // 后跟对象下标
+} SnapshotValue;
+
+/* 生成快照: objects 按发现顺序编号, 同时作为广度优先遍历的队列; indices 是指针 -> 下标的开放寻址表 */
+typedef struct SnapshotWriter {
+    VirtualMachine* vm;
+    BytecodeWriter out;
+    Object** objects;
+    uint32_t count;
+    uint32_t capacity;
+    Object** keys;
+    uint32_t* indices;
+    uint32_t key_capacity;      // 2 的幂
+    char error[160];
+} SnapshotWriter;
+
+/* 加载快照: 已创建的对象放在 objects 中, objects 压在虚拟机栈上作为 gc 根 */
+typedef struct SnapshotReader {
+    VirtualMachine* vm;
+    BytecodeReader in;
+    Vec* objects;
+    uint32_t count;
+    uint8_t* kinds;
+} SnapshotReader;
+
+
+/*===============================================================================*/
+// 写
+/*===============================================================================*/
+
+static void* snapshot_malloc(size_t size) {
+    void* memory = malloc(size);
+    if (memory == NULL) {
+        panic(" {PANIC} [snapshot::snapshot_malloc] snapshot malloc memory fail.");
+    }
+    return memory;
+}
+
+static uint32_t pointer_slot(Object* object, uint32_t capacity) {
+    uint64_t hash = (uint64_t)(uintptr_t)object >> 4;
+    return (uint32_t)((hash * 11400714819323198485ULL) >> 32) & (capacity - 1);
+}
+
+static void grow_indices(SnapshotWriter* self) {
+    uint32_t capacity = self->key_capacity < 64 ? 64 : self->key_capacity * 2;
+    Object** keys = snapshot_malloc(sizeof(Object*) * capacity);
+    uint32_t* indices = snapshot_malloc(sizeof(uint32_t) * capacity);
+    memset(keys, 0, sizeof(Object*) * capacity);
+    for (uint32_t i = 0; i < self->count; i++) {
+        uint32_t slot = pointer_slot(self->objects[i], capacity);
+        while (keys[slot] != NULL) slot = (slot + 1) & (capacity - 1);
+        keys[slot] = self->objects[i];
+        indices[slot] = i;
+    }
+    free(self->keys);
+    free(self->indices);
+    self->keys = keys;
+    self->indices = indices;
+    self->key_capacity = capacity;
+}
+
+/* 对象的下标; 第一次遇到时编号并加入队列 */
+static uint32_t object_index(SnapshotWriter* self, Object* object) {
+    if (self->key_capacity > 0) {
+        uint32_t slot = pointer_slot(object, self->key_capacity);
+        while (self->keys[slot] != NULL) {
+            if (self->keys[slot] == object) return self->indices[slot];
+            slot = (slot + 1) & (self->key_capacity - 1);
+        }
+    }
+
+    if ((self->count + 1) * 2 > self->key_capacity) grow_indices(self);
+    if (self->count == self->capacity) {
+        self->capacity = self->capacity < 64 ? 64 : self->capacity * 2;
+        Object** objects = realloc(self->objects, sizeof(Object*) * self->capacity);
+        if (objects == NULL) {
+            panic(" {PANIC} [snapshot::object_index] snapshot objects realloc memory fail.");
+        }
+        self->objects = objects;
+    }
+    uint32_t index = self->count++;
+    self->objects[index] = object;
+
+    uint32_t slot = pointer_slot(object, self->key_capacity);
+    while (self->keys[slot] != NULL) slot = (slot + 1) & (self->key_capacity - 1);
+    self->keys[slot] = object;
+    self->indices[slot] = index;
+    return index;
+}
+
+static void visit_value(SnapshotWriter* self, Value value) {
+    if (macro_is_obj(value)) object_index(self, macro_as_obj(value));
+}
+
+static void visit_hashmap(SnapshotWriter* self, HashMap* map) {
+    for (int i = 0; i < map->capacity; i++) {
+        Entry* entry = &map->entries[i];
+        if (entry->key == NULL) continue;
+        object_index(self, macro_into_object(entry->key));
+        visit_value(self, entry->value);
+    }
+}
+
+/* 原生函数按名字保存: 先找全局变量, 再找内置类型的方法 */
+static bool native_name(VirtualMachine* vm, Native* native, String** owner, String** name) {
+    HashMap* globals = &vm->globals;
+    for (int i = 0; i < globals->capacity; i++) {
+        Entry* entry = &globals->entries[i];
+        if (entry->key != NULL && macro_is_obj(entry->value) && macro_as_obj(entry->value) == &native->base) {
+            *owner = NULL;
+            *name = entry->key;
+            return true;
+        }
+    }
+    HashMap* types = &vm->types;
+    for (int i = 0; i < types->capacity; i++) {
+        Entry* type = &types->entries[i];
+        if (type->key == NULL || !macro_is_class(type->value)) continue;
+        HashMap* methods = &macro_as_class(type->value)->methods;
+        for (int j = 0; j < methods->capacity; j++) {
+            Entry* entry = &methods->entries[j];
+            if (entry->key != NULL && macro_is_obj(entry->value) && macro_as_obj(entry->value) == &native->base) {
+                *owner = type->key;
+                *name = entry->key;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool is_builtin_class(VirtualMachine* vm, Class* klass) {
+    Value type = hashmap_get(&vm->types, klass->name);
+    return macro_is_obj(type) && macro_as_obj(type) == &klass->base;
+}
+
+/* 广度优先收集全局变量可达的对象; 遇到不能保存的对象时写 error 并返回 false */
+static bool collect_objects(SnapshotWriter* self) {
+    visit_hashmap(self, &self->vm->globals);
+
+    for (uint32_t i = 0; i < self->count; i++) {
+        Object* object = self->objects[i];
+        switch (object->type) {
+            case OBJ_STRING:
+            case OBJ_FN:
+                break;  // Fn 的常量只有数字 / 字符串 / Fn, 随 Fn 记录一起写
+            case OBJ_NATIVE: {
+                String* owner = NULL;
+                String* name = NULL;
+                if (!native_name(self->vm, macro_as_native_from_obj(object), &owner, &name)) {
+                    snprintf(self->error, sizeof(self->error), "native function is not reachable by name");
+                    return false;
+                }
+                break;
+            }
+            case OBJ_CLASS: {
+                Class* klass = macro_as_class_from_obj(object);
+                if (is_builtin_class(self->vm, klass)) break;
+                object_index(self, macro_into_object(klass->name));
+                visit_hashmap(self, &klass->methods);
+                break;
+            }
+            case OBJ_STRUCT: {
+                Struct* struct_ = macro_as_struct_from_obj(object);
+                object_index(self, macro_into_object(struct_->name));
+                object_index(self, macro_into_object(struct_->names));
+                visit_hashmap(self, &struct_->fields);
+                break;
+            }
+            case OBJ_ENUM: {
+                Enum* enum_ = macro_as_enum_from_obj(object);
+                object_index(self, macro_into_object(enum_->name));
+                visit_hashmap(self, &enum_->members);
+                break;
+            }
+            case OBJ_VEC: {
+                Vec* vec = macro_as_vec_from_obj(object);
+                if (vec->base.size_class == 0) {
+                    snprintf(self->error, sizeof(self->error), "vec embedded in an enum instance");
+                    return false;
+                }
+                if (vec->kind == vec_kind_value) {
+                    for (size_t j = 0; j < vec->count; j++) visit_value(self, vec->as.values[j]);
+                }
+                break;
+            }
+            case OBJ_PAIR: {
+                Pair* pair = macro_as_pair_from_obj(object);
+                visit_value(self, pair->first);
+                visit_value(self, pair->second);
+                break;
+            }
+            case OBJ_UPVALUE: {
+                Upvalue* upvalue = macro_as_upvalue_from_obj(object);
+                if (upvalue->location != &upvalue->closed) {
+                    snprintf(self->error, sizeof(self->error), "open upvalue");
+                    return false;
+                }
+                visit_value(self, upvalue->closed);
+                break;
+            }
+            case OBJ_BOUND_METHOD: {
+                BoundMethod* bound = macro_as_bound_method_from_obj(object);
+                visit_value(self, bound->receiver);
+                object_index(self, macro_into_object(bound->method));
+                break;
+            }
+            case OBJ_CLOSURE: {
+                Closure* closure = macro_as_closure_from_obj(object);
+                object_index(self, macro_into_object(closure->fn));
+                for (int j = 0; j < closure->upvalue_count; j++) {
+                    if (closure->upvalue_ptrs[j] == NULL) {
+                        snprintf(self->error, sizeof(self->error), "closure with uncaptured upvalue");
+                        return false;
+                    }
+                    object_index(self, macro_into_object(closure->upvalue_ptrs[j]));
+                }
+                break;
+            }
+            case OBJ_INSTANCE: {
+                Instance* instance = macro_as_instance_from_obj(object);
+                object_index(self, macro_into_object(instance->klass));
+                for (int j = 0; j < instance->shape->slot_count; j++) {
+                    object_index(self, macro_into_object(instance->shape->keys[j]));
+                    visit_value(self, instance->fields[j]);
+                }
+                break;
+            }
+            case OBJ_ENUM_INSTANCE: {
+                EnumInstance* instance = macro_as_enum_instance_from_obj(object);
+                object_index(self, macro_into_object(instance->enum_type));
+                object_index(self, macro_into_object(instance->name));
+                if (instance->values != NULL) {
+                    for (size_t j = 0; j < instance->values->count; j++) {
+                        visit_value(self, instance->values->as.values[j]);
+                    }
+                }
+                break;
+            }
+            default:
+                snprintf(self->error, sizeof(self->error), "unsupported object type %s",
+                         macro_object_type_string(object->type));
+                return false;
+        }
+    }
+    return true;
+}
+
+static void put_ref(SnapshotWriter* self, Object* object) {
+    put_u32(&self->out, object == NULL ? snapshot_no_ref : object_index(self, object));
+}
+
+static void put_value(SnapshotWriter* self, Value value) {
+    BytecodeWriter* out = &self->out;
+    if (macro_is_obj(value)) {
+        put_u8(out, snapshot_value_object);
+        put_ref(self, macro_as_obj(value));
+    } else if (macro_is_i32(value)) {
+        put_u8(out, snapshot_value_i32);
+        put_i32(out, macro_as_i32(value));
+    } else if (macro_is_i64(value)) {
+        put_u8(out, snapshot_value_i64);
+        put_u64(out, (uint64_t)macro_as_i64(value));
+    } else if (macro_is_f32(value)) {
+        float f32 = macro_as_f32(value);
+        uint32_t bits;
+        memcpy(&bits, &f32, sizeof(bits));
+        put_u8(out, snapshot_value_f32);
+        put_u32(out, bits);
+    } else if (macro_is_bool(value)) {
+        put_u8(out, macro_as_bool(value) ? snapshot_value_true : snapshot_value_false);
+    } else if (macro_is_none(value)) {
+        put_u8(out, snapshot_value_none);
+    } else if (macro_is_null(value)) {
+        put_u8(out, snapshot_value_null);
+    } else {
+        double f64 = macro_as_f64(value);
+        uint64_t bits;
+        memcpy(&bits, &f64, sizeof(bits));
+        put_u8(out, snapshot_value_f64);
+        put_u64(out, bits);
+    }
+}
+
+/* HashMap 的 count 含墓碑, 条目数另外数 */
+static void put_entries(SnapshotWriter* self, HashMap* map) {
+    uint32_t count = 0;
+    for (int i = 0; i < map->capacity; i++) {
+        if (map->entries[i].key != NULL) count++;
+    }
+    put_u32(&self->out, count);
+    for (int i = 0; i < map->capacity; i++) {
+        Entry* entry = &map->entries[i];
+        if (entry->key == NULL) continue;
+        put_ref(self, macro_into_object(entry->key));
+        put_value(self, entry->value);
+    }
+}
+
+static bool put_shell(SnapshotWriter* self, Object* object) {
+    BytecodeWriter* out = &self->out;
+    switch (object->type) {
+        case OBJ_STRING:
+            put_u8(out, snapshot_string);
+            put_string(out, macro_as_string_from_obj(object));
+            return true;
+        case OBJ_FN:
+            put_u8(out, snapshot_fn);
+            return put_fn(out, macro_as_fn_from_obj(object));
+        case OBJ_NATIVE: {
+            String* owner = NULL;
+            String* name = NULL;
+            native_name(self->vm, macro_as_native_from_obj(object), &owner, &name);
+            put_u8(out, snapshot_native);
+            put_string(out, owner);
+            put_string(out, name);
+            return true;
+        }
+        case OBJ_CLASS: {
+            Class* klass = macro_as_class_from_obj(object);
+            if (is_builtin_class(self->vm, klass)) {
+                put_u8(out, snapshot_builtin_class);
+                put_string(out, klass->name);
+            } else {
+                put_u8(out, snapshot_class);
+            }
+            return true;
+        }
+        case OBJ_STRUCT:        put_u8(out, snapshot_struct); return true;
+        case OBJ_ENUM:          put_u8(out, snapshot_enum); return true;
+        case OBJ_VEC:           put_u8(out, snapshot_vec); return true;
+        case OBJ_PAIR:          put_u8(out, snapshot_pair); return true;
+        case OBJ_UPVALUE:       put_u8(out, snapshot_upvalue); return true;
+        case OBJ_BOUND_METHOD:  put_u8(out, snapshot_bound_method); return true;
+        case OBJ_CLOSURE:
+            put_u8(out, snapshot_closure);
+            put_ref(self, macro_into_object(macro_as_closure_from_obj(object)->fn));
+            return true;
+        case OBJ_INSTANCE:
+            put_u8(out, snapshot_instance);
+            put_ref(self, macro_into_object(macro_as_instance_from_obj(object)->klass));
+            return true;
+        case OBJ_ENUM_INSTANCE: {
+            EnumInstance* instance = macro_as_enum_instance_from_obj(object);
+            put_u8(out, snapshot_enum_instance);
+            put_i32(out, instance->index);
+            put_i32(out, instance->values == NULL ? 0 : (int32_t)instance->values->count);
+            return true;
+        }
+        default:
+            return false;   // collect_objects 已经拦下
+    }
+}
+
+static void put_link(SnapshotWriter* self, Object* object) {
+    BytecodeWriter* out = &self->out;
+    switch (object->type) {
+        case OBJ_CLASS: {
+            Class* klass = macro_as_class_from_obj(object);
+            if (is_builtin_class(self->vm, klass)) break;
+            put_ref(self, macro_into_object(klass->name));
+            put_entries(self, &klass->methods);
+            break;
+        }
+        case OBJ_STRUCT: {
+            Struct* struct_ = macro_as_struct_from_obj(object);
+            put_ref(self, macro_into_object(struct_->name));
+            put_ref(self, macro_into_object(struct_->names));
+            put_i32(out, struct_->count);
+            put_entries(self, &struct_->fields);
+            break;
+        }
+        case OBJ_ENUM: {
+            Enum* enum_ = macro_as_enum_from_obj(object);
+            put_ref(self, macro_into_object(enum_->name));
+            put_entries(self, &enum_->members);
+            break;
+        }
+        case OBJ_VEC: {
+            Vec* vec = macro_as_vec_from_obj(object);
+            put_u32(out, (uint32_t)vec->count);
+            for (size_t i = 0; i < vec->count; i++) put_value(self, vec_at(vec, i));
+            break;
+        }
+        case OBJ_PAIR: {
+            Pair* pair = macro_as_pair_from_obj(object);
+            put_value(self, pair->first);
+            put_value(self, pair->second);
+            break;
+        }
+        case OBJ_UPVALUE:
+            put_value(self, macro_as_upvalue_from_obj(object)->closed);
+            break;
+        case OBJ_BOUND_METHOD: {
+            BoundMethod* bound = macro_as_bound_method_from_obj(object);
+            put_value(self, bound->receiver);
+            put_ref(self, macro_into_object(bound->method));
+            break;
+        }
+        case OBJ_CLOSURE: {
+            Closure* closure = macro_as_closure_from_obj(object);
+            put_u32(out, (uint32_t)closure->upvalue_count);
+            for (int i = 0; i < closure->upvalue_count; i++) {
+                put_ref(self, macro_into_object(closure->upvalue_ptrs[i]));
+            }
+            break;
+        }
+        case OBJ_INSTANCE: {
+            Instance* instance = macro_as_instance_from_obj(object);
+            put_u32(out, (uint32_t)instance->shape->slot_count);
+            for (int i = 0; i < instance->shape->slot_count; i++) {
+                put_ref(self, macro_into_object(instance->shape->keys[i]));
+                put_value(self, instance->fields[i]);
+            }
+            break;
+        }
+        case OBJ_ENUM_INSTANCE: {
+            EnumInstance* instance = macro_as_enum_instance_from_obj(object);
+            put_ref(self, macro_into_object(instance->enum_type));
+            put_ref(self, macro_into_object(instance->name));
+            if (instance->values != NULL) {
+                for (size_t i = 0; i < instance->values->count; i++) put_value(self, instance->values->as.values[i]);
+            }
+            break;
+        }
+        default:
+            break;  // 字符串 / Fn / 原生函数没有引用
+    }
+}
+
+/*
+* 生成快照: 在 prelude 运行结束后调用, 保存当前全部全局变量.
+* 对象图中有不能保存的对象时返回 false, error 指向原因(静态存储, 下次调用前有效).
+*/
+bool save_snapshot(VirtualMachine* vm, const SourceStamp* stamp, const char* path, const char** error) {
+    static char message[160];
+    SnapshotWriter writer = { .vm = vm, .out = { NULL, 0, 0 } };
+    writer.error[0] = '\0';
+
+    bool ok = collect_objects(&writer);
+    if (ok) {
+        put_header(&writer.out, vm, snapshot_magic, snapshot_version, stamp);
+        put_u32(&writer.out, writer.count);
+        for (uint32_t i = 0; ok && i < writer.count; i++) {
+            ok = put_shell(&writer, writer.objects[i]);
+        }
+        if (!ok) snprintf(writer.error, sizeof(writer.error), "function constant cannot be serialized");
+    }
+    if (ok) {
+        for (uint32_t i = 0; i < writer.count; i++) put_link(&writer, writer.objects[i]);
+        put_entries(&writer, &vm->globals);
+        ok = write_image(&writer.out, path);
+        if (!ok) snprintf(writer.error, sizeof(writer.error), "could not write file");
+    }
+
+    if (!ok) {
+        memcpy(message, writer.error, sizeof(message));
+        *error = message;
+    }
+    free(writer.out.data);
+    free(writer.objects);
+    free(writer.keys);
+    free(writer.indices);
+    return ok;
+}
+
+
+/*===============================================================================*/
+// 读
+/*===============================================================================*/
+
+/* 已创建的对象; 下标越界、还没创建或类型不符(type >= 0 时检查)时置 ok = false 返回 NULL */
+static Object* get_ref(SnapshotReader* self, int type, bool nullable) {
+    uint32_t index = get_u32(&self->in);
+    if (!self->in.ok) return NULL;
+    if (index == snapshot_no_ref && nullable) return NULL;
+    if (index < self->objects->count) {
+        Value value = self->objects->as.values[index];
+        if (macro_is_obj(value) && (type < 0 || macro_as_obj(value)->type == (ObjectType)type)) {
+            return macro_as_obj(value);
+        }
+    }
+    self->in.ok = false;
+    return NULL;
+}
+
+static void keep_object(SnapshotReader* self, Value value) {
+    push(self->vm, value);
+    vec_push(self->objects, value);
+    pop(self->vm);
+}
+
+static Value get_value(SnapshotReader* self) {
+    BytecodeReader* in = &self->in;
+    switch (get_u8(in)) {
+        case snapshot_value_none:   return macro_val_none;
+        case snapshot_value_null:   return macro_val_null;
+        case snapshot_value_false:  return macro_val_from_bool(false);
+        case snapshot_value_true:   return macro_val_from_bool(true);
+        case snapshot_value_i32:    return macro_val_from_i32(get_i32(in));
+        case snapshot_value_i64: {
+            // 装箱的 i64 也放进 objects: 填写引用时后面的分配不会回收它
+            Value value = macro_val_from_i64(self->vm, (int64_t)get_u64(in));
+            if (macro_is_gc_ref(value)) keep_object(self, value);
+            return value;
+        }
+        case snapshot_value_f32: {
+            uint32_t bits = get_u32(in);
+            float f32;
+            memcpy(&f32, &bits, sizeof(f32));
+            return macro_val_from_f32(f32);
+        }
+        case snapshot_value_f64: {
+            uint64_t bits = get_u64(in);
+            double f64;
+            memcpy(&f64, &bits, sizeof(f64));
+            return macro_val_from_f64(f64);
+        }
+        case snapshot_value_object: {
+            Object* object = get_ref(self, -1, false);
+            if (object != NULL) return macro_val_from_obj(object);
+            break;
+        }
+        default: break;
+    }
+    in->ok = false;
+    return macro_val_none;
+}
+
+/* 新对象先压栈, 放进 objects 后再出栈: vec_push 扩容时可能触发 gc */
+static Native* find_native(VirtualMachine* vm, String* owner, String* name) {
+    Value value = macro_val_null;
+    if (owner == NULL) {
+        value = hashmap_get(&vm->globals, name);
+    } else {
+        Value type = hashmap_get(&vm->types, owner);
+        if (macro_is_class(type)) value = hashmap_get(&macro_as_class(type)->methods, name);
+    }
+    return is_obj_type(value, OBJ_NATIVE) ? macro_as_native_from_obj(macro_as_obj(value)) : NULL;
+}
+
+/* 第一遍: 创建没有前置依赖的对象; 闭包 / 实例要等 Fn / Class 都创建好, 先占位, pending 记下依赖的下标 */
+static void get_shells(SnapshotReader* self, uint32_t* pending) {
+    VirtualMachine* vm = self->vm;
+    BytecodeReader* in = &self->in;
+    for (uint32_t i = 0; in->ok && i < self->count; i++) {
+        uint8_t kind = get_u8(in);
+        self->kinds[i] = kind;
+        Object* object = NULL;
+        switch (kind) {
+            case snapshot_string:   object = macro_into_object(get_string(vm, in)); break;
+            case snapshot_fn:       object = macro_into_object(get_fn(vm, in, 0)); break;
+            case snapshot_native: {
+                String* owner = get_string(vm, in);
+                if (owner != NULL) push(vm, macro_val_from_obj(owner));
+                String* name = get_string(vm, in);
+                if (owner != NULL) pop(vm);
+                if (name != NULL) object = macro_into_object(find_native(vm, owner, name));
+                break;
+            }
+            case snapshot_builtin_class: {
+                String* name = get_string(vm, in);
+                Value type = name == NULL ? macro_val_null : hashmap_get(&vm->types, name);
+                if (macro_is_class(type)) object = macro_as_obj(type);
+                break;
+            }
+            case snapshot_class:    object = macro_into_object(new_class(vm, NULL)); break;
+            case snapshot_struct:   object = macro_into_object(new_struct(vm, NULL)); break;
+            case snapshot_enum:     object = macro_into_object(new_enum(vm, NULL)); break;
+            case snapshot_vec:      object = macro_into_object(new_vec(vm)); break;
+            case snapshot_pair:     object = macro_into_object(new_pair(vm, macro_val_none, macro_val_none)); break;
+            case snapshot_upvalue: {
+                Upvalue* upvalue = new_upvalue(vm, NULL);
+                upvalue->location = &upvalue->closed;
+                object = macro_into_object(upvalue);
+                break;
+            }
+            case snapshot_bound_method:
+                object = macro_into_object(new_bound_method(vm, macro_val_none, NULL));
+                break;
+            case snapshot_closure:
+            case snapshot_instance:
+                pending[i] = get_u32(in);
+                keep_object(self, macro_val_none);
+                continue;
+            case snapshot_enum_instance: {
+                int32_t index = get_i32(in);
+                int capacity = get_count(in, 1);
+                object = macro_into_object(new_enum_instance(vm, NULL, NULL, index, capacity));
+                break;
+            }
+            default: break;
+        }
+        if (object == NULL) {
+            in->ok = false;
+            return;
+        }
+        keep_object(self, macro_val_from_obj(object));
+    }
+}
+
+/* 第二遍: 用第一遍得到的 Fn / Class 创建闭包和实例, 替换占位 */
+static void get_dependent_shells(SnapshotReader* self, const uint32_t* pending) {
+    VirtualMachine* vm = self->vm;
+    for (uint32_t i = 0; self->in.ok && i < self->count; i++) {
+        uint8_t kind = self->kinds[i];
+        if (kind != snapshot_closure && kind != snapshot_instance) continue;
+        if (pending[i] >= self->count) {
+            self->in.ok = false;
+            return;
+        }
+
+        Value target = self->objects->as.values[pending[i]];
+        Object* object = NULL;
+        if (kind == snapshot_closure && is_obj_type(target, OBJ_FN)) {
+            object = macro_into_object(new_closure(macro_as_fn_from_obj(macro_as_obj(target))));
+        } else if (kind == snapshot_instance && macro_is_class(target)) {
+            object = macro_into_object(new_instance(vm, macro_as_class(target)));
+        }
+        if (object == NULL) {
+            self->in.ok = false;
+            return;
+        }
+        Value value = macro_val_from_obj(object);
+        push(vm, value);
+        vec_set(self->objects, i, value);
+        pop(vm);
+    }
+}
+
+/* key 必须是字符串; 写入后补写屏障 */
+static void get_entries(SnapshotReader* self, Object* owner, HashMap* map) {
+    int count = get_count(&self->in, 5);
+    for (int i = 0; self->in.ok && i < count; i++) {
+        String* key = (String*)get_ref(self, OBJ_STRING, false);
+        Value value = get_value(self);
+        if (!self->in.ok) return;
+        hashmap_set(map, key, value);
+        gc_write_barrier(owner, macro_val_from_obj(key));
+        gc_write_barrier(owner, value);
+    }
+}
+
+/* 第三遍: 填写对象之间的引用 */
+static void get_links(SnapshotReader* self) {
+    BytecodeReader* in = &self->in;
+    for (uint32_t i = 0; in->ok && i < self->count; i++) {
+        Object* object = macro_as_obj(self->objects->as.values[i]);
+        switch (self->kinds[i]) {
+            case snapshot_class: {
+                Class* klass = macro_as_class_from_obj(object);
+                klass->name = (String*)get_ref(self, OBJ_STRING, false);
+                gc_write_barrier(object, macro_val_from_obj(klass->name));
+                get_entries(self, object, &klass->methods);
+                klass->version = ++self->vm->class_version;
+                break;
+            }
+            case snapshot_struct: {
+                Struct* struct_ = macro_as_struct_from_obj(object);
+                struct_->name = (String*)get_ref(self, OBJ_STRING, false);
+                Vec* names = (Vec*)get_ref(self, OBJ_VEC, false);
+                if (names != NULL) struct_->names = names;
+                struct_->count = get_i32(in);
+                if (struct_->count < 0) in->ok = false;
+                gc_write_barrier(object, macro_val_from_obj(struct_->name));
+                gc_write_barrier(object, macro_val_from_obj(struct_->names));
+                get_entries(self, object, &struct_->fields);
+                break;
+            }
+            case snapshot_enum: {
+                Enum* enum_ = macro_as_enum_from_obj(object);
+                enum_->name = (String*)get_ref(self, OBJ_STRING, false);
+                gc_write_barrier(object, macro_val_from_obj(enum_->name));
+                get_entries(self, object, &enum_->members);
+                break;
+            }
+            case snapshot_vec: {
+                Vec* vec = macro_as_vec_from_obj(object);
+                int count = get_count(in, 1);
+                for (int j = 0; in->ok && j < count; j++) {
+                    Value value = get_value(self);
+                    if (in->ok) vec_push(vec, value);
+                }
+                break;
+            }
+            case snapshot_pair: {
+                Pair* pair = macro_as_pair_from_obj(object);
+                pair->first = get_value(self);
+                pair->second = get_value(self);
+                gc_write_barrier(object, pair->first);
+                gc_write_barrier(object, pair->second);
+                break;
+            }
+            case snapshot_upvalue: {
+                Upvalue* upvalue = macro_as_upvalue_from_obj(object);
+                upvalue->closed = get_value(self);
+                gc_write_barrier(object, upvalue->closed);
+                break;
+            }
+            case snapshot_bound_method: {
+                BoundMethod* bound = macro_as_bound_method_from_obj(object);
+                bound->receiver = get_value(self);
+                bound->method = (Closure*)get_ref(self, OBJ_CLOSURE, false);
+                gc_write_barrier(object, bound->receiver);
+                gc_write_barrier(object, macro_val_from_obj(bound->method));
+                break;
+            }
+            case snapshot_closure: {
+                Closure* closure = macro_as_closure_from_obj(object);
+                if (get_u32(in) != (uint32_t)closure->upvalue_count) in->ok = false;
+                for (int j = 0; in->ok && j < closure->upvalue_count; j++) {
+                    closure->upvalue_ptrs[j] = (Upvalue*)get_ref(self, OBJ_UPVALUE, false);
+                    gc_write_barrier(object, macro_val_from_obj(closure->upvalue_ptrs[j]));
+                }
+                break;
+            }
+            case snapshot_instance: {
+                Instance* instance = macro_as_instance_from_obj(object);
+                int count = get_count(in, 5);
+                for (int j = 0; in->ok && j < count; j++) {
+                    String* key = (String*)get_ref(self, OBJ_STRING, false);
+                    Value value = get_value(self);
+                    if (in->ok) instance_set_field(instance, key, value);
+                }
+                break;
+            }
+            case snapshot_enum_instance: {
+                EnumInstance* instance = macro_as_enum_instance_from_obj(object);
+                instance->enum_type = (Enum*)get_ref(self, OBJ_ENUM, false);
+                instance->name = (String*)get_ref(self, OBJ_STRING, false);
+                gc_write_barrier(object, macro_val_from_obj(instance->enum_type));
+                gc_write_barrier(object, macro_val_from_obj(instance->name));
+                size_t count = instance->values == NULL ? 0 : instance->values->count;
+                for (size_t j = 0; in->ok && j < count; j++) {
+                    instance->values->as.values[j] = get_value(self);
+                    gc_write_barrier(object, instance->values->as.values[j]);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+/* 全局变量: 先完整校验一遍, 全部有效才写入, 损坏的快照不会留下一半的全局变量 */
+static void get_globals(SnapshotReader* self) {
+    BytecodeReader* in = &self->in;
+    const uint8_t* start = in->cursor;
+    int count = get_count(in, 5);
+    for (int i = 0; in->ok && i < count; i++) {
+        get_ref(self, OBJ_STRING, false);
+        get_value(self);
+    }
+    if (!in->ok || in->cursor != in->end) {     // 尾部有多余数据, 当作损坏
+        in->ok = false;
+        return;
+    }
+
+    in->cursor = start;
+    count = get_count(in, 5);
+    for (int i = 0; i < count; i++) {
+        String* name = (String*)get_ref(self, OBJ_STRING, false);
+        hashmap_set(&self->vm->globals, name, get_value(self));
+    }
+}
+
+/*
+* 加载 .jks 并把其中的全局变量写入虚拟机(覆盖同名的全局变量);
+* source_path 不为 NULL 时先检查快照是否与 prelude 源码对应.
+* 文件不存在、不兼容、过期或损坏时返回 false, 全局变量不变, 由调用者改为运行 prelude.
+*/
+bool load_snapshot(VirtualMachine* vm, const char* path, const char* source_path) {
+    BytecodeImage image;
+    if (!map_image(path, &image)) return false;
+
+    SnapshotReader reader = { .vm = vm, .in = { image.base, image.base, image.base + image.size, true } };
+    bool ok = get_header(&reader.in, vm, snapshot_magic, snapshot_version, source_path);
+    reader.count = ok ? (uint32_t)get_count(&reader.in, 1) : 0;
+    ok = ok && reader.in.ok;
+    if (ok) {
+        reader.objects = new_vec_with_kind(vm, vec_kind_value, reader.count);
+        push(vm, macro_val_from_obj(reader.objects));
+        reader.kinds = snapshot_malloc(reader.count + 1);
+        uint32_t* pending = snapshot_malloc(sizeof(uint32_t) * (reader.count + 1));
+
+        get_shells(&reader, pending);
+        get_dependent_shells(&reader, pending);
+        get_links(&reader);
+        get_globals(&reader);
+        ok = reader.in.ok;
+
+        free(pending);
+        free(reader.kinds);
+        pop(vm);
+    }
+
+    if (!ok) {
+        // 已创建的对象交给 gc 回收; 其中的 Fn 不会再碰映像, 可以立刻解除映射
+        unmap_image(&image);
+        return false;
+    }
+    keep_image(vm, &image);
+    return true;
+}
@@ -14,9 +14,6 @@
 // macro for allocate fixed array
 #define macro_allocate_fixed_array(vm, type, elem_type, arr_size, object_type) \
     (type*)allocate_object(vm, (sizeof(type) + arr_size * sizeof(elem_type)), object_type)
-// macro for free fixed array
-#define macro_free_fixed_array(vm, type, pointer, elem_type, arr_size) \
-    reallocate(vm, pointer, (sizeof(type) + arr_size * sizeof(elem_type)), 0)
 
 static uint32_t hash_string(const char* key, int length);
 
@@ -87,7 +84,7 @@ void free_string(String* string) {
               "Expected string length in int32 range, Found invalid string length.");
             return;
         }
-        macro_free_fixed_array(string->base.vm, String, string, char, string->length + 1);
+        release_object(&string->base, sizeof(String) + (string->length + 1) * sizeof(char));
     }
 }
 
@@ -142,6 +139,8 @@ String* concat_string(HashMap* interned_pool, String* left, String* right) {
 	String* interned_string = hashmap_find_key(
         interned_pool, result->chars, result->length, result->hash);
 	if (interned_string != NULL) {
+		// result 刚分配, 仍是新生代链表的表头: 先摘下再释放, 否则 GC 清扫时会访问已释放的内存
+		result->base.vm->gc.nursery = result->base.next;
 		free_string(result);
 		return interned_string;
 	}
@@ -195,11 +194,11 @@ int snprintf_string(String* string, char* buf, size_t size) {
 
 String* number_to_string(VirtualMachine* vm, Value* number) {
     char buffer[64];
-    switch (number->type) {
-        case VAL_I32: snprintf(buffer, sizeof(buffer), "%d", number->as.i32); break;
-        case VAL_I64: snprintf(buffer, sizeof(buffer), "%" PRId64, (long long)number->as.i64); break;
-        case VAL_F32: snprintf(buffer, sizeof(buffer), "%.6g", number->as.f32); break;
-        case VAL_F64: snprintf(buffer, sizeof(buffer), "%.6g", number->as.f64); break;
+    switch (macro_value_type(*number)) {
+        case VAL_I32: snprintf(buffer, sizeof(buffer), "%d", macro_as_i32(*number)); break;
+        case VAL_I64: snprintf(buffer, sizeof(buffer), "%" PRId64, macro_as_i64(*number)); break;
+        case VAL_F32: snprintf(buffer, sizeof(buffer), "%.6g", macro_as_f32(*number)); break;
+        case VAL_F64: snprintf(buffer, sizeof(buffer), "%.6g", macro_as_f64(*number)); break;
         default: runtime_error(vm, "Cannot convert non-number to string"); return NULL;
     }
     return new_string(vm, buffer, (int)strlen(buffer));
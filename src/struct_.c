@@ -8,14 +8,19 @@
 #include "vec.h"
 #include "string_.h"
 #include "struct_.h"
+#include "vm.h"
 
 
 Struct* new_struct(VirtualMachine *vm, String* name) {
+    // names 先分配并压栈保护, 分配 Struct 时可能触发 gc
+    Vec* names = new_vec(vm);
+    push(vm, macro_val_from_obj(names));
     Struct* self = macro_allocate_object(vm, Struct, OBJ_STRUCT);
     self->name = name;
     self->count = 0;
     init_hashmap(&self->fields, vm);
-    self->names = new_vec(vm);
+    self->names = names;
+    pop(vm);
     return self;
 }
 
@@ -23,7 +28,7 @@ void free_struct(Struct* self) {
     if (self != NULL) {
         free_hashmap(&self->fields);
         // free_vec(self->names);   // TODO: fix this, free struct auto free
-        macro_free(self->base.vm, Struct, self);
+        macro_release_object(self, Struct);
     }
 }
 
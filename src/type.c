@@ -19,7 +19,7 @@ Type* new_type(VirtualMachine* vm, String* name) {
 void free_type(Type* type) {
     if (type != NULL) {
         free_hashmap(&type->methods);
-        macro_free(type->base.vm, Type, type);
+        macro_release_object(type, Type);
     }
 }
 
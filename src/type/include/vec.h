@@ -19,6 +19,16 @@ extern Value native_vec_reverse(VirtualMachine* vm, int arg_count, Value* args);
 extern Value native_vec_length(VirtualMachine* vm, int arg_count, Value* args);
 extern Value native_vec_first(VirtualMachine* vm, int arg_count, Value* args);
 extern Value native_vec_last(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_sum(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_min(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_max(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_dot(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_map_add(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_fill(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_index_of(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_equals(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_sort(VirtualMachine* vm, int arg_count, Value* args);
+extern Value native_vec_sort_by(VirtualMachine* vm, int arg_count, Value* args);
 extern const FnMapper(FnName, FnPtr) vec_export_methods[][2];
 
 #endif //JOKER_NATIVE_VEC_H
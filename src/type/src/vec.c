@@ -2,12 +2,17 @@
 // Created by Kilig on 2025/4/2.
 //
 
+#include <string.h>
+
 #include "class.h"
 #include "vm.h"
 #include "value.h"
 #include "vec.h"
 #include "instance.h"
 #include "string_.h"
+#include "memory.h"
+#include "vec_kernel.h"
+#include "vec_sort.h"
 #include "../include/vec.h"
 
 
@@ -24,6 +29,16 @@ const FnMapper(FnName, FnPtr) vec_export_methods[][2] = {
         {"len",     native_vec_length},
         {"first",   native_vec_first},
         {"last",    native_vec_last},
+        {"sum",     native_vec_sum},
+        {"min",     native_vec_min},
+        {"max",     native_vec_max},
+        {"dot",     native_vec_dot},
+        {"map_add", native_vec_map_add},
+        {"fill",    native_vec_fill},
+        {"index_of",native_vec_index_of},
+        {"equals",  native_vec_equals},
+        {"sort",    native_vec_sort},
+        {"sort_by", native_vec_sort_by},
         {NULL,      NULL}
 };
 
@@ -36,11 +51,16 @@ Value native_vec_new(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Class* klass = macro_as_class(hashmap_get(&vm->types, new_string(vm, "Vec", 3)));
-    Instance* instance = new_instance(vm, klass);
-    Vec* data = new_vec(vm);
-    hashmap_set(&instance->fields, new_string(vm, "_data", 5), macro_val_from_obj(data));
-    return macro_val_from_obj(instance);
+    return macro_val_from_obj(new_vec(vm));
+}
+
+/* Vec 参数; 不是 Vec 时报告运行期错误并返回 NULL */
+static Vec* receiver_vec(VirtualMachine* vm, Value receiver) {
+    if (!macro_is_vec(receiver)) {
+        runtime_error(vm, "Expected Vec, Found %s.", macro_type_name(receiver));
+        return NULL;
+    }
+    return macro_as_vec(receiver);
 }
 
 Value native_vec_get(VirtualMachine* vm, int arg_count, Value* args) {
@@ -49,14 +69,9 @@ Value native_vec_get(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)) {
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
 
-    Vec* vec = macro_as_vec(data_val);
     int32_t index = macro_as_i32(args[1]);
     if (index < 0 || index >= (int32_t)vec_len(vec)) {
         runtime_error(vm, "Index %d out of bounds (size=%d).", index, vec_len(vec));
@@ -72,14 +87,9 @@ Value native_vec_set(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)) {
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
 
-    Vec* vec = macro_as_vec(data_val);
     int32_t index = macro_as_i32(args[1]);
     if (index < 0 || index >= (int32_t)vec_len(vec)) {
         runtime_error(vm, "Index %d out of bounds (size=%d).", index, vec_len(vec));
@@ -96,14 +106,10 @@ Value native_vec_push(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)) {
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
 
-    vec_push(macro_as_vec(data_val), args[1]);
+    vec_push(vec, args[1]);
     return macro_val_null;
 }
 
@@ -113,14 +119,10 @@ Value native_vec_pop(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)){
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
 
-    return vec_pop(macro_as_vec(data_val));
+    return vec_pop(vec);
 }
 
 Value native_vec_insert(VirtualMachine* vm, int arg_count, Value* args) {
@@ -129,14 +131,9 @@ Value native_vec_insert(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)) {
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
 
-    Vec* vec = macro_as_vec(data_val);
     int32_t index = macro_as_i32(args[1]);
     if (index < 0 || index > (int32_t)vec_len(vec)) {
         runtime_error(vm, "Index %d out of bounds (size=%d).", index, vec_len(vec));
@@ -153,20 +150,16 @@ Value native_vec_remove(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)) {
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
 
     int index = macro_as_i32(args[1]);
-    if (index < 0 || index >= (int32_t)vec_len(macro_as_vec(data_val))) {
-        runtime_error(vm, "Index %d out of bounds (size=%d).", index, vec_len(macro_as_vec(data_val)));
+    if (index < 0 || index >= (int32_t)vec_len(vec)) {
+        runtime_error(vm, "Index %d out of bounds (size=%d).", index, vec_len(vec));
         return macro_val_null;
     }
 
-    vec_remove(macro_as_vec(data_val), index);
+    vec_remove(vec, index);
     return macro_val_null;
 }
 
@@ -176,21 +169,13 @@ Value native_vec_extend(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* to_vec = macro_as_instance(args[0]);
-    Value to_data = hashmap_get(&to_vec->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(to_data)){
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* to = receiver_vec(vm, args[0]);
+    if (to == NULL) return macro_val_null;
 
-    Instance* from_vec = macro_as_instance(args[1]);
-    Value from_data = hashmap_get(&from_vec->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(from_data)) {
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* from = receiver_vec(vm, args[1]);
+    if (from == NULL) return macro_val_null;
 
-    vec_extend(macro_as_vec(to_data), macro_as_vec(from_data));
+    vec_extend(to, from);
     return macro_val_null;
 }
 
@@ -200,13 +185,9 @@ Value native_vec_clear(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)){
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
-    vec_clear(macro_as_vec(data_val));
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+    vec_clear(vec);
     return macro_val_null;
 }
 
@@ -216,14 +197,10 @@ Value native_vec_reverse(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)) {
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
 
-    vec_reverse(macro_as_vec(data_val));
+    vec_reverse(vec);
     return macro_val_null;
 }
 
@@ -233,14 +210,9 @@ Value native_vec_length(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)) {
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
 
-    Vec* vec = macro_as_vec(data_val);
     return macro_val_from_i32(vec_len(vec));
 }
 
@@ -250,13 +222,9 @@ Value native_vec_first(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)) {
-        runtime_error(vm, "Vector data corrupted.");
-        return macro_val_null;
-    }
-    return vec_first(macro_as_vec(data_val));
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+    return vec_first(vec);
 }
 
 Value native_vec_last(VirtualMachine* vm, int arg_count, Value* args) {
@@ -265,11 +233,424 @@ Value native_vec_last(VirtualMachine* vm, int arg_count, Value* args) {
         return macro_val_null;
     }
 
-    Instance* instance = macro_as_instance(args[0]);
-    Value data_val = hashmap_get(&instance->fields, new_string(vm, "_data", 5));
-    if (!macro_is_vec(data_val)){
-        runtime_error(vm, "Vector data corrupted.");
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+    return vec_last(vec);
+}
+
+
+/*===============================================================================*/
+// 批量方法: 紧凑存储直接交给 vec_kernel 的 SIMD 内核, 通用 Value[] 存储逐个处理
+/*===============================================================================*/
+
+/* 整数结果能放进 i32 时返回 i32, 否则返回 i64 */
+static inline Value integer_value(VirtualMachine* vm, int64_t value) {
+    if (value >= INT32_MIN && value <= INT32_MAX) return macro_val_from_i32((int32_t)value);
+    return macro_val_from_i64(vm, value);
+}
+
+static inline bool is_float(Value value) {
+    return macro_is_f32(value) || macro_is_f64(value);
+}
+
+/* 整数 Value(i32 / i64)的值 */
+static inline int64_t integer_of(Value value) {
+    return macro_is_i32(value) ? macro_as_i32(value) : macro_as_i64(value);
+}
+
+/* 通用存储的 Vec 参与数值运算前, 所有元素必须是数值; has_float 返回是否含浮点元素 */
+static bool check_numbers(VirtualMachine* vm, Vec* vec, const char* method, bool* has_float) {
+    for (size_t i = 0; i < vec_len(vec); i++) {
+        Value element = vec_at(vec, i);
+        if (!macro_is_number(element)) {
+            runtime_error(vm, "Expected numeric Vec for '%s', Found %s at index %zu.",
+                          method, macro_type_name(element), i);
+            return false;
+        }
+        if (is_float(element)) *has_float = true;
+    }
+    return true;
+}
+
+/* a < b; 两个整数按 i64 比较, 否则按 f64 比较 */
+static inline bool number_less(Value a, Value b) {
+    if (!is_float(a) && !is_float(b)) return integer_of(a) < integer_of(b);
+    return value_to_f64(a) < value_to_f64(b);
+}
+
+/* a + b, 按 VM 的数值类型提升规则; 整数溢出返回 false */
+static bool number_add(VirtualMachine* vm, Value a, Value b, Value* out) {
+    if (macro_is_f64(a) || macro_is_f64(b)) {
+        *out = macro_val_from_f64(value_to_f64(a) + value_to_f64(b));
+    } else if (macro_is_f32(a) || macro_is_f32(b)) {
+        *out = macro_val_from_f32(value_to_f32(a) + value_to_f32(b));
+    } else if (macro_is_i64(a) || macro_is_i64(b)) {
+        int64_t result;
+        if (__builtin_add_overflow(integer_of(a), integer_of(b), &result)) return false;
+        *out = macro_val_from_i64(vm, result);
+    } else {
+        int32_t result;
+        if (__builtin_add_overflow(macro_as_i32(a), macro_as_i32(b), &result)) return false;
+        *out = macro_val_from_i32(result);
+    }
+    return true;
+}
+
+/*
+* sum: 整数元素在 i64 中累加, 结果在 i32 范围内返回 i32, 否则加宽为 i64 返回;
+* 与脚本里的 i32 加法不同, i32 存储的和超出 i32 时不报 "i32 overflow". 含浮点元素时按 f64 累加.
+*/
+Value native_vec_sum(VirtualMachine* vm, int arg_count, Value* args) {
+    if (arg_count != 1) {
+        runtime_error(vm, "Expected 0 arguments for 'sum'.");
+        return macro_val_null;
+    }
+
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+
+    size_t length = vec_len(vec);
+    switch (vec->kind) {
+        case vec_kind_i32: return integer_value(vm, kernel_sum_i32(vec->as.i32s, length));
+        case vec_kind_i64: return macro_val_from_i64(vm, kernel_sum_i64(vec->as.i64s, length));
+        case vec_kind_f64: return macro_val_from_f64(kernel_sum_f64(vec->as.f64s, length));
+        default: break;
+    }
+
+    bool has_float = false;
+    if (!check_numbers(vm, vec, "sum", &has_float)) return macro_val_null;
+    if (has_float) {
+        double sum = 0.0;
+        for (size_t i = 0; i < length; i++) sum += value_to_f64(vec->as.values[i]);
+        return macro_val_from_f64(sum);
+    }
+    int64_t sum = 0;
+    for (size_t i = 0; i < length; i++) sum = (int64_t)((uint64_t)sum + (uint64_t)integer_of(vec->as.values[i]));
+    return integer_value(vm, sum);
+}
+
+/* min / max 的公共部分 */
+static Value vec_extremum(VirtualMachine* vm, int arg_count, Value* args, bool max) {
+    const char* method = max ? "max" : "min";
+    if (arg_count != 1) {
+        runtime_error(vm, "Expected 0 arguments for '%s'.", method);
+        return macro_val_null;
+    }
+
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+
+    size_t length = vec_len(vec);
+    if (length == 0) {
+        runtime_error(vm, "Cannot take '%s' of an empty Vec.", method);
+        return macro_val_null;
+    }
+
+    switch (vec->kind) {
+        case vec_kind_i32:
+            return macro_val_from_i32(max ? kernel_max_i32(vec->as.i32s, length) : kernel_min_i32(vec->as.i32s, length));
+        case vec_kind_i64:
+            return macro_val_from_i64(vm, max ? kernel_max_i64(vec->as.i64s, length) : kernel_min_i64(vec->as.i64s, length));
+        case vec_kind_f64:
+            return macro_val_from_f64(max ? kernel_max_f64(vec->as.f64s, length) : kernel_min_f64(vec->as.f64s, length));
+        default: break;
+    }
+
+    bool has_float = false;
+    if (!check_numbers(vm, vec, method, &has_float)) return macro_val_null;
+    Value best = vec->as.values[0];
+    for (size_t i = 1; i < length; i++) {
+        Value element = vec->as.values[i];
+        if (max ? number_less(best, element) : number_less(element, best)) best = element;
+    }
+    return best;
+}
+
+Value native_vec_min(VirtualMachine* vm, int arg_count, Value* args) {
+    return vec_extremum(vm, arg_count, args, false);
+}
+
+Value native_vec_max(VirtualMachine* vm, int arg_count, Value* args) {
+    return vec_extremum(vm, arg_count, args, true);
+}
+
+/* dot: 整数结果的加宽规则同 sum */
+Value native_vec_dot(VirtualMachine* vm, int arg_count, Value* args) {
+    if (arg_count != 2) {
+        runtime_error(vm, "Expected 1 argument for 'dot'.");
+        return macro_val_null;
+    }
+
+    Vec* left = receiver_vec(vm, args[0]);
+    if (left == NULL) return macro_val_null;
+    Vec* right = receiver_vec(vm, args[1]);
+    if (right == NULL) return macro_val_null;
+
+    size_t length = vec_len(left);
+    if (vec_len(right) != length) {
+        runtime_error(vm, "Expected Vec of length %zu for 'dot', Found %zu.", length, vec_len(right));
+        return macro_val_null;
+    }
+
+    if (left->kind == right->kind) {
+        switch (left->kind) {
+            case vec_kind_i32: return integer_value(vm, kernel_dot_i32(left->as.i32s, right->as.i32s, length));
+            case vec_kind_i64: return macro_val_from_i64(vm, kernel_dot_i64(left->as.i64s, right->as.i64s, length));
+            case vec_kind_f64: return macro_val_from_f64(kernel_dot_f64(left->as.f64s, right->as.f64s, length));
+            default: break;
+        }
+    }
+
+    // 存储类型不同(或通用存储): 逐个装箱计算
+    bool has_float = false;
+    if (!check_numbers(vm, left, "dot", &has_float) || !check_numbers(vm, right, "dot", &has_float)) {
+        return macro_val_null;
+    }
+    if (has_float) {
+        double sum = 0.0;
+        for (size_t i = 0; i < length; i++) sum += value_to_f64(vec_at(left, i)) * value_to_f64(vec_at(right, i));
+        return macro_val_from_f64(sum);
+    }
+    uint64_t sum = 0;
+    for (size_t i = 0; i < length; i++) sum += (uint64_t)integer_of(vec_at(left, i)) * (uint64_t)integer_of(vec_at(right, i));
+    return integer_value(vm, (int64_t)sum);
+}
+
+/* vec[i] += x(原地修改); 任何一个元素溢出时报错且不修改 Vec */
+Value native_vec_map_add(VirtualMachine* vm, int arg_count, Value* args) {
+    if (arg_count != 2 || !macro_is_number(args[1])) {
+        runtime_error(vm, "Expected 1 numeric argument for 'map_add'.");
+        return macro_val_null;
+    }
+
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+
+    size_t length = vec_len(vec);
+    if (length == 0) return macro_val_null;
+
+    Value addend = args[1];
+    // 只需检查最小 / 最大元素是否溢出
+    if (vec->kind == vec_kind_i32 && macro_is_i32(addend)) {
+        int32_t k = macro_as_i32(addend);
+        int64_t low = (int64_t)kernel_min_i32(vec->as.i32s, length) + k;
+        int64_t high = (int64_t)kernel_max_i32(vec->as.i32s, length) + k;
+        if (low < INT32_MIN || high > INT32_MAX) {
+            runtime_error(vm, "i32 overflow in operation");
+            return macro_val_null;
+        }
+        kernel_add_i32(vec->as.i32s, length, k);
+        return macro_val_null;
+    }
+    if (vec->kind == vec_kind_i64 && !is_float(addend)) {
+        int64_t k = integer_of(addend);
+        int64_t result;
+        if (__builtin_add_overflow(kernel_min_i64(vec->as.i64s, length), k, &result)
+            || __builtin_add_overflow(kernel_max_i64(vec->as.i64s, length), k, &result)) {
+            runtime_error(vm, "i64 overflow in operation");
+            return macro_val_null;
+        }
+        kernel_add_i64(vec->as.i64s, length, k);
+        return macro_val_null;
+    }
+    if (vec->kind == vec_kind_f64) {
+        kernel_add_f64(vec->as.f64s, length, value_to_f64(addend));
+        return macro_val_null;
+    }
+
+    // 通用存储或需要类型提升: 先全部检查, 再逐个写回
+    bool has_float = false;
+    if (!check_numbers(vm, vec, "map_add", &has_float)) return macro_val_null;
+    Value result;
+    for (size_t i = 0; i < length; i++) {
+        Value element = vec_at(vec, i);
+        if (!number_add(vm, element, addend, &result)) {
+            runtime_error(vm, "%s overflow in operation", macro_is_i64(element) || macro_is_i64(addend) ? "i64" : "i32");
+            return macro_val_null;
+        }
+    }
+    for (size_t i = 0; i < length; i++) {
+        number_add(vm, vec_at(vec, i), addend, &result);
+        push(vm, result);       // NaN-boxing 下 result 可能是新装箱的 i64, vec_set 退化存储时会分配
+        vec_set(vec, i, result);
+        pop(vm);
+    }
+    return macro_val_null;
+}
+
+Value native_vec_fill(VirtualMachine* vm, int arg_count, Value* args) {
+    if (arg_count != 2) {
+        runtime_error(vm, "Expected 1 argument for 'fill'.");
+        return macro_val_null;
+    }
+
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+
+    vec_fill(vec, args[1]);
+    return macro_val_null;
+}
+
+Value native_vec_index_of(VirtualMachine* vm, int arg_count, Value* args) {
+    if (arg_count != 2) {
+        runtime_error(vm, "Expected 1 argument for 'index_of'.");
         return macro_val_null;
     }
-    return vec_last(macro_as_vec(data_val));
+
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+
+    Value target = args[1];
+    size_t length = vec_len(vec);
+    int64_t index = -1;
+    if (vec->kind == vec_kind_value) {
+        for (size_t i = 0; i < length; i++) {
+            if (values_equal(vec->as.values[i], target)) {
+                index = (int64_t)i;
+                break;
+            }
+        }
+    } else if (vec_kind_of(target) == vec->kind) {
+        // values_equal 要求类型相同, 类型不同的紧凑存储不可能命中
+        switch (vec->kind) {
+            case vec_kind_i32: index = kernel_index_of_i32(vec->as.i32s, length, macro_as_i32(target)); break;
+            case vec_kind_i64: index = kernel_index_of_i64(vec->as.i64s, length, macro_as_i64(target)); break;
+            case vec_kind_f64: index = kernel_index_of_f64(vec->as.f64s, length, macro_as_f64(target)); break;
+            default: break;
+        }
+    }
+    return macro_val_from_i32((int32_t)index);
+}
+
+Value native_vec_equals(VirtualMachine* vm, int arg_count, Value* args) {
+    if (arg_count != 2) {
+        runtime_error(vm, "Expected 1 argument for 'equals'.");
+        return macro_val_null;
+    }
+
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+
+    return macro_val_from_bool(macro_is_vec(args[1]) && vec_equal(vec, macro_as_vec(args[1])));
+}
+
+
+/*===============================================================================*/
+// 排序: 紧凑存储基数排序; 通用存储按自然顺序(数值 / 字符串)或 sort_by 的比较闭包稳定归并排序
+/*===============================================================================*/
+
+static bool number_less_than(void* context, Value a, Value b, bool* less) {
+    (void)context;
+    *less = number_less(a, b);
+    return true;
+}
+
+static bool string_less_than(void* context, Value a, Value b, bool* less) {
+    (void)context;
+    String* left = macro_as_string(a);
+    String* right = macro_as_string(b);
+    int length = left->length < right->length ? left->length : right->length;
+    int order = memcmp(left->chars, right->chars, length);
+    *less = order < 0 || (order == 0 && left->length < right->length);
+    return true;
+}
+
+Value native_vec_sort(VirtualMachine* vm, int arg_count, Value* args) {
+    if (arg_count != 1) {
+        runtime_error(vm, "Expected 0 arguments for 'sort'.");
+        return macro_val_null;
+    }
+
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+
+    size_t length = vec_len(vec);
+    if (length < 2) return macro_val_null;
+    if (vec->kind != vec_kind_value) {
+        vec_sort_packed(vec);
+        return macro_val_null;
+    }
+
+    // 自然顺序只定义在全是数值或全是字符串的 Vec 上, 先检查, 排序过程中比较不会失败
+    Value first = vec->as.values[0];
+    ValueLess less = macro_is_string(first) ? string_less_than : number_less_than;
+    for (size_t i = 0; i < length; i++) {
+        Value element = vec->as.values[i];
+        bool comparable = less == string_less_than ? macro_is_string(element) : macro_is_number(element);
+        if (!comparable) {
+            runtime_error(vm, "Cannot sort Vec of %s and %s, use 'sort_by' instead.",
+                          macro_type_name(first), macro_type_name(element));
+            return macro_val_null;
+        }
+    }
+
+    size_t scratch_count = length / 2 + 1;
+    Value* scratch = macro_allocate(vm, Value, scratch_count);
+    values_merge_sort(vec->as.values, scratch, length, less, NULL);
+    macro_free_array(vm, Value, scratch, scratch_count);
+    return macro_val_null;
+}
+
+typedef struct SortByContext {
+    VirtualMachine* vm;
+    Value comparator;
+} SortByContext;
+
+/* 比较闭包返回 bool(a 是否排在 b 之前)或数值(< 0 表示 a 排在 b 之前) */
+static bool closure_less_than(void* context, Value a, Value b, bool* less) {
+    SortByContext* self = context;
+    Value args[2] = {a, b};
+    Value result;
+    if (!vm_call(self->vm, self->comparator, 2, args, &result)) return false;
+
+    if (macro_is_bool(result)) {
+        *less = macro_as_bool(result);
+    } else if (macro_is_number(result)) {
+        *less = is_float(result) ? value_to_f64(result) < 0 : integer_of(result) < 0;
+    } else {
+        runtime_error(self->vm, "Expected bool or number from 'sort_by' comparator, Found %s.", macro_type_name(result));
+        return false;
+    }
+    return true;
+}
+
+Value native_vec_sort_by(VirtualMachine* vm, int arg_count, Value* args) {
+    if (arg_count != 2) {
+        runtime_error(vm, "Expected 1 argument for 'sort_by'.");
+        return macro_val_null;
+    }
+
+    Vec* vec = receiver_vec(vm, args[0]);
+    if (vec == NULL) return macro_val_null;
+
+    size_t length = vec_len(vec);
+    if (length < 2) return macro_val_null;
+
+    /*
+    * 比较闭包可能触发 GC, 也可能修改 vec 本身: 在压栈(作为 GC 根)的副本上排序, 完成后再写回.
+    * 出错时 runtime_error 已重置栈, 直接返回.
+    */
+    Vec* work = new_vec(vm);
+    push(vm, macro_val_from_obj(work));
+    vec_extend(work, vec);
+    vec_generalize(work);
+    Vec* scratch = new_vec(vm);
+    push(vm, macro_val_from_obj(scratch));
+    vec_extend(scratch, work);
+
+    SortByContext context = {vm, args[1]};
+    if (!values_merge_sort(work->as.values, scratch->as.values, length, closure_less_than, &context)) {
+        return macro_val_null;
+    }
+
+    if (vec_len(vec) != length) {
+        runtime_error(vm, "Vec modified during 'sort_by'.");
+        return macro_val_null;
+    }
+    for (size_t i = 0; i < length; i++) {
+        vec_set(vec, i, work->as.values[i]);
+    }
+    pop(vm);
+    pop(vm);
+    return macro_val_null;
 }
@@ -21,9 +21,12 @@ void type_register(VirtualMachine *vm,
                    const ObjectVTable* object_vtable,
                    const FnMapper(FnName, FnPtr) methods[][2]
 ) {
+    // name / klass 压栈作为 gc 根, 注册方法时的分配可能触发 gc
     String* name = new_string(vm, type_name, (int)strlen(type_name));
+    push(vm, macro_val_from_obj(name));
     Class* klass = new_class(vm, name);
     if (klass == NULL) panic("[new_class_build_type] Failed to create class.");
+    push(vm, macro_val_from_obj(klass));
 
     klass->base.vtable = object_vtable;
 
@@ -34,6 +37,8 @@ void type_register(VirtualMachine *vm,
         fn_mapper = methods[i++];
     }
 
+    pop(vm);
+    pop(vm);
     _type_register(vm, name, klass);
 }
 
@@ -51,7 +56,9 @@ static void define_class_native(VirtualMachine* self,
 ) {
     push(self, macro_val_from_obj(new_string(self, fn_mapper[0], strlen(fn_mapper[0]))));
     push(self, macro_val_from_obj(new_native(self, fn_mapper[1], true)));
-    hashmap_set(&klass->methods, macro_as_string(self->stack[0]), self->stack[1]);
+    hashmap_set(&klass->methods, macro_as_string(self->stack_top[-2]), self->stack_top[-1]);
+    gc_write_barrier(&klass->base, self->stack_top[-2]);
+    gc_write_barrier(&klass->base, self->stack_top[-1]);
     pop(self);
     pop(self);
 }
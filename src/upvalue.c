@@ -23,9 +23,7 @@ UpvaluePtr new_upvalue(VirtualMachine *vm, Value* slot) {
 
 void free_upvalue(UpvaluePtr self) {
     if (self == NULL) return;
-    if (self->location != NULL) {
-        macro_free(self->base.vm, Upvalue, self);
-    }
+    macro_release_object(self, Upvalue);
 }
 
 bool upvalue_equal(UpvaluePtr a, UpvaluePtr b) {
@@ -111,11 +109,12 @@ Upvalue* capture_upvalue(VirtualMachine *vm, Value* local) {
 *	Upvalue::location	=> pointer Upvalue::closed
 *	Upvalue::closed		=> stored stack value
 */
-void close_upvalues(UpvaluePtr root, Value* last) {
-    UpvaluePtr upv = root;
-    while (upv != NULL && upv->location > last) {
+void close_upvalues(UpvaluePtrRef root_ref, Value* last) {
+    while (*root_ref != NULL && (*root_ref)->location >= last) {
+        UpvaluePtr upv = *root_ref;
         upv->closed = *upv->location;
         upv->location = &upv->closed;
-        upv = upv->next;
+        gc_write_barrier(&upv->base, upv->closed);
+        *root_ref = upv->next;      // 关闭后摘出链表, 不再作为根, 随闭包一起回收
     }
 }
@@ -9,128 +9,204 @@
 #include "object.h"
 #include "error.h"
 #include "memory.h"
+#include "gc.h"
 
 #include "vec.h"
+#include "vec_kernel.h"
+
+static inline size_t kind_size(VecKind kind) {
+    switch (kind) {
+        case vec_kind_i32: return sizeof(int32_t);
+        case vec_kind_i64: return sizeof(int64_t);
+        case vec_kind_f64: return sizeof(double);
+        default:           return sizeof(Value);
+    }
+}
+
+/* 元素对应的紧凑存储类型; 无法紧凑存储的返回 vec_kind_value */
+VecKind vec_kind_of(Value value) {
+    if (macro_is_i32(value)) return vec_kind_i32;
+    if (macro_is_i64(value)) return vec_kind_i64;
+    if (macro_is_f64(value)) return vec_kind_f64;
+    return vec_kind_value;
+}
 
 Vec* new_vec(VirtualMachine* vm) {
     Vec *vec = macro_allocate_object(vm, Vec, OBJ_VEC);
-    vec->start = NULL;
-    vec->finish = NULL;
-    vec->end = NULL;
+    vec->kind = vec_kind_value;
+    vec->count = 0;
+    vec->capacity = 0;
+    vec->as.data = NULL;
     vec->base.vtable = &vec_vtable;
     return vec;
 }
 
 Vec* new_vec_with_capacity(VirtualMachine* vm, size_t capacity) {
+    return new_vec_with_kind(vm, vec_kind_value, capacity);
+}
+
+Vec* new_vec_with_kind(VirtualMachine* vm, VecKind kind, size_t capacity) {
+    // 先分配存储再分配对象: 分配存储可能触发 gc, 此时新 Vec 还不是任何根可达的
+    void* data = capacity > 0 ? reallocate(vm, NULL, 0, capacity * kind_size(kind)) : NULL;
     Vec *vec = new_vec(vm);
-    if (capacity > 0) {
-        vec->start = macro_allocate(vm, Value, capacity);
-        vec->finish = vec->start;
-        vec->end = vec->start + capacity;
-    }
+    vec->kind = kind;
+    vec->as.data = data;
+    vec->capacity = capacity;
     return vec;
 }
 
 static void vec_resize(Vec* vec, size_t min_capacity) {
-    size_t old_capacity = vec_capacity(vec);
-    size_t new_capacity = macro_grow_capacity(old_capacity);
-
+    size_t new_capacity = macro_grow_capacity(vec->capacity);
     while (new_capacity < min_capacity) {
         new_capacity = macro_grow_capacity(new_capacity);
     }
 
-    Value* old_start = vec->start;
-    size_t old_size = vec_len(vec);
+    size_t size = kind_size(vec->kind);
+    vec->as.data = reallocate(vec->base.vm, vec->as.data, vec->capacity * size, new_capacity * size);
+    if (vec->as.data == NULL) panic("{PANIC} [vec::resize] Failed to reallocate memory.");
+    vec->capacity = new_capacity;
+}
 
-    Value* new_start = macro_allocate(vec->base.vm, Value, new_capacity);
-    if (new_start == NULL) panic("{PANIC} [vec::resize] Failed to reallocate memory.");
-    if (old_size > 0 && old_start != NULL) memcpy(new_start, old_start, old_size * sizeof(Value));
-    if (old_start != NULL) macro_free(vec->base.vm, Value, old_start);
+/* 空 Vec 按新元素的类型重新选择存储, 容量(元素个数)不变 */
+static void vec_retype(Vec* vec, VecKind kind) {
+    if (vec->capacity > 0 && kind_size(kind) != kind_size(vec->kind)) {
+        vec->as.data = reallocate(vec->base.vm, vec->as.data,
+                                  vec->capacity * kind_size(vec->kind), vec->capacity * kind_size(kind));
+    }
+    vec->kind = kind;
+}
+
+/* 退化为通用 Value[] 存储: 逐个装箱已有元素.
+* NaN-boxing 下大的 i64 装箱会分配, 所以先换上 Value[] 存储再逐个写入, 每个装箱值写入后立即可达 */
+void vec_generalize(Vec* vec) {
+    if (vec->kind == vec_kind_value) return;
+
+    VirtualMachine* vm = vec->base.vm;
+    Value* values = vec->capacity > 0 ? macro_allocate(vm, Value, vec->capacity) : NULL;
+    VecKind kind = vec->kind;
+    void* data = vec->as.data;
+    for (size_t i = 0; i < vec->count; i++) {
+        values[i] = macro_val_null;
+    }
+    vec->as.values = values;
+    vec->kind = vec_kind_value;
+    for (size_t i = 0; i < vec->count; i++) {
+        values[i] = vec_load(vm, kind, data, i);
+        gc_write_barrier(&vec->base, values[i]);
+    }
+    reallocate(vm, data, vec->capacity * kind_size(kind), 0);
+}
+
+/* 写入 element 前保证存储类型能容纳它 */
+static inline void vec_prepare_store(Vec* vec, Value element) {
+    if (vec->kind == vec_kind_value) {
+        if (vec->count == 0) {
+            VecKind kind = vec_kind_of(element);
+            if (kind != vec_kind_value) vec_retype(vec, kind);
+        }
+        return;
+    }
+    VecKind kind = vec_kind_of(element);
+    if (kind == vec->kind) return;
+    if (vec->count == 0) {
+        vec_retype(vec, kind);
+    } else {
+        vec_generalize(vec);
+    }
+}
 
-    vec->start = new_start;
-    vec->finish = new_start + old_size;
-    vec->end = new_start + new_capacity;
+/* 按当前存储类型写入(调用方已经 vec_prepare_store) */
+static inline void vec_store(Vec* vec, size_t index, Value element) {
+    switch (vec->kind) {
+        case vec_kind_i32: vec->as.i32s[index] = macro_as_i32(element); break;
+        case vec_kind_i64: vec->as.i64s[index] = macro_as_i64(element); break;
+        case vec_kind_f64: vec->as.f64s[index] = macro_as_f64(element); break;
+        default:
+            vec->as.values[index] = element;
+            gc_write_barrier(&vec->base, element);
+            break;
+    }
 }
 
+/* 元素 [from, from + n) 的地址 */
+static inline char* vec_address(Vec* vec, size_t from) {
+    return (char*)vec->as.data + from * kind_size(vec->kind);
+}
 
 void free_vec(Vec* vec) {
     if (vec != NULL) {
-        if (vec->start != NULL) {
-            macro_free(vec->base.vm, Value, vec->start);
+        if (vec->as.data != NULL) {
+            reallocate(vec->base.vm, vec->as.data, vec->capacity * kind_size(vec->kind), 0);
         }
-        macro_free(vec->base.vm, Vec, vec);
+        macro_release_object(vec, Vec);
     }
 }
 
 inline size_t vec_capacity(Vec* vec) {
-    return vec->start == NULL ? 0: vec->end - vec->start;
+    return vec->capacity;
 }
 
 inline size_t vec_len(Vec* vec) {
-    return vec->start == NULL ? 0: vec->finish - vec->start;
+    return vec->count;
 }
 
 void vec_push(Vec* vec, Value element) {
-    if (vec_len(vec) == vec_capacity(vec)) {
-        vec_resize(vec, vec_len(vec) + 1);
+    vec_prepare_store(vec, element);
+    if (vec->count == vec->capacity) {
+        vec_resize(vec, vec->count + 1);
     }
-    *vec->finish++ = element;
+    vec_store(vec, vec->count++, element);
 }
 
 Value vec_pop(Vec* vec) {
     if (vec_is_empty(vec)) {
         panic("{PANIC} [vec::pop] Cannot pop element from empty vector.");
     }
-    return *--vec->finish;
+    return vec_at(vec, --vec->count);
 }
 
 Value vec_first(Vec* vec) {
     if (vec_is_empty(vec)) {
         panic("{PANIC} [vec::first] Cannot get first element from empty vector.");
     }
-    return vec->start[0];
+    return vec_at(vec, 0);
 }
 
 Value vec_last(Vec* vec) {
     if (vec_is_empty(vec)) {
         panic("{PANIC} [vec::last] Cannot get last element from empty vector.");
     }
-    Value rs = *--vec->finish;
-    vec->finish++;
-    return rs;
+    return vec_at(vec, vec->count - 1);
 }
 
 Value vec_get(Vec* vec, size_t index) {
     if (index >= vec_len(vec)) {
         panic("{PANIC} [vec::get] Index out of range.");
     }
-    return vec->start[index];
+    return vec_at(vec, index);
 }
 
 void vec_set(Vec* vec, size_t index, Value element) {
     if (index >= vec_len(vec)) {
         panic("{PANIC} [vec::set] Index out of range.");
     }
-    vec->start[index] = element;
+    vec_prepare_store(vec, element);
+    vec_store(vec, index, element);
 }
 
 void vec_insert(Vec* vec, size_t index, Value element) {
     size_t length = vec_len(vec);
 
     if (index > length) panic("{PANIC} [vec::insert] Index out of range.");
-    if (length == vec_capacity(vec)) {
+    vec_prepare_store(vec, element);
+    if (length == vec->capacity) {
         vec_resize(vec, length + 1);
     }
 
-    if (index == length) {
-        *vec->finish++ = element;
-    } else {
-        for(size_t i = length; i > index; i--) {
-            vec->start[i] = vec->start[i - 1];
-        }
-        vec->start[index] = element;
-        vec->finish++;
-    }
+    size_t size = kind_size(vec->kind);
+    memmove(vec_address(vec, index + 1), vec_address(vec, index), (length - index) * size);
+    vec_store(vec, index, element);
+    vec->count++;
 }
 
 void vec_remove(Vec* vec, size_t index) {
@@ -138,10 +214,9 @@ void vec_remove(Vec* vec, size_t index) {
     if (index >= length) {
         panic("{PANIC} [vec::remove] Index out of range.");
     }
-    for(size_t i = index; i < length - 1; i++) {
-        vec->start[i] = vec->start[i + 1];
-    }
-    vec->finish--;
+    size_t size = kind_size(vec->kind);
+    memmove(vec_address(vec, index), vec_address(vec, index + 1), (length - index - 1) * size);
+    vec->count--;
 }
 
 void vec_extend(Vec* vec, Vec* other) {
@@ -149,31 +224,74 @@ void vec_extend(Vec* vec, Vec* other) {
 
     size_t len_v = vec_len(vec);
     size_t len_o = vec_len(other);
-    size_t required_cap = len_v + len_o;
 
-    if (required_cap > vec_capacity(vec)) {
-        vec_resize(vec, required_cap);
+    if (len_v == 0 && vec->kind != other->kind) {
+        vec_retype(vec, other->kind);
+    } else if (vec->kind != other->kind) {
+        vec_generalize(vec);
+    }
+    if (len_v + len_o > vec->capacity) {
+        vec_resize(vec, len_v + len_o);
     }
 
-    memcpy(vec->finish, other->start, len_o * sizeof(Value));
-    vec->finish += len_o;
+    if (vec->kind != other->kind) {
+        // 逐个写入并计入 count: 装箱的 i64 写入后立即可达
+        for (size_t i = 0; i < len_o; i++) {
+            Value element = vec_at(other, i);
+            vec->as.values[vec->count++] = element;
+            gc_write_barrier(&vec->base, element);
+        }
+        return;
+    }
+    memcpy(vec_address(vec, len_v), other->as.data, len_o * kind_size(vec->kind));
+    vec->count += len_o;
+    if (vec->kind == vec_kind_value) gc_write_barrier_bulk(&vec->base);
 }
 
 void vec_clear(Vec* vec) {
-    vec->finish = vec->start;
+    vec->count = 0;
+}
+
+/* 所有元素置为 element; 旧元素全部被覆盖, 存储类型直接换成 element 的类型 */
+void vec_fill(Vec* vec, Value element) {
+    size_t length = vec_len(vec);
+    VecKind kind = vec_kind_of(element);
+    if (kind != vec->kind) {
+        vec->count = 0;
+        vec_retype(vec, kind);
+        vec->count = length;
+    }
+    switch (vec->kind) {
+        case vec_kind_i32: kernel_fill_i32(vec->as.i32s, length, macro_as_i32(element)); break;
+        case vec_kind_i64: kernel_fill_i64(vec->as.i64s, length, macro_as_i64(element)); break;
+        case vec_kind_f64: kernel_fill_f64(vec->as.f64s, length, macro_as_f64(element)); break;
+        default:
+            for (size_t i = 0; i < length; i++) vec->as.values[i] = element;
+            gc_write_barrier(&vec->base, element);
+            break;
+    }
 }
 
 void vec_reverse(Vec* vec) {
     size_t length = vec_len(vec);
-    for(size_t i = 0; i < length / 2; i++) {
-        Value tmp = vec->start[i];
-        vec->start[i] = vec->start[length - i - 1];
-        vec->start[length - i - 1] = tmp;
+    switch (vec->kind) {
+#define macro_reverse(type, array)                              \
+        for (size_t i = 0; i < length / 2; i++) {               \
+            type tmp = (array)[i];                              \
+            (array)[i] = (array)[length - i - 1];               \
+            (array)[length - i - 1] = tmp;                      \
+        }                                                       \
+        break;
+        case vec_kind_i32: macro_reverse(int32_t, vec->as.i32s)
+        case vec_kind_i64: macro_reverse(int64_t, vec->as.i64s)
+        case vec_kind_f64: macro_reverse(double, vec->as.f64s)
+        default:           macro_reverse(Value, vec->as.values)
+#undef macro_reverse
     }
 }
 
 bool vec_is_empty(Vec* vec) {
-    return vec->finish == vec->start;
+    return vec->count == 0;
 }
 
 void print_vec(Vec* vec) {
@@ -214,9 +332,9 @@ int snprintf_vec(Vec* vec, char* buf, size_t size) {
     remaining -= written;
     total += written;
 
-    int count = (int)(vec->finish - vec->start);
+    int count = (int)vec_len(vec);
     for (int i = 0; i < count; i++) {
-        Value* element = vec->start + i;
+        Value element = vec_at(vec, i);
 
         if (i > 0) {
             written = snprintf(current, remaining, ", ");
@@ -228,7 +346,7 @@ int snprintf_vec(Vec* vec, char* buf, size_t size) {
             total += written;
         }
 
-        written = snprintf_value(*element, current, remaining);
+        written = snprintf_value(element, current, remaining);
         if (written < 0) {
             return written;  // 传递子函数错误
         } else if ((size_t)written >= remaining) {
@@ -251,11 +369,17 @@ int snprintf_vec(Vec* vec, char* buf, size_t size) {
 bool vec_equal(Vec* left, Vec* right) {
     if (left == right) return true;
     if(vec_len(left) != vec_len(right)) return false;
+    // 整数存储逐字节比较即可; f64 需要按 == 语义比较(NaN / ±0)
+    if (left->kind == right->kind && (left->kind == vec_kind_i32 || left->kind == vec_kind_i64)) {
+        return left->count == 0 || memcmp(left->as.data, right->as.data, left->count * kind_size(left->kind)) == 0;
+    }
+    if (left->kind == vec_kind_f64 && right->kind == vec_kind_f64) {
+        return kernel_equal_f64(left->as.f64s, right->as.f64s, left->count);
+    }
     for(size_t i = 0; i < vec_len(left); i++) {
-        if(!values_equal(left->start[i], right->start[i])) {
+        if(!values_equal(vec_at(left, i), vec_at(right, i))) {
             return false;
         }
     }
     return true;
 }
-
@@ -0,0 +1,519 @@
+//
+// Created by Kilig on 2025/5/10.
+//
+
+#include "vec_kernel.h"
+
+// 指令集在编译期选择(-mavx2 / -march=native 时启用 AVX2)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define kernel_use_avx2 1
+#define kernel_use_sse2 0
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define kernel_use_avx2 0
+#define kernel_use_sse2 1
+#else
+#define kernel_use_avx2 0
+#define kernel_use_sse2 0
+#endif
+
+/* i64 回绕运算, 避免有符号溢出的未定义行为 */
+static inline int64_t wrap_add_i64(int64_t a, int64_t b) {
+    return (int64_t)((uint64_t)a + (uint64_t)b);
+}
+
+static inline int64_t wrap_mul_i64(int64_t a, int64_t b) {
+    return (int64_t)((uint64_t)a * (uint64_t)b);
+}
+
+#if kernel_use_avx2
+static inline int64_t reduce_add_epi64(__m256i acc) {
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return wrap_add_i64(wrap_add_i64(lanes[0], lanes[1]), wrap_add_i64(lanes[2], lanes[3]));
+}
+
+static inline double reduce_add_pd(__m256d acc) {
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+#elif kernel_use_sse2
+static inline int64_t reduce_add_epi64(__m128i acc) {
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return wrap_add_i64(lanes[0], lanes[1]);
+}
+
+static inline double reduce_add_pd(__m128d acc) {
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return lanes[0] + lanes[1];
+}
+
+/* SSE2 没有 pminsd / pmaxsd: 用比较掩码选择 */
+static inline __m128i select_epi32(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+/*===============================================================================*/
+// sum
+/*===============================================================================*/
+
+int64_t kernel_sum_i32(const int32_t* data, size_t count) {
+    size_t i = 0;
+    int64_t sum = 0;
+#if kernel_use_avx2
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+    sum = reduce_add_epi64(acc);
+#elif kernel_use_sse2
+    // 符号扩展到 i64: 高 32 位取 (0 > v) 的掩码
+    __m128i acc = _mm_setzero_si128();
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i sign = _mm_cmpgt_epi32(zero, v);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+    }
+    sum = reduce_add_epi64(acc);
+#endif
+    for (; i < count; i++) sum += data[i];
+    return sum;
+}
+
+int64_t kernel_sum_i64(const int64_t* data, size_t count) {
+    size_t i = 0;
+    int64_t sum = 0;
+#if kernel_use_avx2
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm256_add_epi64(acc, _mm256_loadu_si256((const __m256i*)(data + i)));
+    }
+    sum = reduce_add_epi64(acc);
+#elif kernel_use_sse2
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 2 <= count; i += 2) {
+        acc = _mm_add_epi64(acc, _mm_loadu_si128((const __m128i*)(data + i)));
+    }
+    sum = reduce_add_epi64(acc);
+#endif
+    for (; i < count; i++) sum = wrap_add_i64(sum, data[i]);
+    return sum;
+}
+
+double kernel_sum_f64(const double* data, size_t count) {
+    size_t i = 0;
+    double sum = 0.0;
+#if kernel_use_avx2
+    __m256d acc = _mm256_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm256_add_pd(acc, _mm256_loadu_pd(data + i));
+    }
+    sum = reduce_add_pd(acc);
+#elif kernel_use_sse2
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(data + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(data + i + 2));
+    }
+    sum = reduce_add_pd(_mm_add_pd(acc0, acc1));
+#endif
+    for (; i < count; i++) sum += data[i];
+    return sum;
+}
+
+/*===============================================================================*/
+// min / max
+/*===============================================================================*/
+
+int32_t kernel_min_i32(const int32_t* data, size_t count) {
+    size_t i = 0;
+    int32_t best = data[0];
+#if kernel_use_avx2
+    if (count >= 8) {
+        __m256i acc = _mm256_loadu_si256((const __m256i*)data);
+        for (i = 8; i + 8 <= count; i += 8) {
+            acc = _mm256_min_epi32(acc, _mm256_loadu_si256((const __m256i*)(data + i)));
+        }
+        int32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+        for (int n = 0; n < 8; n++) if (lanes[n] < best) best = lanes[n];
+    }
+#elif kernel_use_sse2
+    if (count >= 4) {
+        __m128i acc = _mm_loadu_si128((const __m128i*)data);
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+            acc = select_epi32(_mm_cmplt_epi32(v, acc), v, acc);
+        }
+        int32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+        for (int n = 0; n < 4; n++) if (lanes[n] < best) best = lanes[n];
+    }
+#endif
+    for (; i < count; i++) if (data[i] < best) best = data[i];
+    return best;
+}
+
+int32_t kernel_max_i32(const int32_t* data, size_t count) {
+    size_t i = 0;
+    int32_t best = data[0];
+#if kernel_use_avx2
+    if (count >= 8) {
+        __m256i acc = _mm256_loadu_si256((const __m256i*)data);
+        for (i = 8; i + 8 <= count; i += 8) {
+            acc = _mm256_max_epi32(acc, _mm256_loadu_si256((const __m256i*)(data + i)));
+        }
+        int32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+        for (int n = 0; n < 8; n++) if (lanes[n] > best) best = lanes[n];
+    }
+#elif kernel_use_sse2
+    if (count >= 4) {
+        __m128i acc = _mm_loadu_si128((const __m128i*)data);
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+            acc = select_epi32(_mm_cmpgt_epi32(v, acc), v, acc);
+        }
+        int32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+        for (int n = 0; n < 4; n++) if (lanes[n] > best) best = lanes[n];
+    }
+#endif
+    for (; i < count; i++) if (data[i] > best) best = data[i];
+    return best;
+}
+
+// SSE2 没有 64 位整数比较(pcmpgtq 属于 SSE4.2), i64 只在 AVX2 下向量化
+int64_t kernel_min_i64(const int64_t* data, size_t count) {
+    size_t i = 0;
+    int64_t best = data[0];
+#if kernel_use_avx2
+    if (count >= 4) {
+        __m256i acc = _mm256_loadu_si256((const __m256i*)data);
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+            acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(acc, v));
+        }
+        int64_t lanes[4];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+        for (int n = 0; n < 4; n++) if (lanes[n] < best) best = lanes[n];
+    }
+#endif
+    for (; i < count; i++) if (data[i] < best) best = data[i];
+    return best;
+}
+
+int64_t kernel_max_i64(const int64_t* data, size_t count) {
+    size_t i = 0;
+    int64_t best = data[0];
+#if kernel_use_avx2
+    if (count >= 4) {
+        __m256i acc = _mm256_loadu_si256((const __m256i*)data);
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+            acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(v, acc));
+        }
+        int64_t lanes[4];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+        for (int n = 0; n < 4; n++) if (lanes[n] > best) best = lanes[n];
+    }
+#endif
+    for (; i < count; i++) if (data[i] > best) best = data[i];
+    return best;
+}
+
+double kernel_min_f64(const double* data, size_t count) {
+    size_t i = 0;
+    double best = data[0];
+#if kernel_use_avx2
+    if (count >= 4) {
+        __m256d acc = _mm256_loadu_pd(data);
+        for (i = 4; i + 4 <= count; i += 4) {
+            acc = _mm256_min_pd(acc, _mm256_loadu_pd(data + i));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        for (int n = 0; n < 4; n++) if (lanes[n] < best) best = lanes[n];
+    }
+#elif kernel_use_sse2
+    if (count >= 2) {
+        __m128d acc = _mm_loadu_pd(data);
+        for (i = 2; i + 2 <= count; i += 2) {
+            acc = _mm_min_pd(acc, _mm_loadu_pd(data + i));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        for (int n = 0; n < 2; n++) if (lanes[n] < best) best = lanes[n];
+    }
+#endif
+    for (; i < count; i++) if (data[i] < best) best = data[i];
+    return best;
+}
+
+double kernel_max_f64(const double* data, size_t count) {
+    size_t i = 0;
+    double best = data[0];
+#if kernel_use_avx2
+    if (count >= 4) {
+        __m256d acc = _mm256_loadu_pd(data);
+        for (i = 4; i + 4 <= count; i += 4) {
+            acc = _mm256_max_pd(acc, _mm256_loadu_pd(data + i));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        for (int n = 0; n < 4; n++) if (lanes[n] > best) best = lanes[n];
+    }
+#elif kernel_use_sse2
+    if (count >= 2) {
+        __m128d acc = _mm_loadu_pd(data);
+        for (i = 2; i + 2 <= count; i += 2) {
+            acc = _mm_max_pd(acc, _mm_loadu_pd(data + i));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        for (int n = 0; n < 2; n++) if (lanes[n] > best) best = lanes[n];
+    }
+#endif
+    for (; i < count; i++) if (data[i] > best) best = data[i];
+    return best;
+}
+
+/*===============================================================================*/
+// dot
+/*===============================================================================*/
+
+// SSE2 只有无符号 32 位乘法(pmuludq), i32 点积只在 AVX2 下向量化
+int64_t kernel_dot_i32(const int32_t* left, const int32_t* right, size_t count) {
+    size_t i = 0;
+    int64_t sum = 0;
+#if kernel_use_avx2
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(left + i)));
+        __m256i b = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(right + i)));
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(a, b));
+    }
+    sum = reduce_add_epi64(acc);
+#endif
+    for (; i < count; i++) sum = wrap_add_i64(sum, (int64_t)left[i] * right[i]);
+    return sum;
+}
+
+int64_t kernel_dot_i64(const int64_t* left, const int64_t* right, size_t count) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; i++) sum = wrap_add_i64(sum, wrap_mul_i64(left[i], right[i]));
+    return sum;
+}
+
+double kernel_dot_f64(const double* left, const double* right, size_t count) {
+    size_t i = 0;
+    double sum = 0.0;
+#if kernel_use_avx2
+    __m256d acc = _mm256_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(left + i), _mm256_loadu_pd(right + i)));
+    }
+    sum = reduce_add_pd(acc);
+#elif kernel_use_sse2
+    __m128d acc = _mm_setzero_pd();
+    for (; i + 2 <= count; i += 2) {
+        acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(left + i), _mm_loadu_pd(right + i)));
+    }
+    sum = reduce_add_pd(acc);
+#endif
+    for (; i < count; i++) sum += left[i] * right[i];
+    return sum;
+}
+
+/*===============================================================================*/
+// add
+/*===============================================================================*/
+
+void kernel_add_i32(int32_t* data, size_t count, int32_t addend) {
+    size_t i = 0;
+#if kernel_use_avx2
+    __m256i k = _mm256_set1_epi32(addend);
+    for (; i + 8 <= count; i += 8) {
+        __m256i* p = (__m256i*)(data + i);
+        _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), k));
+    }
+#elif kernel_use_sse2
+    __m128i k = _mm_set1_epi32(addend);
+    for (; i + 4 <= count; i += 4) {
+        __m128i* p = (__m128i*)(data + i);
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), k));
+    }
+#endif
+    for (; i < count; i++) data[i] += addend;
+}
+
+void kernel_add_i64(int64_t* data, size_t count, int64_t addend) {
+    size_t i = 0;
+#if kernel_use_avx2
+    __m256i k = _mm256_set1_epi64x(addend);
+    for (; i + 4 <= count; i += 4) {
+        __m256i* p = (__m256i*)(data + i);
+        _mm256_storeu_si256(p, _mm256_add_epi64(_mm256_loadu_si256(p), k));
+    }
+#elif kernel_use_sse2
+    __m128i k = _mm_set1_epi64x(addend);
+    for (; i + 2 <= count; i += 2) {
+        __m128i* p = (__m128i*)(data + i);
+        _mm_storeu_si128(p, _mm_add_epi64(_mm_loadu_si128(p), k));
+    }
+#endif
+    for (; i < count; i++) data[i] = wrap_add_i64(data[i], addend);
+}
+
+void kernel_add_f64(double* data, size_t count, double addend) {
+    size_t i = 0;
+#if kernel_use_avx2
+    __m256d k = _mm256_set1_pd(addend);
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(data + i, _mm256_add_pd(_mm256_loadu_pd(data + i), k));
+    }
+#elif kernel_use_sse2
+    __m128d k = _mm_set1_pd(addend);
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(data + i, _mm_add_pd(_mm_loadu_pd(data + i), k));
+    }
+#endif
+    for (; i < count; i++) data[i] += addend;
+}
+
+/*===============================================================================*/
+// fill
+/*===============================================================================*/
+
+void kernel_fill_i32(int32_t* data, size_t count, int32_t value) {
+    size_t i = 0;
+#if kernel_use_avx2
+    __m256i k = _mm256_set1_epi32(value);
+    for (; i + 8 <= count; i += 8) _mm256_storeu_si256((__m256i*)(data + i), k);
+#elif kernel_use_sse2
+    __m128i k = _mm_set1_epi32(value);
+    for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i*)(data + i), k);
+#endif
+    for (; i < count; i++) data[i] = value;
+}
+
+void kernel_fill_i64(int64_t* data, size_t count, int64_t value) {
+    size_t i = 0;
+#if kernel_use_avx2
+    __m256i k = _mm256_set1_epi64x(value);
+    for (; i + 4 <= count; i += 4) _mm256_storeu_si256((__m256i*)(data + i), k);
+#elif kernel_use_sse2
+    __m128i k = _mm_set1_epi64x(value);
+    for (; i + 2 <= count; i += 2) _mm_storeu_si128((__m128i*)(data + i), k);
+#endif
+    for (; i < count; i++) data[i] = value;
+}
+
+void kernel_fill_f64(double* data, size_t count, double value) {
+    size_t i = 0;
+#if kernel_use_avx2
+    __m256d k = _mm256_set1_pd(value);
+    for (; i + 4 <= count; i += 4) _mm256_storeu_pd(data + i, k);
+#elif kernel_use_sse2
+    __m128d k = _mm_set1_pd(value);
+    for (; i + 2 <= count; i += 2) _mm_storeu_pd(data + i, k);
+#endif
+    for (; i < count; i++) data[i] = value;
+}
+
+/*===============================================================================*/
+// index_of
+/*===============================================================================*/
+
+int64_t kernel_index_of_i32(const int32_t* data, size_t count, int32_t value) {
+    size_t i = 0;
+#if kernel_use_avx2
+    __m256i k = _mm256_set1_epi32(value);
+    for (; i + 8 <= count; i += 8) {
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(data + i)), k);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        if (mask != 0) return (int64_t)(i + __builtin_ctz(mask));
+    }
+#elif kernel_use_sse2
+    __m128i k = _mm_set1_epi32(value);
+    for (; i + 4 <= count; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(data + i)), k);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        if (mask != 0) return (int64_t)(i + __builtin_ctz(mask));
+    }
+#endif
+    for (; i < count; i++) if (data[i] == value) return (int64_t)i;
+    return -1;
+}
+
+int64_t kernel_index_of_i64(const int64_t* data, size_t count, int64_t value) {
+    size_t i = 0;
+#if kernel_use_avx2
+    __m256i k = _mm256_set1_epi64x(value);
+    for (; i + 4 <= count; i += 4) {
+        __m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(data + i)), k);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+        if (mask != 0) return (int64_t)(i + __builtin_ctz(mask));
+    }
+#elif kernel_use_sse2
+    // 没有 pcmpeqq: 按 32 位比较, 一个 64 位车道的 8 个字节掩码全为 1 才算相等
+    __m128i k = _mm_set1_epi64x(value);
+    for (; i + 2 <= count; i += 2) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(data + i)), k));
+        if ((mask & 0x00ff) == 0x00ff) return (int64_t)i;
+        if ((mask & 0xff00) == 0xff00) return (int64_t)(i + 1);
+    }
+#endif
+    for (; i < count; i++) if (data[i] == value) return (int64_t)i;
+    return -1;
+}
+
+int64_t kernel_index_of_f64(const double* data, size_t count, double value) {
+    size_t i = 0;
+#if kernel_use_avx2
+    __m256d k = _mm256_set1_pd(value);
+    for (; i + 4 <= count; i += 4) {
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(data + i), k, _CMP_EQ_OQ));
+        if (mask != 0) return (int64_t)(i + __builtin_ctz(mask));
+    }
+#elif kernel_use_sse2
+    __m128d k = _mm_set1_pd(value);
+    for (; i + 2 <= count; i += 2) {
+        int mask = _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(data + i), k));
+        if (mask != 0) return (int64_t)(i + __builtin_ctz(mask));
+    }
+#endif
+    for (; i < count; i++) if (data[i] == value) return (int64_t)i;
+    return -1;
+}
+
+/*===============================================================================*/
+// equal
+/*===============================================================================*/
+
+bool kernel_equal_f64(const double* left, const double* right, size_t count) {
+    size_t i = 0;
+#if kernel_use_avx2
+    for (; i + 4 <= count; i += 4) {
+        __m256d eq = _mm256_cmp_pd(_mm256_loadu_pd(left + i), _mm256_loadu_pd(right + i), _CMP_EQ_OQ);
+        if (_mm256_movemask_pd(eq) != 0xf) return false;
+    }
+#elif kernel_use_sse2
+    for (; i + 2 <= count; i += 2) {
+        __m128d eq = _mm_cmpeq_pd(_mm_loadu_pd(left + i), _mm_loadu_pd(right + i));
+        if (_mm_movemask_pd(eq) != 0x3) return false;
+    }
+#endif
+    for (; i < count; i++) if (left[i] != right[i]) return false;
+    return true;
+}
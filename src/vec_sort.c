@@ -0,0 +1,190 @@
+//
+// Created by Kilig on 2025/5/11.
+//
+
+#include <string.h>
+
+#include "memory.h"
+#include "vec_sort.h"
+
+#define radix_threshold     64      // 元素不多于此数时插入排序
+#define merge_threshold     16      // 归并排序的子数组不多于此数时插入排序
+
+/*===============================================================================*/
+// 基数排序: 对保序键(无符号整数)升序排序
+/*===============================================================================*/
+
+/* i32 -> u32 保序键: 翻转符号位 */
+static inline uint32_t key_of_i32(uint32_t bits) { return bits ^ UINT32_C(0x80000000); }
+
+/* i64 -> u64 保序键: 翻转符号位 */
+static inline uint64_t key_of_i64(uint64_t bits) { return bits ^ UINT64_C(0x8000000000000000); }
+
+/* f64 -> u64 保序键: 正数翻转符号位, 负数翻转全部位 */
+static inline uint64_t key_of_f64(uint64_t bits) {
+    return (bits & UINT64_C(0x8000000000000000)) ? ~bits : bits ^ UINT64_C(0x8000000000000000);
+}
+static inline uint64_t f64_of_key(uint64_t key) {
+    return (key & UINT64_C(0x8000000000000000)) ? key ^ UINT64_C(0x8000000000000000) : ~key;
+}
+
+#define macro_insertion_sort(type, keys, count)                         \
+    for (size_t i = 1; i < (count); i++) {                              \
+        type key = (keys)[i];                                           \
+        size_t j = i;                                                   \
+        for (; j > 0 && (keys)[j - 1] > key; j--) (keys)[j] = (keys)[j - 1]; \
+        (keys)[j] = key;                                                \
+    }
+
+/*
+* LSD 基数排序, 每趟 8 bit; 一次遍历统计所有趟的直方图.
+* 结果可能落在 scratch 中, 返回最终所在的数组.
+*/
+#define macro_radix_sort(type, keys, scratch, count, result)            \
+    do {                                                                \
+        enum { passes = sizeof(type) };                                 \
+        size_t histogram[passes][256];                                  \
+        memset(histogram, 0, sizeof(histogram));                        \
+        for (size_t i = 0; i < (count); i++) {                          \
+            type key = (keys)[i];                                       \
+            for (int p = 0; p < passes; p++) histogram[p][(key >> (p * 8)) & 0xff]++; \
+        }                                                               \
+        type* from = (keys);                                            \
+        type* to = (scratch);                                           \
+        for (int p = 0; p < passes; p++) {                              \
+            size_t* counts = histogram[p];                              \
+            /* 该字节全部相同: 本趟不改变顺序 */                           \
+            if (counts[(from[0] >> (p * 8)) & 0xff] == (count)) continue; \
+            size_t offset = 0;                                          \
+            for (int b = 0; b < 256; b++) {                             \
+                size_t n = counts[b];                                   \
+                counts[b] = offset;                                     \
+                offset += n;                                            \
+            }                                                           \
+            for (size_t i = 0; i < (count); i++) {                      \
+                type key = from[i];                                     \
+                to[counts[(key >> (p * 8)) & 0xff]++] = key;            \
+            }                                                           \
+            type* swap = from;                                          \
+            from = to;                                                  \
+            to = swap;                                                  \
+        }                                                               \
+        (result) = from;                                                \
+    } while (false)
+
+static void sort_u32(VirtualMachine* vm, uint32_t* keys, size_t count) {
+    if (count <= radix_threshold) {
+        macro_insertion_sort(uint32_t, keys, count)
+        return;
+    }
+    uint32_t* scratch = macro_allocate(vm, uint32_t, count);
+    uint32_t* sorted;
+    macro_radix_sort(uint32_t, keys, scratch, count, sorted);
+    if (sorted != keys) memcpy(keys, sorted, count * sizeof(uint32_t));
+    macro_free_array(vm, uint32_t, scratch, count);
+}
+
+static void sort_u64(VirtualMachine* vm, uint64_t* keys, size_t count) {
+    if (count <= radix_threshold) {
+        macro_insertion_sort(uint64_t, keys, count)
+        return;
+    }
+    uint64_t* scratch = macro_allocate(vm, uint64_t, count);
+    uint64_t* sorted;
+    macro_radix_sort(uint64_t, keys, scratch, count, sorted);
+    if (sorted != keys) memcpy(keys, sorted, count * sizeof(uint64_t));
+    macro_free_array(vm, uint64_t, scratch, count);
+}
+
+#undef macro_radix_sort
+#undef macro_insertion_sort
+
+void vec_sort_packed(Vec* vec) {
+    VirtualMachine* vm = vec->base.vm;
+    size_t count = vec->count;
+    if (count < 2) return;
+
+    switch (vec->kind) {
+        case vec_kind_i32: {
+            // int32_t / uint32_t 互为有/无符号对应类型, 可以原地按键排序
+            uint32_t* keys = (uint32_t*)vec->as.i32s;
+            for (size_t i = 0; i < count; i++) keys[i] = key_of_i32(keys[i]);
+            sort_u32(vm, keys, count);
+            for (size_t i = 0; i < count; i++) keys[i] = key_of_i32(keys[i]);
+            break;
+        }
+        case vec_kind_i64: {
+            uint64_t* keys = (uint64_t*)vec->as.i64s;
+            for (size_t i = 0; i < count; i++) keys[i] = key_of_i64(keys[i]);
+            sort_u64(vm, keys, count);
+            for (size_t i = 0; i < count; i++) keys[i] = key_of_i64(keys[i]);
+            break;
+        }
+        case vec_kind_f64: {
+            // double 不能按 uint64_t 访问(严格别名), 键放在单独的数组里
+            uint64_t* keys = macro_allocate(vm, uint64_t, count);
+            for (size_t i = 0; i < count; i++) {
+                uint64_t bits;
+                memcpy(&bits, &vec->as.f64s[i], sizeof(bits));
+                keys[i] = key_of_f64(bits);
+            }
+            sort_u64(vm, keys, count);
+            for (size_t i = 0; i < count; i++) {
+                uint64_t bits = f64_of_key(keys[i]);
+                memcpy(&vec->as.f64s[i], &bits, sizeof(bits));
+            }
+            macro_free_array(vm, uint64_t, keys, count);
+            break;
+        }
+        default: break;
+    }
+}
+
+/*===============================================================================*/
+// 稳定归并排序
+/*===============================================================================*/
+
+static bool insertion_sort(Value* values, size_t count, ValueLess less, void* context) {
+    for (size_t i = 1; i < count; i++) {
+        Value value = values[i];
+        size_t j = i;
+        for (; j > 0; j--) {
+            bool is_less;
+            if (!less(context, value, values[j - 1], &is_less)) {
+                values[j] = value;      // 放回空位, 不丢元素
+                return false;
+            }
+            if (!is_less) break;
+            values[j] = values[j - 1];
+        }
+        values[j] = value;
+    }
+    return true;
+}
+
+bool values_merge_sort(Value* values, Value* scratch, size_t count, ValueLess less, void* context) {
+    if (count <= merge_threshold) return insertion_sort(values, count, less, context);
+
+    size_t mid = count / 2;
+    if (!values_merge_sort(values, scratch, mid, less, context)) return false;
+    if (!values_merge_sort(values + mid, scratch, count - mid, less, context)) return false;
+
+    // 两半已经有序衔接
+    bool is_less;
+    if (!less(context, values[mid], values[mid - 1], &is_less)) return false;
+    if (!is_less) return true;
+
+    // 左半拷贝到 scratch, 再归并回 values; 相等时取左半保证稳定
+    memcpy(scratch, values, mid * sizeof(Value));
+    size_t i = 0, j = mid, k = 0;
+    while (i < mid && j < count) {
+        if (!less(context, values[j], scratch[i], &is_less)) {
+            // values[k, j) 恰好空出 mid - i 个位置
+            memcpy(values + k, scratch + i, (mid - i) * sizeof(Value));
+            return false;
+        }
+        values[k++] = is_less ? values[j++] : scratch[i++];
+    }
+    if (i < mid) memcpy(values + k, scratch + i, (mid - i) * sizeof(Value));
+    return true;
+}
@@ -5,7 +5,7 @@
 #include <setjmp.h>
 #include <stdalign.h>
 
-#if defined(__GNUC__) && !defined(__clang__)
+#if defined(__GNUC__) || defined(__clang__)
 #define USE_COMPUTED_GOTO 1
 #define LIKELY(x)       __builtin_expect(!!(x), 1)
 #define UNLIKELY(x)     __builtin_expect(!!(x), 0)
@@ -32,6 +32,7 @@
 #include "instance.h"
 #include "bound_method.h"
 #include "closure.h"
+#include "bytecode.h"
 #include "common.h"
 #include "compiler.h"
 #include "error.h"
@@ -67,84 +68,23 @@ static int current_code_index(CallFrame* frame);
 static void define_native(VirtualMachine* self, const char* name, NativeFnPtr function);
 static bool call(VirtualMachine* self, Closure* closure, int arg_count);
 static bool call_value(VirtualMachine* self, Value* callee, int arg_count);
-static bool invoke(VirtualMachine* self, String* name, int arg_count);
+static bool invoke(VirtualMachine* self, String* name, int arg_count, InlineCache* cache);
 static bool invoke_from_class(VirtualMachine* self, Class* klass, String* name, int arg_count);
 static void reset_stack(VirtualMachine* self);
 static InterpretResult run(VirtualMachine* self);
+static InterpretResult run_register(VirtualMachine* self);
 
 static InterpretResult negate(VirtualMachine* self, CallFrame* frame, Operator op);
 
-/*computed goto table run case*/
-static inline InterpretResult handle_op_pop(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_dup(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_constant(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_constant_long(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_value(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_none(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_true(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_false(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_not(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_negate(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_equal(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_not_equal(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_less(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_less_equal(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_greater(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_greater_equal(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_add(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_subtract(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_multiply(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_divide(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_mod(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_bw_and(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_bw_or(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_bw_xor(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_bw_sl(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_bw_sr(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_bw_not(VirtualMachine* self, CallFrame* frame);
-
-static inline InterpretResult handle_op_define_global(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_get_global(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_set_global(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_get_local(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_set_local(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_get_upvalue(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_set_upvalue(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_get_property(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_set_property(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_get_super(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_get_layer_property(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_get_type(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_set_layer_property(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_jump_if_false(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_jump_if_neq(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_jump(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_loop(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_call(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_closure(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_close_upvalue(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_print(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_return(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_break(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_continue(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_match(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_class(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_method(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_inherit(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_invoke(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_super_invoke(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_struct(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_member(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_struct_inherit(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_enum(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_enum_define_member(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_enum_get_member(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_enum_member_bind(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_enum_member_match(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_layer_property_call(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_vector_new(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_vector_set(VirtualMachine* self, CallFrame* frame);
-static inline InterpretResult handle_op_vector_get(VirtualMachine* self, CallFrame* frame);
+/* 指令 handler 原型, 由指令表展开 */
+#define OP_PROTOTYPE_hot(handler)       static inline InterpretResult handler(VirtualMachine* self, CallFrame* frame);
+#define OP_PROTOTYPE_next(handler)      OP_PROTOTYPE_hot(handler)
+#define OP_PROTOTYPE_frame(handler)     OP_PROTOTYPE_hot(handler)
+#define OP_PROTOTYPE_return(handler)    OP_PROTOTYPE_hot(handler)
+#define OP_PROTOTYPE_register(handler)
+#define OP(opcode, width, handler, flow) OP_PROTOTYPE_##flow(handler)
+#include "op_table.inc"
+#undef OP
 
 
 // pointer arithmetic to convert stack index to uint32_t for stack access
@@ -192,8 +132,8 @@ static int current_code_index(CallFrame* frame) {
 }
 
 static bool is_falsey(VirtualMachine* self, Value* value) {
-	switch (value->type) {
-	case VAL_BOOL: return !value->as.boolean;
+	switch (macro_value_type(*value)) {
+	case VAL_BOOL: return !macro_as_bool(*value);
 	default:
 		//  raise runtime error, expected boolean for not operation, found
 		runtime_error(self, "Expected boolean for not operation, Found...");
@@ -228,6 +168,8 @@ void init_virtual_machine(VirtualMachine* self) {
     // self->stack_top = ovm->fast_stack;
 
     self->gc = new_garbage_collector();
+    self->class_version = 0;
+    self->register_mode = false;
 
     self->objects = NULL;
 	self->compiler = NULL;
@@ -238,14 +180,19 @@ void init_virtual_machine(VirtualMachine* self) {
 	init_hashmap(&self->globals, self); // 全局变量
     init_hashmap(&self->types, self);   // 类型
 
-    self->tokens = NULL;
-    self->tokens = new_token_list(self);
+    self->arena = NULL;
+    self->images = NULL;
 
     self->init_string = NULL;
     self->init_string = new_string(self, "init", 4);    // init string
 
+    for (int i = 0; i < well_known_string_count; i++) self->well_known[i] = NULL;
+    self->well_known[string_vec]  = new_string(self, "Vec", 3);
+    self->vec_class = NULL;
+
     /* register type */
     type_register(self, "Vec", &vec_vtable,vec_export_methods);
+    self->vec_class = macro_as_class(hashmap_get(&self->types, self->well_known[string_vec]));
 
 	/* register */
 	define_native(self, "clock",    native_clock);
@@ -260,6 +207,8 @@ void init_virtual_machine(VirtualMachine* self) {
 
 void free_virtual_machine(VirtualMachine* self) {
     self->init_string = NULL;
+    for (int i = 0; i < well_known_string_count; i++) self->well_known[i] = NULL;
+    self->vec_class = NULL;
     self->class_compiler = NULL;
     free_compiler(self->compiler);
 
@@ -267,10 +216,10 @@ void free_virtual_machine(VirtualMachine* self) {
 	free_hashmap(&self->globals);       // free globals internal hash table
     free_hashmap(&self->types);         // free type internal hash table
 
-    free_objects(self->objects);      // free all objects
+    free_gc_heap(self);                 // free all objects
     free_garbage_collector(&self->gc);  // free garbage collector
+    free_bytecode_images(self);         // 对象都释放之后才能解除映射
 
-    free_tokens(self->tokens, self);
 #if debug_enable_allocator
     free_allocator(self->allocator);
 #endif
@@ -280,6 +229,7 @@ void free_virtual_machine(VirtualMachine* self) {
 static void reset_stack(VirtualMachine* self) {
 	self->stack_top = self->stack;
 	self->frame_count = 0;
+	self->frame_base = 0;
 	self->open_upv_ptr = NULL;
 }
 
@@ -289,27 +239,37 @@ Compiler* __attribute__((unused)) replace_compiler(VirtualMachine* self, Compile
 	return old_compiler;
 }
 
+/*
+* 栈空间在 call() 处按 Fn.max_stack 一次性检查, push / pop / peek 不再逐次检查边界;
+* 打开 debug_check_stack 可恢复逐次检查, 用于排查栈深度分析的问题.
+*/
 void push(VirtualMachine* self, Value value) {
+#if debug_check_stack
 	if (self->stack_top >= self->stack + constant_stack_max) {
 		// raise overflow error, overflow the stack
 		panic("[ {PANIC} VirtualMachine::push] stack overflow.");
 	}
+#endif
 	*self->stack_top++ = value;
 }
 
 Value pop(VirtualMachine* self) {
+#if debug_check_stack
 	if (self->stack_top <= self->stack) {
 		// raise underflow error, underflow the stack
 		panic("[ {PANIC} VirtualMachine::pop] stack underflow.");
 	}
+#endif
 	return *(--self->stack_top);
 }
 
 static Value* peek(VirtualMachine* self, int distance) {
+#if debug_check_stack
 	if (self->stack_top - distance < self->stack) {
 		// raise underflow error, underflow the stack
 		panic("[ {PANIC} VirtualMachine::peek] stack underflow.");
 	}
+#endif
 	// return the value at the given distance from the top of the stack
 	return (self->stack_top - 1 - distance);
 }
@@ -321,12 +281,12 @@ static InterpretResult negate(VirtualMachine* self, CallFrame* frame, Operator o
 		panic("[ {PANIC} VirtualMachine::negate] stack underflow.");
 	}
 	Value* slot = peek(self, 0);
-	switch (slot->type)
+	switch (macro_value_type(*slot))
 	{
-	case VAL_I32: slot->as.i32 = -slot->as.i32; break;
-    case VAL_I64: slot->as.i64 = -slot->as.i64; break;
-    case VAL_F32: slot->as.f32 = -slot->as.f32; break;
-	case VAL_F64: slot->as.f64 = -slot->as.f64; break;
+	case VAL_I32: macro_set_i32(slot, -macro_as_i32(*slot)); break;
+    case VAL_I64: macro_set_i64(self, slot, -macro_as_i64(*slot)); break;
+    case VAL_F32: macro_set_f32(slot, -macro_as_f32(*slot)); break;
+	case VAL_F64: macro_set_f64(slot, -macro_as_f64(*slot)); break;
 	default:
         //  raise runtime error, unexpected negate operation
         runtime_error(self, "[VirtualMachine::negate]\n"
@@ -347,9 +307,9 @@ static InterpretResult not_(VirtualMachine* self, CallFrame* frame, Operator op)
 		panic("[ {PANIC} VirtualMachine::not_] stack underflow.");
 	}
 	Value* slot = peek(self, 0);
-	switch (slot->type)
+	switch (macro_value_type(*slot))
 	{
-	case VAL_BOOL: slot->as.boolean = !slot->as.boolean; break;
+	case VAL_BOOL: macro_set_bool(slot, !macro_as_bool(*slot)); break;
 	default:
 		//  raise runtime error, expected boolean for not operation, found...
         runtime_error(self, "[VirtualMachine::negate]\n"
@@ -398,13 +358,18 @@ static void define_enum_member(VirtualMachine* self, String* name) {
             macro_val_from_i32(enum_->members.count),
             macro_val_none
         );
+        push(self, macro_val_from_obj(pair));   // gc 根: hashmap_set 扩容可能触发 gc
         hashmap_set(&enum_->members, name, macro_val_from_obj(pair));
+        gc_write_barrier(&enum_->base, macro_val_from_obj(name));
+        gc_write_barrier(&enum_->base, macro_val_from_obj(pair));
+        pop(self);
         pop(self);
     } else {
         Enum* enum_ = macro_as_enum(peek(self, 1 + store_count));
         Vec* values = new_vec(self);
+        push(self, macro_val_from_obj(values));
         for (int i = 0; i < store_count; i++) {
-            Value value = *peek(self, 1 + i);
+            Value value = *peek(self, 2 + i);
             vec_push(values, value);
         }
         Pair* pair = new_pair(
@@ -412,7 +377,11 @@ static void define_enum_member(VirtualMachine* self, String* name) {
             macro_val_from_i32(enum_->members.count),
             macro_val_from_obj(values)
         );
+        self->stack_top[-1] = macro_val_from_obj(pair);     // pair 引用 values, 替换其栈槽
         hashmap_set(&enum_->members, name, macro_val_from_obj(pair));
+        gc_write_barrier(&enum_->base, macro_val_from_obj(name));
+        gc_write_barrier(&enum_->base, macro_val_from_obj(pair));
+        pop(self);
         for(int i = 0; i < store_count; i++) {
             pop(self);
         }
@@ -425,6 +394,8 @@ static void define_member(VirtualMachine* self, String* name) {
     Struct* struct_ = macro_as_struct(peek(self, 1));
     vec_push(struct_->names, macro_val_from_obj(name));
     hashmap_set(&struct_->fields, name, *initializer);
+    gc_write_barrier(&struct_->base, macro_val_from_obj(name));
+    gc_write_barrier(&struct_->base, *initializer);
 
     struct_->count++;
     pop(self);
@@ -434,6 +405,9 @@ static void define_method(VirtualMachine* self, String* name) {
     Value* method = peek(self, 0);
     Class* klass = macro_as_class_from_vptr(peek(self, 1));
     hashmap_set(&klass->methods, name, *method);
+    gc_write_barrier(&klass->base, macro_val_from_obj(name));
+    gc_write_barrier(&klass->base, *method);
+    klass->version = ++self->class_version;     // invalidate inline caches
     pop(self);
 }
 
@@ -469,17 +443,74 @@ static void report_property_error(VirtualMachine* self, const char* format, Stri
     runtime_error(self, format, name->chars);
 }
 
+/* inline cache: 按 (class, version, shape) 查找已缓存的 entry */
+static inline InlineCacheEntry* inline_cache_lookup(InlineCache* cache, Instance* instance) {
+    for (int i = 0; i < cache->count; i++) {
+        InlineCacheEntry* entry = &cache->entries[i];
+        if (entry->shape == instance->shape &&
+            entry->klass == instance->klass &&
+            entry->version == instance->klass->version) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* inline cache: 优先复用同 (class, shape) 的失效 entry, 否则追加, 满后轮换替换 */
+static void inline_cache_fill(InlineCache* cache, Instance* instance, int slot, Value method) {
+    InlineCacheEntry* entry = NULL;
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->entries[i].shape == instance->shape && cache->entries[i].klass == instance->klass) {
+            entry = &cache->entries[i];
+            break;
+        }
+    }
+    if (entry == NULL) {
+        if (cache->count < inline_cache_ways) {
+            entry = &cache->entries[cache->count++];
+        } else {
+            entry = &cache->entries[cache->next];
+            cache->next = (cache->next + 1) % inline_cache_ways;
+        }
+    }
+    entry->klass = instance->klass;
+    entry->version = instance->klass->version;
+    entry->shape = instance->shape;
+    entry->slot = slot;
+    entry->method = method;
+}
+
+static InterpretResult bind_cached_method(VirtualMachine* self, Value method) {
+    BoundMethod *bound = new_bound_method(self, *peek(self, 0), macro_as_closure(method));
+    self->stack_top[-1] = macro_val_from_obj(bound);
+    return interpret_ok;
+}
+
 // 获取属性值的核心逻辑（实例/结构体）
-static InterpretResult get_property(VirtualMachine* self, Value* holder, String* name) {
+static InterpretResult get_property(VirtualMachine* self, Value* holder, String* name, InlineCache* cache) {
     if (macro_is_instance(*holder)) {
         Instance* instance = macro_as_instance(*holder);
-        Value field_value = hashmap_get(&instance->fields, name);
-        if (!macro_is_null(field_value)) {
-            pop(self); // 弹出实例
-            push(self, field_value);
+        InlineCacheEntry* entry = inline_cache_lookup(cache, instance);
+        if (entry != NULL) {
+            if (entry->slot >= 0) {
+                *holder = instance->fields[entry->slot];  // 替换栈顶实例
+                return interpret_ok;
+            }
+            return bind_cached_method(self, entry->method);
+        }
+
+        int slot = shape_find_slot(instance->shape, name);
+        if (slot >= 0) {
+            inline_cache_fill(cache, instance, slot, macro_val_null);
+            *holder = instance->fields[slot];
             return interpret_ok;
         }
         // 检查方法绑定
+        Value method = hashmap_get(&instance->klass->methods, name);
+        if (!macro_is_null(method)) {
+            inline_cache_fill(cache, instance, -1, method);
+            return bind_cached_method(self, method);
+        }
         return bind_method(self, instance->klass, name) ? interpret_ok : interpret_runtime_error;
     } else if (macro_is_struct(*holder)) {
         Struct* struct_ = macro_as_struct(holder);
@@ -496,10 +527,25 @@ static InterpretResult get_property(VirtualMachine* self, Value* holder, String*
 }
 
 // 设置属性值的核心逻辑（实例/结构体）
-static InterpretResult set_property(VirtualMachine* self, Value* holder, String* name, Value value) {
+static InterpretResult set_property(VirtualMachine* self, Value* holder, String* name, Value value, InlineCache* cache) {
     if (macro_is_instance(*holder)) {
         Instance* instance = macro_as_instance(*holder);
-        hashmap_set(&instance->fields, name, value);
+        InlineCacheEntry* entry = inline_cache_lookup(cache, instance);
+        if (entry != NULL && entry->slot >= 0) {
+            instance->fields[entry->slot] = value;
+            gc_write_barrier(&instance->base, value);
+            return interpret_ok;
+        }
+
+        // 已有字段才缓存; 新增字段会切换 shape, 走 instance_set_field
+        int slot = shape_find_slot(instance->shape, name);
+        if (slot >= 0) {
+            inline_cache_fill(cache, instance, slot, macro_val_null);
+            instance->fields[slot] = value;
+            gc_write_barrier(&instance->base, value);
+            return interpret_ok;
+        }
+        instance_set_field(instance, name, value);
         return interpret_ok;
     } else if (macro_is_struct(*holder)) {
         Struct* struct_ = macro_as_struct(holder);
@@ -508,6 +554,7 @@ static InterpretResult set_property(VirtualMachine* self, Value* holder, String*
             return interpret_runtime_error;
         }
         hashmap_set(&struct_->fields, name, value);
+        gc_write_barrier(&struct_->base, value);
         return interpret_ok;
     }
     return interpret_runtime_error;
@@ -575,12 +622,16 @@ static bool call_value(VirtualMachine* self, Value* callee, int arg_count) {
                 return false;
             } else {
                 Struct* instance = new_struct(self, struct_->name);
+                // 压栈作为 gc 根, hashmap_set 扩容时可能触发 gc
+                push(self, macro_val_from_obj(instance));
+                Value* args = self->stack_top - 1 - arg_count;
 
                 for(int i = struct_->count -1; i >= 0; i--) {
                     String* name = macro_as_string(vec_get(struct_->names, i));
-                    Value value = pop(self);
-                    hashmap_set(&instance->fields, name, value);
+                    hashmap_set(&instance->fields, name, args[i]);
+                    gc_write_barrier(&instance->base, args[i]);
                 }
+                self->stack_top -= arg_count + 1;
                 self->stack_top[-1] = macro_val_from_obj(instance);
             }
             return true;
@@ -622,6 +673,8 @@ static bool call_value(VirtualMachine* self, Value* callee, int arg_count) {
             int adjusted_arg_count = native->is_builtin_method ? arg_count + 1 : arg_count; // build type need to add receiver
             Value* args_start = self->stack_top - adjusted_arg_count;
             Value result = native_fn(self, adjusted_arg_count, args_start);
+            // 原生函数总在某个调用帧内执行; 帧栈被清空说明它报告了运行期错误(runtime_error 会重置栈)
+            if (UNLIKELY(self->frame_count == 0)) return false;
             self->stack_top -= arg_count + 1;  // pop args + function
             push(self, result);
             return true;
@@ -633,6 +686,29 @@ static bool call_value(VirtualMachine* self, Value* callee, int arg_count) {
 	return false;
 }
 
+bool vm_call(VirtualMachine* self, Value callee, int arg_count, Value* args, Value* result) {
+    if (self->stack_top + arg_count + 1 > self->stack + constant_stack_max) {
+        runtime_error(self, "[VirtualMachine::vm_call] Value Stack overflow.");
+        return false;
+    }
+    Value* callee_slot = self->stack_top;
+    *self->stack_top++ = callee;
+    for (int i = 0; i < arg_count; i++) *self->stack_top++ = args[i];
+
+    int depth = self->frame_count;
+    if (!call_value(self, callee_slot, arg_count)) return false;
+    if (self->frame_count > depth) {
+        // 脚本函数: 压入了新帧, 嵌套执行到该帧返回
+        int frame_base = self->frame_base;
+        self->frame_base = depth;
+        InterpretResult status = self->register_mode ? run_register(self) : run(self);
+        self->frame_base = frame_base;
+        if (status != interpret_ok) return false;
+    }
+    *result = *--self->stack_top;
+    return true;
+}
+
 static bool call(VirtualMachine* self, Closure* closure, int arg_count) {
 	if (arg_count != closure->fn->arity) {
 		runtime_error(self, "[VirtualMachine::call] Expected %d arguments, Found %d arguments.",
@@ -643,18 +719,34 @@ static bool call(VirtualMachine* self, Closure* closure, int arg_count) {
 		runtime_error(self, "[VirtualMachine::call] CallFrame Stack overflow.");
 		return false;
 	}
+	// 一次性检查本帧所需的栈空间, 执行期间的 push 不再检查
+	Value* slots = self->stack_top - arg_count - 1;
+	if (slots + closure->fn->max_stack + frame_stack_reserve > self->stack + constant_stack_max) {
+		runtime_error(self, "[VirtualMachine::call] Value Stack overflow.");
+		return false;
+	}
 	CallFrame* frame = &self->frames[self->frame_count++];
 	// set up the new call frame: execute func frame.
 	frame->closure = closure;
 	frame->ip = closure->fn->chunk.code;
-	frame->slots = self->stack_top - arg_count - 1;
+	frame->slots = slots;
 
 	return true;
 }
 
-static bool invoke(VirtualMachine* self, String* name, int arg_count) {
+static bool invoke(VirtualMachine* self, String* name, int arg_count, InlineCache* cache) {
     Value receiver = *peek(self, arg_count);
 
+    // Vec 是一等对象, 方法由内置 Vec 类提供(native, receiver 作为 args[0])
+    if (macro_is_vec(receiver)) {
+        Value method = hashmap_get(&self->vec_class->methods, name);
+        if (macro_is_null(method)) {
+            runtime_error(self, "[VirtualMachine::invoke] Undefined Vec method '%s'.", name->chars);
+            return false;
+        }
+        return call_value(self, &method, arg_count);
+    }
+
     if (!macro_is_instance(receiver)) {
         runtime_error(self, "[VirtualMachine::invoke] Only instances have methods.");
         return false;
@@ -662,6 +754,20 @@ static bool invoke(VirtualMachine* self, String* name, int arg_count) {
 
     Instance* instance = macro_as_instance(receiver);
 
+    InlineCacheEntry* entry = inline_cache_lookup(cache, instance);
+    if (entry != NULL) {
+        if (entry->slot >= 0) {
+            Value value = instance->fields[entry->slot];
+            self->stack_top[-arg_count - 1] = value;
+            return call_value(self, &value, arg_count);
+        }
+        if (macro_is_closure(entry->method)) {
+            return call(self, macro_as_closure(entry->method), arg_count);
+        }
+        Value method = entry->method;
+        return call_value(self, &method, arg_count);
+    }
+
     // handle build type
     if (hashmap_contains_key(&self->types, instance->klass->name)) {
         Value value = hashmap_get(&instance->klass->methods, name);
@@ -669,16 +775,23 @@ static bool invoke(VirtualMachine* self, String* name, int arg_count) {
             runtime_error(self, "[VirtualMachine::invoke] Undefined property '%s'.", name->chars);
             return false;
         }
+        inline_cache_fill(cache, instance, -1, value);
         return call_value(self, &value, arg_count);
     }
 
     // look up the method in the instance's class
-    Value value = hashmap_get(&instance->fields, name);
-    if (!macro_is_null(value)) {
+    int slot = shape_find_slot(instance->shape, name);
+    if (slot >= 0) {
+        inline_cache_fill(cache, instance, slot, macro_val_null);
+        Value value = instance->fields[slot];
         self->stack_top[-arg_count - 1] = value;
         return call_value(self, &value, arg_count);
     }
 
+    Value method = hashmap_get(&instance->klass->methods, name);
+    if (!macro_is_null(method)) {
+        inline_cache_fill(cache, instance, -1, method);
+    }
     return invoke_from_class(self, instance->klass, name, arg_count);
 }
 
@@ -776,15 +889,15 @@ static InterpretResult handle_binary_i64_op(VirtualMachine* vm, Operator op, Val
     int64_t b = macro_as_i64(*rhs);
 
     switch (op) {
-        case ADD: macro_set_i64(lhs, a + b); pop(vm); return interpret_ok;
-        case SUB: macro_set_i64(lhs, a - b); pop(vm); return interpret_ok;
-        case MUL: macro_set_i64(lhs, a * b); pop(vm); return interpret_ok;
+        case ADD: macro_set_i64(vm, lhs, a + b); pop(vm); return interpret_ok;
+        case SUB: macro_set_i64(vm, lhs, a - b); pop(vm); return interpret_ok;
+        case MUL: macro_set_i64(vm, lhs, a * b); pop(vm); return interpret_ok;
         case DIV:
             if (b == 0) {
                 runtime_error(vm, "Division by zero");
                 return interpret_runtime_error;
             }
-            macro_set_i64(lhs, a / b);
+            macro_set_i64(vm, lhs, a / b);
             pop(vm);
             return interpret_ok;
         case MOD:
@@ -792,7 +905,7 @@ static InterpretResult handle_binary_i64_op(VirtualMachine* vm, Operator op, Val
                 runtime_error(vm, "Modulo by zero");
                 return interpret_runtime_error;
             }
-            macro_set_i64(lhs, a % b);
+            macro_set_i64(vm, lhs, a % b);
             pop(vm);
             return interpret_ok;
         case EQ:  macro_set_bool(lhs, a == b); pop(vm); return interpret_ok;
@@ -801,11 +914,11 @@ static InterpretResult handle_binary_i64_op(VirtualMachine* vm, Operator op, Val
         case LT:  macro_set_bool(lhs, a < b);  pop(vm); return interpret_ok;
         case GTE: macro_set_bool(lhs, a >= b); pop(vm); return interpret_ok;
         case LTE: macro_set_bool(lhs, a <= b); pop(vm); return interpret_ok;
-        case SHL: macro_set_i64(lhs, a << b); pop(vm); return interpret_ok;
-        case SHR: macro_set_i64(lhs, a >> b); pop(vm); return interpret_ok;
-        case BIT_AND: macro_set_i64(lhs, a & b); pop(vm); return interpret_ok;
-        case BIT_OR:  macro_set_i64(lhs, a | b); pop(vm); return interpret_ok;
-        case BIT_XOR: macro_set_i64(lhs, a ^ b); pop(vm); return interpret_ok;
+        case SHL: macro_set_i64(vm, lhs, a << b); pop(vm); return interpret_ok;
+        case SHR: macro_set_i64(vm, lhs, a >> b); pop(vm); return interpret_ok;
+        case BIT_AND: macro_set_i64(vm, lhs, a & b); pop(vm); return interpret_ok;
+        case BIT_OR:  macro_set_i64(vm, lhs, a | b); pop(vm); return interpret_ok;
+        case BIT_XOR: macro_set_i64(vm, lhs, a ^ b); pop(vm); return interpret_ok;
         default:
             return MACRO_OP_NOT_SUPPORTED("i64", op);
     }
@@ -932,7 +1045,7 @@ static InterpretResult read_binary(VirtualMachine* self, CallFrame* frame, Opera
     }
 
     // 处理基本类型
-    switch (lhs->type) {
+    switch (macro_value_type(*lhs)) {
         case VAL_I32: return handle_binary_i32_op(self, op, lhs, rhs);
         case VAL_I64: return handle_binary_i64_op(self, op, lhs, rhs);
         case VAL_F32: return handle_binary_f32_op(self, op, lhs, rhs);
@@ -956,10 +1069,10 @@ static InterpretResult read_binary(VirtualMachine* self, CallFrame* frame, Opera
 static InterpretResult handle_unary_i32_op(VirtualMachine* self, Operator op, Value* operand) {
     switch (op) {
         case NEG:
-            operand->as.i32 = -operand->as.i32;
+            macro_set_i32(operand, -macro_as_i32(*operand));
             return interpret_ok;
         case BIT_NOT:
-            operand->as.i32 = ~operand->as.i32;
+            macro_set_i32(operand, ~macro_as_i32(*operand));
             return interpret_ok;
         default:
             runtime_error(self, "Invalid unary operator '%s' for i32",macro_ops_to_string(op));
@@ -970,10 +1083,10 @@ static InterpretResult handle_unary_i32_op(VirtualMachine* self, Operator op, Va
 static InterpretResult handle_unary_i64_op(VirtualMachine* self, Operator op, Value* operand) {
     switch (op) {
         case NEG:
-            operand->as.i64 = -operand->as.i64;
+            macro_set_i64(self, operand, -macro_as_i64(*operand));
             return interpret_ok;
         case BIT_NOT:
-            operand->as.i64 = ~operand->as.i64;
+            macro_set_i64(self, operand, ~macro_as_i64(*operand));
             return interpret_ok;
         default:
             runtime_error(self, "Invalid unary operator '%s' for i64", macro_ops_to_string(op));
@@ -984,7 +1097,7 @@ static InterpretResult handle_unary_i64_op(VirtualMachine* self, Operator op, Va
 static InterpretResult handle_unary_f32_op(VirtualMachine* self, Operator op, Value* operand) {
     switch (op) {
         case NEG:
-            operand->as.f32 = -operand->as.f32;
+            macro_set_f32(operand, -macro_as_f32(*operand));
             return interpret_ok;
         default:
             runtime_error(self, "Invalid unary operator '%s' for f32", macro_ops_to_string(op));
@@ -995,7 +1108,7 @@ static InterpretResult handle_unary_f32_op(VirtualMachine* self, Operator op, Va
 static InterpretResult handle_unary_f64_op(VirtualMachine* self, Operator op, Value* operand) {
     switch (op) {
         case NEG:
-            operand->as.f64 = -operand->as.f64;
+            macro_set_f64(operand, -macro_as_f64(*operand));
             return interpret_ok;
         default:
             runtime_error(self, "Invalid unary operator '%s' for f64", macro_ops_to_string(op));
@@ -1006,7 +1119,7 @@ static InterpretResult handle_unary_f64_op(VirtualMachine* self, Operator op, Va
 static InterpretResult handle_unary_bool_op(VirtualMachine* self, Operator op, Value* operand) {
     switch (op) {
         case NOT:
-            operand->as.boolean = !operand->as.boolean;
+            macro_set_bool(operand, !macro_as_bool(*operand));
             return interpret_ok;
         default:
             runtime_error(self, "Invalid unary operator '%s' for bool", macro_ops_to_string(op));
@@ -1053,7 +1166,7 @@ static InterpretResult read_unary(VirtualMachine *self, CallFrame *frame, Operat
         return interpret_runtime_error;
     }
 
-    switch (operand->type) {
+    switch (macro_value_type(*operand)) {
         case VAL_I32: return handle_unary_i32_op(self, op, operand);
         case VAL_I64: return handle_unary_i64_op(self, op, operand);
         case VAL_F32: return handle_unary_f32_op(self, op, operand);
@@ -1081,14 +1194,18 @@ static InterpretResult read_unary(VirtualMachine *self, CallFrame *frame, Operat
 InterpretResult interpret(VirtualMachine* self, const char* source) {
     Fn* fn = compile(self, source);
     if (fn == NULL) return interpret_compile_error;
+    return interpret_fn(self, fn);
+}
 
+/* 运行已经编译好的顶层函数(compile() 或 load_bytecode() 的结果) */
+InterpretResult interpret_fn(VirtualMachine* self, Fn* fn) {
     push(self, macro_val_from_obj(fn));
     Closure* closure = new_closure(fn);
     pop(self);
     push(self, macro_val_from_obj(closure));
     call(self, closure, 0);					// call the top-level function closure
 
-    return run(self);
+    return self->register_mode ? run_register(self) : run(self);
 }
 
 
@@ -1114,17 +1231,6 @@ InterpretResult interpret(VirtualMachine* self, const char* source) {
 })
 
 
-// SIMD优化宏（x86 SSE）
-#ifdef __SSE2__
-#include <emmintrin.h>
-#define VECTOR_LOAD(ptr) _mm_load_si128((const __m128i*)(ptr))
-#define VECTOR_STORE(ptr, val) _mm_store_si128((__m128i*)(ptr), (val))
-#else
-#define VECTOR_LOAD(ptr) (*(ptr))
-#define VECTOR_STORE(ptr, val) (*(ptr) = (val))
-#endif
-
-
 noreturn void vm_panic(VirtualMachine* self, const char* fmt, ...) {
     OptimizedVM* ovm = (OptimizedVM*)self;
     va_list args;
@@ -1147,1044 +1253,334 @@ noreturn void vm_panic(VirtualMachine* self, const char* fmt, ...) {
 
 
 
-static InterpretResult run(VirtualMachine* self) {
-    // OptimizedVM* ovm = (OptimizedVM*)self;
+#if debug_trace_execution
+/* debug_trace_execution: 打印当前栈与即将执行的指令 */
+static void trace_execution(VirtualMachine* self, CallFrame* frame) {
+    printf("		");
+    for (Value* slot = self->stack; slot < self->stack_top; slot++) {
+        printf("[ ");
+        print_value(*slot);
+        printf(" ]");
+    }
+    printf("\n");
+    disassemble_instruction(&frame->closure->fn->chunk, (int)(frame->ip - frame->closure->fn->chunk.code));
+}
+#endif
 
-    CallFrame* frame = &self->frames[self->frame_count - 1];
+/*
+* run(): 字节码解释循环.
+*
+* 指令清单只有 op_table.inc 一份: 跳转表 / switch 分支都由它展开, 指令语义统一由 handle_op_*() 实现.
+* flow 为 hot 的指令在循环内直接展开快路径, 类型不符或出错等慢路径仍交给对应的 handler.
+*
+* ip / sp(栈顶) / slots / constants 缓存在局部变量中(寄存器):
+*   - 调用 handler 前写回 frame->ip 与 self->stack_top, 返回后重新载入;
+*   - call / invoke / return 之后帧可能已切换, 重新载入整个帧.
+*
+* GCC / Clang 使用 computed goto(direct threading): 每条指令末尾直接跳转到下一条指令的标签;
+* 其他编译器退化为 for + switch.
+*/
+static InterpretResult run(VirtualMachine* self) {
+    CallFrame* frame;
+    uint8_t* ip;
+    Value* sp;
+    Value* slots;
+    Value* constants;
+
+#define macro_load_frame()                                              \
+    do {                                                                \
+        frame = &self->frames[self->frame_count - 1];                   \
+        ip = frame->ip;                                                 \
+        slots = frame->slots;                                           \
+        constants = frame->closure->fn->chunk.constants.values;         \
+        sp = self->stack_top;                                           \
+    } while (false)
+#define macro_store_state() (frame->ip = ip, self->stack_top = sp)
+#define macro_load_state()  (ip = frame->ip, sp = self->stack_top)
+
+#if debug_check_stack
+#define macro_push(value)                                               \
+    do {                                                                \
+        if (UNLIKELY(sp >= self->stack + constant_stack_max)) {         \
+            panic("[ {PANIC} VirtualMachine::push] stack overflow.");   \
+        }                                                               \
+        if (UNLIKELY(sp - slots >= frame->closure->fn->max_stack)) {    \
+            panic("[ {PANIC} VirtualMachine::push] exceeds max_stack."); \
+        }                                                               \
+        *sp++ = (value);                                                \
+    } while (false)
+#define macro_pop()                                                     \
+    do {                                                                \
+        if (UNLIKELY(sp <= self->stack)) {                              \
+            panic("[ {PANIC} VirtualMachine::pop] stack underflow.");   \
+        }                                                               \
+        sp--;                                                           \
+    } while (false)
+#else
+// 栈空间已在 call() 处检查
+#define macro_push(value)   (*sp++ = (value))
+#define macro_pop()         (sp--)
+#endif
+/* 16 bit 跳转偏移(ip 指向操作数) */
+#define macro_jump_offset() ((uint16_t)((ip[0] << 8) | ip[1]))
+
+/* 交给 handler 执行(ip 指向操作数, 尚未读取), 出错直接返回 */
+#define macro_call_handler(handler)                                     \
+    do {                                                                \
+        macro_store_state();                                            \
+        if (UNLIKELY(handler(self, frame) == interpret_runtime_error)) {\
+            return interpret_runtime_error;                             \
+        }                                                               \
+        macro_load_state();                                             \
+    } while (false)
+#define macro_call_frame_handler(handler)                               \
+    do {                                                                \
+        macro_store_state();                                            \
+        if (UNLIKELY(handler(self, frame) == interpret_runtime_error)) {\
+            return interpret_runtime_error;                             \
+        }                                                               \
+        macro_load_frame();                                             \
+    } while (false)
 
-// 错误恢复点
-//    if (setjmp(ovm->error_ctx.env)) {
-//        return interpret_runtime_error;
-//    }
+#if debug_trace_execution
+#define macro_trace_execution() (macro_store_state(), trace_execution(self, frame))
+#else
+#define macro_trace_execution() ((void)0)
+#endif
 
 #if USE_COMPUTED_GOTO
-#define OP_LABEL(op) LABEL_##op:
-#define OP_DISPATCH() goto *op_table[*frame->ip++]
-
-// ========== GCC计算跳转实现 ==========
-// 定义所有指令标签的跳转表
-    static const void* op_table[] = {
-            // 使用 && 获取标签地址（GCC扩展）
-            &&LABEL_op_pop,
-            &&LABEL_op_dup,
-            &&LABEL_op_constant,
-            &&LABEL_op_constant_long,
-            &&LABEL_op_value,
-            &&LABEL_op_none,
-            &&LABEL_op_true,
-            &&LABEL_op_false,
-            &&LABEL_op_not,
-            &&LABEL_op_negate,
-            &&LABEL_op_equal,
-            &&LABEL_op_not_equal,
-            &&LABEL_op_less,
-            &&LABEL_op_less_equal,
-            &&LABEL_op_greater,
-            &&LABEL_op_greater_equal,
-            &&LABEL_op_add,
-            &&LABEL_op_subtract,
-            &&LABEL_op_multiply,
-            &&LABEL_op_divide,
-            &&LABEL_op_mod,
-            &&LABEL_op_bw_and,
-            &&LABEL_op_bw_or,
-            &&LABEL_op_bw_xor,
-            &&LABEL_op_bw_sl,
-            &&LABEL_op_bw_sr,
-            &&LABEL_op_bw_not,
-            &&LABEL_op_define_global,
-            &&LABEL_op_get_global,
-            &&LABEL_op_set_global,
-            &&LABEL_op_get_local,
-            &&LABEL_op_set_local,
-            &&LABEL_op_get_upvalue,
-            &&LABEL_op_set_upvalue,
-            &&LABEL_op_get_property,
-            &&LABEL_op_set_property,
-            &&LABEL_op_get_super,
-            &&LABEL_op_get_layer_property,
-            &&LABEL_op_get_type,
-            &&LABEL_op_jump_if_false,
-            &&LABEL_op_jump_if_neq,
-            &&LABEL_op_jump,
-            &&LABEL_op_loop,
-            &&LABEL_op_call,
-            &&LABEL_op_closure,
-            &&LABEL_op_close_upvalue,
-            &&LABEL_op_print,
-            &&LABEL_op_return,
-            &&LABEL_op_break,
-            &&LABEL_op_continue,
-            &&LABEL_op_match,
-            &&LABEL_op_class,
-            &&LABEL_op_method,
-            &&LABEL_op_inherit,
-            &&LABEL_op_invoke,
-            &&LABEL_op_super_invoke,
-            &&LABEL_op_struct,
-            &&LABEL_op_member,
-            &&LABEL_op_struct_inherit,
-            &&LABEL_op_enum,
-            &&LABEL_op_enum_define_member,
-            &&LABEL_op_enum_get_member,
-            &&LABEL_op_enum_member_bind,
-            &&LABEL_op_enum_member_match,
-            &&LABEL_op_layer_property_call,
-            &&LABEL_op_vector_new,
-            &&LABEL_op_vector_set,
-            &&LABEL_op_vector_get,
-            &&LABEL_UNKNOWN_OPCODE,
+#define OP_LABEL(op)    LABEL_##op:
+#define OP_DISPATCH()   do { macro_trace_execution(); goto *op_table[*ip++]; } while (false)
+#define OP_UNKNOWN()    LABEL_UNKNOWN_OPCODE:
+
+#define OP_TABLE_hot(op)        [op] = &&LABEL_##op,
+#define OP_TABLE_next(op)       [op] = &&LABEL_##op,
+#define OP_TABLE_frame(op)      [op] = &&LABEL_##op,
+#define OP_TABLE_return(op)     [op] = &&LABEL_##op,
+#define OP_TABLE_register(op)
+    // 先用区间初始化把 256 项都指向未知操作码, 再由指令表逐项覆盖(-Woverride-init 在这里是预期的)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+    static const void* op_table[256] = {
+            [0 ... 255] = &&LABEL_UNKNOWN_OPCODE,
+#define OP(opcode, width, handler, flow) OP_TABLE_##flow(opcode)
+#include "op_table.inc"
+#undef OP
     };
+#pragma GCC diagnostic pop
 
-    /* computed goto table*/
+    macro_load_frame();
     OP_DISPATCH();
+#else
+#define OP_LABEL(op)    case op:
+#define OP_DISPATCH()   continue
+#define OP_UNKNOWN()    default:
+
+    macro_load_frame();
+    for (;;) {
+        macro_trace_execution();
+        switch (*ip++) {
+#endif
 
-
-    OP_LABEL(op_pop) {
-        handle_op_pop(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_dup) {
-        handle_op_dup(self, frame);
-        OP_DISPATCH();
-    }
+    /* ---------- hot: 快路径 ---------- */
     OP_LABEL(op_constant) {
-        handle_op_constant(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_constant_long) {
-        handle_op_constant_long(self, frame);
-        OP_DISPATCH();
-    }
-
-    OP_LABEL(op_value) {
-        handle_op_value(self, frame);
+        macro_push(constants[*ip++]);
         OP_DISPATCH();
     }
     OP_LABEL(op_none) {
-        handle_op_none(self, frame);
+        macro_push(macro_val_none);
         OP_DISPATCH();
     }
     OP_LABEL(op_true) {
-        handle_op_true(self, frame);
+        macro_push(macro_val_from_bool(true));
         OP_DISPATCH();
     }
     OP_LABEL(op_false) {
-        handle_op_false(self, frame);
-        OP_DISPATCH();
-    }
-
-    OP_LABEL(op_not) {
-        handle_op_not(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_negate) {
-        handle_op_negate(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_equal) {
-        handle_op_equal(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_not_equal) {
-        handle_op_not_equal(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_less) {
-        handle_op_less(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_less_equal) {
-        handle_op_less_equal(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_greater) {
-        handle_op_greater(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_greater_equal) {
-        handle_op_greater_equal(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_add) {
-        handle_op_add(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_subtract) {
-        handle_op_subtract(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_multiply) {
-        handle_op_multiply(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_divide) {
-        handle_op_divide(self, frame);
-        OP_DISPATCH();
-    }
-
-    OP_LABEL(op_mod) {
-        handle_op_mod(self, frame);
-        OP_DISPATCH();
-    }
-
-    OP_LABEL(op_bw_and) {
-        handle_op_bw_and(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_bw_or) {
-        handle_op_bw_or(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_bw_xor) {
-        handle_op_bw_xor(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_bw_sl) {
-        handle_op_bw_sl(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_bw_sr) {
-        handle_op_bw_sr(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_bw_not) {
-        handle_op_bw_not(self, frame);
-        OP_DISPATCH();
-    }
-
-    OP_LABEL(op_define_global) {
-        handle_op_define_global(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_get_global) {
-        handle_op_get_global(self, frame);
+        macro_push(macro_val_from_bool(false));
         OP_DISPATCH();
     }
-    OP_LABEL(op_set_global) {
-        handle_op_set_global(self, frame);
+    OP_LABEL(op_pop) {
+        macro_pop();
         OP_DISPATCH();
     }
     OP_LABEL(op_get_local) {
-        handle_op_get_local(self, frame);
+        Value value = slots[*ip];
+        if (LIKELY(!macro_is_null(value))) {
+            ip++;
+            macro_push(value);
+            OP_DISPATCH();
+        }
+        macro_call_handler(handle_op_get_local);
         OP_DISPATCH();
     }
     OP_LABEL(op_set_local) {
-        handle_op_set_local(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_get_upvalue) {
-        handle_op_get_upvalue(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_set_upvalue) {
-        handle_op_set_upvalue(self, frame);
-        OP_DISPATCH();
-    }
-
-    OP_LABEL(op_get_property) {
-        handle_op_get_property(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_set_property) {
-        handle_op_set_property(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_get_super) {
-        handle_op_get_super(self, frame);
+        slots[*ip++] = sp[-1];
         OP_DISPATCH();
     }
-    OP_LABEL(op_get_layer_property) {
-        handle_op_get_layer_property(self, frame);
+    OP_LABEL(op_get_local_local) {
+        Value lhs = slots[ip[0]];
+        Value rhs = slots[ip[1]];
+        if (LIKELY(!macro_is_null(lhs) && !macro_is_null(rhs))) {
+            ip += 2;
+            macro_push(lhs);
+            macro_push(rhs);
+            OP_DISPATCH();
+        }
+        macro_call_handler(handle_op_get_local_local);
         OP_DISPATCH();
     }
-    OP_LABEL(op_get_type) {
-        handle_op_get_type(self, frame);
+    OP_LABEL(op_jump) {
+        ip += 2 + macro_jump_offset();
         OP_DISPATCH();
     }
-
     OP_LABEL(op_jump_if_false) {
-        handle_op_jump_if_false(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_jump_if_neq) {
-        handle_op_jump_if_neq(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_jump) {
-        handle_op_jump(self, frame);
+        ip += is_falsey(self, sp - 1) ? 2 + macro_jump_offset() : 2;
         OP_DISPATCH();
     }
     OP_LABEL(op_loop) {
-        handle_op_loop(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_call) {
-        handle_op_call(self, frame);
-        frame = &self->frames[self->frame_count - 1];
+        ip += 2;
+        ip -= (uint16_t)((ip[-2] << 8) | ip[-1]);
         OP_DISPATCH();
     }
 
-    OP_LABEL(op_closure) {
-        handle_op_closure(self, frame);
+    /* i32 快路径; 类型不符(deopt)或溢出交给 handler 处理 */
+    OP_LABEL(op_add_i32) {
+        if (LIKELY(macro_is_i32(sp[-2]) && macro_is_i32(sp[-1]))) {
+            int64_t result = (int64_t)macro_as_i32(sp[-2]) + macro_as_i32(sp[-1]);
+            if (LIKELY(result >= INT32_MIN && result <= INT32_MAX)) {
+                macro_set_i32(&sp[-2], (int32_t)result);
+                sp--;
+                OP_DISPATCH();
+            }
+        }
+        macro_call_handler(handle_op_add_i32);
         OP_DISPATCH();
     }
-    OP_LABEL(op_close_upvalue) {
-        handle_op_close_upvalue(self, frame);
+    OP_LABEL(op_subtract_i32) {
+        if (LIKELY(macro_is_i32(sp[-2]) && macro_is_i32(sp[-1]))) {
+            int64_t result = (int64_t)macro_as_i32(sp[-2]) - macro_as_i32(sp[-1]);
+            if (LIKELY(result >= INT32_MIN && result <= INT32_MAX)) {
+                macro_set_i32(&sp[-2], (int32_t)result);
+                sp--;
+                OP_DISPATCH();
+            }
+        }
+        macro_call_handler(handle_op_subtract_i32);
         OP_DISPATCH();
     }
-
-    OP_LABEL(op_print) {
-        handle_op_print(self, frame);
+    OP_LABEL(op_less_i32) {
+        if (LIKELY(macro_is_i32(sp[-2]) && macro_is_i32(sp[-1]))) {
+            macro_set_bool(&sp[-2], macro_as_i32(sp[-2]) < macro_as_i32(sp[-1]));
+            sp--;
+            OP_DISPATCH();
+        }
+        macro_call_handler(handle_op_less_i32);
+        OP_DISPATCH();
+    }
+
+#define macro_compare_jump_i32(opcode, handler, cmp)                        \
+    OP_LABEL(opcode) {                                                      \
+        if (LIKELY(macro_is_i32(sp[-2]) && macro_is_i32(sp[-1]))) {         \
+            bool result = macro_as_i32(sp[-2]) cmp macro_as_i32(sp[-1]);    \
+            macro_set_bool(&sp[-2], result);                                \
+            sp--;                                                           \
+            ip += result ? 2 : 2 + macro_jump_offset();                     \
+            OP_DISPATCH();                                                  \
+        }                                                                   \
+        macro_call_handler(handler);                                        \
+        OP_DISPATCH();                                                      \
+    }
+    macro_compare_jump_i32(op_less_jump_i32, handle_op_less_jump_i32, <)
+    macro_compare_jump_i32(op_less_equal_jump_i32, handle_op_less_equal_jump_i32, <=)
+    macro_compare_jump_i32(op_greater_jump_i32, handle_op_greater_jump_i32, >)
+    macro_compare_jump_i32(op_greater_equal_jump_i32, handle_op_greater_equal_jump_i32, >=)
+#undef macro_compare_jump_i32
+
+    OP_LABEL(op_compare_local_constant_jump) {
+        Value lhs = slots[ip[0]];
+        Value rhs = constants[ip[1]];
+        if (LIKELY(macro_is_i32(lhs) && macro_is_i32(rhs))) {
+            int32_t a = macro_as_i32(lhs);
+            int32_t b = macro_as_i32(rhs);
+            bool result;
+            switch ((Operator)ip[2]) {
+                case EQ:  result = a == b; break;
+                case NEQ: result = a != b; break;
+                case LT:  result = a < b;  break;
+                case LTE: result = a <= b; break;
+                case GT:  result = a > b;  break;
+                default:  result = a >= b; break;
+            }
+            macro_push(macro_val_from_bool(result));
+            ip += 3;
+            ip += result ? 2 : 2 + macro_jump_offset();
+            OP_DISPATCH();
+        }
+        macro_call_handler(handle_op_compare_local_constant_jump);
         OP_DISPATCH();
     }
+
+    /* ---------- return: handler 返回 interpret_ok 表示脚本执行完毕 ---------- */
     OP_LABEL(op_return) {
-        if(handle_op_return(self, frame) == interpret_ok) {
+        macro_store_state();
+        if (handle_op_return(self, frame) == interpret_ok) {
             return interpret_ok;
         }
-        frame = &self->frames[self->frame_count - 1];
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_break) {
-        handle_op_break(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_continue) {
-        handle_op_continue(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_match) {
-        handle_op_match(self, frame);
-        OP_DISPATCH();
-    }
-
-    OP_LABEL(op_class) {
-        handle_op_class(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_method) {
-        handle_op_method(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_inherit) {
-        handle_op_inherit(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_invoke) {
-        handle_op_invoke(self, frame);
-        frame = &self->frames[self->frame_count - 1];
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_super_invoke) {
-        handle_op_super_invoke(self, frame);
-        frame = &self->frames[self->frame_count - 1];
-        OP_DISPATCH();
-
-    }
-    OP_LABEL(op_struct) {
-        handle_op_struct(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_member) {
-        handle_op_member(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_struct_inherit) {
-        handle_op_struct_inherit(self, frame);
-        OP_DISPATCH();
-    }
-
-    OP_LABEL(op_enum) {
-        handle_op_enum(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_enum_define_member) {
-        handle_op_enum_define_member(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_enum_get_member) {
-        handle_op_enum_get_member(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_enum_member_bind) {
-        handle_op_enum_member_bind(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_enum_member_match) {
-        handle_op_enum_member_match(self, frame);
+        macro_load_frame();
         OP_DISPATCH();
     }
 
-    OP_LABEL(op_layer_property_call) {
-        handle_op_layer_property_call(self, frame);
-        frame = &self->frames[self->frame_count - 1];
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_vector_new) {
-        handle_op_vector_new(self, frame);
-        OP_DISPATCH();
-    }
-    OP_LABEL(op_vector_set) {
-        handle_op_vector_set(self, frame);
-        OP_DISPATCH();
+    /* ---------- next / frame: 由指令表展开 ---------- */
+#define OP_hot(opcode, handler)
+#define OP_return(opcode, handler)
+#define OP_register(opcode, handler)
+#define OP_next(opcode, handler)                                        \
+    OP_LABEL(opcode) {                                                  \
+        macro_call_handler(handler);                                    \
+        OP_DISPATCH();                                                  \
     }
-    OP_LABEL(op_vector_get) {
-        handle_op_vector_get(self, frame);
-        OP_DISPATCH();
+#define OP_frame(opcode, handler)                                       \
+    OP_LABEL(opcode) {                                                  \
+        macro_call_frame_handler(handler);                              \
+        OP_DISPATCH();                                                  \
     }
+#define OP(opcode, width, handler, flow) OP_##flow(opcode, handler)
+#include "op_table.inc"
+#undef OP
+#undef OP_frame
+#undef OP_next
+#undef OP_register
+#undef OP_return
+#undef OP_hot
 
-    LABEL_UNKNOWN_OPCODE: {
-        vm_panic(self,
-                 "Unknown opcode 0x%02X at IP=%td (offset %d)",
-                 *frame->ip,
-                 frame->ip - frame->closure->fn->chunk.code,
-                 current_code_index(frame)
-        );
-        // 明确告知编译器此代码不可达
-        __builtin_unreachable();
+    OP_UNKNOWN() {
+        macro_store_state();
+        panic("[ {PANIC} VirtualMachine::run] Unknown opcode 0x%02X at offset %d.",
+              ip[-1], current_code_index(frame));
     }
 
-#else
-/* read a byte from the current instruction pointer: vm->ip++ goto frame->ip++ */
-#define macro_read_byte() (*frame->ip++)
-/* read a byte from the current instruction pointer: vm->ip++ goto frame->ip++ give it to constant long*/
-// #define macro_read_byte_long() ((*frame->ip++) << 8 | (*frame->ip++))
-#define macro_read_byte_long()                  \
-    ({                                          \
-        uint8_t high = *frame->ip++;            \
-        uint8_t low = *frame->ip++;             \
-        (uint16_t)((high << 8) | low);          \
-    })
-/* read a constant from the constant pool */
-#define macro_read_constant() (frame->closure->fn->chunk.constants.values[macro_read_byte()])
-/* read a constant long from the constant pool */
-#define macro_read_constant_long() (frame->closure->fn->chunk.constants.values[macro_read_byte_long()])
-/* read a short from the current instruction pointer */
-#define macro_runtime_error_raised(result)			\
-    do {											\
-        if (result == interpret_runtime_error) {	\
-            return result;							\
-        }											\
-    } while (false)
-/* read a string from the constant pool */
-#define macro_read_string() (macro_as_string(macro_read_constant()))
-/* read a short from the current instruction pointer */
-#define macro_read_short()											\
-	(frame->ip +=2,													\
-	((uint16_t)(frame->ip[-2]) << 8) | (uint16_t)(frame->ip[-1]))
-
-
-    Value constant;
-
-    while (true) {
-
-/* debug_trace_execution */
-#if debug_trace_execution
-        /* stack trace: print the current stack all at once.
-		*
-		VirtualMachine:
-			Value* stack_top = vm->stack_top;
-			Value* stack = vm->stack;
-			for (int i = 0; i < constant_stack_max; i++) {
-		*/
-		printf("		");
-		for (Value* slot = self->stack; slot < self->stack_top; slot++) {
-			printf("[ ");
-			print_value(*slot);
-			printf(" ]");
-		}
-		printf("\n");
-
-		/* print the current instruction pointer.
-		*
-		VirtualMachine:
-			chunk -> chunk->code [first instruction]
-			ip -> current instruction pointer
-		offset:
-			vm->ip - vm->chunk->code
-		*/
-		disassemble_instruction(&frame->closure->fn->chunk, (int)(frame->ip - frame->closure->fn->chunk.code));
-#endif
-        /* execute the current instruction.
-        *
-        VirtualMachine:
-            push(vm, constant);			// push constant to stack
-            pop(vm);					// pop constant from stack
-        */
-        uint8_t instruction = macro_read_byte();
-        switch (instruction) {
-            case op_constant: {
-                constant = macro_read_constant();
-                push(self, constant);
-                break;
-            }
-            case op_constant_long: {
-                constant = macro_read_constant_long();
-                push(self, constant);
-                break;
-            }
-            case op_value:  push(self, macro_val_from_i32(macro_read_byte())); break;
-            case op_negate: macro_runtime_error_raised(negate(self, frame, NEG)); break;
-            case op_not:    macro_runtime_error_raised(not_(self, frame, NOT)); break;
-            case op_none:	push(self, macro_val_none); break;
-            case op_true:	push(self, macro_val_from_bool(true)); break;
-            case op_false:	push(self, macro_val_from_bool(false)); break;
-            case op_dup:    push(self, *peek(self, 0)); break;
-            case op_equal: {
-                Value right = pop(self);
-                Value left = pop(self);
-                push(self, macro_val_from_bool(values_equal(left, right)));
-                break;
-            }
-            case op_not_equal: {
-                Value right = pop(self);
-                Value left = pop(self);
-                push(self, macro_val_from_bool(!values_equal(left, right)));
-                break;
-            }
-            case op_greater:		macro_runtime_error_raised(read_binary(self, frame, GT)); break;
-            case op_greater_equal:	macro_runtime_error_raised(read_binary(self, frame, GTE)); break;
-            case op_less:			macro_runtime_error_raised(read_binary(self, frame, LT)); break;
-            case op_less_equal:		macro_runtime_error_raised(read_binary(self, frame, LTE)); break;
-            case op_add: {
-                Value* r_slot = peek(self, 0);
-                Value* l_slot = peek(self, 1);
-                macro_check_nullptr(r_slot);
-                macro_check_nullptr(l_slot);
-                if (macro_is_string(*l_slot) && macro_is_string(*r_slot)) {
-                    concatenate_string(self);
-                }
-                else { macro_runtime_error_raised(read_binary(self, frame, ADD)); } break;
-            }
-            case op_subtract:		macro_runtime_error_raised(read_binary(self, frame, SUB)); break;
-            case op_multiply:		macro_runtime_error_raised(read_binary(self, frame, MUL)); break;
-            case op_divide:			macro_runtime_error_raised(read_binary(self, frame, DIV)); break;
-            case op_bw_and:         macro_runtime_error_raised(read_binary(self, frame, BIT_AND)); break;
-            case op_bw_or:          macro_runtime_error_raised(read_binary(self, frame, BIT_OR)); break;
-            case op_bw_xor:         macro_runtime_error_raised(read_binary(self, frame, BIT_XOR)); break;
-            case op_bw_not:         macro_runtime_error_raised(read_unary(self, frame, BIT_NOT)); break;
-            case op_bw_sl:          macro_runtime_error_raised(read_binary(self, frame, SHL)); break;
-            case op_bw_sr:          macro_runtime_error_raised(read_binary(self, frame, SHR)); break;
-            case op_pop: pop(self); break;
-            case op_define_global: {
-                String* identifier = macro_read_string();
-                hashmap_set(&self->globals, identifier, *peek(self, 0));
-                pop(self);
-                break;
-            }
-            case op_set_global: {
-                String* identifier = macro_read_string();
-                Entry* entry = hashmap_get_entry(&self->globals, identifier);
-                if (is_empty_entry(entry)) {
-                    runtime_error(self, "[op_set_global | line %d] where: at runtime undefined global variable '%s'.",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  identifier->chars
-                    );
-                    return interpret_runtime_error;
-                }
-                else {
-                    entry->value = *peek(self, 0);
-                }
-                break;
-            }
-            case op_get_global: {
-                String* identifier = macro_read_string();
-                Value value = hashmap_get(&self->globals, identifier);
-                if (macro_is_null(value)) {
-                    runtime_error(self, "[op_get_global | line %d] where: at runtime undefined global variable '%s'.",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  identifier->chars
-                    );
-                    return interpret_runtime_error;
-                }
-                push(self, value);
-                break;
-            }
-            case op_set_local: {
-                uint8_t slot = macro_read_byte();
-                frame->slots[slot] = *peek(self, 0);
-                break;
-            }
-            case op_get_local: {
-                uint8_t slot = macro_read_byte();
-                Value value = frame->slots[slot];
-                if (macro_is_null(value)) {
-                    runtime_error(self, "[line %d] where: at runtime undefined local variable '%s'.",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  slot
-                    );
-                    return interpret_runtime_error;
-                }
-                push(self, value);
-                break;
-            }
-            case op_get_upvalue: {
-                uint8_t slot = macro_read_byte();
-                push(self, *(frame->closure->upvalue_ptrs[slot]->location));
-                break;
-            }
-            case op_set_upvalue: {
-                uint8_t slot = macro_read_byte();
-                *frame->closure->upvalue_ptrs[slot]->location = *peek(self, 0);
-                break;
-            }
-            case op_get_property: {
-                String* name = macro_read_string();
-                Value* holder = peek(self, 0); // 栈顶是属性持有者
-
-                if (!is_valid_property_holder(holder)) {
-                    runtime_error(self, "[op_get_property] Property access on non-object type.");
-                    return interpret_runtime_error;
-                }
-
-                if (get_property(self, holder, name) != interpret_ok) {
-                    return interpret_runtime_error;
-                }
-                break;
-            }
-            case op_set_property: {
-                String* name = macro_read_string();
-                Value value  = *peek(self, 0);      // 待设置的值
-                Value* holder = peek(self, 1);      // 属性持有者（实例或结构体）
-
-                if (!is_valid_property_holder(holder)) {
-                    runtime_error(self, "[op_set_property] Cannot set property on non-object type.");
-                    return interpret_runtime_error;
-                }
-
-                InterpretResult result = set_property(self, holder, name, value);
-                if (result != interpret_ok) {
-                    return result;
-                }
-
-                // 调整栈：弹出设置的值和持有者，重新推入值以保持表达式结果
-                pop(self); // 弹出值
-                pop(self); // 弹出持有者
-                push(self, value);
-                break;
-            }
-            case op_get_super: {
-                String* method_name = macro_read_string();
-                Class* super_class = macro_as_class(pop(self));
-
-                if (!bind_method(self, super_class, method_name)) {
-                    return interpret_runtime_error;
-                }
-                break;
-            }
-            case op_jump_if_false: {
-                // short: 16-bit unsigned signed integer
-                uint16_t offset = macro_read_short();
-
-                if (is_falsey(self, peek(self, 0))) {
-                    frame->ip += offset;
-                }
-                break;
-            }
-            case op_jump_if_neq: {
-                Value pattern = pop(self);        // pattern
-                Value matched = pop(self);        // matched
-
-                if (!values_equal(matched, pattern)) {
-                    int offset = macro_read_short();
-                    frame->ip += offset;
-                } else {
-                    frame->ip += 2; // skip the offset
-                }
-
-                push(self, matched);
-                break;
-            }
-            case op_jump: {
-                uint16_t offset = macro_read_short();
-                frame->ip += offset;
-                break;
-            }
-            case op_loop: {
-                uint16_t offset = macro_read_short();
-                frame->ip -= offset;
-                break;
-            }
-            case op_match: {
-                // pass match jump
-                (void)macro_read_short();
-                break;
-            }
-            case op_call: {
-                int arg_count = macro_read_byte();
-                // call success value can in frames insert new frame(function call).
-                if (!call_value(self, peek(self, arg_count), arg_count)) {
-                    return interpret_runtime_error;
-                }
-                // update current frame pointer point to the new frame(function call);
-                // ps: set base pointer
-                frame = &self->frames[self->frame_count - 1];
-                break;
-            }
-            case op_invoke: {
-                String* method_name = macro_read_string();
-                int arg_count = macro_read_byte();
-
-                if (!invoke(self, method_name, arg_count)) {
-                    return interpret_runtime_error;
-                }
-
-                frame = &self->frames[self->frame_count - 1];
-                break;
-            }
-            case op_super_invoke: {
-                String* method = macro_read_string();
-                int arg_count = macro_read_byte();
-                Class* super_class = macro_as_class(pop(self));
-
-                if (!invoke_from_class(self, super_class, method, arg_count)) {
-                    runtime_error(self, "[line %d] where: at runtime undefined superclass method '%s'.",
-                                  get_rle_line(
-                                          &frame->closure->fn->chunk.lines,
-                                          current_code_index(frame)
-                                  ),
-                                  method->chars
-                    );
-                    return interpret_runtime_error;
-                }
-                frame = &self->frames[self->frame_count - 1];
-                break;
-            }
-            case op_break: {
-                uint16_t offset = macro_read_short();
-                frame->ip += offset;
-                break;
-            }
-            case op_continue: {
-                uint16_t offset = macro_read_short();
-                frame->ip -= offset;
-                break;
-            }
-            case op_class: {
-                push(self, macro_val_from_obj(new_class(self, macro_read_string())));
-                break;
-            }
-            case op_inherit: {
-                // TODO: inherit class.
-                Value superclass = *peek(self, 1);
-                if (!macro_is_class(superclass)) {
-                    runtime_error(self, "[line %d] where: at runtime superclass must be a class.",
-                                  get_rle_line(
-                                          &frame->closure->fn->chunk.lines,
-                                          current_code_index(frame)
-                                  )
-                    );
-                    return interpret_runtime_error;
-                }
-
-                Class* klass = macro_as_class_from_vptr(peek(self, 0));
-                hashmap_add_all(&macro_as_class(superclass)->methods, &klass->methods);
-                pop(self);  // pop klass
-                break;
-            }
-            case op_method: {
-                define_method(self, macro_read_string());
-                break;
-            }
-            case op_closure: {
-                Fn* fn = macro_as_fn(macro_read_constant());
-                Closure* closure = new_closure(fn);
-                push(self, macro_val_from_obj(closure));
-
-                for (int i = 0; i < closure->upvalue_count; i++) {
-                    upvalue_info_t upv_info = macro_read_byte();
-                    bool is_local = upv_info >> 7;
-                    uint8_t index = upv_info & 0b01111111;
-                    if (is_local) {
-                        closure->upvalue_ptrs[i] = capture_upvalue(self,frame->slots + index);
-                    }
-                    else {
-                        closure->upvalue_ptrs[i] = frame->closure->upvalue_ptrs[index];
-                    }
-                }
-                break;
-            }
-            case op_close_upvalue: {
-                close_upvalues(self->open_upv_ptr, self->stack_top - 1);
-                pop(self);
-                break;
-            }
-            case op_struct: {
-                push(self, macro_val_from_obj(new_struct(self, macro_read_string())));
-                break;
-            }
-            case op_struct_inherit: {
-                Value* value = peek(self, 1);
-                if (!macro_is_struct(*value)){
-                    runtime_error(self, "[line %d] where: at runtime super must be a struct.",
-                                  get_rle_line(
-                                          &frame->closure->fn->chunk.lines,
-                                          current_code_index(frame)
-                                  )
-                    );
-                    return interpret_runtime_error;
-                }
-                Struct* super_ = macro_as_struct(value);
-                Struct* struct_ = macro_as_struct(peek(self, 0));
-                hashmap_add_all(&super_->fields, &struct_->fields);
-                struct_->count = super_->count;
-
-//            for(int i = 0; i < super_->count; i++) {
-//                struct_->names[i] = super_->names[i];
-//            }
-
-                pop(self); // pop struct
-                break;
-            }
-            case op_member: {
-                define_member(self, macro_read_string());
-                break;
-            }
-            case op_enum: {
-                push(self, macro_val_from_obj(new_enum(self, macro_read_string())));
-                break;
-            }
-            case op_enum_define_member: {
-                define_enum_member(self, macro_read_string());
-                break;
-            }
-            case op_enum_get_member: {
-                push(self, macro_val_from_obj(macro_read_string()));
-                break;
-            }
-            case op_enum_member_match: {
-                String* member = macro_as_string(pop(self)); // member
-                Value pattern = pop(self);                  // pattern  enum
-                Value matched = pop(self);                  // matched  instance
-                push(self, matched);
-
-                if (string_equal(macro_as_enum_instance_from_value(matched)->name, member)
-                    && enum_equal(macro_as_enum_from_value(pattern), macro_as_enum_instance_from_value(matched)->enum_type)) {
-                    frame->ip += 2; // skip the offset
-                    EnumInstance* instance = macro_as_enum_instance_from_value(matched);
-                    if (!enum_values_is_empty(instance)) {
-                        size_t store_count = vec_len(instance->values);
-                        for(size_t i = 0; i < store_count; i++) {
-                            push(self, vec_get(macro_as_enum_instance_from_value(matched)->values, i));
-                        }
-                    }
-                } else {
-                    int offset = macro_read_short();
-                    frame->ip += offset;
-                }
-                break;
-            }
-            case op_enum_member_bind: {
-                uint8_t bind_count = macro_read_byte();
-                for(int i = 0; i < bind_count; i++) {
-                    uint8_t index = macro_read_byte();
-                    frame->slots[index] = *peek(self, bind_count - i - 1);
-                }
-                break;
-            }
-            case op_layer_property_call: {
-                String* layer_member = macro_read_string();
-                int arg_count = macro_read_byte();
-                Value* value = peek(self, arg_count);
-
-                if (macro_is_class(*value)) {
-                    // 类静态方法调用：ClassName::method(args)
-                    Class* klass = macro_as_class(*value);
-                    Value method = hashmap_get(&klass->methods, layer_member);
-                    if (macro_is_null(method)) {
-                        runtime_error(self, "Undefined static method '%s'.", layer_member->chars);
-                        return interpret_runtime_error;
-                    }
-                    // 替换栈中的类为方法，准备调用
-                    self->stack_top[-arg_count - 1] = method;
-
-                    // call success value can in frames insert new frame(function call).
-                    if (!call_value(self, &method, arg_count)) {
-                        return interpret_runtime_error;
-                    }
-
-                    // update current frame pointer point to the new frame(function call);
-                    // ps: set base pointer
-                    frame = &self->frames[self->frame_count - 1];
-                    break;
-                } else if (macro_is_enum(*value)) {
-                    Enum* enum_ = macro_as_enum(value);
-                    Value member = hashmap_get(&enum_->members, layer_member);
-                    Pair* pair = macro_as_pair(member);
-
-                    EnumInstance *instance = new_enum_instance(
-                            self,
-                            macro_as_enum(value),
-                            layer_member,
-                            macro_as_i32(pair->first),
-                            arg_count
-                    );
-                    for(int i = arg_count - 1; i >= 0; i--) {
-                        vec_set(instance->values, i, pop(self));
-                    }
-
-                    pop(self);
-                    push(self, macro_val_from_obj(instance));    // TODO: enum instance
-                    break;
-                }
-                break;
-            }
-            case op_get_layer_property: {
-                Value* value = peek(self, 0);
-                String* layer_name = macro_read_string();
-                if (!get_layer_property(self, value, layer_name)) {
-                    return interpret_runtime_error;
-                }
-                break;
-            }
-            case op_get_type: {
-                String* identifier = macro_read_string();
-                Value type = hashmap_get(&self->types, identifier);
-                if (macro_is_null(type)) {
-                    runtime_error(self, "[op_get_type | line %d] where: at runtime undefined global type variable '%s'.",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  identifier->chars
-                    );
-                    return interpret_runtime_error;
-                }
-                push(self, type);
-                break;
-            }
-            case op_vector_new: {
-                uint8_t  element_count = macro_read_byte();
-                Vec* vec = new_vec_with_capacity(self, element_count);
-
-                for (int i = element_count - 1; i >= 0; i--) {
-                    Value element = pop(self);
-                    vec->start[i] = element;
-                    vec->finish++;
-                }
-
-                Class* vector_class = macro_as_class(hashmap_get(
-                        &self->types,
-                        new_string(self, "Vec", 3)
-                )
-                );
-                Instance* vector_instance = new_instance(self, vector_class);
-                hashmap_set(
-                        &vector_instance->fields,
-                        new_string(self, "_data", 5),
-                        macro_val_from_obj(vec)
-                );
-
-                push(self, macro_val_from_obj(vector_instance));
-                break;
-            }
-            case op_vector_get: {
-                Value index_val = pop(self);
-                Value vec_val = pop(self);
-
-                if (!macro_is_instance(vec_val) && strcmp(macro_as_instance(vec_val)->klass->name->chars, "Vec") != 0) {
-                    runtime_error(self, "[line %d] Expected vector for 'op_vector_get', Found %s.",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  macro_type_name(vec_val)
-                    );
-                    return interpret_runtime_error;
-                }
-                if (!macro_is_i32(index_val)) {
-                    runtime_error(self, "[line %d] Expected integer index for 'op_vector_get', Found %s.",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  macro_type_name(index_val)
-                    );
-                    return interpret_runtime_error;
-                }
-
-                Instance* vec_instance = macro_as_instance(vec_val);
-                Vec* vec = macro_as_vec(hashmap_get(
-                        &vec_instance->fields, new_string(self, "_data", 5)));
-                int32_t index = macro_as_i32(index_val);
-
-                if (index < 0 || index >= (int32_t)vec_len(vec)) {
-                    runtime_error(self, "[line %d] Vector index out of bounds (size=%d, index=%d).",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  vec_len(vec), index
-                    );
-                    return interpret_runtime_error;
-                }
-
-                push(self, vec_get(vec, index));
-                break;
-            }
-            case op_vector_set: {
-                // 从栈顶弹出值、索引、向量对象
-                Value value = pop(self);
-                Value index_val = pop(self);
-                Value vec_val = pop(self);
-
-                // 类型检查
-                if (!macro_is_instance(vec_val) && strcmp(macro_as_instance(vec_val)->klass->name->chars, "Vec") != 0) {
-                    runtime_error(self, "[line %d] Expected vector for 'op_vector_get', Found %s.",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  macro_type_name(vec_val)
-                    );
-                    return interpret_runtime_error;
-                }
-                if (!macro_is_i32(index_val)) {
-                    runtime_error(self, "[line %d] Expected integer index for 'op_vector_get', Found %s.",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  macro_type_name(index_val)
-                    );
-                    return interpret_runtime_error;
-                }
-
-                Instance* vec_instance = macro_as_instance(vec_val);
-                Vec* vec = macro_as_vec(hashmap_get(
-                        &vec_instance->fields, new_string(self, "_data", 5)));
-                int32_t index = macro_as_i32(index_val);
-
-                // 索引越界检查
-                if (index < 0 || index >= (int32_t)vec_len(vec)) {
-                    runtime_error(self, "[line %d] Vector index out of bounds (size=%d, index=%d).",
-                                  get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
-                                  vec_len(vec), index
-                    );
-                    return interpret_runtime_error;
-                }
-
-                // 更新向量中的值
-                vec_set(vec, index, value);
-                push(self, value); // 将设置的值重新压栈（可选，根据语义需求）
-                break;
-            }
-            case op_return: {
-                Value result = pop(self);	// pop the return value
-                close_upvalues(self->open_upv_ptr, frame->slots);
-                self->frame_count--;		// jump to the caller frame
-                if (self->frame_count == 0) {
-                    return interpret_ok;
-                }
-
-                // update vm stack top pointer point to the caller frame stack top pointer.
-                // this doesn't need set frame ip pointer,
-                // because caller frame execute frame->ip over
-                // can return to caller frame continue to execute caller->frame->ip++, next.
-                self->stack_top = frame->slots;
-                // push the return value to the caller frame stack.
-                push(self, result);
-                // update frame pointer point to the caller frame.
-                frame = &self->frames[self->frame_count - 1];
-                break;
-            }
-            case op_print: {
-                printf_value(pop(self)); break;
-            }
-            default: panic("[ {PANIC} VirtualMachine::run] Expected run command arm, Found noting arm!");
+#if !USE_COMPUTED_GOTO
         }
     }
-
-#undef macro_read_short
-#undef macro_read_string
-#undef macro_runtime_error_raised
-#undef macro_read_constant_long
-#undef macro_read_constant
-#undef macro_read_byte_long
-#undef macro_read_byte
+#else
+#undef OP_TABLE_register
+#undef OP_TABLE_return
+#undef OP_TABLE_frame
+#undef OP_TABLE_next
+#undef OP_TABLE_hot
 #endif
+#undef OP_UNKNOWN
+#undef OP_DISPATCH
+#undef OP_LABEL
+#undef macro_trace_execution
+#undef macro_call_frame_handler
+#undef macro_call_handler
+#undef macro_jump_offset
+#undef macro_pop
+#undef macro_push
+#undef macro_load_state
+#undef macro_store_state
+#undef macro_load_frame
 }
 
 
@@ -2207,6 +1603,7 @@ static InterpretResult run(VirtualMachine* self) {
 #define macro_read_short(frame)											\
 	(frame->ip +=2,													    \
 	((uint16_t)(frame->ip[-2]) << 8) | (uint16_t)(frame->ip[-1]))
+#define macro_read_cache(frame) (&frame->closure->fn->chunk.caches.caches[macro_read_short(frame)])
 
 
 static inline InterpretResult handle_op_pop(VirtualMachine* self, CallFrame* frame){
@@ -2369,11 +1766,14 @@ static inline InterpretResult handle_op_get_upvalue(VirtualMachine* self, CallFr
 }
 static inline InterpretResult handle_op_set_upvalue(VirtualMachine* self, CallFrame* frame){
     uint8_t slot = macro_read_byte(frame);
-    *frame->closure->upvalue_ptrs[slot]->location = *peek(self, 0);
+    Upvalue* upvalue = frame->closure->upvalue_ptrs[slot];
+    *upvalue->location = *peek(self, 0);
+    gc_write_barrier(&upvalue->base, *peek(self, 0));   // 已关闭的 upvalue 写入的是自身的 closed
     return interpret_ok;
 }
 static inline InterpretResult handle_op_get_property(VirtualMachine* self, CallFrame* frame){
     String* name = macro_read_string(frame);
+    InlineCache* cache = macro_read_cache(frame);
     Value* holder = peek(self, 0); // 栈顶是属性持有者
 
     if (!is_valid_property_holder(holder)) {
@@ -2381,13 +1781,14 @@ static inline InterpretResult handle_op_get_property(VirtualMachine* self, CallF
         return interpret_runtime_error;
     }
 
-    if (get_property(self, holder, name) != interpret_ok) {
+    if (get_property(self, holder, name, cache) != interpret_ok) {
         return interpret_runtime_error;
     }
     return interpret_ok;
 }
 static inline InterpretResult handle_op_set_property(VirtualMachine* self, CallFrame* frame){
     String* name = macro_read_string(frame);
+    InlineCache* cache = macro_read_cache(frame);
     Value value  = *peek(self, 0);      // 待设置的值
     Value* holder = peek(self, 1);      // 属性持有者（实例或结构体）
 
@@ -2396,7 +1797,7 @@ static inline InterpretResult handle_op_set_property(VirtualMachine* self, CallF
         return interpret_runtime_error;
     }
 
-    InterpretResult result = set_property(self, holder, name, value);
+    InterpretResult result = set_property(self, holder, name, value, cache);
     if (result != interpret_ok) {
         return result;
     }
@@ -2507,13 +1908,15 @@ static inline InterpretResult handle_op_closure(VirtualMachine* self, CallFrame*
         else {
             closure->upvalue_ptrs[i] = frame->closure->upvalue_ptrs[index];
         }
+        // capture_upvalue 分配时 closure 可能已经晋升
+        gc_write_barrier(&closure->base, macro_val_from_obj(closure->upvalue_ptrs[i]));
     }
     return interpret_ok;
 }
 static inline InterpretResult handle_op_close_upvalue(VirtualMachine* self, CallFrame* frame){
     (void)frame;
 
-    close_upvalues(self->open_upv_ptr, self->stack_top - 1);
+    close_upvalues(&self->open_upv_ptr, self->stack_top - 1);
     pop(self);
     return interpret_ok;
 }
@@ -2525,11 +1928,8 @@ static inline InterpretResult handle_op_print(VirtualMachine* self, CallFrame* f
 }
 static inline InterpretResult handle_op_return(VirtualMachine* self, CallFrame* frame){
     Value result = pop(self);	// pop the return value
-    close_upvalues(self->open_upv_ptr, frame->slots);
+    close_upvalues(&self->open_upv_ptr, frame->slots);
     self->frame_count--;		// jump to the caller frame
-    if (self->frame_count == 0) {
-        return interpret_ok;
-    }
 
     // update vm stack top pointer point to the caller frame stack top pointer.
     // this doesn't need set frame ip pointer,
@@ -2538,8 +1938,10 @@ static inline InterpretResult handle_op_return(VirtualMachine* self, CallFrame*
     self->stack_top = frame->slots;
     // push the return value to the caller frame stack.
     push(self, result);
-    // update frame pointer point to the caller frame.
-    frame = &self->frames[self->frame_count - 1];
+    // 脚本执行完毕(frame_base == 0), 或 vm_call 发起的调用返回
+    if (self->frame_count == self->frame_base) {
+        return interpret_ok;
+    }
     return interpret_passed;
 }
 static inline InterpretResult handle_op_break(VirtualMachine* self, CallFrame* frame){
@@ -2586,14 +1988,17 @@ static inline InterpretResult handle_op_inherit(VirtualMachine* self, CallFrame*
 
     Class* klass = macro_as_class_from_vptr(peek(self, 0));
     hashmap_add_all(&macro_as_class(superclass)->methods, &klass->methods);
+    gc_write_barrier_bulk(&klass->base);
+    klass->version = ++self->class_version;     // invalidate inline caches
     pop(self);  // pop klass
     return interpret_ok;
 }
 static inline InterpretResult handle_op_invoke(VirtualMachine* self, CallFrame* frame){
     String* method_name = macro_read_string(frame);
     int arg_count = macro_read_byte(frame);
+    InlineCache* cache = macro_read_cache(frame);
 
-    if (!invoke(self, method_name, arg_count)) {
+    if (!invoke(self, method_name, arg_count, cache)) {
         return interpret_runtime_error;
     }
 
@@ -2642,6 +2047,7 @@ static inline InterpretResult handle_op_struct_inherit(VirtualMachine* self, Cal
     Struct* super_ = macro_as_struct(value);
     Struct* struct_ = macro_as_struct(peek(self, 0));
     hashmap_add_all(&super_->fields, &struct_->fields);
+    gc_write_barrier_bulk(&struct_->base);
     vec_extend(struct_->names, super_->names);
     struct_->count = super_->count;
 
@@ -2738,23 +2144,22 @@ static inline InterpretResult handle_op_layer_property_call(VirtualMachine* self
 }
 static inline InterpretResult handle_op_vector_new(VirtualMachine* self, CallFrame* frame){
     uint8_t  element_count = macro_read_byte(frame);
-    Vec* vec = new_vec_with_capacity(self, element_count);
+    Value* elements = self->stack_top - element_count;
 
-    for (int i = element_count - 1; i >= 0; i--) {
-        Value element = pop(self);
-        vec->start[i] = element;
-        vec->finish++;
+    // 元素同为 i32 / i64 / f64 时直接使用紧凑存储
+    VecKind kind = element_count > 0 ? vec_kind_of(elements[0]) : vec_kind_value;
+    for (int i = 1; i < element_count && kind != vec_kind_value; i++) {
+        if (vec_kind_of(elements[i]) != kind) kind = vec_kind_value;
     }
 
-    Class* vector_class = type_find(self, "Vec");
-    Instance* vector_instance = new_instance(self, vector_class);
-    hashmap_set(
-            &vector_instance->fields,
-            new_string(self, "_data", 5),
-            macro_val_from_obj(vec)
-    );
+    Vec* vec = new_vec_with_kind(self, kind, element_count);
+    push(self, macro_val_from_obj(vec));    // gc 根: 空 Vec 按首元素选存储, 混合元素时 vec_push 会重新分配
+    for (int i = 0; i < element_count; i++) {
+        vec_push(vec, elements[i]);
+    }
 
-    push(self, macro_val_from_obj(vector_instance));
+    self->stack_top -= element_count + 1;
+    push(self, macro_val_from_obj(vec));
     return interpret_ok;
 }
 static inline InterpretResult handle_op_vector_set(VirtualMachine* self, CallFrame* frame){
@@ -2763,25 +2168,22 @@ static inline InterpretResult handle_op_vector_set(VirtualMachine* self, CallFra
     Value vec_val = pop(self);
 
     // 类型检查
-    if (UNLIKELY(!macro_is_instance(vec_val))
-        && strcmp(macro_as_instance(vec_val)->klass->name->chars, "Vec") != 0) {
-        runtime_error(self, "[line %d] Expected vector for 'op_vector_get', Found %s.",
+    if (UNLIKELY(!macro_is_vec(vec_val))) {
+        runtime_error(self, "[line %d] Expected vector for 'op_vector_set', Found %s.",
           get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
           macro_type_name(vec_val)
         );
         return interpret_runtime_error;
     }
     if (UNLIKELY(!macro_is_i32(index_val))) {
-        runtime_error(self, "[line %d] Expected integer index for 'op_vector_get', Found %s.",
+        runtime_error(self, "[line %d] Expected integer index for 'op_vector_set', Found %s.",
           get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
           macro_type_name(index_val)
         );
         return interpret_runtime_error;
     }
 
-    Instance* vec_instance = macro_as_instance(vec_val);
-    Vec* vec = macro_as_vec(hashmap_get(
-            &vec_instance->fields, new_string(self, "_data", 5)));
+    Vec* vec = macro_as_vec(vec_val);
     int32_t index = macro_as_i32(index_val);
 
     if (UNLIKELY(index < 0 || index >= (int32_t)vec_len(vec))) {
@@ -2800,8 +2202,7 @@ static inline InterpretResult handle_op_vector_get(VirtualMachine* self, CallFra
     Value index_val = pop(self);
     Value vec_val = pop(self);
 
-    if (UNLIKELY(!macro_is_instance(vec_val))
-        && strcmp(macro_as_instance(vec_val)->klass->name->chars, "Vec") != 0) {
+    if (UNLIKELY(!macro_is_vec(vec_val))) {
         runtime_error(self, "[line %d] Expected vector for 'op_vector_get', Found %s.",
           get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
           macro_type_name(vec_val)
@@ -2816,9 +2217,7 @@ static inline InterpretResult handle_op_vector_get(VirtualMachine* self, CallFra
         return interpret_runtime_error;
     }
 
-    Instance* vec_instance = macro_as_instance(vec_val);
-    Vec* vec = macro_as_vec(hashmap_get(
-            &vec_instance->fields, new_string(self, "_data", 5)));
+    Vec* vec = macro_as_vec(vec_val);
     int32_t index = macro_as_i32(index_val);
 
     if (UNLIKELY(index < 0 || index >= (int32_t)vec_len(vec))) {
@@ -2829,93 +2228,422 @@ static inline InterpretResult handle_op_vector_get(VirtualMachine* self, CallFra
         return interpret_runtime_error;
     }
 
-// 使用缓存预取
-#ifdef __SSE2__
-    _mm_prefetch((const char*)&vec->start[index], _MM_HINT_T0);
-#endif
-    MACRO_SAFE_PUSH(vec->start[index]);
+    Value element = vec_at(vec, index);    // 先取值: NaN-boxing 下装箱 i64 会分配
+    MACRO_SAFE_PUSH(element);
     return interpret_ok;
 }
 
 
 
+
+/*
+* 类型特化指令: 栈顶两个操作数都是期望的类型时直接计算, 跳过 coerce_types / 类型分派;
+* 否则 deopt: 把本条指令改回通用指令(frame->ip[-1]), 再由 read_binary 处理.
+*/
+static inline InterpretResult typed_binary_i32(VirtualMachine* vm, CallFrame* frame, Operator op, uint8_t generic) {
+    Value* rhs = vm->stack_top - 1;
+    Value* lhs = vm->stack_top - 2;
+    if (UNLIKELY(!macro_is_i32(*lhs) || !macro_is_i32(*rhs))) {
+        if (!frame->closure->fn->chunk.is_mapped) frame->ip[-1] = generic;     // 映射的指令只读, 每次走通用路径
+        return read_binary(vm, frame, op);
+    }
+
+    int32_t a = macro_as_i32(*lhs);
+    int32_t b = macro_as_i32(*rhs);
+    switch (op) {
+        case ADD: MACRO_CHECK_I32_OVERFLOW(a, +, b); macro_set_i32(lhs, a + b); break;
+        case SUB: MACRO_CHECK_I32_OVERFLOW(a, -, b); macro_set_i32(lhs, a - b); break;
+        case MUL: MACRO_CHECK_I32_OVERFLOW(a, *, b); macro_set_i32(lhs, a * b); break;
+        case EQ:  macro_set_bool(lhs, a == b); break;
+        case NEQ: macro_set_bool(lhs, a != b); break;
+        case LT:  macro_set_bool(lhs, a < b);  break;
+        case LTE: macro_set_bool(lhs, a <= b); break;
+        case GT:  macro_set_bool(lhs, a > b);  break;
+        case GTE: macro_set_bool(lhs, a >= b); break;
+        default:  break;
+    }
+    vm->stack_top--;
+    return interpret_ok;
+}
+
+static inline InterpretResult typed_binary_f64(VirtualMachine* vm, CallFrame* frame, Operator op, uint8_t generic) {
+    Value* rhs = vm->stack_top - 1;
+    Value* lhs = vm->stack_top - 2;
+    if (UNLIKELY(!macro_is_f64(*lhs) || !macro_is_f64(*rhs))) {
+        if (!frame->closure->fn->chunk.is_mapped) frame->ip[-1] = generic;
+        return read_binary(vm, frame, op);
+    }
+
+    double a = macro_as_f64(*lhs);
+    double b = macro_as_f64(*rhs);
+    switch (op) {
+        case ADD: macro_set_f64(lhs, a + b); break;
+        case SUB: macro_set_f64(lhs, a - b); break;
+        case MUL: macro_set_f64(lhs, a * b); break;
+        case DIV:
+            if (b == 0) {
+                runtime_error(vm, "Division by zero");
+                return interpret_runtime_error;
+            }
+            macro_set_f64(lhs, a / b);
+            break;
+        case LT:  macro_set_bool(lhs, a < b);  break;
+        case LTE: macro_set_bool(lhs, a <= b); break;
+        case GT:  macro_set_bool(lhs, a > b);  break;
+        case GTE: macro_set_bool(lhs, a >= b); break;
+        default:  break;
+    }
+    vm->stack_top--;
+    return interpret_ok;
+}
+
+/* compare_i32 + jump_if_false: 比较结果仍留在栈顶(与分开的两条指令栈效果一致) */
+static inline InterpretResult typed_compare_jump_i32(VirtualMachine* vm, CallFrame* frame, Operator op) {
+    uint16_t offset = macro_read_short(frame);
+    Value* rhs = vm->stack_top - 1;
+    Value* lhs = vm->stack_top - 2;
+
+    if (LIKELY(macro_is_i32(*lhs) && macro_is_i32(*rhs))) {
+        int32_t a = macro_as_i32(*lhs);
+        int32_t b = macro_as_i32(*rhs);
+        bool result;
+        switch (op) {
+            case LT:  result = a < b;  break;
+            case LTE: result = a <= b; break;
+            case GT:  result = a > b;  break;
+            default:  result = a >= b; break;
+        }
+        macro_set_bool(lhs, result);
+        vm->stack_top--;
+        if (!result) frame->ip += offset;
+        return interpret_ok;
+    }
+
+    InterpretResult result = read_binary(vm, frame, op);
+    if (result != interpret_ok) return result;
+    if (is_falsey(vm, peek(vm, 0))) frame->ip += offset;
+    return interpret_ok;
+}
+
+static inline InterpretResult handle_op_add_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_i32(self, frame, ADD, op_add);
+}
+static inline InterpretResult handle_op_subtract_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_i32(self, frame, SUB, op_subtract);
+}
+static inline InterpretResult handle_op_multiply_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_i32(self, frame, MUL, op_multiply);
+}
+static inline InterpretResult handle_op_equal_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_i32(self, frame, EQ, op_equal);
+}
+static inline InterpretResult handle_op_not_equal_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_i32(self, frame, NEQ, op_not_equal);
+}
+static inline InterpretResult handle_op_less_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_i32(self, frame, LT, op_less);
+}
+static inline InterpretResult handle_op_less_equal_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_i32(self, frame, LTE, op_less_equal);
+}
+static inline InterpretResult handle_op_greater_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_i32(self, frame, GT, op_greater);
+}
+static inline InterpretResult handle_op_greater_equal_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_i32(self, frame, GTE, op_greater_equal);
+}
+static inline InterpretResult handle_op_add_f64(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_f64(self, frame, ADD, op_add);
+}
+static inline InterpretResult handle_op_subtract_f64(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_f64(self, frame, SUB, op_subtract);
+}
+static inline InterpretResult handle_op_multiply_f64(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_f64(self, frame, MUL, op_multiply);
+}
+static inline InterpretResult handle_op_divide_f64(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_f64(self, frame, DIV, op_divide);
+}
+static inline InterpretResult handle_op_less_f64(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_f64(self, frame, LT, op_less);
+}
+static inline InterpretResult handle_op_less_equal_f64(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_f64(self, frame, LTE, op_less_equal);
+}
+static inline InterpretResult handle_op_greater_f64(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_f64(self, frame, GT, op_greater);
+}
+static inline InterpretResult handle_op_greater_equal_f64(VirtualMachine* self, CallFrame* frame){
+    return typed_binary_f64(self, frame, GTE, op_greater_equal);
+}
+static inline InterpretResult handle_op_less_jump_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_compare_jump_i32(self, frame, LT);
+}
+static inline InterpretResult handle_op_less_equal_jump_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_compare_jump_i32(self, frame, LTE);
+}
+static inline InterpretResult handle_op_greater_jump_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_compare_jump_i32(self, frame, GT);
+}
+static inline InterpretResult handle_op_greater_equal_jump_i32(VirtualMachine* self, CallFrame* frame){
+    return typed_compare_jump_i32(self, frame, GTE);
+}
+
+
+/* 超级指令读取局部变量, 与 op_get_local 相同的未定义检查 */
+static inline bool read_local(VirtualMachine* self, CallFrame* frame, uint8_t slot, Value* value) {
+    *value = frame->slots[slot];
+    if (UNLIKELY(macro_is_null(*value))) {
+        runtime_error(self, "[line %d] where: at runtime undefined local variable '%d'.",
+              get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
+              slot
+        );
+        return false;
+    }
+    return true;
+}
+static inline InterpretResult handle_op_get_local_local(VirtualMachine* self, CallFrame* frame){
+    Value lhs, rhs;
+    if (!read_local(self, frame, macro_read_byte(frame), &lhs)
+        || !read_local(self, frame, macro_read_byte(frame), &rhs)) {
+        return interpret_runtime_error;
+    }
+    push(self, lhs);
+    push(self, rhs);
+    return interpret_ok;
+}
+static inline InterpretResult handle_op_add_local_local(VirtualMachine* self, CallFrame* frame){
+    Value lhs, rhs;
+    if (!read_local(self, frame, macro_read_byte(frame), &lhs)
+        || !read_local(self, frame, macro_read_byte(frame), &rhs)) {
+        return interpret_runtime_error;
+    }
+    push(self, lhs);
+    push(self, rhs);
+    if (LIKELY(macro_is_i32(lhs) && macro_is_i32(rhs))) {
+        return handle_binary_i32_op(self, ADD, peek(self, 1), peek(self, 0));
+    }
+    return read_binary(self, frame, ADD);
+}
+/* get_local + constant + compare + jump_if_false: 比较结果仍留在栈顶 */
+static inline InterpretResult handle_op_compare_local_constant_jump(VirtualMachine* self, CallFrame* frame){
+    uint8_t slot = macro_read_byte(frame);
+    Value rhs = macro_read_constant(frame);
+    Operator op = (Operator)macro_read_byte(frame);
+    uint16_t offset = macro_read_short(frame);
+    Value lhs;
+    if (!read_local(self, frame, slot, &lhs)) {
+        return interpret_runtime_error;
+    }
+
+    if (LIKELY(macro_is_i32(lhs) && macro_is_i32(rhs))) {
+        int32_t a = macro_as_i32(lhs);
+        int32_t b = macro_as_i32(rhs);
+        bool result;
+        switch (op) {
+            case EQ:  result = a == b; break;
+            case NEQ: result = a != b; break;
+            case LT:  result = a < b;  break;
+            case LTE: result = a <= b; break;
+            case GT:  result = a > b;  break;
+            default:  result = a >= b; break;
+        }
+        push(self, macro_val_from_bool(result));
+        if (!result) frame->ip += offset;
+        return interpret_ok;
+    }
+
+    push(self, lhs);
+    push(self, rhs);
+    InterpretResult result = read_binary(self, frame, op);
+    if (result != interpret_ok) return result;
+    if (is_falsey(self, peek(self, 0))) frame->ip += offset;
+    return interpret_ok;
+}
+static inline InterpretResult handle_op_get_self_property(VirtualMachine* self, CallFrame* frame){
+    Value holder;
+    if (!read_local(self, frame, 0, &holder)) {
+        return interpret_runtime_error;
+    }
+    push(self, holder);
+    // 操作数布局与 op_get_property 相同
+    return handle_op_get_property(self, frame);
+}
+
 static const OpMetadata __attribute__((unused)) op_meta[256] = {
-        [op_pop]        = { "OP_POP", 0, handle_op_pop},
-        [op_dup]        = { "OP_DUP", 0, handle_op_dup},
-        [op_constant]   = { "OP_CONSTANT", 1, handle_op_constant},
-        [op_constant_long] = { "OP_CONSTANT_LONG", 2, handle_op_constant_long},
-        [op_value]      = { "OP_VALUE", 0, handle_op_value},
-        [op_none]       = { "OP_NONE", 0, handle_op_none},
-        [op_true]       = { "OP_TRUE", 0, handle_op_true},
-        [op_false]      = { "OP_FALSE", 0, handle_op_false},
-        [op_not]        = { "OP_NOT", 0, handle_op_not},
-        [op_negate]     = { "OP_NEGATE", 0, handle_op_negate},
-        [op_equal]      = { "OP_EQUAL", 0, handle_op_equal},
-        [op_not_equal]  = { "OP_NOT_EQUAL", 0, handle_op_not_equal},
-        [op_less]       = { "OP_LESS", 0, handle_op_less},
-        [op_less_equal] = { "OP_LESS_EQUAL", 0, handle_op_less_equal},
-        [op_greater]    = { "OP_GREATER", 0, handle_op_greater},
-        [op_greater_equal] = { "OP_GREATER_EQUAL", 0, handle_op_greater_equal},
-        [op_add]        = { "OP_ADD", 0, handle_op_add},
-        [op_subtract]   = { "OP_SUBTRACT", 0, handle_op_subtract},
-        [op_multiply]   = { "OP_MULTIPLY", 0, handle_op_multiply},
-        [op_divide]     = { "OP_DIVIDE", 0, handle_op_divide},
-        [op_bw_and]     = { "OP_BW_AND", 0, handle_op_bw_and},
-        [op_bw_or]      = { "OP_BW_OR", 0, handle_op_bw_or},
-        [op_bw_xor]     = { "OP_BW_XOR", 0, handle_op_bw_xor},
-        [op_bw_sl]      = { "OP_BW_SL", 0, handle_op_bw_sl},
-        [op_bw_sr]      = { "OP_BW_SR", 0, handle_op_bw_sr},
-        [op_bw_not]     = { "OP_BW_NOT", 0, handle_op_bw_not},
-        [op_define_global] = { "OP_DEFINE_GLOBAL", 1, handle_op_define_global},
-        [op_get_global] = { "OP_GET_GLOBAL", 1, handle_op_get_global},
-        [op_set_global] = { "OP_SET_GLOBAL", 1, handle_op_set_global},
-        [op_get_local]  = { "OP_GET_LOCAL", 1, handle_op_get_local},
-        [op_set_local]  = { "OP_SET_LOCAL", 1, handle_op_set_local},
-        [op_get_upvalue]  = { "OP_GET_UPVALUE", 1, handle_op_get_upvalue},
-        [op_set_upvalue]  = { "OP_SET_UPVALUE", 1, handle_op_set_upvalue},
-        [op_get_property] = { "OP_GET_PROPERTY", 1, handle_op_get_property},
-        [op_set_property] = { "OP_SET_PROPERTY", 1, handle_op_set_property},
-        [op_get_super]  = { "OP_GET_SUPER", 1, handle_op_get_super},
-        [op_get_layer_property] = { "OP_GET_LAYER_PROPERTY", 1, handle_op_get_layer_property},
-        [op_get_type]   = { "OP_GET_TYPE", 1, handle_op_get_type},
-        [op_jump_if_false] = { "OP_JUMP_IF_FALSE", 2, handle_op_jump_if_false},
-        [op_jump_if_neq] = { "OP_JUMP_IF_NEQ", 2, handle_op_jump_if_neq},
-        [op_jump]       = { "OP_JUMP", 2, handle_op_jump},
-        [op_loop]       = { "OP_LOOP", 2, handle_op_loop},
-        [op_call]       = { "OP_CALL", 1, handle_op_call},
-        [op_closure]    = { "OP_CLOSURE", 2, handle_op_closure},
-        [op_close_upvalue] = { "OP_CLOSE_UPVALUE", 0, handle_op_close_upvalue},
-        [op_print]      = { "OP_PRINT", 0, handle_op_print},
-        [op_return]     = { "OP_RETURN", 0, handle_op_return},
-        [op_break]      = { "OP_BREAK", 0, handle_op_break},
-        [op_continue]   = { "OP_CONTINUE", 0, handle_op_continue},
-        [op_match]      = { "OP_MATCH", 0, handle_op_match},
-        [op_class]      = { "OP_CLASS", 1, handle_op_class},
-        [op_method]     = { "OP_METHOD", 1, handle_op_method},
-        [op_inherit]    = { "OP_INHERIT", 0, handle_op_inherit},
-        [op_invoke]     = { "OP_INVOKE", 2, handle_op_invoke},
-        [op_super_invoke] = { "OP_SUPER_INVOKE", 2, handle_op_super_invoke},
-        [op_struct]     = { "OP_STRUCT", 1, handle_op_struct},
-        [op_member]     = { "OP_MEMBER", 1, handle_op_member},
-        [op_struct_inherit] = { "OP_STRUCT_INHERIT", 0, handle_op_struct_inherit},
-        [op_enum]       = { "OP_ENUM", 1, handle_op_enum},
-        [op_enum_define_member] = { "OP_ENUM_DEFINE_MEMBER", 1, handle_op_enum_define_member},
-        [op_enum_get_member]    = { "OP_ENUM_GET_MEMBER", 1, handle_op_enum_get_member},
-        [op_enum_member_bind]   = { "OP_ENUM_MEMBER_BIND", 1, handle_op_enum_member_bind},
-        [op_enum_member_match]  = { "OP_ENUM_MEMBER_MATCH", 1, handle_op_enum_member_match},
-        [op_layer_property_call] = { "OP_LAYER_PROPERTY_CALL", 1, handle_op_layer_property_call},
-        [op_vector_new] = { "OP_VECTOR_NEW", 1, handle_op_vector_new},
-        [op_vector_set] = { "OP_VECTOR_SET", 1, handle_op_vector_set},
-        [op_vector_get] = { "OP_VECTOR_GET", 1, handle_op_vector_get},
+#define OP(opcode, width, handler, flow) [opcode] = { #opcode, width, handler },
+#include "op_table.inc"
+#undef OP
 };
 
 
+/*
+* 读取 RK 操作数: 常量池 或 当前帧 slot.
+* slot 为 null 时与 op_get_local 一致, 报未定义的局部变量.
+*/
+static inline Value* register_operand(VirtualMachine* self, CallFrame* frame, uint8_t rk) {
+    if (macro_rk_is_constant(rk)) {
+        return &frame->closure->fn->chunk.constants.values[macro_rk_index(rk)];
+    }
+    Value* value = &frame->slots[rk];
+    if (UNLIKELY(macro_is_null(*value))) {
+        runtime_error(self, "[line %d] where: at runtime undefined local variable(slot %d).",
+              get_rle_line(&frame->closure->fn->chunk.lines, current_code_index(frame)),
+              rk
+        );
+        return NULL;
+    }
+    return value;
+}
+
+/*
+* 3-address 二元运算: R[A] = RK(B) op RK(C), A == reg_push 时结果压栈.
+* i32 / f64 同类型直接计算, 其余情况(类型提升, 对象运算符, 错误信息)借用栈上的 read_binary.
+*/
+static inline InterpretResult register_binary(VirtualMachine* vm, CallFrame* frame, Operator op) {
+    uint8_t dst = macro_read_byte(frame);
+    Value* lhs = register_operand(vm, frame, macro_read_byte(frame));
+    if (lhs == NULL) return interpret_runtime_error;
+    Value* rhs = register_operand(vm, frame, macro_read_byte(frame));
+    if (rhs == NULL) return interpret_runtime_error;
+
+    Value result;
+    if (macro_is_i32(*lhs) && macro_is_i32(*rhs)) {
+        int32_t a = macro_as_i32(*lhs);
+        int32_t b = macro_as_i32(*rhs);
+        switch (op) {
+            case ADD: MACRO_CHECK_I32_OVERFLOW(a, +, b); result = macro_val_from_i32(a + b); goto store;
+            case SUB: MACRO_CHECK_I32_OVERFLOW(a, -, b); result = macro_val_from_i32(a - b); goto store;
+            case MUL: MACRO_CHECK_I32_OVERFLOW(a, *, b); result = macro_val_from_i32(a * b); goto store;
+            case DIV: if (b == 0) break; result = macro_val_from_i32(a / b); goto store;
+            case MOD: if (b == 0) break; result = macro_val_from_i32(a % b); goto store;
+            case EQ:  result = macro_val_from_bool(a == b); goto store;
+            case NEQ: result = macro_val_from_bool(a != b); goto store;
+            case LT:  result = macro_val_from_bool(a < b);  goto store;
+            case LTE: result = macro_val_from_bool(a <= b); goto store;
+            case GT:  result = macro_val_from_bool(a > b);  goto store;
+            case GTE: result = macro_val_from_bool(a >= b); goto store;
+            default: break;
+        }
+    } else if (macro_is_f64(*lhs) && macro_is_f64(*rhs)) {
+        double a = macro_as_f64(*lhs);
+        double b = macro_as_f64(*rhs);
+        switch (op) {
+            case ADD: result = macro_val_from_f64(a + b); goto store;
+            case SUB: result = macro_val_from_f64(a - b); goto store;
+            case MUL: result = macro_val_from_f64(a * b); goto store;
+            case EQ:  result = macro_val_from_bool(a == b); goto store;
+            case NEQ: result = macro_val_from_bool(a != b); goto store;
+            case LT:  result = macro_val_from_bool(a < b);  goto store;
+            case LTE: result = macro_val_from_bool(a <= b); goto store;
+            case GT:  result = macro_val_from_bool(a > b);  goto store;
+            case GTE: result = macro_val_from_bool(a >= b); goto store;
+            default: break;
+        }
+    }
+
+    push(vm, *lhs);
+    push(vm, *rhs);
+    InterpretResult status = read_binary(vm, frame, op);
+    if (status != interpret_ok) return status;
+    if (dst != reg_push) {
+        frame->slots[dst] = pop(vm);
+    }
+    return interpret_ok;
+
+store:
+    if (dst == reg_push) {
+        push(vm, result);
+    } else {
+        frame->slots[dst] = result;
+    }
+    return interpret_ok;
+}
+
+/*
+* run_register: 寄存器模式(-r)的执行器.
+*   - op_r_* 直接在当前帧 slot 上读写, 省去 get_local/constant 的压栈和 read_binary 的出栈
+*   - 其余栈指令与 run() 共用 op_meta 中的 handler
+*/
+static InterpretResult run_register(VirtualMachine* self) {
+    CallFrame* frame = &self->frames[self->frame_count - 1];
+
+    while (true) {
+        uint8_t instruction = macro_read_byte(frame);
+        InterpretResult result;
+
+        switch (instruction) {
+            case op_r_move: {
+                uint8_t dst = macro_read_byte(frame);
+                Value* src = register_operand(self, frame, macro_read_byte(frame));
+                if (src == NULL) return interpret_runtime_error;
+                frame->slots[dst] = *src;
+                continue;
+            }
+            case op_r_add:              result = register_binary(self, frame, ADD); break;
+            case op_r_subtract:         result = register_binary(self, frame, SUB); break;
+            case op_r_multiply:         result = register_binary(self, frame, MUL); break;
+            case op_r_divide:           result = register_binary(self, frame, DIV); break;
+            case op_r_mod:              result = register_binary(self, frame, MOD); break;
+            case op_r_equal:            result = register_binary(self, frame, EQ);  break;
+            case op_r_not_equal:        result = register_binary(self, frame, NEQ); break;
+            case op_r_less:             result = register_binary(self, frame, LT);  break;
+            case op_r_less_equal:       result = register_binary(self, frame, LTE); break;
+            case op_r_greater:          result = register_binary(self, frame, GT);  break;
+            case op_r_greater_equal:    result = register_binary(self, frame, GTE); break;
+            // 常见栈指令直接调用(可内联), 避免经 op_meta 的间接调用
+            case op_pop:            result = handle_op_pop(self, frame); break;
+            case op_constant:       result = handle_op_constant(self, frame); break;
+            case op_true:           result = handle_op_true(self, frame); break;
+            case op_false:          result = handle_op_false(self, frame); break;
+            case op_get_local:      result = handle_op_get_local(self, frame); break;
+            case op_set_local:      result = handle_op_set_local(self, frame); break;
+            case op_get_global:     result = handle_op_get_global(self, frame); break;
+            case op_set_global:     result = handle_op_set_global(self, frame); break;
+            case op_get_property:   result = handle_op_get_property(self, frame); break;
+            case op_set_property:   result = handle_op_set_property(self, frame); break;
+            case op_add:            result = handle_op_add(self, frame); break;
+            case op_subtract:       result = handle_op_subtract(self, frame); break;
+            case op_less:           result = handle_op_less(self, frame); break;
+            case op_jump_if_false:  result = handle_op_jump_if_false(self, frame); break;
+            case op_jump:           result = handle_op_jump(self, frame); break;
+            case op_loop:           result = handle_op_loop(self, frame); break;
+            case op_vector_get:     result = handle_op_vector_get(self, frame); break;
+            case op_vector_set:     result = handle_op_vector_set(self, frame); break;
+            case op_return: {
+                if (handle_op_return(self, frame) == interpret_ok) {
+                    return interpret_ok;
+                }
+                frame = &self->frames[self->frame_count - 1];
+                continue;
+            }
+            default: {
+                OperatorHandler handler = op_meta[instruction].handler;
+                if (UNLIKELY(handler == NULL)) {
+                    vm_panic(self, "Unknown opcode 0x%02X at offset %d", instruction, current_code_index(frame));
+                }
+                if (UNLIKELY(handler(self, frame) == interpret_runtime_error)) {
+                    return interpret_runtime_error;
+                }
+                // call / invoke 等会切换帧
+                frame = &self->frames[self->frame_count - 1];
+                continue;
+            }
+        }
+        if (UNLIKELY(result == interpret_runtime_error)) {
+            return result;
+        }
+    }
+}
+
+
 #undef macro_read_byte
 #undef macro_read_byte_long
 #undef macro_read_constant
 #undef macro_read_constant_long
 #undef macro_runtime_error_raised
 #undef macro_read_string
+#undef macro_read_cache
 #undef macro_read_short
 
 /* just-in-time compilation(JIT) */
@@ -0,0 +1,105 @@
+//
+// Created by Kilig on 2025/5/18.
+//
+
+#include <stdlib.h>
+
+#include "work_deque.h"
+#include "error.h"
+
+
+static WorkBuffer* new_work_buffer(int64_t capacity) {
+    WorkBuffer* buffer = malloc(sizeof(WorkBuffer) + (size_t)capacity * sizeof(_Atomic(void*)));
+    if (buffer == NULL) {
+        panic(" {PANIC} [work_deque::new_work_buffer] work deque malloc memory fail.");
+    }
+    buffer->capacity = capacity;
+    buffer->prev = NULL;
+    return buffer;
+}
+
+void work_deque_init(WorkDeque* self, int64_t capacity) {
+    atomic_init(&self->top, 0);
+    atomic_init(&self->bottom, 0);
+    atomic_init(&self->buffer, new_work_buffer(capacity));
+}
+
+void work_deque_free(WorkDeque* self) {
+    WorkBuffer* buffer = atomic_load_explicit(&self->buffer, memory_order_relaxed);
+    while (buffer != NULL) {
+        WorkBuffer* prev = buffer->prev;
+        free(buffer);
+        buffer = prev;
+    }
+    atomic_store_explicit(&self->buffer, NULL, memory_order_relaxed);
+}
+
+/* 扩容: 只有拥有者调用, [top, bottom) 拷贝到新数组 */
+static WorkBuffer* grow_work_buffer(WorkDeque* self, WorkBuffer* old, int64_t top, int64_t bottom) {
+    WorkBuffer* buffer = new_work_buffer(old->capacity * 2);
+    for (int64_t i = top; i < bottom; i++) {
+        void* item = atomic_load_explicit(&old->items[i & (old->capacity - 1)], memory_order_relaxed);
+        atomic_store_explicit(&buffer->items[i & (buffer->capacity - 1)], item, memory_order_relaxed);
+    }
+    buffer->prev = old;
+    atomic_store_explicit(&self->buffer, buffer, memory_order_release);
+    return buffer;
+}
+
+void work_deque_push(WorkDeque* self, void* item) {
+    int64_t bottom = atomic_load_explicit(&self->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&self->top, memory_order_acquire);
+    WorkBuffer* buffer = atomic_load_explicit(&self->buffer, memory_order_relaxed);
+    if (bottom - top > buffer->capacity - 1) {
+        buffer = grow_work_buffer(self, buffer, top, bottom);
+    }
+    atomic_store_explicit(&buffer->items[bottom & (buffer->capacity - 1)], item, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&self->bottom, bottom + 1, memory_order_relaxed);
+}
+
+/* 拥有者取栈顶; 空(或最后一个被窃取)返回 NULL */
+void* work_deque_pop(WorkDeque* self) {
+    int64_t bottom = atomic_load_explicit(&self->bottom, memory_order_relaxed) - 1;
+    WorkBuffer* buffer = atomic_load_explicit(&self->buffer, memory_order_relaxed);
+    atomic_store_explicit(&self->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&self->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&self->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+    void* item = atomic_load_explicit(&buffer->items[bottom & (buffer->capacity - 1)], memory_order_relaxed);
+    if (top == bottom) {
+        // 只剩一个元素: 与窃取者竞争
+        if (!atomic_compare_exchange_strong_explicit(&self->top, &top, top + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            item = NULL;
+        }
+        atomic_store_explicit(&self->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return item;
+}
+
+/* 其他线程从另一端窃取; 空或竞争失败返回 NULL */
+void* work_deque_steal(WorkDeque* self) {
+    int64_t top = atomic_load_explicit(&self->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&self->bottom, memory_order_acquire);
+    if (top >= bottom) return NULL;
+
+    WorkBuffer* buffer = atomic_load_explicit(&self->buffer, memory_order_acquire);
+    void* item = atomic_load_explicit(&buffer->items[top & (buffer->capacity - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&self->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return item;
+}
+
+bool work_deque_is_empty(WorkDeque* self) {
+    int64_t top = atomic_load_explicit(&self->top, memory_order_acquire);
+    int64_t bottom = atomic_load_explicit(&self->bottom, memory_order_acquire);
+    return bottom <= top;
+}
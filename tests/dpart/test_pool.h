@@ -48,14 +48,17 @@ void test_basic_operation() {
     assert(*obj == 42);
     pool_free(pool, obj);
 
-    // 测试池空情况
+    // 测试池空情况: 用完一块后自动扩容
     void* objs[100];
     for (int i = 0; i < 100; ++i) {
         objs[i] = pool_alloc(pool);
         assert(objs[i] != NULL);
     }
-    assert(pool_alloc(pool) == NULL);
+    void* extra = pool_alloc(pool);
+    assert(extra != NULL);
+    assert(atomic_load(&pool->block_cnt) == 2);
 
+    pool_free(pool, extra);
     for(int i = 0; i < 100; ++i) {
         pool_free(pool, objs[i]);
     }
@@ -256,4 +259,28 @@ void test_alignment() {
 }
 
 
+void test_packed_pool() {
+    // 紧凑池: 节点只按 16 字节对齐, 相邻节点间隔 16 + 对齐后的对象大小
+    Pool* pool = pool_create_packed(56, 4);
+    assert(pool != NULL && pool->node_size == 16 + 64);
+
+    void* objs[6];
+    for (int i = 0; i < 6; ++i) {
+        objs[i] = pool_alloc(pool);
+        assert(objs[i] != NULL && (uintptr_t)objs[i] % 16 == 0);
+    }
+    assert((uint8_t*)objs[1] - (uint8_t*)objs[0] == (ptrdiff_t)pool->node_size);
+    assert(atomic_load(&pool->block_cnt) == 2);
+
+    // 批量释放进线程缓存, pool_alloc 优先从缓存取回
+    pool_free_batch(pool, objs, 6);
+    assert(pool_alloc(pool) == objs[5]);
+    pool_free(pool, objs[5]);
+
+    pool_destroy(&pool);
+    assert(pool == NULL);
+    printf("Packed pool test passed\n");
+}
+
+
 #endif //JOKER_TEST_POOL_H